@@ -0,0 +1,172 @@
+/* osgEarth
+* Copyright 2025 Pelican Mapping
+* MIT License
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/MapNode>
+#include <osgEarth/Threading>
+#include <osgEarthProcedural/LifeMapLayer>
+#include <osgDB/ReadFile>
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <thread>
+
+#define LC "[bakelifemap] "
+
+using namespace osgEarth;
+using namespace osgEarth::Procedural;
+
+int
+usage(const char* name, const std::string& error)
+{
+    OE_NOTICE
+        << "Error: " << error
+        << "\nUsage:"
+        << "\n" << name << " file.earth"
+        << "\n  --layer layername                    ; name of LifeMap layer (optional)"
+        << "\n  --extents swlong swlat nelong nelat  ; extents in degrees"
+        << "\n  --min-level level                    ; lowest level to bake (default = 1)"
+        << "\n  --max-level level                    ; highest level to bake"
+        << "\n  --threads num                        ; number of threads (optional)"
+        << "\n\nTiles are written to the LifeMap layer's cache, which must be enabled"
+        << "\nand writeable in the earth file."
+        << std::endl;
+
+    return -1;
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    std::string layername;
+    arguments.read("--layer", layername);
+
+    double xmin, ymin, xmax, ymax;
+    if (!arguments.read("--extents", xmin, ymin, xmax, ymax))
+        return usage(argv[0], "Missing --extents");
+
+    unsigned minLevel = 1u, maxLevel = 0u;
+    arguments.read("--min-level", minLevel);
+    if (!arguments.read("--max-level", maxLevel))
+        return usage(argv[0], "Missing --max-level");
+
+    // Tiles are baked as sibling quads, so level 0 is not available
+    minLevel = std::max(minLevel, 1u);
+    if (maxLevel < minLevel)
+        return usage(argv[0], "--max-level must be at least --min-level");
+
+    unsigned numThreads = 0u;
+    arguments.read("--threads", numThreads);
+
+    osg::ref_ptr<osg::Node> node = osgDB::readNodeFiles(arguments);
+    osg::ref_ptr<MapNode> mapNode = MapNode::get(node.get());
+    if (!mapNode.valid())
+        return usage(argv[0], "No earth file");
+
+    const Map* map = mapNode->getMap();
+
+    LifeMapLayer* lifemap =
+        !layername.empty() ? map->getLayerByName<LifeMapLayer>(layername) :
+        map->getLayer<LifeMapLayer>();
+
+    if (!lifemap)
+        return usage(argv[0], "Cannot find LifeMap layer in map");
+
+    if (!lifemap->isOpen())
+        return usage(argv[0], lifemap->getStatus().message());
+
+    if (!lifemap->getCacheSettings() ||
+        !lifemap->getCacheSettings()->isCacheEnabled() ||
+        !lifemap->getCacheSettings()->cachePolicy()->isCacheWriteable())
+    {
+        return usage(argv[0], "LifeMap layer does not have a writeable cache");
+    }
+
+    const Profile* profile = lifemap->getProfile();
+    GeoExtent extent(SpatialReference::get("wgs84"), xmin, ymin, xmax, ymax);
+
+    // Group the tiles at each level by parent, so that siblings are
+    // created together and share their elevation, normal and land cover
+    // neighborhoods.
+    std::vector<std::vector<TileKey>> quads;
+    unsigned numTiles = 0u;
+
+    for (unsigned lod = minLevel; lod <= maxLevel; ++lod)
+    {
+        std::vector<TileKey> keys;
+        profile->getIntersectingTiles(extent, lod, keys);
+
+        std::set<TileKey> parents;
+        for (auto& key : keys)
+            parents.insert(key.createParentKey());
+
+        for (auto& parent : parents)
+        {
+            std::vector<TileKey> quad;
+            for (unsigned q = 0; q < 4; ++q)
+            {
+                TileKey child = parent.createChildKey(q);
+                if (child.getExtent().intersects(extent))
+                    quad.push_back(child);
+            }
+            numTiles += quad.size();
+            quads.emplace_back(std::move(quad));
+        }
+    }
+
+    if (quads.empty())
+        return usage(argv[0], "No tiles in extent");
+
+    std::cout << "Baking " << numTiles << " tiles in " << quads.size() << " groups.." << std::endl;
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+
+    auto pool = jobs::get_pool("oe.bakelifemap", numThreads > 0 ? numThreads : std::thread::hardware_concurrency());
+    auto group = jobs::jobgroup::create();
+
+    std::atomic<unsigned> done(0u), failed(0u);
+
+    for (auto& quad : quads)
+    {
+        jobs::context job;
+        job.name = "Bake LifeMap";
+        job.pool = pool;
+        job.group = group;
+
+        jobs::dispatch([lifemap, &quad, &done, &failed]()
+            {
+                // createImages writes each result to the layer's cache
+                std::vector<GeoImage> images = lifemap->createImages(quad, nullptr);
+                for (auto& image : images)
+                {
+                    if (!image.valid())
+                        ++failed;
+                }
+                done += quad.size();
+            }, job);
+    }
+
+    unsigned reported = 0u;
+    while (reported < numTiles)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        reported = done;
+        std::cout << "\r" << reported << "/" << numTiles << std::flush;
+    }
+    group->join();
+
+    osg::Timer_t end = osg::Timer::instance()->tick();
+
+    std::cout
+        << "\rDone"
+        << "; tiles=" << numTiles
+        << "; failed=" << failed
+        << "; time=" << osg::Timer::instance()->delta_s(start, end) << "s"
+        << std::endl;
+
+    return 0;
+}
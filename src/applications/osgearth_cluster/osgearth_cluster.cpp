@@ -13,6 +13,7 @@
 #include <osgEarth/Controls>
 #include <osgDB/ReadFile>
 #include <iostream>
+#include <random>
 
 #include <osgEarth/PlaceNode>
 
@@ -30,6 +31,7 @@ usage(const char* name)
 {
     OE_NOTICE
         << "\nUsage: " << name << " file.earth" << std::endl
+        << "   or: " << name << " --benchmark [count]  ; time the cluster index" << std::endl
         << MapNodeHelper().usage() << std::endl;
 
     return 0;
@@ -261,6 +263,52 @@ public:
 };
 
 
+//! Times the cluster index on randomly placed points: the initial build,
+//! a query over a regional view at every zoom, and incremental updates.
+int
+benchmark(unsigned count)
+{
+    osg::Timer* timer = osg::Timer::instance();
+    std::minstd_rand gen(0);
+    std::uniform_real_distribution<double> lon(-180.0, 180.0), lat(-85.0, 85.0);
+
+    ClusterIndex index;
+    for (unsigned i = 0; i < count; ++i)
+        index.add(lon(gen), lat(gen));
+
+    osg::Timer_t t0 = timer->tick();
+    index.build();
+    std::cout << "Built index of " << count << " points in " << timer->delta_m(t0, timer->tick()) << " ms" << std::endl;
+
+    std::vector<ClusterIndex::Cluster> clusters;
+    for (unsigned zoom = index.getMinZoom(); zoom <= index.getMaxZoom() + 1; ++zoom)
+    {
+        // a view about four tiles across at this zoom, centered on 0,0
+        double half = std::min(180.0, 2.0 * 360.0 / std::pow(2.0, (double)zoom));
+
+        const int runs = 100;
+        t0 = timer->tick();
+        for (int run = 0; run < runs; ++run)
+        {
+            clusters.clear();
+            index.getClusters(-half, -half / 2.0, half, half / 2.0, zoom, clusters);
+        }
+        double ms = timer->delta_m(t0, timer->tick()) / (double)runs;
+
+        std::cout << "  zoom " << zoom << ": " << clusters.size() << " clusters in " << ms << " ms" << std::endl;
+    }
+
+    const unsigned updates = 1000;
+    t0 = timer->tick();
+    for (unsigned i = 0; i < updates; ++i)
+        index.remove(i);
+    for (unsigned i = 0; i < updates; ++i)
+        index.add(lon(gen), lat(gen));
+    std::cout << "Removed and added " << updates << " points in " << timer->delta_m(t0, timer->tick()) << " ms" << std::endl;
+
+    return 0;
+}
+
 int
 main(int argc, char** argv)
 {
@@ -271,6 +319,14 @@ main(int argc, char** argv)
     if (arguments.read("--help"))
         return usage(argv[0]);
 
+    if (arguments.read("--benchmark"))
+    {
+        unsigned count = 100000u;
+        if (arguments.argc() > 1)
+            count = std::max(1, atoi(arguments[1]));
+        return benchmark(count);
+    }
+
     // create a viewer:
     osgViewer::Viewer viewer(arguments);
 
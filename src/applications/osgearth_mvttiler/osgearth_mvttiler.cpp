@@ -0,0 +1,206 @@
+/* osgEarth
+* Copyright 2025 Pelican Mapping
+* MIT License
+*/
+#define LC "[osgearth_mvttiler] "
+
+#include <osgEarth/Notify>
+#include <osgEarth/MVTTiler>
+#include <osgEarth/OGRFeatureSource>
+#include <osgEarth/StringUtils>
+
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <osgDB/FileNameUtils>
+
+#include <iostream>
+#include <iomanip>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+int
+usage(const std::string& msg)
+{
+    if (!msg.empty())
+    {
+        std::cout << msg << std::endl;
+    }
+
+    std::cout
+        << std::endl
+        << "Cuts a feature source into Mapbox Vector Tiles (spherical mercator)." << std::endl
+        << std::endl
+        << "USAGE: osgearth_mvttiler [options] filename --out [destination]" << std::endl
+        << std::endl
+        << "    filename                      ; Shapefile or other OGR-readable feature file" << std::endl
+        << "    --in [prop_name] [prop_value] ; Set a feature source property instead of using a filename (e.g. --in driver TFSFeatures --in url ...)" << std::endl
+        << "    --out [destination]           ; Output .mbtiles file, or a directory for {z}/{x}/{y}.pbf files" << std::endl
+        << "    --min-level [int]             ; Lowest zoom level to write (default 0)" << std::endl
+        << "    --max-level [int]             ; Highest zoom level to write (default 14)" << std::endl
+        << "    --layer [name]                ; Name of the layer in each tile (default is the input file name)" << std::endl
+        << "    --extent [int]                ; Tile resolution in integer units (default 4096)" << std::endl
+        << "    --buffer [int]                ; Margin around each tile in tile units (default 64)" << std::endl
+        << "    --simplify [float]            ; Simplification tolerance in tile units, 0 to disable (default 1)" << std::endl
+        << "    --attribute [name]            ; Attribute to write; repeat for more. Default is all attributes" << std::endl
+        << "    --expression [expr]           ; Query expression to run on the feature source" << std::endl
+        << "    --no-compress                 ; Write uncompressed tiles (default is gzip)" << std::endl
+        << "    --threads [int]               ; Number of worker threads (default is one per core)" << std::endl
+        << std::endl;
+
+    return -1;
+}
+
+// Prints the percentage done on one line
+struct ProgressReporter : public osgEarth::ProgressCallback
+{
+    bool reportProgress(double current, double total, unsigned, unsigned, const std::string&) override
+    {
+        if (total > 0.0)
+        {
+            std::cout << "\r" << std::fixed << std::setprecision(1)
+                << std::min(100.0, 100.0 * current / total) << "% (" << (unsigned)current << " tiles)" << std::flush;
+        }
+        return false;
+    }
+};
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    if (argc < 2)
+    {
+        return usage("");
+    }
+
+    osgEarth::initialize();
+
+    MVTTiler tiler;
+
+    unsigned value;
+    if (arguments.read("--min-level", value))
+        tiler.setMinLevel(value);
+
+    if (arguments.read("--max-level", value))
+        tiler.setMaxLevel(value);
+
+    if (arguments.read("--extent", value))
+        tiler.setExtent(value);
+
+    if (arguments.read("--buffer", value))
+        tiler.setBuffer(value);
+
+    if (arguments.read("--threads", value))
+        tiler.setNumThreads(value < 1 ? 1 : value);
+
+    double simplify;
+    if (arguments.read("--simplify", simplify))
+        tiler.setSimplifyTolerance(simplify);
+
+    if (arguments.read("--no-compress"))
+        tiler.setCompress(false);
+
+    std::vector<std::string> attributes;
+    std::string attribute;
+    while (arguments.read("--attribute", attribute))
+        attributes.push_back(attribute);
+    tiler.setAttributes(attributes);
+
+    std::string expression;
+    if (arguments.read("--expression", expression))
+    {
+        Query query;
+        query.expression() = expression;
+        tiler.setQuery(query);
+    }
+
+    std::string destination;
+    if (!arguments.read("--out", destination))
+    {
+        return usage("Please provide an output with --out");
+    }
+
+    std::string layerName;
+    arguments.read("--layer", layerName);
+
+    // Either a feature source defined with --in properties, or a file for OGR.
+    osg::ref_ptr<FeatureSource> features;
+    Config inConf;
+    std::string key, prop;
+    while (arguments.read("--in", key, prop))
+        inConf.set(key, prop);
+
+    if (!inConf.empty())
+    {
+        inConf.key() = inConf.value("driver");
+        auto layer = Layer::create(ConfigOptions(inConf));
+        features = dynamic_cast<FeatureSource*>(layer.get());
+        if (!features.valid())
+        {
+            OE_WARN << LC << "Failed to create a feature source for " << inConf.toJSON(false) << std::endl;
+            return -1;
+        }
+    }
+    else
+    {
+        std::string filename;
+        for (int pos = 1; pos < arguments.argc(); ++pos)
+        {
+            if (!arguments.isOption(pos))
+            {
+                filename = arguments[pos];
+                break;
+            }
+        }
+
+        if (filename.empty())
+        {
+            return usage("Please provide a filename");
+        }
+
+        auto ogr = new OGRFeatureSource();
+        ogr->setURL(filename);
+        features = ogr;
+
+        if (layerName.empty())
+            layerName = osgDB::getStrippedName(filename);
+    }
+
+    if (features->open().isError())
+    {
+        OE_WARN << LC << "Failed to open input: " << features->getStatus().message() << std::endl;
+        return -1;
+    }
+
+    if (layerName.empty())
+        layerName = features->getName().empty() ? "features" : features->getName();
+    tiler.setLayerName(layerName);
+
+    OE_NOTICE << LC << "Tiling to " << destination << std::endl
+        << "  Layer=" << tiler.getLayerName() << std::endl
+        << "  Levels=" << tiler.getMinLevel() << "-" << tiler.getMaxLevel() << std::endl
+        << "  Extent=" << tiler.getExtent() << std::endl
+        << "  Buffer=" << tiler.getBuffer() << std::endl
+        << "  Simplify=" << tiler.getSimplifyTolerance() << std::endl
+        << "  Threads=" << tiler.getNumThreads() << std::endl
+        << std::endl;
+
+    osg::Timer_t startTime = osg::Timer::instance()->tick();
+
+    osg::ref_ptr<ProgressReporter> progress = new ProgressReporter();
+    Status status = tiler.run(features.get(), destination, progress.get());
+    std::cout << std::endl;
+
+    if (status.isError())
+    {
+        OE_WARN << LC << status.message() << std::endl;
+        return -1;
+    }
+
+    osg::Timer_t endTime = osg::Timer::instance()->tick();
+    OE_NOTICE << LC << "Completed in " << osg::Timer::instance()->delta_s(startTime, endTime) << " s" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+/* osgEarth
+* Copyright 2025 Pelican Mapping
+* MIT License
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/OGRFeatureSource>
+#include <osgEarth/Feature>
+#include <osgEarth/Bounds>
+#include <osgEarthProcedural/RoadNetwork>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <iostream>
+
+#define LC "[roadnetwork] "
+
+using namespace osgEarth;
+using namespace osgEarth::Procedural;
+
+int
+usage(const char* name, const std::string& error)
+{
+    OE_NOTICE
+        << "Benchmarks building a road network from linear features."
+        << "\nError: " << error
+        << "\nUsage:"
+        << "\n" << name
+        << "\n  --in roads.shp       ; road features to load, or:"
+        << "\n  --grid blocks        ; synthetic city with blocks x blocks streets"
+        << "\n  [--tiles n]          ; add the features in n x n batches (default = 1)"
+        << "\n  [--snap meters]      ; endpoint snapping tolerance"
+        << std::endl;
+
+    return -1;
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    std::string infile;
+    unsigned blocks = 0u;
+    if (!arguments.read("--in", infile) && !arguments.read("--grid", blocks))
+        return usage(argv[0], "Missing --in or --grid");
+
+    unsigned tiles = 1u;
+    arguments.read("--tiles", tiles);
+    tiles = std::max(tiles, 1u);
+
+    double snap = 0.0;
+    arguments.read("--snap", snap);
+
+    FeatureList features;
+
+    if (!infile.empty())
+    {
+        osg::ref_ptr<OGRFeatureSource> input = new OGRFeatureSource();
+        input->setURL(infile);
+        if (input->open().isError())
+            return usage(argv[0], input->getStatus().message());
+
+        // snapping works in meters, so use a projected SRS
+        osg::ref_ptr<const SpatialReference> srs = SpatialReference::get("spherical-mercator");
+
+        osg::ref_ptr<FeatureCursor> cursor = input->createFeatureCursor();
+        while (cursor.valid() && cursor->hasMore())
+        {
+            Feature* f = cursor->nextFeature();
+            if (f && f->getGeometry() && f->getGeometry()->isLinear())
+            {
+                f->transform(srs.get());
+                features.emplace_back(f);
+            }
+        }
+    }
+    else
+    {
+        // Streets every 100m, broken at each intersection like OSM ways
+        const double size = 100.0;
+        FeatureID fid = 1;
+        for (unsigned i = 0; i <= blocks; ++i)
+        {
+            for (unsigned j = 0; j < blocks; ++j)
+            {
+                auto* ew = new LineString();
+                ew->push_back(j * size, i * size);
+                ew->push_back((j + 0.5) * size, i * size);
+                ew->push_back((j + 1) * size, i * size);
+                features.emplace_back(new Feature(ew, nullptr, Style(), fid++));
+
+                auto* ns = new LineString();
+                ns->push_back(i * size, j * size);
+                ns->push_back(i * size, (j + 0.5) * size);
+                ns->push_back(i * size, (j + 1) * size);
+                features.emplace_back(new Feature(ns, nullptr, Style(), fid++));
+            }
+        }
+    }
+
+    if (features.empty())
+        return usage(argv[0], "No linear features");
+
+    // Bin the features by centroid, to simulate tiles arriving one at a time.
+    Bounds bounds;
+    for (auto& f : features)
+        bounds.expandBy(f->getGeometry()->getBounds());
+
+    std::vector<FeatureList> batches(tiles * tiles);
+    for (auto& f : features)
+    {
+        auto c = f->getGeometry()->getBounds().center();
+        unsigned tx = std::min(tiles - 1, (unsigned)(tiles * (c.x() - bounds.xMin()) / std::max(width(bounds), 1.0)));
+        unsigned ty = std::min(tiles - 1, (unsigned)(tiles * (c.y() - bounds.yMin()) / std::max(height(bounds), 1.0)));
+        batches[ty * tiles + tx].emplace_back(f);
+    }
+
+    std::cout << "Building network from " << features.size() << " features in " << batches.size() << " batches.." << std::endl;
+
+    RoadNetwork network;
+    if (snap > 0.0)
+        network.snapTolerance = snap;
+
+    double addTime = 0.0, relateTime = 0.0;
+
+    for (auto& batch : batches)
+    {
+        osg::Timer_t t0 = osg::Timer::instance()->tick();
+
+        for (auto& f : batch)
+            network.addFeature(f.get());
+
+        osg::Timer_t t1 = osg::Timer::instance()->tick();
+
+        network.buildRelations();
+
+        osg::Timer_t t2 = osg::Timer::instance()->tick();
+
+        addTime += osg::Timer::instance()->delta_s(t0, t1);
+        relateTime += osg::Timer::instance()->delta_s(t1, t2);
+    }
+
+    std::cout
+        << "Done"
+        << "; junctions=" << network.junctions.size()
+        << "; ways=" << network.ways.size()
+        << "; relations=" << network.relations.size()
+        << "; add=" << addTime << "s"
+        << "; build=" << relateTime << "s"
+        << std::endl;
+
+    return 0;
+}
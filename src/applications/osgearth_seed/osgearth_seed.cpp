@@ -26,6 +26,8 @@
 #include <iostream>
 #include <sstream>
 #include <iterator>
+#include <thread>
+#include <cstdlib>
 
 using namespace osgEarth;
 
@@ -34,6 +36,7 @@ using namespace osgEarth;
 int list( osg::ArgumentParser& args );
 int seed( osg::ArgumentParser& args );
 int purge( osg::ArgumentParser& args );
+int migrate( osg::ArgumentParser& args );
 int usage( const std::string& msg );
 int message( const std::string& msg );
 
@@ -48,6 +51,8 @@ int main(int argc, char** argv)
         return list( args );
     else if ( args.read( "--purge" ) )
         return purge( args );        
+    else if ( args.read( "--migrate" ) )
+        return migrate( args );
     else
     return usage("");
 }
@@ -74,14 +79,59 @@ int usage( const std::string& msg )
         << "        [--mp]                          ; Use multiprocessing to process the tiles.  Useful for GDAL sources as this avoids the global GDAL lock" << std::endl
         << "        [--mt]                          ; Use multithreading to process the tiles." << std::endl
         << "        [--concurrency]                 ; The number of threads or processes to use if --mp or --mt are provided." << std::endl
+        << "        [--journal file]                ; Record progress in a journal so an interrupted seed resumes where it stopped" << std::endl
+        << "        [--unit-level level]            ; Level at which to split the seed into work units (default=6)" << std::endl
+        << "        [--worker index count]          ; Seed only this worker's share of the work units (used by --mp)" << std::endl
         << "        [--verbose]                     ; Displays progress of the seed operation" << std::endl
         << std::endl
         << "    --purge file.earth                  ; Purges a layer cache in a .earth file (interactive)" << std::endl
+        << std::endl
+        << "    --migrate path                      ; Upgrades a RocksDB cache folder to the current record layout" << std::endl
         << std::endl;
 
     return -1;
 }
 
+struct SeedProgressCallback : public ProgressCallback
+{
+    bool reportProgress(double current, double total, unsigned stage, unsigned totalStages, const std::string& msg) override
+    {
+        if (!msg.empty())
+            std::cout << msg << std::endl;
+        else if (total > 0.0)
+            std::cout << (int)(100.0*current/total) << "%" << std::endl;
+        return false;
+    }
+};
+
+// Runs "count" copies of this program, each seeding one share of the work units.
+int launchWorkers( const std::string& command, unsigned count )
+{
+    std::vector<std::thread> workers;
+    std::vector<int> results(count, 0);
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        std::string workerCommand = Stringify() << command << " --worker " << i << " " << count;
+        OE_NOTICE << LC << "Launching " << workerCommand << std::endl;
+        workers.emplace_back([&results, i, workerCommand]() {
+            results[i] = ::system(workerCommand.c_str());
+        });
+    }
+
+    int result = 0;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        workers[i].join();
+        if (results[i] != 0)
+        {
+            OE_WARN << LC << "Worker " << i << " exited with code " << results[i] << std::endl;
+            result = results[i];
+        }
+    }
+    return result;
+}
+
 int message( const std::string& msg )
 {
     if ( !msg.empty() )
@@ -93,6 +143,25 @@ int message( const std::string& msg )
 
 int seed( osg::ArgumentParser& args )
 {    
+    // Remember the command line in case we need to launch workers.
+    std::string command = Stringify() << args.getApplicationName() << " --seed";
+    for (int pos = 1; pos < args.argc(); ++pos)
+    {
+        std::string arg = args[pos];
+        if (arg == "--mp")
+            continue;
+        // workers are single-threaded processes
+        if ((arg == "-c" || arg == "--concurrency") && pos + 1 < args.argc())
+        {
+            ++pos;
+            continue;
+        }
+        if (arg.find(' ') != std::string::npos)
+            command += " \"" + arg + "\"";
+        else
+            command += " " + arg;
+    }
+
     osgDB::Registry::instance()->getReaderWriterForExtension("png");
     osgDB::Registry::instance()->getReaderWriterForExtension("jpg");
     osgDB::Registry::instance()->getReaderWriterForExtension("tiff");
@@ -118,13 +187,16 @@ int seed( osg::ArgumentParser& args )
         bounds.push_back( b );
     }    
 
-    std::string tileList;
-    while (args.read( "--tiles", tileList ) );
-
     bool verbose = args.read("--verbose");
 
-    unsigned int batchSize = 0;
-    args.read("--batchsize", batchSize);
+    std::string journal;
+    args.read("--journal", journal);
+
+    int unitLevel = -1;
+    args.read("--unit-level", unitLevel);
+
+    unsigned int workerIndex = 0, workerCount = 0;
+    args.read("--worker", workerIndex, workerCount);
 
     // Read the concurrency level
     unsigned int concurrency = 0;
@@ -201,70 +273,50 @@ int seed( osg::ArgumentParser& args )
         return 0;
     }
     
-    osg::ref_ptr< TileVisitor > visitor;
-
-
-    // If we are given a task file, load it up and create a new TileKeyListVisitor
-    if (!tileList.empty())
-    {        
-        TaskList tasks( mapNode->getMap()->getProfile() );
-        tasks.load( tileList );
-
-        TileKeyListVisitor* v = new TileKeyListVisitor();
-        v->setKeys( tasks.getKeys() );
-        visitor = v;        
-        OE_DEBUG << "Read task list with " << tasks.getKeys().size() << " tasks" << std::endl;
+    // Multiprocessing: split the work units among copies of this program.
+    if (args.read("--mp"))
+    {
+        unsigned count = concurrency > 0 ? concurrency : std::max(1u, std::thread::hardware_concurrency());
+        return launchWorkers( command, count );
     }
-  
 
-    // If we dont' have a visitor create one.
-    if (!visitor.valid())
+    osg::ref_ptr< TileVisitor > visitor;
+    ResumableTileVisitor* resumable = nullptr;
+
+    if (!journal.empty() || workerCount > 0)
     {
-        if (args.read("--mt"))
+        // Journaled visitor that can resume an interrupted seed
+        resumable = new ResumableTileVisitor();
+        if (concurrency > 0)
+            resumable->setNumThreads(concurrency);
+        if (unitLevel >= 0)
+            resumable->setUnitLevel(unitLevel);
+        if (workerCount > 0)
         {
-            // Create a multithreaded visitor
-            MultithreadedTileVisitor* v = new MultithreadedTileVisitor();
-            if (concurrency > 0)
-            {
-                v->setNumThreads(concurrency);
-            }
-            visitor = v;            
+            resumable->setWorker(workerIndex, workerCount);
+            // processes each run a single thread unless told otherwise
+            if (concurrency == 0)
+                resumable->setNumThreads(1);
         }
-        else if (args.read("--mp"))
+        visitor = resumable;
+    }
+    else if (args.read("--mt"))
+    {
+        // Create a multithreaded visitor
+        MultithreadedTileVisitor* v = new MultithreadedTileVisitor();
+        if (concurrency > 0)
         {
-            // Create a multiprocess visitor
-            MultiprocessTileVisitor* v = new MultiprocessTileVisitor();
-            if (concurrency > 0)
-            {
-                v->setNumProcesses(concurrency);
-            }
-
-            if (batchSize > 0)
-            {                
-                v->setBatchSize(batchSize);
-            }
-
-            // Try to find the earth file
-            std::string earthFile;
-            for(int pos=1;pos<args.argc();++pos)
-            {
-                if (!args.isOption(pos))
-                {
-                    earthFile  = args[ pos ];
-                    break;
-                }
-            }
-            v->setEarthFile( earthFile );            
-            visitor = v;            
+            v->setNumThreads(concurrency);
         }
-        else
-        {
-            // Create a single thread visitor
-            visitor = new TileVisitor();            
-        }        
+        visitor = v;            
     }
+    else
+    {
+        // Create a single thread visitor
+        visitor = new TileVisitor();            
+    }        
 
-    osg::ref_ptr< ProgressCallback > progress = new ConsoleProgressCallback();
+    osg::ref_ptr< ProgressCallback > progress = new SeedProgressCallback();
     
     if (verbose)
     {
@@ -281,7 +333,7 @@ int seed( osg::ArgumentParser& args )
     {
         GeoExtent extent(mapNode->getMapSRS(), bounds[i]);
         OE_DEBUG << "Adding extent " << extent.toString() << std::endl;                
-        visitor->addExtent( extent );
+        visitor->addExtentToVisit( extent );
     }    
     
 
@@ -291,6 +343,18 @@ int seed( osg::ArgumentParser& args )
 
     osgEarth::Map* map = mapNode->getMap();
 
+    // Each layer (and each worker) keeps its own journal.
+    auto setJournal = [&](const Layer* layer)
+    {
+        if (resumable && !journal.empty())
+        {
+            std::string path = Stringify() << journal << "." << map->getIndexOfLayer(layer);
+            if (workerCount > 0)
+                path = Stringify() << path << ".w" << resumable->getWorkerIndex();
+            resumable->setJournal(path);
+        }
+    };
+
     // They want to seed an image layer
     if (imageLayerIndex >= 0)
     {
@@ -298,6 +362,7 @@ int seed( osg::ArgumentParser& args )
         if (layer)
         {
             OE_NOTICE << "Seeding single layer " << layer->getName() << std::endl;
+            setJournal(layer.get());
             osg::Timer_t start = osg::Timer::instance()->tick();        
             seeder.run(layer.get(), map);
             osg::Timer_t end = osg::Timer::instance()->tick();
@@ -320,6 +385,7 @@ int seed( osg::ArgumentParser& args )
         if (layer)
         {
             OE_NOTICE << "Seeding single layer " << layer->getName() << std::endl;
+            setJournal(layer.get());
             osg::Timer_t start = osg::Timer::instance()->tick();        
             seeder.run(layer.get(), map);
             osg::Timer_t end = osg::Timer::instance()->tick();
@@ -345,6 +411,7 @@ int seed( osg::ArgumentParser& args )
         {            
             osg::ref_ptr< TileLayer > layer = terrainLayers[i].get();
             OE_NOTICE << "Seeding layer" << layer->getName() << std::endl;            
+            setJournal(layer.get());
             osg::Timer_t start = osg::Timer::instance()->tick();
             seeder.run(layer.get(), map);            
             osg::Timer_t end = osg::Timer::instance()->tick();
@@ -544,4 +611,33 @@ purge( osg::ArgumentParser& args )
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+int
+migrate( osg::ArgumentParser& args )
+{
+    if ( args.argc() < 2 )
+        return usage( "Missing cache path." );
+
+    std::string path = args[1];
+    if ( !osgDB::fileExists(path) )
+        return usage( "Cache folder \"" + path + "\" does not exist." );
+
+    // Opening the cache with migration enabled performs the conversion.
+    Config conf("cache");
+    conf.set("driver", "rocksdb");
+    conf.set("path", path);
+    conf.set("migrate", true);
+
+    std::cout << "Migrating cache at \"" << path << "\"..." << std::endl;
+
+    osg::ref_ptr<Cache> cache = CacheFactory::create( CacheOptions(conf) );
+    if ( !cache.valid() || cache->getStatus().isError() )
+        return message( "Failed to open the cache." );
+
+    std::cout << "Compacting..." << std::endl;
+    cache->compact();
+
+    std::cout << "Done. Cache size = " << (cache->getApproximateSize()/1048576) << " MB" << std::endl;
+    return 0;
+}
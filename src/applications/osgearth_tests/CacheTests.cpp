@@ -65,4 +65,29 @@ TEST_CASE( "Cache" ) {
         ReadResult r2 = bin->readImage(key, 0L);
         REQUIRE(r2.failed());
     }  
+
+    SECTION("Image batch")
+    {
+        osg::ref_ptr<osg::Image> red = ImageUtils::createOnePixelImage(osg::Vec4(1, 0, 0, 1));
+        osg::ref_ptr<osg::Image> blue = ImageUtils::createOnePixelImage(osg::Vec4(0, 0, 1, 1));
+
+        REQUIRE(bin->write("batch_0", red.get(), 0L));
+        REQUIRE(bin->write("batch_2", blue.get(), 0L));
+
+        // Results come back in key order, with misses in place
+        std::vector<std::string> keys = { "batch_0", "batch_1", "batch_2" };
+        std::vector<ReadResult> r = bin->readImages(keys, 0L);
+        REQUIRE(r.size() == 3);
+        REQUIRE(r[0].succeeded());
+        REQUIRE(r[1].failed());
+        REQUIRE(r[2].succeeded());
+        REQUIRE(ImageUtils::areEquivalent(r[0].getImage(), red.get()));
+        REQUIRE(ImageUtils::areEquivalent(r[2].getImage(), blue.get()));
+
+        std::vector<CacheBin::RecordStatus> status = bin->getRecordStatuses(keys);
+        REQUIRE(status.size() == 3);
+        REQUIRE(status[0] == CacheBin::STATUS_OK);
+        REQUIRE(status[1] == CacheBin::STATUS_NOT_FOUND);
+        REQUIRE(status[2] == CacheBin::STATUS_OK);
+    }
 }
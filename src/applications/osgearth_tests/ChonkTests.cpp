@@ -0,0 +1,100 @@
+/* osgEarth
+* Copyright 2025 Pelican Mapping
+* MIT License
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/Chonk>
+#include <algorithm>
+#include <set>
+
+using namespace osgEarth;
+
+namespace
+{
+    // 10000 instances on a 100x100 grid, 10m apart, centered at the origin.
+    std::vector<osg::BoundingSphere> makeGrid()
+    {
+        std::vector<osg::BoundingSphere> bounds;
+        for (int y = 0; y < 100; ++y)
+            for (int x = 0; x < 100; ++x)
+                bounds.emplace_back(osg::Vec3(x * 10.0f - 495.0f, y * 10.0f - 495.0f, 0.0f), 2.0f);
+        return bounds;
+    }
+
+    // Camera above the point (x, y) looking straight down.
+    osg::Matrix lookDown(double x, double y, double height)
+    {
+        return osg::Matrix::lookAt(osg::Vec3d(x, y, height), osg::Vec3d(x, y, 0), osg::Vec3d(0, 1, 0));
+    }
+}
+
+TEST_CASE("ChonkPreCuller") {
+
+    auto bounds = makeGrid();
+    osg::Matrix proj = osg::Matrix::perspective(30.0, 1.0, 1.0, 10000.0);
+
+    ChonkPreCuller culler;
+    culler.reset(bounds, 100u);
+
+    REQUIRE(culler.getStats().instances == bounds.size());
+    REQUIRE(culler.getStats().cells > 1u);
+    REQUIRE(culler.getLayout().size() % ChonkPreCuller::PAGE_SIZE == 0u);
+
+    SECTION("Every instance is in the layout once") {
+        std::set<int> seen;
+        for (auto i : culler.getLayout())
+            if (i != ChonkPreCuller::EMPTY)
+                REQUIRE(seen.insert(i).second);
+        REQUIRE(seen.size() == bounds.size());
+    }
+
+    SECTION("Whole set in view") {
+        culler.cull(lookDown(0, 0, 5000), proj);
+        REQUIRE(culler.getStats().submitted == bounds.size());
+        REQUIRE(culler.getStats().changedSlots == culler.getSlots().size());
+    }
+
+    SECTION("Whole set out of view") {
+        culler.cull(lookDown(5000, 0, 500), proj);
+        REQUIRE(culler.getStats().submitted == 0u);
+        REQUIRE(culler.getSlots().empty());
+    }
+
+    SECTION("Part of the set in view") {
+        culler.cull(lookDown(-400, -400, 200), proj);
+        auto& stats = culler.getStats();
+        REQUIRE(stats.submitted > 0u);
+        REQUIRE(stats.submitted < bounds.size() / 4);
+
+        // the instance right under the camera must be submitted:
+        int target = 5 * 100 + 5; // (-445, -445)
+        std::set<int> pages(culler.getSlots().begin(), culler.getSlots().end());
+        auto& layout = culler.getLayout();
+        auto pos = std::find(layout.begin(), layout.end(), target) - layout.begin();
+        REQUIRE(pages.count(pos / ChonkPreCuller::PAGE_SIZE) == 1u);
+    }
+
+    SECTION("Unchanged view changes no slots") {
+        culler.cull(lookDown(-400, -400, 200), proj);
+        auto slots = culler.getSlots();
+        culler.cull(lookDown(-400, -400, 200), proj);
+        REQUIRE(culler.getStats().changedSlots == 0u);
+        REQUIRE(culler.getSlots() == slots);
+    }
+
+    SECTION("Pages keep their slots while in view") {
+        culler.cull(lookDown(-400, -400, 200), proj);
+        auto before = culler.getSlots();
+        culler.cull(lookDown(-390, -400, 200), proj);
+        auto& after = culler.getSlots();
+
+        unsigned kept = 0;
+        for (unsigned s = 0; s < std::min(before.size(), after.size()); ++s)
+            if (before[s] != ChonkPreCuller::EMPTY && before[s] == after[s])
+                ++kept;
+        REQUIRE(kept > 0u);
+        REQUIRE(culler.getStats().changedSlots < after.size());
+    }
+}
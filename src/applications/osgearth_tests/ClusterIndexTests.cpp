@@ -0,0 +1,312 @@
+/* osgEarth
+* Copyright 2025 Pelican Mapping
+* MIT License
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/ClusterIndex>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+
+using namespace osgEarth;
+using namespace osgEarth::Contrib;
+
+namespace
+{
+    // same normalized mercator projection the index uses
+    double toX(double lon) { return lon / 360.0 + 0.5; }
+    double toY(double lat)
+    {
+        double s = std::sin(lat * 3.14159265358979323846 / 180.0);
+        return 0.5 - 0.25 * std::log((1.0 + s) / (1.0 - s)) / 3.14159265358979323846;
+    }
+
+    std::vector<ClusterIndex::Cluster> everything(ClusterIndex& index, unsigned zoom)
+    {
+        std::vector<ClusterIndex::Cluster> clusters;
+        index.getClusters(-180.0, -85.0, 180.0, 85.0, zoom, clusters);
+        return clusters;
+    }
+
+    // Checks that the clusters at every zoom partition the live points,
+    // that each count matches the points below it, and that each
+    // representative point is one of them.
+    void requireConsistent(ClusterIndex& index, const std::set<unsigned>& live)
+    {
+        for (unsigned zoom = index.getMinZoom(); zoom <= index.getMaxZoom() + 1; ++zoom)
+        {
+            std::set<unsigned> seen;
+            for (auto& cluster : everything(index, zoom))
+            {
+                std::vector<unsigned> points;
+                index.getPoints(cluster, zoom, points);
+                REQUIRE(points.size() == cluster.count);
+                REQUIRE(std::find(points.begin(), points.end(), cluster.point) != points.end());
+                for (auto p : points)
+                {
+                    REQUIRE(live.count(p) == 1);
+                    REQUIRE(seen.insert(p).second);
+                }
+            }
+            REQUIRE(seen == live);
+        }
+    }
+}
+
+TEST_CASE("ClusterIndex build matches a brute force grouping")
+{
+    // Clumps of points, each much smaller than the cluster radius at the
+    // test zoom and much farther apart than it, so there is exactly one
+    // correct grouping: one cluster per clump.
+    const unsigned zoom = 6u;
+    const unsigned clumps = 40u;
+
+    ClusterIndex index;
+    index.setZoomRange(0u, 12u);
+    double pixelDegrees = 360.0 / (index.getTileSize() * std::pow(2.0, zoom));
+    double spread = 0.1 * index.getRadius() * pixelDegrees;
+    double spacing = 8.0 * index.getRadius() * pixelDegrees;
+
+    std::mt19937 gen(42u);
+    std::uniform_real_distribution<double> jitter(-spread, spread);
+    std::uniform_int_distribution<unsigned> sizes(1u, 20u);
+
+    std::vector<std::vector<unsigned>> expected;
+    std::vector<osg::Vec2d> lonlat;
+    for (unsigned c = 0; c < clumps; ++c)
+    {
+        double lon = -170.0 + (c % 8) * spacing;
+        double lat = -40.0 + (c / 8) * spacing;
+        expected.emplace_back();
+        for (unsigned n = sizes(gen); n > 0; --n)
+        {
+            osg::Vec2d p(lon + jitter(gen), lat + jitter(gen));
+            expected.back().push_back(index.add(p.x(), p.y()));
+            lonlat.push_back(p);
+        }
+    }
+
+    auto clusters = everything(index, zoom);
+    REQUIRE(clusters.size() == clumps);
+
+    for (auto& cluster : clusters)
+    {
+        std::vector<unsigned> points;
+        index.getPoints(cluster, zoom, points);
+        std::sort(points.begin(), points.end());
+
+        auto clump = std::find(expected.begin(), expected.end(), points);
+        REQUIRE(clump != expected.end());
+        REQUIRE(cluster.count == points.size());
+
+        // the center is the mean of the points in mercator space
+        double x = 0.0, y = 0.0;
+        for (auto p : points)
+        {
+            x += toX(lonlat[p].x());
+            y += toY(lonlat[p].y());
+        }
+        REQUIRE(toX(cluster.longitude) == Approx(x / points.size()).epsilon(1e-9));
+        REQUIRE(toY(cluster.latitude) == Approx(y / points.size()).epsilon(1e-9));
+    }
+
+    // above the maximum zoom every point stands alone
+    REQUIRE(everything(index, index.getMaxZoom() + 1).size() == lonlat.size());
+
+    std::set<unsigned> live;
+    for (unsigned i = 0; i < lonlat.size(); ++i)
+        live.insert(i);
+    requireConsistent(index, live);
+}
+
+TEST_CASE("ClusterIndex add and remove keep clusters consistent")
+{
+    ClusterIndex index;
+    index.setZoomRange(0u, 10u);
+
+    std::mt19937 gen(7u);
+    std::uniform_real_distribution<double> lon(-20.0, 20.0), lat(-20.0, 20.0);
+
+    std::set<unsigned> live;
+    for (unsigned i = 0; i < 2000; ++i)
+        live.insert(index.add(lon(gen), lat(gen)));
+
+    index.build();
+    requireConsistent(index, live);
+
+    SECTION("Adding to a built index")
+    {
+        for (unsigned i = 0; i < 500; ++i)
+            live.insert(index.add(lon(gen), lat(gen)));
+
+        REQUIRE(index.size() == live.size());
+        requireConsistent(index, live);
+    }
+
+    SECTION("Removing representative points")
+    {
+        // take out the representative of every low zoom cluster, repeatedly,
+        // so the index must keep choosing new ones from live children
+        for (unsigned pass = 0; pass < 5; ++pass)
+        {
+            for (auto& cluster : everything(index, 3u))
+            {
+                index.remove(cluster.point);
+                live.erase(cluster.point);
+            }
+        }
+
+        REQUIRE(index.size() == live.size());
+        requireConsistent(index, live);
+    }
+
+    SECTION("Interleaved adds and removes")
+    {
+        std::uniform_int_distribution<unsigned> coin(0u, 1u);
+        for (unsigned i = 0; i < 2000; ++i)
+        {
+            if (coin(gen) == 0u && !live.empty())
+            {
+                auto victim = live.begin();
+                std::advance(victim, gen() % live.size());
+                index.remove(*victim);
+                live.erase(victim);
+            }
+            else
+            {
+                live.insert(index.add(lon(gen), lat(gen)));
+            }
+        }
+
+        REQUIRE(index.size() == live.size());
+        requireConsistent(index, live);
+    }
+}
+
+TEST_CASE("ClusterIndex queries across the antimeridian")
+{
+    ClusterIndex index;
+    index.setZoomRange(0u, 8u);
+
+    unsigned east = index.add(179.9, 10.0);
+    unsigned west = index.add(-179.9, 10.0);
+    index.add(0.0, 10.0);
+    index.add(170.0, 10.0);
+
+    std::vector<ClusterIndex::Cluster> clusters;
+    index.getClusters(179.0, 0.0, -179.0, 20.0, index.getMaxZoom() + 1, clusters);
+
+    std::set<unsigned> found;
+    for (auto& cluster : clusters)
+        found.insert(cluster.point);
+    REQUIRE(found == (std::set<unsigned>{ east, west }));
+
+    // the same region without the wrap finds neither
+    clusters.clear();
+    index.getClusters(-179.0, 0.0, 179.0, 20.0, index.getMaxZoom() + 1, clusters);
+    REQUIRE(clusters.size() == 2u);
+    for (auto& cluster : clusters)
+        REQUIRE((cluster.point != east && cluster.point != west));
+}
+
+TEST_CASE("ClusterIndex getPoints returns the points of a cluster")
+{
+    ClusterIndex index;
+    index.setZoomRange(0u, 4u);
+
+    std::set<unsigned> here, there;
+    for (unsigned i = 0; i < 10; ++i)
+    {
+        here.insert(index.add(10.0 + 0.01 * i, 20.0));
+        there.insert(index.add(-100.0, -30.0 + 0.01 * i));
+    }
+
+    auto clusters = everything(index, 0u);
+    REQUIRE(clusters.size() == 2u);
+
+    for (auto& cluster : clusters)
+    {
+        std::vector<unsigned> points;
+        index.getPoints(cluster, 0u, points);
+        std::set<unsigned> got(points.begin(), points.end());
+        REQUIRE(got.size() == points.size());
+        REQUIRE((got == here || got == there));
+    }
+
+    // a removed point is no longer returned
+    unsigned gone = *here.begin();
+    index.remove(gone);
+    here.erase(gone);
+    for (auto& cluster : everything(index, 0u))
+    {
+        std::vector<unsigned> points;
+        index.getPoints(cluster, 0u, points);
+        REQUIRE(std::find(points.begin(), points.end(), gone) == points.end());
+    }
+
+    // an id from another zoom that is out of range is ignored
+    ClusterIndex::Cluster bogus{ 1000000u, 0.0, 0.0, 1u, 0u };
+    std::vector<unsigned> points;
+    index.getPoints(bogus, 0u, points);
+    REQUIRE(points.empty());
+}
+
+TEST_CASE("ClusterIndex keeps apart points the can-merge function separates")
+{
+    ClusterIndex index;
+    index.setZoomRange(0u, 8u);
+
+    // Two kinds of point mixed together in the same clumps. Like
+    // ClusterNode, the function looks each point up by id, so it must
+    // only be asked about points that have been recorded.
+    std::vector<int> kinds;
+    index.setCanMergeFunction([&](unsigned a, unsigned b)
+        {
+            REQUIRE(a < kinds.size());
+            REQUIRE(b < kinds.size());
+            return kinds[a] == kinds[b];
+        });
+
+    std::mt19937 gen(11u);
+    std::uniform_real_distribution<double> jitter(-0.5, 0.5);
+
+    std::set<unsigned> live;
+    auto add = [&](int kind, double lon, double lat)
+    {
+        kinds.push_back(kind);
+        unsigned id = index.add(lon + jitter(gen), lat + jitter(gen));
+        REQUIRE(id == kinds.size() - 1u);
+        live.insert(id);
+    };
+
+    for (unsigned i = 0; i < 200; ++i)
+        add((int)(i % 2), 10.0 * (i % 5), 10.0 * (i % 3));
+
+    index.build();
+
+    // adding to the built index consults the function about the new points
+    for (unsigned i = 0; i < 100; ++i)
+        add((int)(i % 3 == 0), 10.0 * (i % 5), 10.0 * (i % 3));
+
+    REQUIRE(index.size() == live.size());
+    requireConsistent(index, live);
+
+    for (unsigned zoom = index.getMinZoom(); zoom <= index.getMaxZoom(); ++zoom)
+    {
+        auto clusters = everything(index, zoom);
+
+        // the kinds never share a cluster, even at the lowest zoom
+        REQUIRE(clusters.size() >= 2u);
+
+        for (auto& cluster : clusters)
+        {
+            std::vector<unsigned> points;
+            index.getPoints(cluster, zoom, points);
+            for (auto p : points)
+                REQUIRE(kinds[p] == kinds[cluster.point]);
+        }
+    }
+}
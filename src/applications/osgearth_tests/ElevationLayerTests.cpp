@@ -0,0 +1,199 @@
+/* osgEarth
+* Copyright 2025 Pelican Mapping
+* MIT License
+*/
+
+#include <osgEarth/catch.hpp>
+#include "TempShapefile"
+
+#include <osgEarth/DecalLayer>
+#include <osgEarth/ElevationPool>
+#include <osgEarth/FlatteningLayer>
+#include <osgEarth/FlatteningLayerImpl>
+#include <osgEarth/OGRFeatureSource>
+#include <osgEarth/Map>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace osgEarth;
+
+TEST_CASE("ElevationPool revision follows the map's elevation data")
+{
+    // Caches of clamped data (e.g. vegetation placements) key on this
+    osg::ref_ptr<Map> map = new Map();
+    ElevationPool* pool = map->getElevationPool();
+    std::size_t empty = pool->getRevision();
+    REQUIRE(pool->getRevision() == empty);
+
+    osg::ref_ptr<DecalElevationLayer> decals = new DecalElevationLayer();
+    map->addLayer(decals.get());
+    REQUIRE(decals->isOpen());
+    std::size_t added = pool->getRevision();
+    REQUIRE(added != empty);
+
+    // editing a dynamic layer bumps its revision
+    decals->clearDecals();
+    std::size_t edited = pool->getRevision();
+    REQUIRE(edited != added);
+    REQUIRE(pool->getRevision() == edited);
+
+    map->removeLayer(decals.get());
+    REQUIRE(pool->getRevision() != edited);
+}
+
+TEST_CASE("FlatteningLayer segment bins match a brute force search")
+{
+    using namespace osgEarth::Internal;
+
+    // Random segments around rows of 100 posts one unit apart, with some
+    // zero-length, vertical and horizontal ones thrown in
+    std::mt19937 gen(5u);
+    std::uniform_real_distribution<double> ux(-20.0, 120.0), uy(-20.0, 20.0), uz(-5.0, 5.0), uw(0.0, 6.0);
+
+    WidthsList widths;
+    for (unsigned g = 0; g < 10; ++g)
+        widths.emplace_back(uw(gen), uw(gen));
+
+    LineSegmentList segments;
+    for (unsigned i = 0; i < 400; ++i)
+    {
+        osg::Vec3d A(ux(gen), uy(gen), uz(gen));
+        osg::Vec3d B(ux(gen), uy(gen), uz(gen));
+        if (i % 17 == 0) B = A;
+        else if (i % 13 == 0) B.x() = A.x();
+        else if (i % 11 == 0) B.y() = A.y();
+        segments.emplace_back(A, B, i % widths.size());
+    }
+
+    // the row search finds the hits in no particular order
+    std::vector<unsigned> hits(segments.size());
+    for (unsigned i = 0; i < hits.size(); ++i)
+        hits[i] = i;
+    std::shuffle(hits.begin(), hits.end(), gen);
+
+    std::vector<unsigned> rank(segments.size());
+    for (unsigned i = 0; i < hits.size(); ++i)
+        rank[hits[i]] = i;
+
+    const unsigned numCols = 100u;
+    const double xmin = 0.0, col_interval = 1.0;
+
+    SegmentBins bins;
+    bins.blockSize = 8u;
+    std::vector<unsigned> colRanges;
+    std::vector<double> kernelT, kernelD2;
+
+    for (double y : { -12.0, -0.5, 0.0, 3.25, 19.0 })
+    {
+        binSegments(hits, segments, widths, y, xmin, col_interval, numCols, colRanges, bins);
+        REQUIRE(bins.offsets.size() == (numCols + bins.blockSize - 1) / bins.blockSize + 1);
+
+        for (unsigned col = 0; col < numCols; ++col)
+        {
+            osg::Vec3d P(xmin + col * col_interval, y, 0.0);
+            unsigned block = col / bins.blockSize;
+            unsigned begin = bins.offsets[block], end = bins.offsets[block + 1];
+
+            kernelT.resize(end - begin);
+            kernelD2.resize(end - begin);
+            nearestPointsOnSegments(P.x(), P.y(), bins, begin, end, kernelT.data(), kernelD2.data());
+
+            std::vector<bool> listed(segments.size(), false);
+            for (unsigned e = begin; e < end; ++e)
+            {
+                unsigned s = bins.segment[e];
+                REQUIRE(s < segments.size());
+                REQUIRE_FALSE(listed[s]);
+                listed[s] = true;
+
+                // each block keeps the search order
+                if (e > begin)
+                    REQUIRE(rank[bins.segment[e - 1]] < rank[s]);
+
+                const LineSegment& seg = segments[s];
+                const Widths& w = widths[seg.geomIndex];
+                REQUIRE(bins.innerRadius[e] == w.lineWidth * 0.5);
+                REQUIRE(bins.outerRadius[e] == w.lineWidth * 0.5 + w.bufferWidth);
+
+                osg::Vec3d AP = P - seg.A;
+                double t = seg.length2 > 0.0 ? osg::clampBetween((AP * seg.AB) / seg.length2, 0.0, 1.0) : 0.0;
+                double D2 = (P - (seg.A + seg.AB * t)).length2();
+                REQUIRE(kernelT[e - begin] == Approx(t));
+                REQUIRE(kernelD2[e - begin] == Approx(D2));
+            }
+
+            // every segment whose buffer reaches the post is in its block
+            for (unsigned s = 0; s < segments.size(); ++s)
+            {
+                const LineSegment& seg = segments[s];
+                const Widths& w = widths[seg.geomIndex];
+                double outerRadius = w.lineWidth * 0.5 + w.bufferWidth;
+
+                osg::Vec3d AP = P - seg.A;
+                double t = seg.length2 > 0.0 ? osg::clampBetween((AP * seg.AB) / seg.length2, 0.0, 1.0) : 0.0;
+                double D2 = (P - (seg.A + seg.AB * t)).length2();
+                if (D2 <= outerRadius * outerRadius)
+                    REQUIRE(listed[s]);
+            }
+        }
+    }
+}
+
+TEST_CASE("FlatteningLayer road grid benchmark", "[.][benchmark]")
+{
+    TempShapefile shapefile;
+
+    // A road grid: 100 east-west and 100 north-south roads about a kilometer
+    // apart, each made of 100 meter segments
+    {
+        GeoExtent extent(SpatialReference::get("wgs84"), 0.0, 45.0, 1.0, 46.0);
+        auto output = shapefile.create(extent, Geometry::TYPE_LINESTRING);
+        REQUIRE(output.valid());
+
+        for (unsigned i = 0; i < 100; ++i)
+        {
+            LineString* eastWest = new LineString();
+            LineString* northSouth = new LineString();
+            for (unsigned j = 0; j <= 1000; ++j)
+            {
+                eastWest->push_back(0.001 * j, 45.0 + 0.01 * i + 0.0002 * (j % 7));
+                northSouth->push_back(0.01 * i + 0.0002 * (j % 5), 45.0 + 0.001 * j);
+            }
+            osg::ref_ptr<Feature> a = new Feature(eastWest, extent.getSRS());
+            osg::ref_ptr<Feature> b = new Feature(northSouth, extent.getSRS());
+            output->insertFeature(a.get());
+            output->insertFeature(b.get());
+        }
+    }
+
+    auto features = shapefile.open();
+    REQUIRE(features.valid());
+
+    osg::ref_ptr<Map> map = new Map();
+    osg::ref_ptr<FlatteningLayer> layer = new FlatteningLayer();
+    layer->setFeatureSource(features.get());
+    layer->setLineWidth(NumericExpression(10.0));
+    layer->setBufferWidth(NumericExpression(40.0));
+    map->addLayer(layer.get());
+    REQUIRE(layer->isOpen());
+
+    std::vector<TileKey> keys;
+    layer->getProfile()->getIntersectingTiles(
+        GeoExtent(SpatialReference::get("wgs84"), 0.25, 45.25, 0.5, 45.5), 12, keys);
+
+    unsigned valid = 0u;
+    auto t0 = std::chrono::steady_clock::now();
+    for (auto& key : keys)
+    {
+        if (layer->createHeightField(key).valid())
+            ++valid;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+
+    using ms = std::chrono::duration<double, std::milli>;
+    std::cout
+        << "Tiles: " << keys.size() << " (" << valid << " flattened)"
+        << ", " << ms(t1 - t0).count() / (double)keys.size() << " ms/tile" << std::endl;
+}
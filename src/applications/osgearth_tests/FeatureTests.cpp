@@ -8,6 +8,42 @@
 #include <osgEarth/Feature>
 #include <osgEarth/Geometry>
 #include <osgEarth/GeometryUtils>
+#include <osgEarth/Tessellator>
+#include <osgEarth/MeshOptimizer>
+#include <osgEarth/FlatGeometry>
+#include <osgEarth/ScanlineRasterizer>
+#include <osgEarth/SpatialJoin>
+#include <osgEarth/CompiledExpression>
+#include <osgEarth/SpatialReference>
+#include <osgEarth/MVT>
+#include <osgEarth/Profile>
+#include <osgEarth/ScriptEngine>
+#include <osgEarth/LineSymbol>
+#include <osgEarth/StyleSheet>
+#include <osgEarth/TiledFeatureModelLayer>
+#include <osgEarth/ContourFeatureSource>
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/FeatureCursor>
+#include <osgEarth/FeatureIndex>
+#include <osgEarth/GeometryCompiler>
+#include <osgEarth/PolygonSymbol>
+#include <osgEarth/RenderSymbol>
+#include <osgEarth/Session>
+#include <osgEarth/Map>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osgDB/Registry>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
 
 using namespace osgEarth;
 
@@ -215,3 +251,1421 @@ TEST_CASE("Feature handles attributes correctly.")
         REQUIRE(feature->getBool("bool") == false);
     }
 }
+
+TEST_CASE("JavaScript sees feature attributes as ordinary properties")
+{
+    osg::ref_ptr<ScriptEngine> engine = ScriptEngineFactory::create("javascript", "", true);
+    if (!engine.valid())
+    {
+        WARN("No javascript engine available");
+        return;
+    }
+
+    osg::ref_ptr<Feature> feature = new Feature(new Point(), SpatialReference::create("wgs84"));
+    feature->setFID(7);
+    feature->set("name", std::string("Main St"));
+    feature->set("lanes", 2);
+
+    auto run = [&](const std::string& code)
+    {
+        ScriptResult result = engine->run(code, feature.get());
+        REQUIRE(result.success());
+        return result.asString();
+    };
+
+    SECTION("Object.keys and for-in enumerate the attributes")
+    {
+        REQUIRE(run("Object.keys(feature.properties).sort().join(',')") == "lanes,name");
+        REQUIRE(run("var k = []; for (var p in feature.properties) k.push(p); k.sort().join(',')") == "lanes,name");
+        REQUIRE(run("Object.keys(feature).sort().join(',')") == "geometry,id,properties");
+    }
+
+    SECTION("The in operator finds attributes and feature members")
+    {
+        REQUIRE(run("'name' in feature.properties") == "true");
+        REQUIRE(run("'nope' in feature.properties") == "false");
+        REQUIRE(run("'id' in feature && 'properties' in feature && 'attributes' in feature") == "true");
+        REQUIRE(run("feature.properties.hasOwnProperty('lanes')") == "true");
+    }
+
+    SECTION("JSON.stringify serializes the feature")
+    {
+        REQUIRE(run(
+            "var o = JSON.parse(JSON.stringify(feature));"
+            "o.id === 7 && o.properties.name === 'Main St' && o.properties.lanes === 2") == "true");
+    }
+
+    SECTION("Assigned values enumerate and do not outlive the feature")
+    {
+        REQUIRE(run("feature.properties.extra = 1; Object.keys(feature.properties).sort().join(',')") == "extra,lanes,name");
+
+        osg::ref_ptr<Feature> next = new Feature(new Point(), SpatialReference::create("wgs84"));
+        next->set("kind", std::string("river"));
+        ScriptResult result = engine->run("Object.keys(feature.properties).join(',') + ';' + ('name' in feature.properties)", next.get());
+        REQUIRE(result.success());
+        REQUIRE(result.asString() == "kind;false");
+    }
+}
+
+TEST_CASE("Tessellator techniques triangulate a polygon with a hole")
+{
+    // 10x10 square with a 2x2 hole: area 96
+    osg::ref_ptr<Polygon> poly = new Polygon();
+    poly->push_back(osg::Vec3d(0, 0, 0));
+    poly->push_back(osg::Vec3d(10, 0, 0));
+    poly->push_back(osg::Vec3d(10, 10, 0));
+    poly->push_back(osg::Vec3d(0, 10, 0));
+
+    osg::ref_ptr<Ring> hole = new Ring();
+    hole->push_back(osg::Vec3d(4, 4, 0));
+    hole->push_back(osg::Vec3d(4, 6, 0));
+    hole->push_back(osg::Vec3d(6, 6, 0));
+    hole->push_back(osg::Vec3d(6, 4, 0));
+    poly->getHoles().push_back(hole);
+
+    // all the input points, in the order the tessellator indexes them
+    Vec points(poly->begin(), poly->end());
+    points.insert(points.end(), hole->begin(), hole->end());
+
+    auto area = [&](const std::vector<uint32_t>& indices)
+    {
+        double a = 0.0;
+        for (unsigned i = 0; i + 2 < indices.size(); i += 3)
+        {
+            const osg::Vec3d& p0 = points[indices[i]];
+            const osg::Vec3d& p1 = points[indices[i + 1]];
+            const osg::Vec3d& p2 = points[indices[i + 2]];
+            a += 0.5 * fabs((p1.x() - p0.x()) * (p2.y() - p0.y()) - (p2.x() - p0.x()) * (p1.y() - p0.y()));
+        }
+        return a;
+    };
+
+    std::vector<uint32_t> indices;
+
+    SECTION("earcut cuts the hole") {
+        Util::Tessellator tess(Util::Tessellator::TECHNIQUE_EARCUT);
+        REQUIRE(tess.tessellate2D(poly.get(), indices));
+        REQUIRE(indices.size() % 3 == 0);
+        REQUIRE(area(indices) == Approx(96.0));
+    }
+
+    SECTION("GLU cuts the hole") {
+        Util::Tessellator tess(Util::Tessellator::TECHNIQUE_GLU);
+        REQUIRE(tess.tessellate2D(poly.get(), indices));
+        REQUIRE(indices.size() % 3 == 0);
+        REQUIRE(area(indices) == Approx(96.0));
+    }
+
+    SECTION("Legacy ear clipper fills the outer ring only") {
+        Util::Tessellator tess(Util::Tessellator::TECHNIQUE_EARCLIP);
+        REQUIRE(tess.tessellate2D(poly.get(), indices));
+        REQUIRE(indices.size() == 6);
+        REQUIRE(area(indices) == Approx(100.0));
+    }
+}
+
+TEST_CASE("MeshOptimizer welds shared vertices and compacts the layout")
+{
+    // a quad as two triangles with unshared corners and a constant color
+    osg::ref_ptr<osg::Vec3Array> verts = new osg::Vec3Array();
+    for (auto& v : Vec{ {0,0,0}, {1,0,0}, {1,1,0}, {0,0,0}, {1,1,0}, {0,1,0} })
+        verts->push_back(v);
+
+    osg::ref_ptr<osg::Vec4Array> colors = new osg::Vec4Array(osg::Array::BIND_PER_VERTEX, 6);
+    for (auto& c : *colors)
+        c.set(1, 0, 0, 1);
+
+    osg::ref_ptr<osg::Geometry> geom = new osg::Geometry();
+    geom->setUseVertexBufferObjects(true);
+    geom->setVertexArray(verts.get());
+    geom->setColorArray(colors.get());
+    geom->addPrimitiveSet(new osg::DrawArrays(GL_TRIANGLES, 0, 6));
+
+    osg::ref_ptr<osg::Geode> geode = new osg::Geode();
+    geode->addDrawable(geom.get());
+
+    Util::MeshOptimizer optimizer;
+    optimizer.run(geode.get());
+
+    const auto& stats = optimizer.getStats();
+    REQUIRE(stats.geometries == 1u);
+    REQUIRE(stats.verticesBefore == 6u);
+    REQUIRE(stats.verticesAfter == 4u);
+    REQUIRE(stats.indicesAfter == 6u);
+    REQUIRE(stats.bytesAfter < stats.bytesBefore);
+
+    REQUIRE(geom->getVertexArray()->getNumElements() == 4u);
+    REQUIRE(geom->getColorArray()->getBinding() == osg::Array::BIND_OVERALL);
+    REQUIRE(geom->getNumPrimitiveSets() == 1u);
+    REQUIRE(dynamic_cast<osg::DrawElementsUShort*>(geom->getPrimitiveSet(0)) != nullptr);
+}
+
+TEST_CASE("FlatGeometry matches the per-part Geometry operations")
+{
+    // 10x10 square with a 2x2 hole, plus a line crossing it
+    osg::ref_ptr<Polygon> poly = new Polygon();
+    poly->push_back(osg::Vec3d(0, 0, 0));
+    poly->push_back(osg::Vec3d(10, 0, 0));
+    poly->push_back(osg::Vec3d(10, 10, 0));
+    poly->push_back(osg::Vec3d(0, 10, 0));
+
+    osg::ref_ptr<Ring> hole = new Ring();
+    hole->push_back(osg::Vec3d(4, 4, 0));
+    hole->push_back(osg::Vec3d(4, 6, 0));
+    hole->push_back(osg::Vec3d(6, 6, 0));
+    hole->push_back(osg::Vec3d(6, 4, 0));
+    poly->getHoles().push_back(hole);
+
+    osg::ref_ptr<LineString> line = new LineString();
+    line->push_back(osg::Vec3d(-5, 5, 0));
+    line->push_back(osg::Vec3d(15, 5, 0));
+
+    osg::ref_ptr<MultiGeometry> multi = new MultiGeometry();
+    multi->add(poly.get());
+    multi->add(line.get());
+
+    FlatGeometry flat(multi.get());
+    REQUIRE(flat.size() == 10u);
+    REQUIRE(flat.parts.size() == 3u);
+    REQUIRE(flat.parts[1].polygon == 0);
+
+    SECTION("bounds and signed distance") {
+        Bounds b = flat.getBounds();
+        REQUIRE(b.xMin() == -5.0);
+        REQUIRE(b.xMax() == 15.0);
+        for (auto& p : { osg::Vec3d(1, 1, 0), osg::Vec3d(5, 5, 0), osg::Vec3d(12, 8, 0) })
+            REQUIRE(flat.getSignedDistance2D(p.x(), p.y()) == Approx(multi->getSignedDistance2D(p)));
+    }
+
+    SECTION("one batched transform equals the per-part transforms") {
+        osg::ref_ptr<const SpatialReference> wgs84 = SpatialReference::get("wgs84");
+        osg::ref_ptr<const SpatialReference> merc = SpatialReference::get("spherical-mercator");
+
+        REQUIRE(flat.transform(wgs84.get(), merc.get()));
+
+        osg::ref_ptr<Geometry> expected = multi->clone();
+        GeometryIterator iter(expected.get());
+        while (iter.hasMore())
+            REQUIRE(wgs84->transform(iter.next()->asVector(), merc.get()));
+
+        REQUIRE(flat.writeTo(multi.get()));
+        ConstGeometryIterator a(multi.get()), e(expected.get());
+        while (a.hasMore() && e.hasMore())
+        {
+            const Geometry* ag = a.next();
+            const Geometry* eg = e.next();
+            REQUIRE(ag->size() == eg->size());
+            for (unsigned i = 0; i < ag->size(); ++i)
+            {
+                REQUIRE((*ag)[i].x() == Approx((*eg)[i].x()));
+                REQUIRE((*ag)[i].y() == Approx((*eg)[i].y()));
+            }
+        }
+    }
+
+    SECTION("crop to a box") {
+        FlatGeometry cropped = flat.crop(Bounds(2, 2, 0, 8, 8, 0));
+        REQUIRE(cropped.parts.size() == 3u);
+        Bounds b = cropped.getBounds();
+        REQUIRE(b.xMin() == 2.0);
+        REQUIRE(b.xMax() == 8.0);
+
+        osg::ref_ptr<Geometry> g = cropped.toGeometry();
+        REQUIRE(g->getType() == Geometry::TYPE_MULTI);
+        REQUIRE(g->getTotalPointCount() == 10);
+    }
+}
+
+TEST_CASE("ScanlineRasterizer coverage sums to the polygon area")
+{
+    // 40x40 square with a 20x20 hole, offset so no edge falls on a pixel boundary
+    osg::ref_ptr<Polygon> poly = new Polygon();
+    poly->push_back(osg::Vec3d(10.25, 10.5, 0));
+    poly->push_back(osg::Vec3d(50.25, 10.5, 0));
+    poly->push_back(osg::Vec3d(50.25, 50.5, 0));
+    poly->push_back(osg::Vec3d(10.25, 50.5, 0));
+
+    osg::ref_ptr<Ring> hole = new Ring();
+    hole->push_back(osg::Vec3d(20.25, 20.5, 0));
+    hole->push_back(osg::Vec3d(20.25, 40.5, 0));
+    hole->push_back(osg::Vec3d(40.25, 40.5, 0));
+    hole->push_back(osg::Vec3d(40.25, 20.5, 0));
+    poly->getHoles().push_back(hole);
+
+    auto sum = [](Util::ScanlineRasterizer& ras)
+    {
+        double total = 0.0;
+        ras.render([&](int row, int begin, int end, const float* coverage) {
+            for (int x = begin; x < end; ++x)
+                total += coverage[x];
+        });
+        return total;
+    };
+
+    Util::ScanlineRasterizer ras(64, 64);
+    ras.addGeometry(poly.get());
+
+    SECTION("fill rules") {
+        REQUIRE(sum(ras) == Approx(1200.0));
+        ras.setFillRule(Util::ScanlineRasterizer::FILL_EVEN_ODD);
+        REQUIRE(sum(ras) == Approx(1200.0));
+    }
+
+    SECTION("geometry outside the buffer is clipped") {
+        ras.reset();
+        ras.addGeometry(poly.get(), 30.0, 30.0);
+        REQUIRE(sum(ras) == Approx(20.25 * 20.5 - 10.25 * 10.5));
+    }
+
+    SECTION("row bands on several threads match one thread") {
+        std::vector<unsigned char> a(64 * 64, 0), b(64 * 64, 0);
+        ras.renderCoverage(a.data(), 64);
+        ras.setNumThreads(4);
+        ras.renderCoverage(b.data(), 64);
+        REQUIRE(a == b);
+        REQUIRE(a[30 * 64 + 15] == 255); // inside
+        REQUIRE(a[30 * 64 + 30] == 0);   // in the hole
+        REQUIRE(a[30 * 64 + 10] == 191); // 3/4 covered
+    }
+
+    SECTION("float values") {
+        std::vector<float> f(64 * 64, 0.0f);
+        ras.renderValue(f.data(), 64, 7.0f, 0.5f);
+        REQUIRE(f[30 * 64 + 15] == 7.0f);
+        REQUIRE(f[30 * 64 + 30] == 0.0f);
+        REQUIRE(f[30 * 64 + 10] == 7.0f);
+        REQUIRE(f[30 * 64 + 50] == 0.0f); // 1/4 covered
+    }
+}
+
+namespace
+{
+    // Features whose attribute columns are not always in the same order
+    FeatureList makeExpressionFeatures(unsigned count)
+    {
+        FeatureList features;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            osg::ref_ptr<Feature> f = new Feature(new Point(), SpatialReference::get("wgs84"));
+            if (i % 3 == 0)
+                f->set("name", std::string("bldg"));
+            f->set("height", 10.0 + (double)i);
+            f->set("levels", (int)(i % 7));
+            features.push_back(f);
+        }
+        return features;
+    }
+}
+
+TEST_CASE("Compiled expressions match the interpreted ones")
+{
+    const FilterContext* noContext = nullptr;
+    FeatureList features = makeExpressionFeatures(12);
+
+    for (auto& src : {
+        "[height] * 2 + (3 - 1)",
+        "max([levels] * 3.5, [height]) - [height] % 4",
+        "min([height], 15) / [levels]",
+        "[missing] + 1",
+        "1 + 2 * 3",
+        "[height]" })
+    {
+        NumericExpression expr(src);
+        CompiledNumericExpression compiled(expr);
+
+        std::vector<double> batch;
+        compiled.eval(features, batch, noContext);
+
+        for (unsigned i = 0; i < features.size(); ++i)
+        {
+            double expected = features[i]->eval(expr, noContext);
+            REQUIRE(compiled.eval(features[i].get(), noContext) == Approx(expected));
+            REQUIRE(batch[i] == Approx(expected));
+        }
+    }
+
+    REQUIRE(CompiledNumericExpression(NumericExpression("1 + 2 * 3")).isConstant());
+    REQUIRE(CompiledNumericExpression(NumericExpression("(1 + 2) * [height]")).getNumInstructions() == 1u);
+
+    StringExpression strExpr("[name] + \"-\" + [levels]");
+    CompiledStringExpression compiledStr(strExpr);
+    for (auto& f : features)
+        REQUIRE(compiledStr.eval(f.get(), noContext) == f->eval(strExpr, noContext));
+}
+
+TEST_CASE("Compiled expression benchmark", "[.][benchmark]")
+{
+    const FilterContext* noContext = nullptr;
+    FeatureList features = makeExpressionFeatures(250000);
+    NumericExpression expr("max([levels] * 3.5, [height]) * 1.5 + (2 * 4)");
+
+    auto t0 = std::chrono::steady_clock::now();
+    double interpreted = 0.0;
+    for (auto& f : features)
+        interpreted += f->eval(expr, noContext);
+
+    auto t1 = std::chrono::steady_clock::now();
+    CompiledNumericExpression compiled(expr);
+    std::vector<double> results;
+    compiled.eval(features, results, noContext);
+    double batched = 0.0;
+    for (auto r : results)
+        batched += r;
+
+    auto t2 = std::chrono::steady_clock::now();
+    using ms = std::chrono::duration<double, std::milli>;
+    std::cout << "Interpreted: " << ms(t1 - t0).count() << " ms, compiled: " << ms(t2 - t1).count() << " ms" << std::endl;
+
+    REQUIRE(batched == Approx(interpreted));
+}
+
+namespace
+{
+    // Random star-shaped polygons scattered over [0..size]^2, every third
+    // one with a hole and every fifth one split into a multipolygon
+    FeatureList makeJoinBoundaries(unsigned count, double size, unsigned seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<double> pos(0.0, size), unit(0.0, 1.0);
+        double radius = 2.0 * size / std::sqrt((double)count);
+
+        auto star = [&](double cx, double cy, double r, unsigned n, Ring* ring)
+        {
+            for (unsigned k = 0; k < n; ++k)
+            {
+                double a = 2.0 * osg::PI * (double)k / (double)n;
+                double d = r * (0.5 + 0.5 * unit(rng));
+                ring->push_back(osg::Vec3d(cx + d * cos(a), cy + d * sin(a), 0.0));
+            }
+        };
+
+        FeatureList boundaries;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            double cx = pos(rng), cy = pos(rng);
+            osg::ref_ptr<osgEarth::Polygon> polygon = new osgEarth::Polygon();
+            star(cx, cy, radius, 5u + i % 20u, polygon.get());
+            if (i % 3 == 0)
+            {
+                osg::ref_ptr<Ring> hole = new Ring();
+                star(cx, cy, radius * 0.25, 6u, hole.get());
+                polygon->getHoles().push_back(hole);
+            }
+
+            osg::ref_ptr<Geometry> geom = polygon.get();
+            if (i % 5 == 0)
+            {
+                osg::ref_ptr<MultiGeometry> multi = new MultiGeometry();
+                multi->add(polygon.get());
+                osg::ref_ptr<osgEarth::Polygon> other = new osgEarth::Polygon();
+                star(pos(rng), pos(rng), radius, 7u, other.get());
+                multi->add(other.get());
+                geom = multi.get();
+            }
+
+            boundaries.push_back(new Feature(geom.get(), nullptr));
+        }
+        return boundaries;
+    }
+
+    // The containment test the intersect filter used before it had an index
+    int bruteForceContaining(const FeatureList& boundaries, double x, double y)
+    {
+        for (unsigned i = 0; i < boundaries.size(); ++i)
+        {
+            ConstGeometryIterator iter(boundaries[i]->getGeometry(), false);
+            while (iter.hasMore())
+            {
+                const Ring* ring = dynamic_cast<const Ring*>(iter.next());
+                if (ring && ring->contains2D(x, y))
+                    return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    std::vector<osg::Vec2d> makeJoinPoints(unsigned count, double size, unsigned seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<double> pos(-0.05 * size, 1.05 * size);
+        std::vector<osg::Vec2d> points(count);
+        for (auto& p : points)
+            p.set(pos(rng), pos(rng));
+        return points;
+    }
+}
+
+TEST_CASE("SpatialJoin matches a brute force point-in-polygon join")
+{
+    FeatureList boundaries = makeJoinBoundaries(500, 1000.0, 42u);
+
+    // a vertex exactly on a probe row, and an open ring without a polygon
+    Vec notch = { {0,0,0}, {10,0,0}, {10,10,0}, {5,5,0}, {0,10,0} };
+    osg::ref_ptr<Ring> ring = new Ring(&notch);
+    boundaries.push_back(new Feature(ring.get(), nullptr));
+
+    Util::SpatialJoin join(boundaries);
+    REQUIRE(join.getBoundaries().size() == boundaries.size());
+
+    std::vector<osg::Vec2d> points = makeJoinPoints(20000, 1000.0, 7u);
+    points.emplace_back(5.0, 5.0);
+    points.emplace_back(2.0, 5.0);
+    points.emplace_back(7.0, 7.0);
+
+    unsigned inside = 0;
+    for (auto& p : points)
+    {
+        int expected = bruteForceContaining(boundaries, p.x(), p.y());
+        REQUIRE(join.findContaining(p.x(), p.y()) == expected);
+        if (expected >= 0)
+            ++inside;
+    }
+    REQUIRE(inside > 0u);
+    REQUIRE(inside < points.size());
+
+    // the batch version runs in parallel and must agree with the single probes
+    std::vector<int> batch;
+    join.findContaining(points, batch);
+    REQUIRE(batch.size() == points.size());
+    for (unsigned i = 0; i < points.size(); ++i)
+        REQUIRE(batch[i] == join.findContaining(points[i].x(), points[i].y()));
+}
+
+TEST_CASE("SpatialJoin benchmark", "[.][benchmark]")
+{
+    FeatureList boundaries = makeJoinBoundaries(10000, 100000.0, 42u);
+    std::vector<osg::Vec2d> points = makeJoinPoints(1000000, 100000.0, 7u);
+
+    auto t0 = std::chrono::steady_clock::now();
+    Util::SpatialJoin join(boundaries);
+    auto t1 = std::chrono::steady_clock::now();
+    std::vector<int> hits;
+    join.findContaining(points, hits);
+    auto t2 = std::chrono::steady_clock::now();
+
+    // the brute force join is far too slow to run in full; time a sample
+    const unsigned sample = 1000u;
+    for (unsigned i = 0; i < sample; ++i)
+        REQUIRE(bruteForceContaining(boundaries, points[i].x(), points[i].y()) == hits[i]);
+    auto t3 = std::chrono::steady_clock::now();
+
+    using ms = std::chrono::duration<double, std::milli>;
+    std::cout << "SpatialJoin: build " << ms(t1 - t0).count() << " ms, "
+        << points.size() << " probes " << ms(t2 - t1).count() << " ms; "
+        << "brute force (extrapolated): " << ms(t3 - t2).count() * (double)points.size() / (double)sample << " ms" << std::endl;
+}
+
+#ifdef OSGEARTH_HAVE_GEOS
+TEST_CASE("SpatialJoin::findIntersecting picks the first match in source order")
+{
+    FeatureList boundaries = makeJoinBoundaries(300, 1000.0, 42u);
+    Util::SpatialJoin join(boundaries);
+
+    // squares, lines and points, many of them overlapping several boundaries
+    std::mt19937 rng(11u);
+    std::uniform_real_distribution<double> pos(-50.0, 1050.0), size(1.0, 150.0);
+
+    std::vector<osg::ref_ptr<Geometry>> probes;
+    for (unsigned i = 0; i < 600; ++i)
+    {
+        double x = pos(rng), y = pos(rng), s = size(rng);
+        if (i % 3 == 0)
+        {
+            Vec square = { {x,y,0}, {x + s,y,0}, {x + s,y + s,0}, {x,y + s,0} };
+            probes.push_back(new osgEarth::Polygon(&square));
+        }
+        else if (i % 3 == 1)
+        {
+            Vec line = { {x,y,0}, {x + s,y + 0.5 * s,0}, {x + 0.5 * s,y + s,0} };
+            probes.push_back(new LineString(&line));
+        }
+        else
+        {
+            Vec point = { {x,y,0} };
+            probes.push_back(new PointSet(&point));
+        }
+    }
+
+    std::vector<const Geometry*> geometries;
+    unsigned hits = 0;
+    for (auto& probe : probes)
+    {
+        int expected = -1;
+        for (unsigned i = 0; i < boundaries.size() && expected < 0; ++i)
+        {
+            if (boundaries[i]->getGeometry()->intersects(probe.get()))
+                expected = (int)i;
+        }
+        REQUIRE(join.findIntersecting(probe.get()) == expected);
+        if (expected >= 0)
+            ++hits;
+        geometries.push_back(probe.get());
+    }
+    REQUIRE(hits > 0u);
+    REQUIRE(hits < probes.size());
+
+    std::vector<int> batch;
+    join.findIntersecting(geometries, batch);
+    REQUIRE(batch.size() == geometries.size());
+    for (unsigned i = 0; i < geometries.size(); ++i)
+        REQUIRE(batch[i] == join.findIntersecting(geometries[i]));
+}
+#endif // OSGEARTH_HAVE_GEOS
+
+namespace
+{
+    // In-memory boundary source for exercising SpatialJoinCache
+    class JoinBoundarySource : public FeatureSource
+    {
+    public:
+        META_LayerNoOptions(osgEarth, JoinBoundarySource, FeatureSource, join_boundaries);
+
+        FeatureList features;
+
+    protected:
+        Status openImplementation() override
+        {
+            Status parent = super::openImplementation();
+            if (parent.isError())
+                return parent;
+
+            setFeatureProfile(new FeatureProfile(GeoExtent(SpatialReference::get("wgs84"), -180, -90, 180, 90)));
+            return Status::NoError;
+        }
+
+        FeatureCursor* createFeatureCursorImplementation(const Query&, ProgressCallback*) const override
+        {
+            // copies, since the cache transforms what it reads
+            FeatureList output;
+            for (auto& feature : features)
+                output.push_back(new Feature(*feature));
+            return new FeatureListCursor(std::move(output));
+        }
+    };
+}
+
+TEST_CASE("SpatialJoinCache rebuilds when the source revision changes")
+{
+    const SpatialReference* wgs84 = SpatialReference::get("wgs84");
+
+    osg::ref_ptr<JoinBoundarySource> source = new JoinBoundarySource();
+    source->features = makeJoinBoundaries(50, 10.0, 42u);
+    for (auto& feature : source->features)
+        feature->setSRS(wgs84);
+    REQUIRE(source->open().isOK());
+
+    GeoExtent extent(wgs84, -1.0, -1.0, 11.0, 11.0);
+    Util::SpatialJoinCache cache;
+
+    auto first = cache.get(source.get(), extent, wgs84, nullptr);
+    REQUIRE(first != nullptr);
+    REQUIRE(first->getBoundaries().size() == 50u);
+
+    // same revision, same join
+    REQUIRE(cache.get(source.get(), extent, wgs84, nullptr) == first);
+
+    // new boundaries don't show up until the source is dirtied
+    source->features = makeJoinBoundaries(20, 10.0, 7u);
+    for (auto& feature : source->features)
+        feature->setSRS(wgs84);
+    REQUIRE(cache.get(source.get(), extent, wgs84, nullptr) == first);
+
+    int revision = source->getRevision();
+    source->dirty();
+    REQUIRE(source->getRevision() != revision);
+
+    auto second = cache.get(source.get(), extent, wgs84, nullptr);
+    REQUIRE(second != nullptr);
+    REQUIRE(second != first);
+    REQUIRE(second->getBoundaries().size() == 20u);
+    REQUIRE(cache.get(source.get(), extent, wgs84, nullptr) == second);
+
+    // and the new join answers from the new boundaries
+    for (auto& p : makeJoinPoints(1000, 10.0, 3u))
+    {
+        REQUIRE(second->findContaining(p.x(), p.y()) ==
+            bruteForceContaining(second->getBoundaries(), p.x(), p.y()));
+    }
+}
+
+namespace
+{
+    // Hands out object IDs in the order it first sees each feature, and
+    // records which ID each drawable got. Chunks tag from several threads.
+    struct RecordingFeatureIndex : public FeatureIndexBuilder
+    {
+        std::mutex mutex;
+        std::map<FeatureID, ObjectID> oids;
+        std::map<const osg::Drawable*, ObjectID> tags;
+
+        ObjectID insert(Feature* feature) override
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return oids.emplace(feature->getFID(), (ObjectID)oids.size() + 1u).first->second;
+        }
+
+        ObjectID tagDrawable(osg::Drawable* drawable, Feature* feature) override
+        {
+            ObjectID oid = insert(feature);
+            std::lock_guard<std::mutex> lock(mutex);
+            tags[drawable] = oid;
+            return oid;
+        }
+
+        ObjectID tagAllDrawables(osg::Node* node, Feature* feature) override { return insert(feature); }
+        ObjectID tagNode(osg::Node* node, Feature* feature) override { return insert(feature); }
+
+        ObjectID tagRange(osg::Drawable* drawable, Feature* feature, unsigned start, unsigned count) override
+        {
+            return tagDrawable(drawable, feature);
+        }
+    };
+
+    struct DrawableCollector : public osg::NodeVisitor
+    {
+        std::vector<const osg::Drawable*> drawables;
+        DrawableCollector() : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN) { }
+        void apply(osg::Drawable& drawable) override { drawables.push_back(&drawable); }
+    };
+
+    // A grid of small squares, one feature each
+    FeatureList makeCompilerFeatures(unsigned count, const SpatialReference* srs)
+    {
+        FeatureList features;
+        unsigned columns = (unsigned)std::ceil(std::sqrt((double)count));
+        for (unsigned i = 0; i < count; ++i)
+        {
+            double x = -90.0 + 0.5 * (double)(i % columns);
+            double y = -45.0 + 0.5 * (double)(i / columns);
+            Polygon* square = new Polygon();
+            square->push_back(x, y);
+            square->push_back(x + 0.4, y);
+            square->push_back(x + 0.4, y + 0.4);
+            square->push_back(x, y + 0.4);
+            features.push_back(new Feature(square, srs, Style(), (FeatureID)i + 1));
+        }
+        return features;
+    }
+
+    struct CompileResult
+    {
+        osg::ref_ptr<osg::Node> node;
+        RecordingFeatureIndex index;
+    };
+
+    void compileFeatures(unsigned count, bool parallel, CompileResult& result)
+    {
+        const SpatialReference* srs = SpatialReference::get("wgs84");
+        osg::ref_ptr<Map> map = new Map();
+        osg::ref_ptr<Session> session = new Session(map.get());
+        osg::ref_ptr<FeatureProfile> profile = new FeatureProfile(GeoExtent(srs, -180.0, -90.0, 180.0, 90.0));
+        FilterContext context(session.get(), profile.get(), profile->getExtent(), &result.index);
+
+        Style style;
+        style.getOrCreate<PolygonSymbol>()->fill()->color() = Color::Yellow;
+
+        GeometryCompilerOptions options;
+        options.parallelCompile() = parallel;
+        options.parallelChunkSize() = 64u;
+        options.mergeGeometry() = false;
+        options.shaderPolicy() = SHADERPOLICY_INHERIT;
+        options.optimizeStateSharing() = false;
+
+        FeatureList features = makeCompilerFeatures(count, srs);
+        GeometryCompiler compiler(options);
+        result.node = compiler.compile(features, style, context);
+    }
+}
+
+TEST_CASE("GeometryCompiler compiles the same features in parallel as serially")
+{
+    // enough features for several chunks, and a partial last one
+    const unsigned count = 300u;
+    CompileResult serial, parallel;
+    compileFeatures(count, false, serial);
+    compileFeatures(count, true, parallel);
+    REQUIRE(serial.node.valid());
+    REQUIRE(parallel.node.valid());
+
+    DrawableCollector serialDrawables, parallelDrawables;
+    serial.node->accept(serialDrawables);
+    parallel.node->accept(parallelDrawables);
+    REQUIRE(serialDrawables.drawables.size() == count);
+    REQUIRE(parallelDrawables.drawables.size() == count);
+
+    // every feature gets the same object ID...
+    REQUIRE(serial.index.oids.size() == count);
+    REQUIRE(parallel.index.oids == serial.index.oids);
+
+    // ...and the drawables come out in the same order with the same tags
+    for (unsigned i = 0; i < count; ++i)
+    {
+        auto s = serial.index.tags.find(serialDrawables.drawables[i]);
+        auto p = parallel.index.tags.find(parallelDrawables.drawables[i]);
+        REQUIRE(s != serial.index.tags.end());
+        REQUIRE(p != parallel.index.tags.end());
+        REQUIRE(p->second == s->second);
+    }
+}
+
+TEST_CASE("GeometryCompiler parallel compile benchmark", "[.][benchmark]")
+{
+    const unsigned count = 100000u;
+
+    auto t0 = std::chrono::steady_clock::now();
+    CompileResult serial;
+    compileFeatures(count, false, serial);
+    auto t1 = std::chrono::steady_clock::now();
+    CompileResult parallel;
+    compileFeatures(count, true, parallel);
+    auto t2 = std::chrono::steady_clock::now();
+
+    using ms = std::chrono::duration<double, std::milli>;
+    std::cout << "GeometryCompiler " << count << " features: serial " << ms(t1 - t0).count()
+        << " ms, parallel " << ms(t2 - t1).count() << " ms" << std::endl;
+
+    REQUIRE(parallel.index.oids == serial.index.oids);
+}
+
+namespace
+{
+    struct TileCacheKeyLayer : public TiledFeatureModelLayer
+    {
+        std::string tileCacheKey(const TileKey& key) const { return makeTileCacheKey(key); }
+    };
+}
+
+TEST_CASE("TiledFeatureModelLayer tile cache key follows the style sheet")
+{
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::GLOBAL_GEODETIC);
+    TileKey key(5, 3, 7, profile.get());
+
+    osg::ref_ptr<StyleSheet> sheet = new StyleSheet();
+    sheet->addStyle(Style("roads"));
+
+    osg::ref_ptr<TileCacheKeyLayer> layer = new TileCacheKeyLayer();
+    layer->setStyleSheet(sheet.get());
+
+    std::string original = layer->tileCacheKey(key);
+    REQUIRE(layer->tileCacheKey(key) == original);
+
+    SECTION("Editing the sheet in place changes the key")
+    {
+        int revision = sheet->getRevision();
+        sheet->addStyle(Style("rivers"));
+        REQUIRE(sheet->getRevision() != revision);
+        std::string added = layer->tileCacheKey(key);
+        REQUIRE(added != original);
+
+        sheet->removeStyle("rivers");
+        REQUIRE(layer->tileCacheKey(key) != added);
+
+        sheet->getStyles()["roads"].getOrCreate<LineSymbol>();
+        sheet->dirty();
+        REQUIRE(layer->tileCacheKey(key) != original);
+    }
+
+    SECTION("Replacing the sheet changes the key")
+    {
+        osg::ref_ptr<StyleSheet> other = new StyleSheet();
+        other->addStyle(Style("buildings"));
+        layer->setStyleSheet(other.get());
+        REQUIRE(layer->tileCacheKey(key) != original);
+    }
+
+    SECTION("Loader threads see one key per revision")
+    {
+        // first readers after an edit race to rehash the sheet
+        sheet->dirty();
+
+        std::vector<std::string> keys(4);
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < keys.size(); ++t)
+        {
+            threads.emplace_back([&, t]()
+            {
+                for (unsigned i = 0; i < 100; ++i)
+                    keys[t] = layer->tileCacheKey(key);
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        std::string settled = layer->tileCacheKey(key);
+        REQUIRE(settled != original);
+        for (auto& k : keys)
+            REQUIRE(k == settled);
+    }
+}
+
+TEST_CASE("StyleGroup keeps its style through an osgb round trip")
+{
+    // the compiled-tile cache writes StyleGroups with the osgb plugin
+    osgDB::ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension("osgb");
+    REQUIRE(rw != nullptr);
+
+    auto roundTrip = [rw](osg::Node* node) -> osg::ref_ptr<osg::Node>
+    {
+        std::stringstream buf;
+        REQUIRE(rw->writeNode(*node, buf).success());
+        osgDB::ReaderWriter::ReadResult rr = rw->readNode(buf);
+        REQUIRE(rr.validNode());
+        return rr.getNode();
+    };
+
+    SECTION("Styled group")
+    {
+        Style style("roads");
+        style.getOrCreate<LineSymbol>()->stroke()->color() = Color::Red;
+        style.getOrCreate<LineSymbol>()->stroke()->width() = Distance(3.0, Units::PIXELS);
+        style.getOrCreate<RenderSymbol>()->depthTest() = false;
+        style.getOrCreate<RenderSymbol>()->renderBin() = "RenderBin";
+
+        osg::ref_ptr<StyleGroup> group = new StyleGroup(style);
+        group->addChild(new osg::Group());
+
+        osg::ref_ptr<osg::Node> node = roundTrip(group.get());
+        StyleGroup* restored = dynamic_cast<StyleGroup*>(node.get());
+        REQUIRE(restored != nullptr);
+        REQUIRE(restored->getNumChildren() == 1u);
+
+        REQUIRE(restored->style.getName() == "roads");
+        REQUIRE(restored->style.getConfig(false).toJSON() == style.getConfig(false).toJSON());
+
+        const LineSymbol* line = restored->style.get<LineSymbol>();
+        REQUIRE(line != nullptr);
+        REQUIRE(line->stroke()->color() == Color::Red);
+        REQUIRE(line->stroke()->width()->literal().getValue() == 3.0);
+
+        const RenderSymbol* render = restored->style.get<RenderSymbol>();
+        REQUIRE(render != nullptr);
+        REQUIRE(render->depthTest() == false);
+        REQUIRE(render->renderBin() == "RenderBin");
+    }
+
+    SECTION("Unstyled group")
+    {
+        osg::ref_ptr<StyleGroup> group = new StyleGroup();
+
+        osg::ref_ptr<osg::Node> node = roundTrip(group.get());
+        StyleGroup* restored = dynamic_cast<StyleGroup*>(node.get());
+        REQUIRE(restored != nullptr);
+        REQUIRE(restored->style.empty());
+    }
+}
+
+namespace
+{
+    // Elevation layer that evaluates a function of longitude and latitude
+    // at 257x257 posts per tile, the ElevationPool's tile size, so the pool
+    // samples the function exactly
+    class FunctionElevationLayer : public ElevationLayer
+    {
+    public:
+        META_LayerNoOptions(osgEarth, FunctionElevationLayer, ElevationLayer, function_elevation);
+
+        std::function<double(double, double)> function;
+
+        static double spacing(const TileKey& key) { return key.getExtent().width() / 256.0; }
+
+    protected:
+        void init() override
+        {
+            super::init();
+            setProfile(Profile::create(Profile::GLOBAL_GEODETIC));
+            layerHints().cachePolicy() = CachePolicy::NO_CACHE;
+        }
+
+        GeoHeightField createHeightFieldImplementation(const TileKey& key, ProgressCallback*) const override
+        {
+            const GeoExtent& ex = key.getExtent();
+            osg::ref_ptr<osg::HeightField> hf = new osg::HeightField();
+            hf->allocate(257, 257);
+            for (unsigned r = 0; r < 257; ++r)
+                for (unsigned c = 0; c < 257; ++c)
+                    hf->setHeight(c, r, (float)function(ex.xMin() + c * spacing(key), ex.yMin() + r * spacing(key)));
+            return GeoHeightField(hf.get(), ex);
+        }
+    };
+
+    // A map holding a function elevation layer and a contour source on it
+    struct ContourMap
+    {
+        osg::ref_ptr<Map> map = new Map();
+        osg::ref_ptr<FunctionElevationLayer> elevation = new FunctionElevationLayer();
+        osg::ref_ptr<ContourFeatureSource> contours = new ContourFeatureSource();
+
+        ContourMap(double interval, double offset, std::function<double(double, double)> function)
+        {
+            elevation->function = function;
+            map->addLayer(elevation.get());
+            contours->setInterval(interval);
+            contours->setOffset(offset);
+            map->addLayer(contours.get());
+        }
+
+        FeatureList query(const Query& query)
+        {
+            FeatureList features;
+            auto cursor = contours->createFeatureCursor(query);
+            if (cursor.valid())
+                cursor->fill(features);
+            return features;
+        }
+    };
+
+    // A cone peaking at 1000m and reaching 0 at the given radius
+    std::function<double(double, double)> cone(double cx, double cy, double radius)
+    {
+        return [=](double x, double y)
+        {
+            double r = std::sqrt((x - cx) * (x - cx) + (y - cy) * (y - cy));
+            return std::max(0.0, 1000.0 * (1.0 - r / radius));
+        };
+    }
+
+    // Checks that the features are the closed rings of the cone at
+    // elevations 50, 150, ... 950, each within a post of its true radius
+    void requireConeRings(const FeatureList& features, double cx, double cy, double radius, double spacing)
+    {
+        REQUIRE(features.size() == 10u);
+
+        std::set<double> elevations;
+        for (auto& feature : features)
+        {
+            double elevation = feature->getDouble("elevation");
+            REQUIRE(elevations.insert(elevation).second);
+            double expected = radius * (1.0 - elevation / 1000.0);
+
+            const Geometry* line = feature->getGeometry();
+            REQUIRE(line->size() >= 4u);
+            REQUIRE(line->front() == line->back());
+            for (auto& p : *line)
+            {
+                double r = std::sqrt((p.x() - cx) * (p.x() - cx) + (p.y() - cy) * (p.y() - cy));
+                REQUIRE(std::abs(r - expected) < spacing);
+            }
+        }
+        REQUIRE(*elevations.begin() == 50.0);
+        REQUIRE(*elevations.rbegin() == 950.0);
+    }
+}
+
+TEST_CASE("ContourFeatureSource contours a peak as closed rings")
+{
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::GLOBAL_GEODETIC);
+    TileKey key(10, 1100, 300, profile.get());
+    const GeoExtent& ex = key.getExtent();
+    double cx = ex.xMin() + 0.45 * ex.width(), cy = ex.yMin() + 0.55 * ex.height();
+    double radius = 0.4 * ex.width();
+
+    ContourMap map(100.0, 50.0, cone(cx, cy, radius));
+    REQUIRE(map.contours->isOpen());
+
+    requireConeRings(map.query(Query(key)), cx, cy, radius, FunctionElevationLayer::spacing(key));
+
+    SECTION("Contours follow changes to the elevation data")
+    {
+        // same tile, lower peak: the cached lines must not be reused
+        double lower = 0.5 * radius;
+        map.elevation->function = cone(cx, cy, lower);
+        map.elevation->dirty();
+
+        FeatureList features = map.query(Query(key));
+        REQUIRE(features.size() == 10u);
+        for (auto& feature : features)
+        {
+            double expected = lower * (1.0 - feature->getDouble("elevation") / 1000.0);
+            auto& p = feature->getGeometry()->front();
+            REQUIRE(std::abs((p - osg::Vec3d(cx, cy, p.z())).length() - expected) < FunctionElevationLayer::spacing(key));
+        }
+    }
+}
+
+TEST_CASE("ContourFeatureSource resolves saddles by the cell average")
+{
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::GLOBAL_GEODETIC);
+    TileKey key(10, 1100, 300, profile.get());
+    const GeoExtent& ex = key.getExtent();
+    const double s = FunctionElevationLayer::spacing(key);
+
+    // a saddle centered in a grid cell, raised a little so that the cell's
+    // average is above zero while its corners still alternate: the zero
+    // contour is the two branches of a hyperbola in the north-west and
+    // south-east quadrants, and the high corners connect through the cell
+    double cx = ex.xMin() + 128.5 * s, cy = ex.yMin() + 128.5 * s;
+    double k = 1600.0 / (ex.width() * ex.width());
+    double raise = 0.5 * k * s * s / 4.0;
+
+    ContourMap map(1000.0, 0.0, [=](double x, double y) { return k * (x - cx) * (y - cy) + raise; });
+    REQUIRE(map.contours->isOpen());
+
+    FeatureList features = map.query(Query(key));
+    REQUIRE(features.size() == 2u);
+
+    int west = 0, east = 0;
+    for (auto& feature : features)
+    {
+        REQUIRE(feature->getDouble("elevation") == 0.0);
+
+        // each line stays on one branch
+        const Geometry* line = feature->getGeometry();
+        REQUIRE(line->front() != line->back());
+        bool isWest = line->front().x() < cx;
+        for (auto& p : *line)
+        {
+            REQUIRE((p.x() < cx) == isWest);
+            REQUIRE((p.y() > cy) == isWest);
+        }
+        (isWest ? west : east)++;
+    }
+    REQUIRE(west == 1);
+    REQUIRE(east == 1);
+}
+
+TEST_CASE("ContourFeatureSource stitches lines across tiles")
+{
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::GLOBAL_GEODETIC);
+    TileKey left(10, 1100, 300, profile.get()), right(10, 1101, 300, profile.get());
+    const GeoExtent& ex = left.getExtent();
+
+    // a peak on the border between the two tiles
+    double cx = ex.xMax(), cy = ex.yMin() + 0.5 * ex.height();
+    double radius = 0.4 * ex.width();
+
+    ContourMap map(100.0, 50.0, cone(cx, cy, radius));
+    map.contours->setMaxTilesPerQuery(2u);
+    REQUIRE(map.contours->isOpen());
+
+    // each tile alone holds open halves of the rings
+    for (auto& key : { left, right })
+    {
+        FeatureList halves = map.query(Query(key));
+        REQUIRE(halves.size() == 10u);
+        for (auto& feature : halves)
+            REQUIRE(feature->getGeometry()->front() != feature->getGeometry()->back());
+    }
+
+    // a query spanning both tiles joins the halves into whole rings
+    double inset = 0.01 * ex.width();
+    Query query;
+    query.bounds() = Bounds(
+        ex.xMin() + inset, ex.yMin() + inset, 0.0,
+        right.getExtent().xMax() - inset, ex.yMax() - inset, 0.0);
+
+    requireConeRings(map.query(query), cx, cy, radius, FunctionElevationLayer::spacing(left));
+}
+
+#ifdef OSGEARTH_HAVE_MVT
+TEST_CASE("MVT::writeTile round-trips through MVT::readTile")
+{
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::SPHERICAL_MERCATOR);
+    TileKey key(3, 4, 2, profile.get());
+    const GeoExtent& e = key.getExtent();
+
+    // (u, v) in [0..1] across the tile
+    auto at = [&](double u, double v) {
+        return osg::Vec3d(e.xMin() + u * e.width(), e.yMin() + v * e.height(), 0.0);
+    };
+
+    osg::ref_ptr<osgEarth::Polygon> polygon = new osgEarth::Polygon();
+    polygon->push_back(at(0.1, 0.1));
+    polygon->push_back(at(0.1, 0.9)); // clockwise; the encoder must rewind it
+    polygon->push_back(at(0.9, 0.9));
+    polygon->push_back(at(0.9, 0.1));
+    osg::ref_ptr<Ring> hole = new Ring();
+    hole->push_back(at(0.4, 0.4));
+    hole->push_back(at(0.6, 0.4));
+    hole->push_back(at(0.6, 0.6));
+    hole->push_back(at(0.4, 0.6));
+    polygon->getHoles().push_back(hole);
+
+    osg::ref_ptr<Feature> area = new Feature(polygon.get(), profile->getSRS());
+    area->setFID(7);
+    area->set("name", std::string("park"));
+    area->set("levels", 3);
+    area->set("depth", -12);
+    area->set("height", 10.5);
+    area->set("open", true);
+
+    osg::ref_ptr<osgEarth::LineString> line = new osgEarth::LineString();
+    line->push_back(at(0.0, 0.5));
+    line->push_back(at(0.5, 0.5));
+    line->push_back(at(1.0, 0.75));
+    osg::ref_ptr<Feature> road = new Feature(line.get(), profile->getSRS());
+    road->set("name", std::string("park")); // shares a value with "area"
+
+    std::string tile;
+    REQUIRE(MVT::writeTile({ area, road }, key, "test", tile));
+    REQUIRE(!tile.empty());
+
+    FeatureList features;
+    REQUIRE(MVT::readTile(tile.data(), tile.size(), key, features));
+    REQUIRE(features.size() == 2);
+
+    auto* p = dynamic_cast<osgEarth::Polygon*>(features[0]->getGeometry());
+    REQUIRE(p);
+    REQUIRE(p->size() == 4);
+    REQUIRE(p->getHoles().size() == 1);
+    REQUIRE(p->getOrientation() == Geometry::ORIENTATION_CCW);
+    REQUIRE(p->getHoles().front()->getOrientation() == Geometry::ORIENTATION_CW);
+    REQUIRE(features[0]->getFID() == 7);
+    REQUIRE(features[0]->getString("name") == "park");
+    REQUIRE(features[0]->getInt("levels") == 3);
+    REQUIRE(features[0]->getInt("depth") == -12);
+    REQUIRE(features[0]->getDouble("height") == 10.5);
+    REQUIRE(features[0]->getBool("open") == true);
+    REQUIRE(features[0]->getString("mvt_layer") == "test");
+
+    // one tile unit of quantization error at most
+    double tolerance = e.width() / 4096.0;
+    REQUIRE(p->getBounds().xMin() == Approx(at(0.1, 0.1).x()).margin(tolerance));
+    REQUIRE(p->getBounds().yMax() == Approx(at(0.9, 0.9).y()).margin(tolerance));
+
+    auto* l = dynamic_cast<osgEarth::LineString*>(features[1]->getGeometry());
+    REQUIRE(l);
+    REQUIRE(l->size() == 3);
+    REQUIRE((*l)[2].x() == Approx(at(1.0, 0.75).x()).margin(tolerance));
+    REQUIRE((*l)[2].y() == Approx(at(1.0, 0.75).y()).margin(tolerance));
+    REQUIRE(features[1]->getString("name") == "park");
+}
+
+namespace
+{
+    // Minimal protobuf writer for hand-built tiles
+    struct Pbf
+    {
+        std::string out;
+
+        Pbf& varint(std::uint64_t v) {
+            while (v >= 0x80) { out.push_back((char)((v & 0x7f) | 0x80)); v >>= 7; }
+            out.push_back((char)v);
+            return *this;
+        }
+        Pbf& key(unsigned tag, unsigned type) { return varint(((std::uint64_t)tag << 3) | type); }
+        Pbf& field(unsigned tag, std::uint64_t v) { return key(tag, 0).varint(v); }
+        Pbf& bytes(unsigned tag, const std::string& v) { key(tag, 2).varint(v.size()); out += v; return *this; }
+        Pbf& packed(unsigned tag, const std::vector<std::uint32_t>& values) {
+            Pbf p;
+            for (auto v : values) p.varint(v);
+            return bytes(tag, p.out);
+        }
+    };
+
+    std::uint32_t cmd(unsigned id, unsigned count) { return (count << 3) | id; }
+    std::uint32_t zz(std::int32_t n) { return ((std::uint32_t)n << 1) ^ (std::uint32_t)(n >> 31); }
+
+    // One layer named "test" with keys "name" and "kind" and two string values
+    std::string makeTile(const std::vector<std::string>& features)
+    {
+        Pbf layer;
+        layer.field(15, 2).bytes(1, "test");
+        for (auto& f : features)
+            layer.bytes(2, f);
+        layer.bytes(3, "name").bytes(3, "kind");
+        layer.bytes(4, Pbf().bytes(1, "river").out).bytes(4, Pbf().bytes(1, "water").out);
+        layer.field(5, 4096);
+        return Pbf().bytes(3, layer.out).out;
+    }
+
+    // line from (1000,1000) to (3000,1000) in tile units
+    const std::vector<std::uint32_t> lineCommands = {
+        cmd(1, 1), zz(1000), zz(1000), cmd(2, 1), zz(2000), zz(0) };
+
+    bool readVarint(const std::string& in, std::size_t& i, std::uint64_t& v)
+    {
+        v = 0;
+        for (unsigned shift = 0; i < in.size() && shift < 64; shift += 7)
+        {
+            std::uint8_t b = (std::uint8_t)in[i++];
+            v |= (std::uint64_t)(b & 0x7f) << shift;
+            if ((b & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    // Payloads of the length-delimited fields numbered "tag" in a message
+    std::vector<std::string> bytesFields(const std::string& in, unsigned tag)
+    {
+        std::vector<std::string> result;
+        std::size_t i = 0;
+        std::uint64_t key, v;
+        while (i < in.size() && readVarint(in, i, key))
+        {
+            unsigned type = (unsigned)(key & 7);
+            if (type == 0 && readVarint(in, i, v))
+                continue;
+            if (type != 2 || !readVarint(in, i, v) || i + v > in.size())
+                break;
+            if ((key >> 3) == tag)
+                result.push_back(in.substr(i, (std::size_t)v));
+            i += (std::size_t)v;
+        }
+        return result;
+    }
+
+    // Geometry command streams of every feature in an uncompressed tile
+    std::vector<std::vector<std::uint32_t>> featureGeometries(const std::string& tile)
+    {
+        std::vector<std::vector<std::uint32_t>> result;
+        for (auto& layer : bytesFields(tile, 3))
+        {
+            for (auto& feature : bytesFields(layer, 2))
+            {
+                for (auto& packed : bytesFields(feature, 4))
+                {
+                    result.emplace_back();
+                    std::size_t i = 0;
+                    std::uint64_t v;
+                    while (i < packed.size() && readVarint(packed, i, v))
+                        result.back().push_back((std::uint32_t)v);
+                }
+            }
+        }
+        return result;
+    }
+}
+
+TEST_CASE("MVT::writeTile round-trips a multipoint as one MoveTo")
+{
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::SPHERICAL_MERCATOR);
+    TileKey key(3, 4, 2, profile.get());
+    const GeoExtent& e = key.getExtent();
+
+    auto at = [&](double u, double v) {
+        return osg::Vec3d(e.xMin() + u * e.width(), e.yMin() + v * e.height(), 0.0);
+    };
+
+    osg::ref_ptr<MultiGeometry> multi = new MultiGeometry();
+    for (double u : { 0.25, 0.5, 0.75 })
+    {
+        osg::ref_ptr<osgEarth::Point> point = new osgEarth::Point();
+        point->push_back(at(u, u));
+        multi->add(point.get());
+    }
+    osg::ref_ptr<Feature> feature = new Feature(multi.get(), profile->getSRS());
+
+    std::string tile;
+    REQUIRE(MVT::writeTile({ feature }, key, "test", tile));
+
+    auto geometries = featureGeometries(tile);
+    REQUIRE(geometries.size() == 1u);
+    REQUIRE(geometries[0].size() == 7u);
+    REQUIRE(geometries[0][0] == cmd(1, 3));
+
+    FeatureList features;
+    REQUIRE(MVT::readTile(tile.data(), tile.size(), key, features));
+    REQUIRE(features.size() == 1);
+    auto* points = features[0]->getGeometry();
+    REQUIRE(points->getType() == Geometry::TYPE_POINTSET);
+    REQUIRE(points->size() == 3);
+
+    double tolerance = e.width() / 4096.0;
+    REQUIRE((*points)[1].x() == Approx(at(0.5, 0.5).x()).margin(tolerance));
+    REQUIRE((*points)[2].y() == Approx(at(0.75, 0.75).y()).margin(tolerance));
+}
+
+TEST_CASE("MVT::readTile decodes unpacked tags and geometry")
+{
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::SPHERICAL_MERCATOR);
+    TileKey key(3, 4, 2, profile.get());
+
+    // the same feature three ways: packed, unpacked, and split across both
+    Pbf packed;
+    packed.field(1, 11).packed(2, { 0, 0, 1, 1 }).field(3, 2).packed(4, lineCommands);
+
+    Pbf unpacked;
+    unpacked.field(1, 12);
+    for (auto v : { 0u, 0u, 1u, 1u }) unpacked.field(2, v);
+    unpacked.field(3, 2);
+    for (auto v : lineCommands) unpacked.field(4, v);
+
+    Pbf mixed;
+    mixed.field(1, 13).packed(2, { 0, 0 }).field(2, 1).field(2, 1).field(3, 2)
+        .packed(4, { lineCommands[0], lineCommands[1], lineCommands[2] })
+        .field(4, lineCommands[3]).packed(4, { lineCommands[4], lineCommands[5] });
+
+    std::string tile = makeTile({ packed.out, unpacked.out, mixed.out });
+
+    FeatureList features;
+    REQUIRE(MVT::readTile(tile.data(), tile.size(), key, features));
+    REQUIRE(features.size() == 3);
+
+    for (auto& f : features)
+    {
+        REQUIRE(f->getString("name") == "river");
+        REQUIRE(f->getString("kind") == "water");
+        auto* line = dynamic_cast<osgEarth::LineString*>(f->getGeometry());
+        REQUIRE(line);
+        REQUIRE(line->size() == 2);
+        REQUIRE((*line)[0].x() == Approx(features[0]->getGeometry()->asVector()[0].x()));
+        REQUIRE((*line)[1].x() == Approx(features[0]->getGeometry()->asVector()[1].x()));
+    }
+    REQUIRE(features[0]->getFID() == 11);
+    REQUIRE(features[1]->getFID() == 12);
+    REQUIRE(features[2]->getFID() == 13);
+}
+
+TEST_CASE("MVT::readTile survives zero-length and malformed commands")
+{
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::SPHERICAL_MERCATOR);
+    TileKey key(3, 4, 2, profile.get());
+    FeatureList features;
+
+    SECTION("A long run of zero-count commands is skipped")
+    {
+        std::vector<std::uint32_t> commands(1000000, cmd(1, 0));
+        commands.insert(commands.end(), lineCommands.begin(), lineCommands.end());
+
+        Pbf f;
+        f.field(3, 2).packed(4, commands);
+        std::string tile = makeTile({ f.out });
+
+        REQUIRE(MVT::readTile(tile.data(), tile.size(), key, features));
+        REQUIRE(features.size() == 1);
+        REQUIRE(features[0]->getGeometry()->size() == 2);
+    }
+
+    SECTION("A vertex count larger than the stream ends the geometry")
+    {
+        Pbf f;
+        f.field(3, 2).packed(4, { cmd(1, 1), zz(10), zz(10), cmd(2, 100000000), zz(5), zz(5) });
+        std::string tile = makeTile({ f.out });
+
+        REQUIRE(MVT::readTile(tile.data(), tile.size(), key, features));
+        REQUIRE(features.size() == 1);
+        REQUIRE(features[0]->getGeometry()->size() == 1);
+    }
+
+    SECTION("Unknown commands and huge close counts end the geometry")
+    {
+        Pbf unknown;
+        unknown.field(3, 2).packed(4, { cmd(1, 1), zz(10), zz(10), cmd(5, 3), cmd(2, 1), zz(5), zz(5) });
+        Pbf close;
+        close.field(3, 3).packed(4, {
+            cmd(1, 1), zz(0), zz(0), cmd(2, 2), zz(100), zz(0), zz(0), zz(100), cmd(7, 100000000) });
+        std::string tile = makeTile({ unknown.out, close.out });
+
+        REQUIRE(MVT::readTile(tile.data(), tile.size(), key, features));
+        REQUIRE(features.size() == 2);
+        REQUIRE(features[0]->getGeometry()->size() == 1);
+        REQUIRE(dynamic_cast<osgEarth::Polygon*>(features[1]->getGeometry()));
+    }
+
+    SECTION("Truncated tiles fail cleanly")
+    {
+        Pbf f;
+        f.field(1, 1).packed(2, { 0, 0 }).field(3, 2).packed(4, lineCommands);
+        std::string tile = makeTile({ f.out });
+
+        for (std::size_t size = 1; size < tile.size(); ++size)
+        {
+            features.clear();
+            MVT::readTile(tile.data(), size, key, features);
+        }
+        std::string garbage = "\x1a\xff\xff\xff\xff\x0f";
+        REQUIRE(MVT::readTile(garbage.data(), garbage.size(), key, features) == false);
+    }
+}
+#endif
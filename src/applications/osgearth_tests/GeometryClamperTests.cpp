@@ -0,0 +1,369 @@
+/* osgEarth
+* Copyright 2025 Pelican Mapping
+* MIT License
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/GeometryClamper>
+#include <osgEarth/Profile>
+#include <osgEarth/SpatialReference>
+#include <osgEarth/TerrainTileNode>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Image>
+#include <osg/MatrixTransform>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    // Records what a drain hands over
+    struct Drained
+    {
+        std::vector<TileKey> keys;
+        std::vector<osg::Node*> tiles;
+
+        std::function<void(const TileKey&, osg::Node*)> func()
+        {
+            return [this](const TileKey& key, osg::Node* tile)
+            {
+                keys.push_back(key);
+                tiles.push_back(tile);
+            };
+        }
+    };
+
+    // Restores the shared frame budget when a test changes it
+    struct FrameBudgetScope
+    {
+        double saved = GeometryClamper::getFrameBudget();
+        ~FrameBudgetScope() { GeometryClamper::setFrameBudget(saved); }
+    };
+
+    // Flat terrain: one big horizontal square at the given height
+    osg::ref_ptr<osg::Node> makeFlatTerrain(double height)
+    {
+        const double size = 1e8;
+        osg::Vec3Array* verts = new osg::Vec3Array();
+        verts->push_back(osg::Vec3(-size, -size, height));
+        verts->push_back(osg::Vec3(size, -size, height));
+        verts->push_back(osg::Vec3(-size, size, height));
+        verts->push_back(osg::Vec3(size, size, height));
+
+        osg::Geometry* geom = new osg::Geometry();
+        geom->setVertexArray(verts);
+        geom->addPrimitiveSet(new osg::DrawArrays(GL_TRIANGLE_STRIP, 0, 4));
+
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode();
+        geode->addDrawable(geom);
+        return geode;
+    }
+
+    // A terrain tile that renders with an elevation raster, as the engine's
+    // tiles do
+    struct RasterTile : public osg::Node, public TerrainTile
+    {
+        TileKey key;
+        osg::ref_ptr<osg::Image> raster;
+        osg::Matrixf matrix;
+
+        const TileKey& getKey() const override { return key; }
+        const osg::Image* getElevationRaster() const override { return raster.get(); }
+        const osg::Matrixf& getElevationMatrix() const override { return matrix; }
+    };
+}
+
+TEST_CASE("GeometryClamper::DirtyTiles merges, supersedes and carries over")
+{
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::SPHERICAL_MERCATOR);
+    TileKey a(8, 10, 20, profile.get()), b(8, 11, 20, profile.get()), c(8, 12, 20, profile.get());
+    osg::ref_ptr<osg::Node> tileA = new osg::Node(), tileB = new osg::Node(), tileC = new osg::Node();
+    osg::ref_ptr<osg::Node> newerA = new osg::Node();
+
+    GeometryClamper::DirtyTiles queue;
+    REQUIRE(queue.empty());
+
+    SECTION("A newer update of a queued tile replaces the older one")
+    {
+        queue.push(a, tileA.get());
+        queue.push(b, tileB.get());
+        queue.push(a, newerA.get());
+        REQUIRE_FALSE(queue.empty());
+
+        Drained drained;
+        queue.drain(nullptr, drained.func());
+        REQUIRE(drained.keys == (std::vector<TileKey>{ a, b }));
+        REQUIRE(drained.tiles == (std::vector<osg::Node*>{ newerA.get(), tileB.get() }));
+        REQUIRE(queue.empty());
+    }
+
+    SECTION("A full reclamp supersedes queued and later tiles")
+    {
+        queue.push(a, tileA.get());
+        queue.push(TileKey::INVALID, nullptr);
+        queue.push(b, tileB.get());
+
+        Drained drained;
+        queue.drain(nullptr, drained.func());
+        REQUIRE(drained.keys.size() == 1u);
+        REQUIRE_FALSE(drained.keys[0].valid());
+        REQUIRE(drained.tiles[0] == nullptr);
+        REQUIRE(queue.empty());
+
+        // once drained, tiles queue normally again
+        queue.push(c, tileC.get());
+        drained = {};
+        queue.drain(nullptr, drained.func());
+        REQUIRE(drained.keys == (std::vector<TileKey>{ c }));
+    }
+
+    SECTION("Tiles that left the scene graph are dropped")
+    {
+        osg::ref_ptr<osg::Node> gone = new osg::Node();
+        queue.push(a, gone.get());
+        queue.push(b, tileB.get());
+        gone = nullptr;
+
+        Drained drained;
+        queue.drain(nullptr, drained.func());
+        REQUIRE(drained.keys == (std::vector<TileKey>{ b }));
+        REQUIRE(queue.empty());
+    }
+
+    SECTION("Work past the frame budget waits for the next frame")
+    {
+        // with no budget, each frame still gets one tile
+        FrameBudgetScope scope;
+        GeometryClamper::setFrameBudget(0.0);
+
+        queue.push(a, tileA.get());
+        queue.push(b, tileB.get());
+        queue.push(c, tileC.get());
+
+        osg::ref_ptr<osg::FrameStamp> stamp = new osg::FrameStamp();
+        stamp->setFrameNumber(1000001);
+
+        Drained drained;
+        queue.drain(stamp.get(), drained.func());
+        REQUIRE(drained.keys == (std::vector<TileKey>{ a }));
+
+        // the same frame has nothing left to give
+        queue.drain(stamp.get(), drained.func());
+        REQUIRE(drained.keys.size() == 1u);
+
+        // an update of a waiting tile merges into the carried-over queue
+        queue.push(c, newerA.get());
+
+        stamp->setFrameNumber(1000002);
+        queue.drain(stamp.get(), drained.func());
+        REQUIRE(drained.keys == (std::vector<TileKey>{ a, b }));
+
+        stamp->setFrameNumber(1000003);
+        queue.drain(stamp.get(), drained.func());
+        REQUIRE(drained.keys == (std::vector<TileKey>{ a, b, c }));
+        REQUIRE(drained.tiles.back() == newerA.get());
+        REQUIRE(queue.empty());
+
+        // a full reclamp waits for a frame with budget too
+        queue.push(TileKey::INVALID, nullptr);
+        queue.drain(stamp.get(), drained.func());
+        REQUIRE_FALSE(queue.empty());
+
+        stamp->setFrameNumber(1000004);
+        queue.drain(stamp.get(), drained.func());
+        REQUIRE(queue.empty());
+        REQUIRE_FALSE(drained.keys.back().valid());
+    }
+}
+
+TEST_CASE("GeometryClamper clamps only the vertices inside a terrain tile")
+{
+    // tile edges at round numbers, so vertices can sit exactly on them
+    osg::ref_ptr<const Profile> profile = Profile::create(
+        SpatialReference::get("spherical-mercator"), 0.0, 0.0, 1024000.0, 1024000.0, 1u, 1u);
+    TileKey key(2, 1, 1, profile.get());
+    TileKey east(2, 2, 1, profile.get());
+    const GeoExtent& ex = key.getExtent();
+
+    // Vertices scattered over the tile and its surroundings, in no
+    // particular order, including some right on the tile's edges and
+    // some inside its x range but outside its y range.
+    std::mt19937 gen(3u);
+    std::uniform_real_distribution<double> u(-1.0, 2.0);
+
+    osg::ref_ptr<osg::Vec3Array> verts = new osg::Vec3Array();
+    for (unsigned i = 0; i < 500; ++i)
+        verts->push_back(osg::Vec3(ex.xMin() + u(gen) * ex.width(), ex.yMin() + u(gen) * ex.height(), 0.0f));
+    verts->push_back(osg::Vec3(ex.xMin(), ex.yMin() + 0.5 * ex.height(), 0.0f));
+    verts->push_back(osg::Vec3(ex.xMax(), ex.yMax(), 0.0f));
+    verts->push_back(osg::Vec3(ex.xMin() + 0.5 * ex.width(), ex.yMax() + 0.1 * ex.height(), 0.0f));
+
+    // keep float-exact copies, since the vertex array holds floats
+    std::vector<osg::Vec3d> original(verts->begin(), verts->end());
+
+    osg::ref_ptr<osg::Geometry> geom = new osg::Geometry();
+    geom->setUseVertexBufferObjects(false);
+    geom->setVertexArray(verts.get());
+    geom->addPrimitiveSet(new osg::DrawArrays(GL_POINTS, 0, verts->size()));
+
+    osg::ref_ptr<osg::Geode> geode = new osg::Geode();
+    geode->addDrawable(geom.get());
+    osg::ref_ptr<osg::MatrixTransform> root = new osg::MatrixTransform();
+    root->addChild(geode.get());
+
+    auto inside = [](const osg::Vec3d& p, const GeoExtent& e)
+    {
+        return p.x() >= e.xMin() && p.x() <= e.xMax() && p.y() >= e.yMin() && p.y() <= e.yMax();
+    };
+
+    GeometryClamper::LocalData data;
+    auto clampTile = [&](const TileKey& tileKey, double height)
+    {
+        osg::ref_ptr<osg::Node> terrain = makeFlatTerrain(height);
+        GeometryClamper clamper(data);
+        clamper.setTerrainSRS(profile->getSRS());
+        clamper.setTerrainTile(tileKey, terrain.get());
+        root->accept(clamper);
+    };
+
+    clampTile(key, 100.0);
+
+    unsigned clamped = 0u;
+    for (unsigned i = 0; i < verts->size(); ++i)
+    {
+        bool in = inside(original[i], ex);
+        REQUIRE((*verts)[i].z() == Approx(in ? 100.0 : 0.0));
+        REQUIRE((*verts)[i].x() == Approx(original[i].x()));
+        if (in) ++clamped;
+    }
+    REQUIRE(clamped > 3u);
+    REQUIRE((*verts)[500].z() == Approx(100.0));
+    REQUIRE((*verts)[501].z() == Approx(100.0));
+    REQUIRE((*verts)[502].z() == Approx(0.0));
+
+    SECTION("A neighboring tile leaves the first tile's vertices alone")
+    {
+        clampTile(east, 200.0);
+
+        for (unsigned i = 0; i < verts->size(); ++i)
+        {
+            // vertices on the shared edge belong to both tiles
+            double expected =
+                inside(original[i], east.getExtent()) ? 200.0 :
+                inside(original[i], ex) ? 100.0 :
+                0.0;
+            REQUIRE((*verts)[i].z() == Approx(expected));
+        }
+    }
+
+    SECTION("Moving the geometry rebuilds its index")
+    {
+        // shift everything a tile west: what was in the east tile is now
+        // in this one
+        root->setMatrix(osg::Matrixd::translate(-ex.width(), 0.0, 0.0));
+        clampTile(key, 300.0);
+
+        GeoExtent shifted(ex.getSRS(), ex.xMin() + ex.width(), ex.yMin(), ex.xMax() + ex.width(), ex.yMax());
+        for (unsigned i = 0; i < verts->size(); ++i)
+        {
+            if (inside(original[i], shifted))
+                REQUIRE((*verts)[i].z() == Approx(300.0));
+            else
+                REQUIRE((*verts)[i].z() == Approx(inside(original[i], ex) ? 100.0 : 0.0));
+        }
+    }
+}
+
+TEST_CASE("GeometryClamper samples a terrain tile's elevation raster")
+{
+    osg::ref_ptr<const Profile> profile = Profile::create(
+        SpatialReference::get("spherical-mercator"), 0.0, 0.0, 1024000.0, 1024000.0, 1u, 1u);
+    TileKey key(2, 1, 1, profile.get());
+    TileKey parent = key.createParentKey();
+    const GeoExtent& ex = key.getExtent();
+    const GeoExtent& pex = parent.getExtent();
+
+    // The tile inherits its parent's raster, so the elevation matrix maps
+    // it into one quadrant. The posts follow a function that bilinear
+    // sampling reproduces exactly, except for one with no data.
+    const int size = 9;
+    auto post = [](double s, double t) { return 10.0 * s + 100.0 * t + 3.0 * s * t; };
+
+    osg::ref_ptr<RasterTile> tile = new RasterTile();
+    tile->key = key;
+    ex.createScaleBias(pex, tile->matrix);
+    tile->raster = new osg::Image();
+    tile->raster->allocateImage(size, size, 1, GL_RED, GL_FLOAT);
+    for (int t = 0; t < size; ++t)
+        for (int s = 0; s < size; ++s)
+            *reinterpret_cast<float*>(tile->raster->data(s, t)) = (float)post(s, t);
+
+    // a post inside the tile's quadrant
+    const int holeS = 6, holeT = 2;
+    *reinterpret_cast<float*>(tile->raster->data(holeS, holeT)) = NO_DATA_VALUE;
+
+    std::mt19937 gen(9u);
+    std::uniform_real_distribution<double> u(0.0, 1.0);
+
+    osg::ref_ptr<osg::Vec3Array> verts = new osg::Vec3Array();
+    for (unsigned i = 0; i < 300; ++i)
+    {
+        // every third vertex sits above the terrain, to carry its height over
+        float z = (i % 3 == 0) ? 2.0f : 0.0f;
+        verts->push_back(osg::Vec3(ex.xMin() + u(gen) * ex.width(), ex.yMin() + u(gen) * ex.height(), z));
+    }
+    verts->push_back(osg::Vec3(ex.xMin(), ex.yMin(), 0.0f));
+    verts->push_back(osg::Vec3(ex.xMax(), ex.yMax(), 0.0f));
+    std::vector<osg::Vec3d> original(verts->begin(), verts->end());
+
+    osg::ref_ptr<osg::Geometry> geom = new osg::Geometry();
+    geom->setUseVertexBufferObjects(false);
+    geom->setVertexArray(verts.get());
+    geom->addPrimitiveSet(new osg::DrawArrays(GL_POINTS, 0, verts->size()));
+
+    osg::ref_ptr<osg::Geode> geode = new osg::Geode();
+    geode->addDrawable(geom.get());
+    osg::ref_ptr<osg::MatrixTransform> root = new osg::MatrixTransform();
+    root->addChild(geode.get());
+
+    GeometryClamper::LocalData data;
+    GeometryClamper clamper(data);
+    clamper.setTerrainSRS(profile->getSRS());
+    clamper.setOffset(5.0f);
+    clamper.setTerrainTile(key, tile.get());
+    root->accept(clamper);
+
+    unsigned sampled = 0u, skipped = 0u;
+    for (unsigned i = 0; i < verts->size(); ++i)
+    {
+        const osg::Vec3d& p = original[i];
+        REQUIRE((*verts)[i].x() == Approx(p.x()));
+        REQUIRE((*verts)[i].y() == Approx(p.y()));
+
+        // raster coordinates, straight from the parent's extent
+        double sf = (p.x() - pex.xMin()) / pex.width() * (double)(size - 1);
+        double tf = (p.y() - pex.yMin()) / pex.height() * (double)(size - 1);
+        int s0 = std::min((int)sf, size - 2), t0 = std::min((int)tf, size - 2);
+
+        if ((s0 == holeS || s0 + 1 == holeS) && (t0 == holeT || t0 + 1 == holeT))
+        {
+            // a corner has no data: leave the vertex alone
+            REQUIRE((*verts)[i].z() == Approx(p.z()));
+            ++skipped;
+        }
+        else
+        {
+            // the vertex keeps its height above the terrain
+            REQUIRE((*verts)[i].z() == Approx(post(sf, tf) + p.z()));
+            ++sampled;
+        }
+    }
+    REQUIRE(sampled > 100u);
+    REQUIRE(skipped > 10u);
+}
@@ -4,10 +4,19 @@
 */
 
 #include <osgEarth/catch.hpp>
+#include "TempShapefile"
 
 #include <osgEarth/ImageLayer>
 #include <osgEarth/Registry>
 #include <osgEarth/GDAL>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/FeatureImageLayer>
+#include <osgEarth/OGRFeatureSource>
+#include <osgEarth/PolygonSymbol>
+#include <osgEarth/LineSymbol>
+#include <osgEarth/Map>
+#include <chrono>
+#include <iostream>
 
 using namespace osgEarth;
 
@@ -50,4 +59,236 @@ TEST_CASE("Attribution works")
 
     REQUIRE(status.isOK());
     REQUIRE(layer->getAttribution() == attribution);
-}
\ No newline at end of file
+}
+TEST_CASE("Tiled GeoTIFF reads match RasterIO")
+{
+    osg::ref_ptr<GDALImageLayer> direct = new GDALImageLayer();
+    direct->setURL("../data/world.tif");
+    direct->setUseCOG(true);
+    REQUIRE(direct->open().isOK());
+
+    osg::ref_ptr<GDALImageLayer> resampled = new GDALImageLayer();
+    resampled->setURL("../data/world.tif");
+    resampled->setUseCOG(false);
+    REQUIRE(resampled->open().isOK());
+
+    for (unsigned lod = 0; lod < 3; ++lod)
+    {
+        TileKey key(lod, 0, 0, direct->getProfile());
+        GeoImage a = direct->createImage(key);
+        GeoImage b = resampled->createImage(key);
+        REQUIRE(a.valid() == b.valid());
+        if (a.valid())
+        {
+            REQUIRE(ImageUtils::areEquivalent(a.getImage(), b.getImage()));
+        }
+    }
+}
+
+namespace
+{
+    // Two feature image layers on the same features, one rendering a tile
+    // at a time and one rendering batches of tiles
+    struct FeatureImagePair
+    {
+        osg::ref_ptr<Map> map;
+        osg::ref_ptr<FeatureImageLayer> single;
+        osg::ref_ptr<FeatureImageLayer> batched;
+
+        FeatureImagePair(FeatureSource* features, const Style& style)
+        {
+            osg::ref_ptr<StyleSheet> sheet = new StyleSheet();
+            sheet->addStyle(style);
+
+            map = new Map();
+
+            single = new FeatureImageLayer();
+            single->setFeatureSource(features);
+            single->setStyleSheet(sheet.get());
+            map->addLayer(single.get());
+
+            batched = new FeatureImageLayer();
+            batched->options().batchTiles() = true;
+            batched->setFeatureSource(features);
+            batched->setStyleSheet(sheet.get());
+            map->addLayer(batched.get());
+        }
+    };
+
+    Style fillStyle()
+    {
+        Style style;
+        style.getOrCreate<PolygonSymbol>()->fill()->color() = Color(Color::Yellow, 0.5f);
+        return style;
+    }
+
+    std::vector<TileKey> childrenOf(const TileKey& parent)
+    {
+        std::vector<TileKey> children;
+        for (unsigned q = 0; q < 4; ++q)
+            children.push_back(parent.createChildKey(q));
+        return children;
+    }
+}
+
+TEST_CASE("FeatureImageLayer renders batched tiles like single tiles")
+{
+    osg::ref_ptr<OGRFeatureSource> features = new OGRFeatureSource();
+    features->setURL("../data/world.shp");
+    REQUIRE(features->open().isOK());
+
+    FeatureImagePair layers(features.get(), fillStyle());
+    REQUIRE(layers.single->isOpen());
+    REQUIRE(layers.batched->isOpen());
+
+    const Profile* profile = layers.batched->getProfile();
+
+    for (unsigned lod = 0; lod < 3; ++lod)
+    {
+        unsigned tx, ty;
+        profile->getNumTiles(lod, tx, ty);
+        for (unsigned y = 0; y < ty; ++y)
+        {
+            for (unsigned x = 0; x < tx; ++x)
+            {
+                std::vector<TileKey> children = childrenOf(TileKey(lod, x, y, profile));
+                std::vector<GeoImage> images = layers.batched->createImages(children, nullptr);
+                REQUIRE(images.size() == children.size());
+
+                for (unsigned i = 0; i < children.size(); ++i)
+                {
+                    GeoImage expected = layers.single->createImage(children[i]);
+                    REQUIRE(images[i].valid() == expected.valid());
+                    if (expected.valid())
+                    {
+                        REQUIRE(ImageUtils::areEquivalent(images[i].getImage(), expected.getImage()));
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("FeatureImageLayer renders batched line strokes like single tiles")
+{
+    // Line positions are in pixels from the center of the parent tile,
+    // whose children are the default 256 pixels across
+    const float strokeWidth = 4.0f;
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::GLOBAL_GEODETIC);
+    TileKey parent(2, 4, 1, profile.get());
+    const GeoExtent& extent = parent.getExtent();
+    double mx = extent.xMin() + 0.5 * extent.width();
+    double my = extent.yMin() + 0.5 * extent.height();
+    double pixel = extent.width() / 512.0;
+
+    TempShapefile shapefile;
+    {
+        auto output = shapefile.create(extent, Geometry::TYPE_LINESTRING);
+        REQUIRE(output.valid());
+
+        auto insert = [&](std::initializer_list<osg::Vec2d> points)
+        {
+            LineString* line = new LineString();
+            for (auto& p : points)
+                line->push_back(mx + p.x() * pixel, my + p.y() * pixel);
+            osg::ref_ptr<Feature> feature = new Feature(line, extent.getSRS());
+            output->insertFeature(feature.get());
+        };
+
+        // a zigzag well inside each child
+        for (int qx = -1; qx <= 1; qx += 2)
+            for (int qy = -1; qy <= 1; qy += 2)
+                insert({ {qx * 40.0, qy * 40.0}, {qx * 120.0, qy * 60.0}, {qx * 80.0, qy * 200.0} });
+
+        // one crossing the boundary between two children
+        insert({ {-100.0, 30.0}, {100.0, 50.0} });
+
+        // one passing just south-west of the center: it crosses the
+        // north-west, south-west and south-east children, and its bounds
+        // (but not the line itself) reach into the north-east child, whose
+        // own query skips it
+        insert({ {-10.0, 9.0}, {9.0, -10.0} });
+    }
+
+    auto lines = shapefile.open();
+    REQUIRE(lines.valid());
+
+    Style style;
+    style.getOrCreate<LineSymbol>()->stroke()->color() = Color::Red;
+    style.getOrCreate<LineSymbol>()->stroke()->width() = Distance(strokeWidth, Units::PIXELS);
+
+    FeatureImagePair lineLayers(lines.get(), style);
+    REQUIRE(lineLayers.batched->isOpen());
+
+    std::vector<TileKey> children = childrenOf(parent);
+    std::vector<GeoImage> images = lineLayers.batched->createImages(children, nullptr);
+    REQUIRE(images.size() == children.size());
+
+    for (unsigned i = 0; i < children.size(); ++i)
+    {
+        GeoImage expected = lineLayers.single->createImage(children[i]);
+        REQUIRE(images[i].valid());
+        REQUIRE(expected.valid());
+        REQUIRE(ImageUtils::areEquivalent(images[i].getImage(), expected.getImage()));
+    }
+}
+
+TEST_CASE("FeatureImageLayer batched tile benchmark", "[.][benchmark]")
+{
+    // A landuse-like layer: a grid of 10,000 small parcels
+    GeoExtent extent(SpatialReference::get("wgs84"), -10.0, 40.0, 10.0, 60.0);
+    TempShapefile shapefile;
+    {
+        auto output = shapefile.create(extent, Geometry::TYPE_POLYGON);
+        REQUIRE(output.valid());
+
+        for (unsigned y = 0; y < 100; ++y)
+        {
+            for (unsigned x = 0; x < 100; ++x)
+            {
+                double x0 = -10.0 + 0.2 * x, y0 = 40.0 + 0.2 * y;
+                Polygon* poly = new Polygon();
+                poly->push_back(x0, y0);
+                poly->push_back(x0 + 0.15, y0 + 0.02);
+                poly->push_back(x0 + 0.18, y0 + 0.17);
+                poly->push_back(x0 + 0.03, y0 + 0.15);
+                osg::ref_ptr<Feature> feature = new Feature(poly, extent.getSRS());
+                output->insertFeature(feature.get());
+            }
+        }
+    }
+
+    auto features = shapefile.open();
+    REQUIRE(features.valid());
+
+    FeatureImagePair layers(features.get(), fillStyle());
+    REQUIRE(layers.batched->isOpen());
+
+    const Profile* profile = layers.batched->getProfile();
+    std::vector<TileKey> parents;
+    profile->getIntersectingTiles(extent, 6, parents);
+
+    unsigned tiles = 0u;
+    auto t0 = std::chrono::steady_clock::now();
+    for (auto& parent : parents)
+    {
+        for (auto& child : childrenOf(parent))
+        {
+            layers.single->createImage(child);
+            ++tiles;
+        }
+    }
+
+    auto t1 = std::chrono::steady_clock::now();
+    for (auto& parent : parents)
+    {
+        layers.batched->createImages(childrenOf(parent), nullptr);
+    }
+
+    auto t2 = std::chrono::steady_clock::now();
+    using sec = std::chrono::duration<double>;
+    std::cout
+        << "Tiles: " << tiles
+        << ", single: " << tiles / sec(t1 - t0).count() << " tiles/s"
+        << ", batched: " << tiles / sec(t2 - t1).count() << " tiles/s" << std::endl;
+}
@@ -0,0 +1,156 @@
+/* osgEarth
+* Copyright 2025 Pelican Mapping
+* MIT License
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/Common>
+
+#ifdef OSGEARTH_HAVE_PROCEDURAL_NODEKIT
+
+#include <osgEarthProcedural/LifeMapLayer>
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/ImageLayer>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/Map>
+#include <osgEarth/Profile>
+#include <cmath>
+#include <functional>
+
+using namespace osgEarth;
+using namespace osgEarth::Procedural;
+
+namespace
+{
+    // Elevation layer with rolling hills
+    class HillsElevationLayer : public ElevationLayer
+    {
+    public:
+        META_LayerNoOptions(osgEarth, HillsElevationLayer, ElevationLayer, hills_elevation);
+
+    protected:
+        void init() override
+        {
+            super::init();
+            setProfile(Profile::create(Profile::GLOBAL_GEODETIC));
+            layerHints().cachePolicy() = CachePolicy::NO_CACHE;
+        }
+
+        GeoHeightField createHeightFieldImplementation(const TileKey& key, ProgressCallback*) const override
+        {
+            const GeoExtent& ex = key.getExtent();
+            osg::ref_ptr<osg::HeightField> hf = new osg::HeightField();
+            hf->allocate(257, 257);
+            for (unsigned r = 0; r < 257; ++r)
+            {
+                for (unsigned c = 0; c < 257; ++c)
+                {
+                    double x = ex.xMin() + ex.width() * (double)c / 256.0;
+                    double y = ex.yMin() + ex.height() * (double)r / 256.0;
+                    hf->setHeight(c, r, (float)(500.0 * std::sin(x * 40.0) * std::cos(y * 40.0)));
+                }
+            }
+            return GeoHeightField(hf.get(), ex);
+        }
+    };
+
+    // Image layer that evaluates a function of longitude and latitude, with
+    // no data past a given level so that tiles fall back on an ancestor
+    class FunctionImageLayer : public ImageLayer
+    {
+    public:
+        META_LayerNoOptions(osgEarth, FunctionImageLayer, ImageLayer, function_image);
+
+        std::function<osg::Vec4(double, double)> function;
+        unsigned maxLevel = ~0u;
+
+    protected:
+        void init() override
+        {
+            super::init();
+            setProfile(Profile::create(Profile::GLOBAL_GEODETIC));
+            layerHints().cachePolicy() = CachePolicy::NO_CACHE;
+        }
+
+        GeoImage createImageImplementation(const TileKey& key, ProgressCallback*) const override
+        {
+            if (key.getLOD() > maxLevel)
+                return GeoImage::INVALID;
+
+            const GeoExtent& ex = key.getExtent();
+            osg::ref_ptr<osg::Image> image = new osg::Image();
+            image->allocateImage(getTileSize(), getTileSize(), 1, GL_RGBA, GL_UNSIGNED_BYTE);
+            ImageUtils::PixelWriter write(image.get());
+            for (int t = 0; t < image->t(); ++t)
+            {
+                for (int s = 0; s < image->s(); ++s)
+                {
+                    double x = ex.xMin() + ex.width() * ((double)s + 0.5) / (double)image->s();
+                    double y = ex.yMin() + ex.height() * ((double)t + 0.5) / (double)image->t();
+                    write(function(x, y), s, t);
+                }
+            }
+            return GeoImage(image.get(), ex);
+        }
+    };
+}
+
+TEST_CASE("LifeMapLayer creates the same images in a batch as one at a time")
+{
+    osg::ref_ptr<Map> map = new Map();
+    map->addLayer(new HillsElevationLayer());
+
+    osg::ref_ptr<FunctionImageLayer> mask = new FunctionImageLayer();
+    mask->function = [](double x, double y) {
+        float v = (float)(0.5 + 0.5 * std::sin(x * 25.0 + y * 15.0));
+        return osg::Vec4(v, v, v, 1.0f);
+    };
+    map->addLayer(mask.get());
+
+    // the color layer stops well above the test tiles, so every tile reads
+    // the same ancestor
+    osg::ref_ptr<FunctionImageLayer> color = new FunctionImageLayer();
+    color->maxLevel = 8u;
+    color->function = [](double x, double y) {
+        return osg::Vec4(
+            (float)(0.5 + 0.5 * std::sin(x * 3.0)),
+            (float)(0.5 + 0.5 * std::cos(y * 3.0)),
+            0.25f, 1.0f);
+    };
+    map->addLayer(color.get());
+
+    // one layer for the batch and one for single tiles, so neither sees
+    // the other's cached inputs
+    osg::ref_ptr<LifeMapLayer> batched = new LifeMapLayer();
+    osg::ref_ptr<LifeMapLayer> single = new LifeMapLayer();
+    for (auto& lifemap : { batched, single })
+    {
+        lifemap->setMaskLayer(mask.get());
+        lifemap->setColorLayer(color.get());
+        lifemap->setCachePolicy(CachePolicy::NO_CACHE);
+        map->addLayer(lifemap.get());
+        REQUIRE(lifemap->isOpen());
+    }
+
+    // deep enough that both noise levels contribute
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::GLOBAL_GEODETIC);
+    TileKey parent(14, 13000, 5000, profile.get());
+
+    std::vector<TileKey> keys;
+    for (unsigned q = 0; q < 4; ++q)
+        keys.push_back(parent.createChildKey(q));
+
+    std::vector<GeoImage> images = batched->createImages(keys, nullptr);
+    REQUIRE(images.size() == keys.size());
+
+    for (unsigned i = 0; i < keys.size(); ++i)
+    {
+        GeoImage expected = single->createImage(keys[i]);
+        REQUIRE(expected.valid());
+        REQUIRE(images[i].valid());
+        REQUIRE(ImageUtils::areEquivalent(images[i].getImage(), expected.getImage()));
+    }
+}
+
+#endif // OSGEARTH_HAVE_PROCEDURAL_NODEKIT
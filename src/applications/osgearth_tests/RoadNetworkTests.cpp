@@ -0,0 +1,171 @@
+/* osgEarth
+* Copyright 2025 Pelican Mapping
+* MIT License
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/Common>
+
+#ifdef OSGEARTH_HAVE_PROCEDURAL_NODEKIT
+
+#include <osgEarthProcedural/RoadNetwork>
+#include <osgEarth/Feature>
+#include <osgEarth/Geometry>
+#include <osgEarth/SpatialReference>
+#include <algorithm>
+
+using namespace osgEarth;
+using namespace osgEarth::Procedural;
+
+namespace
+{
+    osg::ref_ptr<Feature> makeRoad(FeatureID fid, const std::vector<osg::Vec3d>& points)
+    {
+        auto* line = new LineString();
+        for (auto& p : points)
+            line->push_back(p);
+        osg::ref_ptr<Feature> feature = new Feature(line, SpatialReference::get("spherical-mercator"));
+        feature->setFID(fid);
+        return feature;
+    }
+
+    std::size_t countWays(const RoadNetwork::Junction& junction, const RoadNetwork::Way* way)
+    {
+        return std::count(junction.ways.begin(), junction.ways.end(), way);
+    }
+}
+
+TEST_CASE("RoadNetwork::addJunction snaps points within the tolerance")
+{
+    RoadNetwork network;
+    network.snapTolerance = 1.0;
+
+    auto& a = network.addJunction(osg::Vec3d(100.0, 100.0, 0.0));
+    REQUIRE(&network.addJunction(osg::Vec3d(100.5, 100.5, 0.0)) == &a);
+
+    // just outside the tolerance is a new junction
+    auto& b = network.addJunction(osg::Vec3d(101.5, 100.0, 0.0));
+    REQUIRE(&b != &a);
+
+    // neighbors across a grid cell boundary still snap
+    auto& c = network.addJunction(osg::Vec3d(199.99, 0.0, 0.0));
+    REQUIRE(&network.addJunction(osg::Vec3d(200.01, 0.0, 0.0)) == &c);
+    REQUIRE(&network.addJunction(osg::Vec3d(199.99, -0.6, 0.0)) == &c);
+
+    // with two candidates in range, the closer one wins
+    REQUIRE(&network.addJunction(osg::Vec3d(100.9, 100.0, 0.0)) == &b);
+    REQUIRE(&network.addJunction(osg::Vec3d(100.6, 100.0, 0.0)) == &a);
+
+    REQUIRE(network.junctions.size() == 3u);
+    for (unsigned i = 0; i < network.junctions.size(); ++i)
+        REQUIRE(network.junctions[i].index == i);
+}
+
+TEST_CASE("RoadNetwork::addFeature skips parts repeated by overlapping tiles")
+{
+    RoadNetwork network;
+    network.snapTolerance = 0.5;
+
+    // tile A and tile B both carry road 7 and their own roads;
+    // each tile makes its own copy of the feature
+    network.addFeature(makeRoad(7, { {0, 0, 0}, {50, 0, 0}, {100, 0, 0} }));
+    network.addFeature(makeRoad(8, { {0, 0, 0}, {0, 100, 0} }));
+
+    network.addFeature(makeRoad(7, { {0.1, 0.1, 0}, {50, 0, 0}, {99.9, 0, 0} }));
+    network.addFeature(makeRoad(9, { {100, 0, 0}, {100, 100, 0} }));
+
+    REQUIRE(network.ways.size() == 3u);
+    REQUIRE(network.junctions.size() == 4u);
+
+    network.compile();
+    auto& origin = network.addJunction(osg::Vec3d(0, 0, 0));
+    REQUIRE(origin.ways.size() == 2u);
+    auto& corner = network.addJunction(osg::Vec3d(100, 0, 0));
+    REQUIRE(corner.ways.size() == 2u);
+
+    SECTION("A different FID on the same endpoints is a separate way")
+    {
+        network.addFeature(makeRoad(10, { {0, 0, 0}, {100, 0, 0} }));
+        REQUIRE(network.ways.size() == 4u);
+    }
+
+    SECTION("Features without an FID are never merged")
+    {
+        network.addFeature(makeRoad(0, { {0, 0, 0}, {0, 100, 0} }));
+        network.addFeature(makeRoad(0, { {0, 0, 0}, {0, 100, 0} }));
+        REQUIRE(network.ways.size() == 5u);
+    }
+
+    SECTION("A later batch is linked into the compiled network")
+    {
+        network.addFeature(makeRoad(7, { {0, 0, 0}, {100, 0, 0} }));
+        network.addFeature(makeRoad(11, { {0, 100, 0}, {100, 100, 0} }));
+        REQUIRE(network.ways.size() == 4u);
+
+        network.compile();
+        REQUIRE(origin.ways.size() == 2u);
+        REQUIRE(network.addJunction(osg::Vec3d(0, 100, 0)).ways.size() == 2u);
+    }
+}
+
+TEST_CASE("RoadNetwork::moveJunction updates every way at the junction")
+{
+    RoadNetwork network;
+
+    // three roads meet at the origin; one of them is a loop that
+    // starts and ends there
+    network.addFeature(makeRoad(1, { {0, 0, 0}, {100, 0, 0} }));
+    network.addFeature(makeRoad(2, { {0, 100, 0}, {0, 0, 0} }));
+    network.addFeature(makeRoad(3, { {0, 0, 0}, {-50, 50, 0}, {-50, -50, 0}, {0, 0, 0} }));
+    network.compile();
+
+    auto& hub = network.addJunction(osg::Vec3d(0, 0, 0));
+    REQUIRE(hub.ways.size() == 4u);
+
+    auto& moved = network.moveJunction(hub, osg::Vec3d(5, 5, 0));
+    REQUIRE(&moved != &hub);
+    REQUIRE(moved.x() == 5.0);
+    REQUIRE(moved.ways.size() == 4u);
+    REQUIRE(hub.ways.empty());
+
+    for (auto& way : network.ways)
+    {
+        REQUIRE(way.start != &hub);
+        REQUIRE(way.end != &hub);
+    }
+    REQUIRE(network.ways[0].start == &moved);
+    REQUIRE(network.ways[1].end == &moved);
+    REQUIRE(network.ways[2].start == &moved);
+    REQUIRE(network.ways[2].end == &moved);
+    REQUIRE(countWays(moved, &network.ways[2]) == 2u);
+
+    // the other ends are untouched
+    REQUIRE(countWays(*network.ways[0].end, &network.ways[0]) == 1u);
+    REQUIRE(countWays(*network.ways[1].start, &network.ways[1]) == 1u);
+
+    SECTION("The move survives recompiling after more features arrive")
+    {
+        network.addFeature(makeRoad(4, { {100, 0, 0}, {200, 0, 0} }));
+        network.compile();
+
+        REQUIRE(moved.ways.size() == 4u);
+        REQUIRE(hub.ways.empty());
+        REQUIRE(network.ways[0].end->ways.size() == 2u);
+    }
+
+    SECTION("Relations follow the moved junction")
+    {
+        network.buildRelations();
+
+        std::size_t total = 0u;
+        for (auto& relation : network.relations)
+            total += relation.ways.size();
+        REQUIRE(total >= 2u);
+        for (auto& relation : network.relations)
+            for (auto* way : relation.ways)
+                REQUIRE((way->start != &hub && way->end != &hub));
+    }
+}
+
+#endif // OSGEARTH_HAVE_PROCEDURAL_NODEKIT
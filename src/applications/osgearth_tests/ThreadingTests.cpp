@@ -5,7 +5,9 @@
 
 #include <osgEarth/catch.hpp>
 #include <osgEarth/Threading>
+#include <atomic>
 #include <thread>
+#include <vector>
 
 using namespace osgEarth;
 
@@ -116,4 +118,50 @@ TEST_CASE( "ReadWriteMutex can handle multiple read locks from the same thread w
     REQUIRE(!thread2.isRunning());
     REQUIRE(elapsedTime < maxTimeSeconds);
 }
-#endif
\ No newline at end of file
+#endif
+TEST_CASE("jobs::parallel_for visits every index exactly once")
+{
+    const unsigned count = 100000u;
+    std::vector<std::atomic<unsigned>> visits(count);
+    for (auto& v : visits)
+        v = 0u;
+
+    // Catch assertions are not thread-safe, so count failures instead
+    std::atomic<unsigned> bad(0u), nested(0u);
+    jobs::parallel_for("oe.test.parallel_for", count, [&](unsigned begin, unsigned end)
+        {
+            if (begin >= end || end > count)
+                ++bad;
+
+            for (unsigned i = begin; i < end; ++i)
+                ++visits[i];
+
+            // a nested loop runs serially on this thread, in one range
+            std::thread::id me = std::this_thread::get_id();
+            jobs::parallel_for("oe.test.parallel_for", 1000u, [&](unsigned b, unsigned e)
+                {
+                    if (b == 0u && e == 1000u && std::this_thread::get_id() == me)
+                        ++nested;
+                });
+        },
+        64u);
+
+    REQUIRE(bad == 0u);
+    for (auto& v : visits)
+        REQUIRE(v == 1u);
+    REQUIRE(nested > 0u);
+    REQUIRE(jobs::in_parallel_for() == false);
+
+    // below the grain, the loop is one range on the calling thread
+    std::thread::id caller = std::this_thread::get_id();
+    unsigned calls = 0u;
+    jobs::parallel_for("oe.test.parallel_for", 10u, [&](unsigned begin, unsigned end)
+        {
+            REQUIRE(std::this_thread::get_id() == caller);
+            REQUIRE(begin == 0u);
+            REQUIRE(end == 10u);
+            ++calls;
+        },
+        16u);
+    REQUIRE(calls == 1u);
+}
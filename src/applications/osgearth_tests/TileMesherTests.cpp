@@ -0,0 +1,84 @@
+/* osgEarth
+* Copyright 2025 Pelican Mapping
+* MIT License
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/TileMesher>
+#include <osgEarth/TerrainOptions>
+#include <osgEarth/Profile>
+#include <osgEarth/Feature>
+#include <osgEarth/Geometry>
+
+using namespace osgEarth;
+
+namespace
+{
+    // A polygon covering the middle quarter of the tile, in tile unit space
+    MeshConstraints makeHole(const TileKey& key)
+    {
+        const GeoExtent& e = key.getExtent();
+        auto unit = [&](double u, double v) {
+            return osg::Vec3d(e.xMin() + u * e.width(), e.yMin() + v * e.height(), 0.0);
+        };
+
+        Polygon* hole = new Polygon();
+        hole->push_back(unit(0.25, 0.25));
+        hole->push_back(unit(0.75, 0.25));
+        hole->push_back(unit(0.75, 0.75));
+        hole->push_back(unit(0.25, 0.75));
+
+        MeshConstraint edit;
+        edit.features.push_back(new Feature(hole, key.getProfile()->getSRS()));
+        edit.removeInterior = true;
+        return { edit };
+    }
+
+    // Sum of triangle areas in tile unit space, and the largest area
+    // of any triangle whose centroid falls inside the hole.
+    void measure(const TileMesh& mesh, double& area, double& areaInHole)
+    {
+        area = 0.0, areaInHole = 0.0;
+        auto& uvs = *mesh.uvs;
+        for (unsigned i = 0; i + 2 < mesh.indices->getNumIndices(); i += 3)
+        {
+            const osg::Vec3f& a = uvs[mesh.indices->index(i)];
+            const osg::Vec3f& b = uvs[mesh.indices->index(i + 1)];
+            const osg::Vec3f& c = uvs[mesh.indices->index(i + 2)];
+            double t = 0.5 * std::abs((b.x() - a.x()) * (c.y() - a.y()) - (c.x() - a.x()) * (b.y() - a.y()));
+            area += t;
+
+            double cx = (a.x() + b.x() + c.x()) / 3.0, cy = (a.y() + b.y() + c.y()) / 3.0;
+            if (cx > 0.26 && cx < 0.74 && cy > 0.26 && cy < 0.74)
+                areaInHole += t;
+        }
+    }
+}
+
+TEST_CASE("TileMesher cuts a hole with both meshing methods")
+{
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::GLOBAL_GEODETIC);
+    TileKey key(12, 2211, 1000, profile.get());
+
+    for (auto method : { MeshingMethod::SPLIT, MeshingMethod::CDT })
+    {
+        TerrainOptions options;
+        options.meshingMethod() = method;
+
+        TileMesher mesher;
+        mesher.setTerrainOptions(TerrainOptionsAPI(&options));
+
+        TileMesh mesh = mesher.createMesh(key, makeHole(key), nullptr);
+        REQUIRE(mesh.verts.valid());
+        REQUIRE(mesh.indices.valid());
+        REQUIRE(mesh.hasConstraints);
+
+        double area, areaInHole;
+        measure(mesh, area, areaInHole);
+
+        // the tile minus the middle quarter
+        REQUIRE(area == Approx(0.75).margin(1e-3));
+        REQUIRE(areaInHole < 1e-6);
+    }
+}
@@ -20,6 +20,7 @@
 #include <osgEarth/PointDrawable>
 #include <osgEarth/Registry>
 #include <osgEarth/StyleSheet>
+#include <osgEarth/Threading>
 #include <osg/Geode>
 #include <osg/Geometry>
 #include <osg/TriangleIndexFunctor>
@@ -32,6 +33,11 @@
 
 #define LC "[BuildGeometryFilter] "
 
+#define ARENA_TESSELLATE "oe.tessellate"
+
+// fewest polygon parts worth handing to a tessellation thread
+#define MIN_POLYGONS_PER_THREAD 8u
+
 #define OE_TEST OE_NULL
 
 #define USE_GNOMONIC_TESSELLATION
@@ -272,7 +278,20 @@ BuildGeometryFilter::processPolygons(FeatureList& features, FilterContext& conte
         }
     }
 
-    // ready, time to iterate the features.
+    // One unit of polygon work: a single part of a feature.
+    struct PolygonJob
+    {
+        Feature* feature;
+        Geometry* part;
+        osg::ref_ptr<osg::Geometry> osgGeom;
+        osg::Vec4f color;
+        osg::Matrixd w2l, l2w;
+        Tessellator::Technique technique;
+    };
+    std::vector<PolygonJob> work;
+
+    // Pass 1: resolve symbology and set up each part. This touches the
+    // feature's attributes and scripts, so it stays on this thread.
     for( FeatureList::iterator f = features.begin(); f != features.end(); ++f )
     {
         Feature* input = f->get();
@@ -343,67 +362,91 @@ BuildGeometryFilter::processPolygons(FeatureList& features, FilterContext& conte
                 l2w = _local2world;
             }
 
-            // collect all the pre-transformation HAT (Z) values.
-            osg::ref_ptr<osg::FloatArray> hats = new osg::FloatArray();
-            hats->reserve( part->size() );
-            for(Geometry::const_iterator i = part->begin(); i != part->end(); ++i )
-                hats->push_back( i->z() );
+            PolygonJob job;
+            job.feature = input;
+            job.part = part;
+            job.osgGeom = osgGeom;
+            job.color = primaryColor;
+            job.w2l = w2l;
+            job.l2w = l2w;
+            job.technique = poly->tessellation().value();
+            work.push_back(std::move(job));
+        }
+    }
 
-            // build the geometry:
-            tileAndBuildPolygon(part, featureSRS, outputSRS, makeECEF, true, osgGeom.get(), skin_res, w2l);
+    // Pass 2: triangulate (and subdivide) the parts. Each part writes only
+    // to its own osg::Geometry, so the parts can be built in parallel.
+    auto build = [&](PolygonJob& job)
+    {
+        tileAndBuildPolygon(job.part, featureSRS, outputSRS, makeECEF, true, job.osgGeom.get(), skin_res.get(), job.w2l, job.technique);
 
-            osg::Vec3Array* allPoints = static_cast<osg::Vec3Array*>(osgGeom->getVertexArray());
-            if (allPoints && allPoints->size() > 0)
+        osg::Vec3Array* allPoints = static_cast<osg::Vec3Array*>(job.osgGeom->getVertexArray());
+        if (allPoints && allPoints->size() > 0)
+        {
+            // subdivide the mesh if necessary to conform to an ECEF globe:
+            if ( makeECEF )
             {
-                // subdivide the mesh if necessary to conform to an ECEF globe:
-                if ( makeECEF )
+                //convert back to world coords
+                for( osg::Vec3Array::iterator i = allPoints->begin(); i != allPoints->end(); ++i )
                 {
-                    //convert back to world coords
-                    for( osg::Vec3Array::iterator i = allPoints->begin(); i != allPoints->end(); ++i )
-                    {
-                        osg::Vec3d v(*i);
-                        v = v * l2w;
-                        v = v * _world2local;
-
-                        (*i)._v[0] = v[0];
-                        (*i)._v[1] = v[1];
-                        (*i)._v[2] = v[2];
-                    }
+                    osg::Vec3d v(*i);
+                    v = v * job.l2w;
+                    v = v * _world2local;
 
-                    double threshold = osg::DegreesToRadians( *_maxAngle_deg );
-                    //OE_TEST << "Running mesh subdivider with threshold " << *_maxAngle_deg << std::endl;
-                    MeshSubdivider ms( _world2local, _local2world );
-                    if ( input->geoInterp().isSet() )
-                        ms.run( *osgGeom, threshold, *input->geoInterp() );
-                    else
-                        ms.run( *osgGeom, threshold, *_geoInterp );
+                    (*i)._v[0] = v[0];
+                    (*i)._v[1] = v[1];
+                    (*i)._v[2] = v[2];
                 }
 
-                // assign the primary color array. PER_VERTEX required in order to support
-                // vertex optimization later
-                unsigned count = osgGeom->getVertexArray()->getNumElements();
-                osg::Vec4Array* colors = new osg::Vec4Array(osg::Array::BIND_PER_VERTEX);
-                colors->assign( count, primaryColor );
-                osgGeom->setColorArray( colors );
+                double threshold = osg::DegreesToRadians( *_maxAngle_deg );
+                //OE_TEST << "Running mesh subdivider with threshold " << *_maxAngle_deg << std::endl;
+                MeshSubdivider ms( _world2local, _local2world );
+                if ( job.feature->geoInterp().isSet() )
+                    ms.run( *job.osgGeom, threshold, *job.feature->geoInterp() );
+                else
+                    ms.run( *job.osgGeom, threshold, *_geoInterp );
+            }
+        }
+    };
+
+    jobs::parallel_for(ARENA_TESSELLATE, (unsigned)work.size(), [&](unsigned begin, unsigned end)
+        {
+            for (unsigned i = begin; i < end; ++i)
+                build(work[i]);
+        },
+        MIN_POLYGONS_PER_THREAD);
 
-                geode->addDrawable( osgGeom );
+    // Pass 3: assemble the results in feature order.
+    for (auto& job : work)
+    {
+        osg::Geometry* osgGeom = job.osgGeom.get();
+        osg::Vec3Array* allPoints = static_cast<osg::Vec3Array*>(osgGeom->getVertexArray());
+        if (allPoints && allPoints->size() > 0)
+        {
+            // assign the primary color array. PER_VERTEX required in order to support
+            // vertex optimization later
+            unsigned count = osgGeom->getVertexArray()->getNumElements();
+            osg::Vec4Array* colors = new osg::Vec4Array(osg::Array::BIND_PER_VERTEX);
+            colors->assign( count, job.color );
+            osgGeom->setColorArray( colors );
 
-                // record the geometry's primitive set(s) in the index:
-                if ( context.featureIndex() )
-                    context.featureIndex()->tagDrawable( osgGeom.get(), input );
+            geode->addDrawable( osgGeom );
 
-                // install clamping attributes if necessary
-                if (_style.has<AltitudeSymbol>() &&
-                    _style.get<AltitudeSymbol>()->technique() == AltitudeSymbol::TECHNIQUE_GPU)
-                {
-                    Clamping::applyDefaultClampingAttrs( osgGeom.get(), input->getDouble("__oe_verticalOffset", 0.0) );
-                }
-            }
-            else
+            // record the geometry's primitive set(s) in the index:
+            if ( context.featureIndex() )
+                context.featureIndex()->tagDrawable( osgGeom, job.feature );
+
+            // install clamping attributes if necessary
+            if (_style.has<AltitudeSymbol>() &&
+                _style.get<AltitudeSymbol>()->technique() == AltitudeSymbol::TECHNIQUE_GPU)
             {
-                OE_TEST << LC << "Oh no. tileAndBuildPolygon returned nothing.\n";
+                Clamping::applyDefaultClampingAttrs( osgGeom, job.feature->getDouble("__oe_verticalOffset", 0.0) );
             }
         }
+        else
+        {
+            OE_TEST << LC << "Oh no. tileAndBuildPolygon returned nothing.\n";
+        }
     }
 
     OE_TEST << LC << "Num drawables = " << geode->getNumDrawables() << "\n";
@@ -1204,7 +1247,8 @@ BuildGeometryFilter::tileAndBuildPolygon(
     bool                    tessellate,
     osg::Geometry*          osgGeom,
     const SkinResource*     skin_res,
-    const osg::Matrixd&     world2local)
+    const osg::Matrixd&     world2local,
+    Tessellator::Technique  technique)
 {
     OE_SOFT_ASSERT_AND_RETURN(input != nullptr, void());
     OE_SOFT_ASSERT_AND_RETURN(input->getType() != Geometry::TYPE_MULTI, void());
@@ -1541,7 +1585,7 @@ BuildGeometryFilter::tileAndBuildPolygon(
         }
 
         // tessellate
-        Tessellator tess;
+        Tessellator tess(technique);
 
         std::vector<uint32_t> indices;
         if (tess.tessellate2D(proj.get(), indices, plane) == false)
@@ -56,6 +56,12 @@ bool CacheTileHandler::hasData( const TileKey& key ) const
     return _layer->mayHaveData(key);
 }
 
+std::vector<bool> CacheTileHandler::isComplete( const std::vector<TileKey>& keys ) const
+{
+    // A tile that's already in the cache doesn't need seeding again
+    return _layer->isCached(keys);
+}
+
 std::string CacheTileHandler::getProcessString() const
 {
     std::stringstream buf;
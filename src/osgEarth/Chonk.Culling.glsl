@@ -108,7 +108,7 @@ void cull()
     const uint lod = gl_GlobalInvocationID.y; // lod
 
     // skip instances that exist only to pad the instance array to the workgroup size:
-    if (input_instances[i].first_lod_cmd_index < 0)
+    if (int(input_instances[i].first_lod_cmd_index) < 0)
         return;
 
     // initialize by clearing the visibility for this LOD:
@@ -12,7 +12,9 @@
 #include "DrawInstanced"
 #include "Registry"
 #include "PBRMaterial"
+#include "Math"
 
+#include <osg/Polytope>
 #include <osg/Switch>
 #include <osg/LOD>
 #include <osgUtil/Optimizer>
@@ -29,6 +31,8 @@ using namespace osgEarth;
 // note: this MUST match the local_size product in Chonk.Culling.glsl
 #define GPU_CULLING_LOCAL_WG_SIZE 32
 
+static_assert(ChonkPreCuller::PAGE_SIZE == GPU_CULLING_LOCAL_WG_SIZE, "Pre-cull pages must fill whole workgroups");
+
 // Uncomment this to reset all buffer base index bindings after rendering.
 // It's unlikely this is necessary, but it's here just we find otherwise.
 //#define RESET_BUFFER_BASE_BINDINGS
@@ -725,6 +729,220 @@ ChonkFactory::load(osg::Node* node, ChonkDrawable* drawable, float far_pixel_sca
 }
 
 
+void
+ChonkPreCuller::reset(const std::vector<osg::BoundingSphere>& bounds, unsigned instancesPerCell)
+{
+    _cells.clear();
+    _layout.clear();
+    _slots.clear();
+    _pageSlot.clear();
+    _changed.clear();
+    _visible.clear();
+    _box.init();
+    _stats = Stats();
+    _stats.instances = bounds.size();
+
+    if (bounds.empty())
+        return;
+
+    // Grid the two longest axes of the set of instance centers.
+    osg::BoundingBox centers;
+    for (auto& bs : bounds)
+        centers.expandBy(bs.center());
+
+    osg::Vec3 size = centers._max - centers._min;
+    int flat =
+        size.x() <= size.y() && size.x() <= size.z() ? 0 :
+        size.y() <= size.z() ? 1 : 2;
+    int a = (flat + 1) % 3, b = (flat + 2) % 3;
+
+    double numCells = std::max(1.0, (double)bounds.size() / (double)std::max(instancesPerCell, 1u));
+    double sa = std::max(size[a], 1e-3f), sb = std::max(size[b], 1e-3f);
+    unsigned na = clamp((unsigned)std::round(std::sqrt(numCells * sa / sb)), 1u, 64u);
+    unsigned nb = clamp((unsigned)std::round(numCells / (double)na), 1u, 64u);
+
+    // bucket the instances by grid cell (counting sort):
+    std::vector<unsigned> cellOf(bounds.size());
+    std::vector<unsigned> counts(na * nb, 0u);
+    for (unsigned i = 0; i < bounds.size(); ++i)
+    {
+        auto& c = bounds[i].center();
+        unsigned ia = std::min(na - 1, (unsigned)(na * (c[a] - centers._min[a]) / sa));
+        unsigned ib = std::min(nb - 1, (unsigned)(nb * (c[b] - centers._min[b]) / sb));
+        cellOf[i] = ib * na + ia;
+        ++counts[cellOf[i]];
+    }
+
+    // make a cell, and a run of pages, for each non-empty grid cell:
+    std::vector<unsigned> next(na * nb, 0u);
+    unsigned numPages = 0;
+    for (unsigned g = 0; g < counts.size(); ++g)
+    {
+        if (counts[g] > 0)
+        {
+            Cell cell;
+            cell.firstPage = numPages;
+            cell.numPages = (counts[g] + PAGE_SIZE - 1) / PAGE_SIZE;
+            cell.count = counts[g];
+            next[g] = numPages * PAGE_SIZE;
+            numPages += cell.numPages;
+            counts[g] = _cells.size();
+            _cells.emplace_back(std::move(cell));
+        }
+    }
+
+    _layout.assign(numPages * PAGE_SIZE, EMPTY);
+    for (unsigned i = 0; i < bounds.size(); ++i)
+    {
+        unsigned g = cellOf[i];
+        _layout[next[g]++] = i;
+        _cells[counts[g]].box.expandBy(bounds[i]);
+    }
+
+    for (auto& cell : _cells)
+    {
+        cell.bound.expandBy(cell.box);
+        _box.expandBy(cell.box);
+    }
+
+    _pageSlot.assign(numPages, EMPTY);
+    _visible.assign(_cells.size(), false);
+    _stats.cells = _cells.size();
+}
+
+void
+ChonkPreCuller::cull(
+    const osg::Matrix& modelView,
+    const osg::Matrix& projection,
+    const Horizon* horizon,
+    const osg::Matrix& localToWorld)
+{
+    _changed.clear();
+    _dirty.clear();
+    _stats.submitted = 0u;
+    _stats.visibleCells = 0u;
+    _stats.changedSlots = 0u;
+
+    if (_cells.empty())
+        return;
+
+    // Side planes only, like the GPU culler.
+    osg::Polytope frustum;
+    frustum.setToUnitFrustum(false, false);
+    frustum.transformProvidingInverse(modelView * projection);
+
+    // Test the whole set first, then the cells as needed.
+    bool none = !frustum.contains(_box);
+    bool all = !none && frustum.containsAllOf(_box);
+
+    if (!none && horizon)
+    {
+        osg::BoundingSphere bs(_box);
+        none = !horizon->isVisible(bs.center() * localToWorld, bs.radius());
+    }
+
+    for (unsigned c = 0; c < _cells.size(); ++c)
+    {
+        const Cell& cell = _cells[c];
+
+        bool visible =
+            !none &&
+            (all || frustum.contains(cell.box)) &&
+            (horizon == nullptr || horizon->isVisible(cell.bound.center() * localToWorld, cell.bound.radius()));
+
+        _visible[c] = visible;
+
+        if (visible)
+        {
+            ++_stats.visibleCells;
+            _stats.submitted += cell.count;
+        }
+        else
+        {
+            // free the slots of pages that left the view:
+            for (unsigned p = cell.firstPage; p < cell.firstPage + cell.numPages; ++p)
+            {
+                if (_pageSlot[p] != EMPTY)
+                {
+                    _slots[_pageSlot[p]] = EMPTY;
+                    _dirty.push_back(_pageSlot[p]);
+                    _pageSlot[p] = EMPTY;
+                }
+            }
+        }
+    }
+
+    // place pages that came into view, filling holes first:
+    unsigned hole = 0u;
+    for (unsigned c = 0; c < _cells.size(); ++c)
+    {
+        if (!_visible[c])
+            continue;
+
+        const Cell& cell = _cells[c];
+        for (unsigned p = cell.firstPage; p < cell.firstPage + cell.numPages; ++p)
+        {
+            if (_pageSlot[p] == EMPTY)
+            {
+                while (hole < _slots.size() && _slots[hole] != EMPTY)
+                    ++hole;
+
+                if (hole == _slots.size())
+                    _slots.push_back(EMPTY);
+
+                _slots[hole] = p;
+                _pageSlot[p] = hole;
+                _dirty.push_back(hole);
+            }
+        }
+    }
+
+    while (!_slots.empty() && _slots.back() == EMPTY)
+        _slots.pop_back();
+
+    // If too many holes remain, repack the visible pages.
+    unsigned holes = std::count(_slots.begin(), _slots.end(), EMPTY);
+    if (holes * 4u > _slots.size())
+    {
+        unsigned s = 0u;
+        for (unsigned c = 0; c < _cells.size(); ++c)
+        {
+            if (_visible[c])
+            {
+                const Cell& cell = _cells[c];
+                for (unsigned p = cell.firstPage; p < cell.firstPage + cell.numPages; ++p, ++s)
+                {
+                    if (_slots[s] != (int)p)
+                    {
+                        _slots[s] = p;
+                        _dirty.push_back(s);
+                    }
+                    _pageSlot[p] = s;
+                }
+            }
+        }
+        _slots.resize(s);
+    }
+
+    // merge the changed slots into ranges:
+    std::sort(_dirty.begin(), _dirty.end());
+    _dirty.erase(std::unique(_dirty.begin(), _dirty.end()), _dirty.end());
+
+    for (auto s : _dirty)
+    {
+        if (s >= _slots.size())
+            break;
+
+        if (!_changed.empty() && _changed.back().second == s)
+            _changed.back().second = s + 1;
+        else
+            _changed.emplace_back(s, s + 1);
+
+        ++_stats.changedSlots;
+    }
+}
+
+
 bool
 ChonkDrawable::add(osg::Node* node, ChonkFactory& factory, float far_pixel_scale, float near_pixel_scale)
 {
@@ -861,6 +1079,32 @@ ChonkDrawable::setUseGPUCulling(bool value)
     _gpucull = value;
 }
 
+void
+ChonkDrawable::setUseCPUCulling(bool value)
+{
+    if (_cpucull != value)
+    {
+        _cpucull = value;
+        dirtyGLObjects();
+    }
+}
+
+void
+ChonkDrawable::setEllipsoid(const Ellipsoid& value)
+{
+    _ellipsoid = value;
+    dirtyGLObjects();
+}
+
+ChonkPreCuller::Stats
+ChonkDrawable::getPreCullStats(unsigned contextID) const
+{
+    if (contextID < _globjects.size())
+        return _globjects[contextID]._preCuller.getStats();
+    else
+        return ChonkPreCuller::Stats();
+}
+
 void
 ChonkDrawable::dirtyGLObjects()
 {
@@ -951,6 +1195,8 @@ ChonkDrawable::update_gl_objects(GLObjects& globjects, osg::State& state) const
     {
         std::lock_guard<std::mutex> lock(_m);
         globjects._gpucull = _gpucull;
+        globjects._cpucull = _cpucull && _gpucull;
+        globjects._horizon = _ellipsoid.isSet() ? new Horizon(_ellipsoid.get()) : nullptr;
         globjects.update(_batches, this, _fadeNear, _fadeFar, _birthday, _alphaCutoff, state);
     }
 }
@@ -1191,6 +1437,9 @@ ChonkDrawable::GLObjects::update(
     // build a LUT of all instances by (gl_InstanceID + gl_BaseInstance).
     _all_instances.clear();
 
+    // bounds of each instance, for CPU pre-culling.
+    std::vector<osg::BoundingSphere> bounds;
+
     std::size_t max_lod_count = 0;
 
     for (auto& batch : batches)
@@ -1234,15 +1483,30 @@ ChonkDrawable::GLObjects::update(
         {
             _all_instances.push_back(instance);
             _all_instances.back().first_lod_cmd_index = first_lod_cmd_index;
+
+            if (_cpucull)
+            {
+                auto& box = chonk->getBound();
+                auto& m = instance.xform;
+                float scale = std::max(
+                    osg::Vec3f(m(0, 0), m(0, 1), m(0, 2)).length(), std::max(
+                    osg::Vec3f(m(1, 0), m(1, 1), m(1, 2)).length(),
+                    osg::Vec3f(m(2, 0), m(2, 1), m(2, 2)).length()));
+                bounds.emplace_back(box.center() * m, box.radius() * scale);
+            }
         }
 
         // pad out the size of the instances array so it's a multiple of the
         // GPU culling workgroup size. Add "padding" instances will have the
         // first_lod_cmd_index member equal to -1, indicating an invalid instance.
         // The CS will check for this and discard them.
-        unsigned workgroups = (_all_instances.size() + GPU_CULLING_LOCAL_WG_SIZE - 1) / GPU_CULLING_LOCAL_WG_SIZE;
-        unsigned paddedSize = workgroups * GPU_CULLING_LOCAL_WG_SIZE;
-        _all_instances.resize(paddedSize);
+        // (The pre-culler pads its own pages.)
+        if (!_cpucull)
+        {
+            unsigned workgroups = (_all_instances.size() + GPU_CULLING_LOCAL_WG_SIZE - 1) / GPU_CULLING_LOCAL_WG_SIZE;
+            unsigned paddedSize = workgroups * GPU_CULLING_LOCAL_WG_SIZE;
+            _all_instances.resize(paddedSize);
+        }
 
         max_lod_count = std::max(max_lod_count, lod_commands.size());
     }
@@ -1253,6 +1517,22 @@ ChonkDrawable::GLObjects::update(
         lod.total_num_commands = _commands.size();
     }
 
+    // with pre-culling, arrange the instances into the culler's pages;
+    // the pages are uploaded as they come into view.
+    if (_cpucull)
+    {
+        _preCuller.reset(bounds);
+
+        auto& layout = _preCuller.getLayout();
+        std::vector<Instance> paged(layout.size());
+        for (unsigned i = 0; i < layout.size(); ++i)
+        {
+            if (layout[i] != ChonkPreCuller::EMPTY)
+                paged[i] = _all_instances[layout[i]];
+        }
+        _all_instances.swap(paged);
+    }
+
     // Send to the GPU:
     if (!_instanceInputBuf)
     {
@@ -1263,7 +1543,10 @@ ChonkDrawable::GLObjects::update(
         _instanceInputBuf->debugLabel("Chonk drawable", "input " + host->getName());
         _instanceInputBuf->unbind();
     }
-    _instanceInputBuf->uploadData(_all_instances, GL_STATIC_DRAW);
+    if (_cpucull)
+        _instanceInputBuf->uploadData(_all_instances.size() * sizeof(Instance), nullptr);
+    else
+        _instanceInputBuf->uploadData(_all_instances, GL_STATIC_DRAW);
 
     // need to do this since it gets sent in cull() when gpu culling is on.
     if (!_commandBuf)
@@ -1306,7 +1589,8 @@ ChonkDrawable::GLObjects::update(
         _commandBuf->uploadData(_commands);
     }
 
-    _numInstances = _all_instances.size();
+    // with pre-culling, precull() sets the instance count each frame.
+    _numInstances = _cpucull ? 0u : _all_instances.size();
     _maxNumLODs = max_lod_count;
 
     _dirty = false;
@@ -1341,6 +1625,15 @@ ChonkDrawable::GLObjects::cull(osg::State& state)
     }
     _commandBuf->uploadData(_commands);
 
+    // with pre-culling, submit only the instances in visible cells:
+    if (_cpucull)
+    {
+        precull(state);
+
+        if (_numInstances == 0)
+            return;
+    }
+
     _instanceOutputBuf->bindBufferBase(0);
     _commandBuf->bindBufferBase(29);
     _chonkBuf->bindBufferBase(30);
@@ -1371,6 +1664,62 @@ ChonkDrawable::GLObjects::cull(osg::State& state)
     ext->glDispatchCompute(workgroups, _maxNumLODs, 1);
 }
 
+void
+ChonkDrawable::GLObjects::precull(osg::State& state)
+{
+    OE_GL_ZONE_NAMED("precull");
+
+    const osg::Matrix& modelView = state.getModelViewMatrix();
+    const osg::Matrix& projection = state.getProjectionMatrix();
+
+    // the horizon is meaningless for an orthographic camera (e.g. shadows)
+    const Horizon* horizon = nullptr;
+    osg::Matrix localToWorld;
+    if (_horizon.valid() && !ProjectionMatrix::isOrtho(projection))
+    {
+        const osg::Matrix& viewToWorld = state.getInitialInverseViewMatrix();
+        localToWorld = modelView * viewToWorld;
+        _horizon->setEye(viewToWorld.getTrans());
+        horizon = _horizon.get();
+    }
+
+    _preCuller.cull(modelView, projection, horizon, localToWorld);
+
+    // upload only the slots whose pages changed:
+    const unsigned PAGE_SIZE = ChonkPreCuller::PAGE_SIZE;
+    auto& slots = _preCuller.getSlots();
+    auto& changed = _preCuller.getChangedSlots();
+
+    if (!changed.empty())
+    {
+        _instanceInputBuf->bind();
+
+        std::vector<Instance> pages;
+        for (auto& range : changed)
+        {
+            pages.resize((range.second - range.first) * PAGE_SIZE);
+
+            for (unsigned s = range.first; s < range.second; ++s)
+            {
+                auto out = pages.begin() + (s - range.first) * PAGE_SIZE;
+                if (slots[s] == ChonkPreCuller::EMPTY)
+                    std::fill(out, out + PAGE_SIZE, Instance());
+                else
+                    std::copy_n(_all_instances.begin() + slots[s] * PAGE_SIZE, PAGE_SIZE, out);
+            }
+
+            _instanceInputBuf->bufferSubData(
+                range.first * PAGE_SIZE * sizeof(Instance),
+                pages.size() * sizeof(Instance),
+                pages.data());
+        }
+
+        _instanceInputBuf->unbind();
+    }
+
+    _numInstances = slots.size() * PAGE_SIZE;
+}
+
 void
 ChonkDrawable::GLObjects::draw(osg::State& state)
 {
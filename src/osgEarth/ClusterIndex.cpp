@@ -0,0 +1,543 @@
+/* osgEarth
+ * Copyright 2025 Pelican Mapping
+ * MIT License
+ */
+#include <osgEarth/ClusterIndex>
+#include <osg/Math>
+#include <algorithm>
+#include <cmath>
+
+using namespace osgEarth;
+using namespace osgEarth::Contrib;
+
+namespace
+{
+    // equatorial circumference of the spherical mercator world, in meters
+    constexpr double MERCATOR_CIRCUMFERENCE = 40075016.68557849;
+
+    inline double lonToX(double lon)
+    {
+        return lon / 360.0 + 0.5;
+    }
+
+    inline double latToY(double lat)
+    {
+        double s = sin(osg::DegreesToRadians(lat));
+        double y = 0.5 - 0.25 * log((1.0 + s) / (1.0 - s)) / osg::PI;
+        return y < 0.0 ? 0.0 : y > 1.0 ? 1.0 : y;
+    }
+
+    inline double xToLon(double x)
+    {
+        return (x - 0.5) * 360.0;
+    }
+
+    inline double yToLat(double y)
+    {
+        double y2 = (180.0 - y * 360.0) * osg::PI / 180.0;
+        return 360.0 * atan(exp(y2)) / osg::PI - 90.0;
+    }
+}
+
+// One zoom level: its nodes and a static k-d index over them, in the
+// style of kdbush. Nodes added after the index was sorted are kept in
+// an unsorted tail and scanned directly until the next reindex.
+struct ClusterIndex::Level
+{
+    std::vector<Node> nodes;
+    std::vector<unsigned> ids;  // k-d sorted node indices
+    std::vector<double> coords; // x,y of each entry in ids, in the same order
+    unsigned indexed = 0u;      // nodes [0, indexed) are in the k-d index
+
+    static constexpr unsigned LEAF_SIZE = 16u;
+
+    void reindex()
+    {
+        ids.clear();
+        for (unsigned i = 0; i < nodes.size(); ++i)
+        {
+            if (nodes[i].count > 0)
+                ids.push_back(i);
+        }
+        indexed = (unsigned)nodes.size();
+
+        coords.resize(ids.size() * 2);
+        for (std::size_t k = 0; k < ids.size(); ++k)
+        {
+            coords[2 * k] = nodes[ids[k]].x;
+            coords[2 * k + 1] = nodes[ids[k]].y;
+        }
+
+        if (!ids.empty())
+            sort(0, ids.size() - 1, 0);
+    }
+
+    //! reindex once the unsorted tail grows too long to scan cheaply
+    void maybeReindex()
+    {
+        unsigned tail = (unsigned)nodes.size() - indexed;
+        if (tail > std::max(LEAF_SIZE, indexed / 8u))
+            reindex();
+    }
+
+    void swapItems(std::size_t a, std::size_t b)
+    {
+        std::swap(ids[a], ids[b]);
+        std::swap(coords[2 * a], coords[2 * b]);
+        std::swap(coords[2 * a + 1], coords[2 * b + 1]);
+    }
+
+    // Floyd-Rivest selection, as in kdbush
+    void select(std::size_t k, std::size_t left, std::size_t right, int axis)
+    {
+        while (right > left)
+        {
+            if (right - left > 600)
+            {
+                double n = (double)(right - left + 1);
+                double m = (double)(k - left + 1);
+                double z = log(n);
+                double s = 0.5 * exp(2.0 * z / 3.0);
+                double sd = 0.5 * sqrt(z * s * (n - s) / n) * (m - n / 2.0 < 0.0 ? -1.0 : 1.0);
+                std::size_t newLeft = (std::size_t)std::max((double)left, floor((double)k - m * s / n + sd));
+                std::size_t newRight = (std::size_t)std::min((double)right, floor((double)k + (n - m) * s / n + sd));
+                select(k, newLeft, newRight, axis);
+            }
+
+            double t = coords[2 * k + axis];
+            std::size_t i = left;
+            std::size_t j = right;
+
+            swapItems(left, k);
+            if (coords[2 * right + axis] > t)
+                swapItems(left, right);
+
+            while (i < j)
+            {
+                swapItems(i, j);
+                ++i;
+                --j;
+                while (coords[2 * i + axis] < t) ++i;
+                while (coords[2 * j + axis] > t) --j;
+            }
+
+            if (coords[2 * left + axis] == t)
+            {
+                swapItems(left, j);
+            }
+            else
+            {
+                ++j;
+                swapItems(j, right);
+            }
+
+            if (j <= k) left = j + 1;
+            if (k <= j) right = j - 1;
+            if (j == 0) break;
+        }
+    }
+
+    void sort(std::size_t left, std::size_t right, int axis)
+    {
+        if (right - left <= LEAF_SIZE)
+            return;
+
+        std::size_t m = (left + right) >> 1;
+        select(m, left, right, axis);
+
+        sort(left, m - 1, 1 - axis);
+        sort(m + 1, right, 1 - axis);
+    }
+
+    //! calls func(index) for each live node within the box
+    template<typename FUNC>
+    void range(double minX, double minY, double maxX, double maxY, FUNC&& func) const
+    {
+        if (!ids.empty())
+            range(minX, minY, maxX, maxY, func, 0, ids.size() - 1, 0);
+
+        for (unsigned i = indexed; i < nodes.size(); ++i)
+        {
+            const Node& n = nodes[i];
+            if (n.count > 0 && n.x >= minX && n.x <= maxX && n.y >= minY && n.y <= maxY)
+                func(i);
+        }
+    }
+
+    template<typename FUNC>
+    void range(double minX, double minY, double maxX, double maxY, FUNC& func,
+        std::size_t left, std::size_t right, int axis) const
+    {
+        if (right - left <= LEAF_SIZE)
+        {
+            for (std::size_t k = left; k <= right; ++k)
+            {
+                double x = coords[2 * k], y = coords[2 * k + 1];
+                if (x >= minX && x <= maxX && y >= minY && y <= maxY && nodes[ids[k]].count > 0)
+                    func(ids[k]);
+            }
+            return;
+        }
+
+        std::size_t m = (left + right) >> 1;
+        double x = coords[2 * m], y = coords[2 * m + 1];
+        if (x >= minX && x <= maxX && y >= minY && y <= maxY && nodes[ids[m]].count > 0)
+            func(ids[m]);
+
+        double c = axis == 0 ? x : y;
+        if ((axis == 0 ? minX : minY) <= c)
+            range(minX, minY, maxX, maxY, func, left, m - 1, 1 - axis);
+        if ((axis == 0 ? maxX : maxY) >= c)
+            range(minX, minY, maxX, maxY, func, m + 1, right, 1 - axis);
+    }
+};
+
+ClusterIndex::ClusterIndex() :
+    _radius(50.0),
+    _tileSize(256u),
+    _minZoom(0u),
+    _maxZoom(16u),
+    _size(0u),
+    _built(false)
+{
+    //nop
+}
+
+ClusterIndex::~ClusterIndex()
+{
+    //nop
+}
+
+void
+ClusterIndex::setRadius(double value)
+{
+    if (value != _radius)
+    {
+        _radius = value;
+        _built = false;
+    }
+}
+
+void
+ClusterIndex::setTileSize(unsigned value)
+{
+    if (value != _tileSize && value > 0u)
+    {
+        _tileSize = value;
+        _built = false;
+    }
+}
+
+void
+ClusterIndex::setZoomRange(unsigned minZoom, unsigned maxZoom)
+{
+    if (maxZoom < minZoom)
+        std::swap(minZoom, maxZoom);
+
+    if (minZoom != _minZoom || maxZoom != _maxZoom)
+    {
+        _minZoom = minZoom;
+        _maxZoom = maxZoom;
+        _built = false;
+    }
+}
+
+void
+ClusterIndex::setCanMergeFunction(const CanMergeFunction& value)
+{
+    _canMerge = value;
+    _built = false;
+}
+
+double
+ClusterIndex::radiusAt(unsigned zoom) const
+{
+    return _radius / ((double)_tileSize * std::pow(2.0, (double)zoom));
+}
+
+double
+ClusterIndex::getZoom(double metersPerPixel, double latitude) const
+{
+    if (metersPerPixel <= 0.0)
+        return (double)(_maxZoom + 1);
+
+    double worldPixels = MERCATOR_CIRCUMFERENCE * cos(osg::DegreesToRadians(latitude)) / metersPerPixel;
+    return std::log2(worldPixels / (double)_tileSize);
+}
+
+unsigned
+ClusterIndex::add(double longitude, double latitude)
+{
+    unsigned id = (unsigned)_points.size();
+    _points.emplace_back(lonToX(longitude), latToY(latitude));
+    _removed.push_back(false);
+    ++_size;
+
+    if (!_built)
+        return id;
+
+    // Add the point to the existing hierarchy. At each zoom it joins the
+    // nearest cluster in range; if there is none, it becomes a cluster of
+    // its own and the search continues at the next lower zoom.
+    unsigned level = _maxZoom + 1;
+    Level& points = *_levels[level];
+    points.nodes.push_back(Node{ _points[id].x(), _points[id].y(), 1u, id, -1, -1, -1 });
+    points.maybeReindex();
+
+    unsigned child = id;
+
+    for (int z = (int)_maxZoom; z >= (int)_minZoom; --z)
+    {
+        Level& current = *_levels[z];
+        Node& node = _levels[z + 1]->nodes[child];
+
+        double r = radiusAt(z);
+
+        int best = -1;
+        double bestDist2 = r * r;
+
+        current.range(node.x - r, node.y - r, node.x + r, node.y + r, [&](unsigned i)
+            {
+                const Node& c = current.nodes[i];
+                double dx = c.x - node.x, dy = c.y - node.y;
+                double d2 = dx * dx + dy * dy;
+                if (d2 <= bestDist2 && (!_canMerge || _canMerge(c.point, id)))
+                {
+                    best = (int)i;
+                    bestDist2 = d2;
+                }
+            });
+
+        if (best >= 0)
+        {
+            // join the cluster and count the point in all of its ancestors
+            node.parent = best;
+            node.nextSibling = current.nodes[best].firstChild;
+            current.nodes[best].firstChild = (int)child;
+
+            for (int i = best, lz = z; i >= 0; i = _levels[lz]->nodes[i].parent, --lz)
+            {
+                ++_levels[lz]->nodes[i].count;
+            }
+            return id;
+        }
+
+        unsigned index = (unsigned)current.nodes.size();
+        current.nodes.push_back(Node{ node.x, node.y, 1u, id, -1, (int)child, -1 });
+        current.maybeReindex();
+        node.parent = (int)index;
+        child = index;
+    }
+
+    return id;
+}
+
+void
+ClusterIndex::remove(unsigned id)
+{
+    if (id >= _points.size() || _removed[id])
+        return;
+
+    _removed[id] = true;
+    --_size;
+
+    if (!_built)
+        return;
+
+    // Take the point out of every cluster above it. Clusters keep their
+    // positions; those left empty are skipped by all searches.
+    unsigned level = _maxZoom + 1;
+    int i = (int)id;
+
+    while (i >= 0)
+    {
+        Level& current = *_levels[level];
+        Node& node = current.nodes[i];
+
+        if (--node.count > 0 && node.point == id)
+        {
+            // choose a new representative point from a live child
+            const auto& children = _levels[level + 1]->nodes;
+            for (int c = node.firstChild; c >= 0; c = children[c].nextSibling)
+            {
+                if (children[c].count > 0)
+                {
+                    node.point = children[c].point;
+                    break;
+                }
+            }
+        }
+
+        i = node.parent;
+        if (level == 0)
+            break;
+        --level;
+    }
+}
+
+void
+ClusterIndex::clear()
+{
+    _points.clear();
+    _removed.clear();
+    _levels.clear();
+    _size = 0u;
+    _built = false;
+}
+
+void
+ClusterIndex::build()
+{
+    _levels.clear();
+    for (unsigned z = 0; z <= _maxZoom + 1; ++z)
+    {
+        _levels.emplace_back(new Level());
+    }
+
+    // the highest level holds the points themselves
+    Level& points = *_levels[_maxZoom + 1];
+    points.nodes.reserve(_points.size());
+
+    for (unsigned i = 0; i < _points.size(); ++i)
+    {
+        points.nodes.push_back(Node{ _points[i].x(), _points[i].y(), _removed[i] ? 0u : 1u, i, -1, -1, -1 });
+    }
+    points.reindex();
+
+    for (int z = (int)_maxZoom; z >= (int)_minZoom; --z)
+    {
+        clusterLevel((unsigned)z);
+    }
+
+    _built = true;
+}
+
+void
+ClusterIndex::clusterLevel(unsigned zoom)
+{
+    Level& previous = *_levels[zoom + 1];
+    Level& current = *_levels[zoom];
+
+    double r = radiusAt(zoom);
+    double r2 = r * r;
+
+    std::vector<unsigned> neighbors;
+
+    // The previous level was just indexed, so visiting its nodes in k-d
+    // order covers all of them and keeps neighboring seeds close in memory.
+    for (unsigned i : previous.ids)
+    {
+        Node& seed = previous.nodes[i];
+
+        // skip removed nodes and those already claimed by a cluster
+        if (seed.count == 0 || seed.parent >= 0)
+            continue;
+
+        neighbors.clear();
+
+        previous.range(seed.x - r, seed.y - r, seed.x + r, seed.y + r, [&](unsigned j)
+            {
+                if (j != i)
+                {
+                    const Node& n = previous.nodes[j];
+                    double dx = n.x - seed.x, dy = n.y - seed.y;
+                    if (n.parent < 0 && dx * dx + dy * dy <= r2 &&
+                        (!_canMerge || _canMerge(seed.point, n.point)))
+                    {
+                        neighbors.push_back(j);
+                    }
+                }
+            });
+
+        unsigned index = (unsigned)current.nodes.size();
+
+        // weighted center of the seed and its unclaimed neighbors
+        double wx = seed.x * seed.count, wy = seed.y * seed.count;
+        unsigned count = seed.count;
+
+        Node cluster{ 0.0, 0.0, 0u, seed.point, -1, (int)i, -1 };
+        seed.parent = (int)index;
+
+        for (auto j : neighbors)
+        {
+            Node& n = previous.nodes[j];
+            wx += n.x * n.count;
+            wy += n.y * n.count;
+            count += n.count;
+            n.parent = (int)index;
+            n.nextSibling = cluster.firstChild;
+            cluster.firstChild = (int)j;
+        }
+
+        cluster.x = wx / (double)count;
+        cluster.y = wy / (double)count;
+        cluster.count = count;
+
+        current.nodes.push_back(cluster);
+    }
+
+    current.reindex();
+}
+
+void
+ClusterIndex::getClusters(
+    double west, double south, double east, double north,
+    unsigned zoom,
+    std::vector<Cluster>& output)
+{
+    if (!_built)
+        build();
+
+    if (west > east)
+    {
+        getClusters(west, south, 180.0, north, zoom, output);
+        getClusters(-180.0, south, east, north, zoom, output);
+        return;
+    }
+
+    unsigned level = zoom < _minZoom ? _minZoom : zoom > _maxZoom + 1 ? _maxZoom + 1 : zoom;
+    const Level& current = *_levels[level];
+
+    // mercator y runs north to south
+    current.range(lonToX(west), latToY(north), lonToX(east), latToY(south), [&](unsigned i)
+        {
+            const Node& n = current.nodes[i];
+            output.push_back(Cluster{ i, xToLon(n.x), yToLat(n.y), n.count, n.point });
+        });
+}
+
+void
+ClusterIndex::getPoints(
+    const Cluster& cluster,
+    unsigned zoom,
+    std::vector<unsigned>& output)
+{
+    if (!_built)
+        build();
+
+    unsigned level = zoom < _minZoom ? _minZoom : zoom > _maxZoom + 1 ? _maxZoom + 1 : zoom;
+    if (cluster.id < _levels[level]->nodes.size())
+    {
+        collectPoints(level, cluster.id, output);
+    }
+}
+
+void
+ClusterIndex::collectPoints(unsigned level, unsigned index, std::vector<unsigned>& output) const
+{
+    const Node& node = _levels[level]->nodes[index];
+    if (node.count == 0)
+        return;
+
+    if (level == _maxZoom + 1)
+    {
+        output.push_back(node.point);
+        return;
+    }
+
+    const auto& children = _levels[level + 1]->nodes;
+    for (int c = node.firstChild; c >= 0; c = children[c].nextSibling)
+    {
+        collectPoints(level + 1, (unsigned)c, output);
+    }
+}
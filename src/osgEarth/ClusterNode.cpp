@@ -1,9 +1,9 @@
 #include <osgEarth/ClusterNode>
+#include <osgEarth/MapNode>
+#include <osgEarth/Math>
 
-#include <osgEarth/kdbush.hpp>
-
-typedef std::pair<int, int> TPoint;
-typedef std::vector< std::size_t > TIds;
+#include <cfloat>
+#include <sstream>
 
 using namespace osgEarth;
 using namespace osgEarth::Contrib;
@@ -15,6 +15,7 @@ ClusterNode::ClusterNode(MapNode* mapNode, osg::Image* defaultImage) :
     _enabled(true),
     _dirty(true),
     _defaultImage(defaultImage),
+    _cacheZoom(~0u),
     _dirtyIndex(true)
 {
     setCullingActive(false);
@@ -26,7 +27,12 @@ void ClusterNode::addNode(osg::Node* node)
 {
     _nodes.push_back(node);
     _dirty = true;
-    _dirtyIndex = true;
+
+    // merge into the existing index if there is one
+    if (!_dirtyIndex && _mapNode.valid())
+    {
+        addToIndex(node);
+    }
 }
 
 void ClusterNode::removeNode(osg::Node* node)
@@ -37,7 +43,14 @@ void ClusterNode::removeNode(osg::Node* node)
         _nodes.erase(itr);
     }
     _dirty = true;
-    _dirtyIndex = true;
+
+    auto id = _pointIds.find(node);
+    if (!_dirtyIndex && id != _pointIds.end())
+    {
+        _clusterIndex.remove(id->second);
+        _indexedNodes[id->second] = nullptr;
+        _pointIds.erase(id);
+    }
 }
 
 void ClusterNode::clear()
@@ -56,6 +69,7 @@ void ClusterNode::setRadius(unsigned int radius)
 {
     _radius = radius;
     _dirty = true;
+    _dirtyIndex = true;
 }
 
 bool ClusterNode::getEnabled() const
@@ -107,47 +121,196 @@ void ClusterNode::setCanClusterCallback(ClusterNode::CanClusterCallback* callbac
 {
     _canClusterCallback = callback;
     _dirty = true;
+    _dirtyIndex = true;
 }
 
-namespace
+void ClusterNode::addToIndex(osg::Node* node)
 {
-    bool boundSort(const osg::ref_ptr< osg::Node> &i, const osg::ref_ptr< osg::Node> &j)
-    {
-        osg::BoundingSphere bsI = i->getBound();
-        osg::BoundingSphere bsJ = j->getBound();
-
-        return bsI.center().x() < bsJ.center().x();
-    }
+    const SpatialReference* mapSRS = _mapNode->getMapSRS();
+
+    GeoPoint point;
+    point.fromWorld(mapSRS, node->getBound().center());
+    point = point.transform(mapSRS->getGeographicSRS());
+
+    // adding to a built index asks the can-merge function about the new
+    // point, which looks up its node by id, so record the node first
+    _indexedNodes.push_back(node);
+    _indexedHeights.push_back(point.z());
+    unsigned id = _clusterIndex.add(point.x(), point.y());
+    _pointIds[node] = id;
 }
+
 void ClusterNode::buildIndex()
 {
     if (_dirtyIndex)
     {
         _clusterIndex.clear();
+        _indexedNodes.clear();
+        _indexedHeights.clear();
+        _pointIds.clear();
 
-        std::sort(_nodes.begin(), _nodes.end(), boundSort);
+        _clusterIndex.setRadius(_radius);
 
-        unsigned int maxNodes = 10000;
+        if (_canClusterCallback.valid())
+        {
+            _clusterIndex.setCanMergeFunction([this](unsigned a, unsigned b)
+                {
+                    return (*_canClusterCallback)(_indexedNodes[a].get(), _indexedNodes[b].get());
+                });
+        }
+        else
+        {
+            _clusterIndex.setCanMergeFunction(nullptr);
+        }
+
+        for (auto& node : _nodes)
+        {
+            addToIndex(node.get());
+        }
 
-        osg::Group* currentGroup = 0;
+        _clusterIndex.build();
 
-        for (unsigned int i = 0; i < _nodes.size(); i++)
+        _clusterCache.clear();
+    }
+    _dirtyIndex = false;
+}
+
+unsigned ClusterNode::getZoom(osgUtil::CullVisitor* cv, const osg::Matrixd& mvpw, double bounds[4])
+{
+    osg::Viewport* viewport = cv->getCurrentCamera()->getViewport();
+    const SpatialReference* mapSRS = _mapNode->getMapSRS();
+    const SpatialReference* geoSRS = mapSRS->getGeographicSRS();
+    const Ellipsoid& ellipsoid = mapSRS->getEllipsoid();
+
+    osg::Matrixd inverse;
+    inverse.invert(mvpw);
+
+    // Finds the lon/lat on the ground under a window coordinate
+    auto groundAt = [&](double x, double y, osg::Vec3d& lla)
+    {
+        osg::Vec3d p0 = osg::Vec3d(x, y, 0.0) * inverse;
+        osg::Vec3d p1 = osg::Vec3d(x, y, 1.0) * inverse;
+
+        if (_mapNode->isGeocentric())
+        {
+            osg::Vec3d hit;
+            if (!ellipsoid.intersectGeocentricLine(p0, p1, hit))
+                return false;
+            lla = ellipsoid.geocentricToGeodetic(hit);
+            return true;
+        }
+        else
+        {
+            if (equivalent(p0.z(), p1.z()))
+                return false;
+            double t = p0.z() / (p0.z() - p1.z());
+            if (t < 0.0)
+                return false;
+            GeoPoint point(mapSRS, p0 + (p1 - p0) * t);
+            point = point.transform(geoSRS);
+            lla.set(point.x(), point.y(), 0.0);
+            return true;
+        }
+    };
+
+    double cx = viewport->x() + 0.5 * viewport->width();
+    double cy = viewport->y() + 0.5 * viewport->height();
+
+    // Meters per pixel at the center of the view, measured
+    // across one cluster radius
+    double metersPerPixel = 0.0;
+    double latitude = 0.0;
+    osg::Vec3d center, offset;
+    if (groundAt(cx, cy, center) && groundAt(cx + (double)_radius, cy, offset))
+    {
+        metersPerPixel = ellipsoid.geodesicDistance(
+            osg::Vec2d(center.x(), center.y()),
+            osg::Vec2d(offset.x(), offset.y())) / (double)_radius;
+        latitude = center.y();
+    }
+    else
+    {
+        // The view center is off the ground, so estimate from the height
+        // of the eye looking straight down.
+        osg::Vec3d eye = osg::Vec3d(0, 0, 0) * cv->getCurrentCamera()->getInverseViewMatrix();
+        GeoPoint eyePoint;
+        eyePoint.fromWorld(mapSRS, eye);
+        eyePoint = eyePoint.transform(geoSRS);
+
+        double fovy, aspect, zn, zf;
+        if (cv->getCurrentCamera()->getProjectionMatrixAsPerspective(fovy, aspect, zn, zf))
+        {
+            metersPerPixel = 2.0 * std::max(eyePoint.z(), 1.0) *
+                tan(osg::DegreesToRadians(0.5 * fovy)) / viewport->height();
+        }
+        latitude = eyePoint.y();
+    }
+
+    // Geographic bounds of the view, sampled on a grid of window points.
+    // If any of them misses the ground, the horizon is in view; query
+    // the whole world and let the per-cluster tests sort it out.
+    bounds[0] = -180.0, bounds[1] = -90.0, bounds[2] = 180.0, bounds[3] = 90.0;
+
+    double west = DBL_MAX, south = DBL_MAX, east = -DBL_MAX, north = -DBL_MAX;
+    bool allHit = true;
+    for (int i = 0; i <= 2 && allHit; ++i)
+    {
+        for (int j = 0; j <= 2 && allHit; ++j)
         {
-            if (!currentGroup || currentGroup->getNumChildren() >= maxNodes)
+            osg::Vec3d lla;
+            allHit = groundAt(
+                viewport->x() + 0.5 * i * viewport->width(),
+                viewport->y() + 0.5 * j * viewport->height(),
+                lla);
+            if (allHit)
             {
-                currentGroup = new osg::Group;
-                _clusterIndex.push_back(currentGroup);
+                west = std::min(west, lla.x()), east = std::max(east, lla.x());
+                south = std::min(south, lla.y()), north = std::max(north, lla.y());
             }
-            currentGroup->addChild(_nodes[i]);                      
         }
     }
-    _dirtyIndex = false;
-}
 
+    if (allHit)
+    {
+        // pad by a margin so clusters just outside the edges still count
+        double padX = 0.1 * (east - west), padY = 0.1 * (north - south);
+        bounds[1] = std::max(-90.0, south - padY);
+        bounds[3] = std::min(90.0, north + padY);
+
+        // a view that spans the antimeridian or sees a pole needs all longitudes
+        bool seesPole = false;
+        if (_mapNode->isGeocentric())
+        {
+            for (double lat : { -90.0, 90.0 })
+            {
+                osg::Vec3d pole = ellipsoid.geodeticToGeocentric(osg::Vec3d(0.0, lat, 0.0));
+                osg::Vec3d screen = pole * mvpw;
+                if (_horizon->isVisible(pole) &&
+                    screen.x() >= viewport->x() && screen.x() <= viewport->x() + viewport->width() &&
+                    screen.y() >= viewport->y() && screen.y() <= viewport->y() + viewport->height())
+                {
+                    seesPole = true;
+                    if (lat < 0.0) bounds[1] = -90.0; else bounds[3] = 90.0;
+                }
+            }
+        }
+
+        if (!seesPole && east - west < 180.0)
+        {
+            bounds[0] = west - padX;
+            bounds[2] = east + padX;
+            if (bounds[0] < -180.0) bounds[0] += 360.0;
+            if (bounds[2] > 180.0) bounds[2] -= 360.0;
+        }
+    }
+
+    double zoom = _clusterIndex.getZoom(metersPerPixel, latitude);
+    return (unsigned)clamp(zoom, 0.0, (double)(_clusterIndex.getMaxZoom() + 1));
+}
 
-void ClusterNode::getClusters(osgUtil::CullVisitor* cv, ClusterList& out)
+void ClusterNode::cullClusters(osgUtil::CullVisitor* cv)
 {
-    _nextLabel = 0;
+    _visibleClusters.clear();
 
     osg::Camera* camera = cv->getCurrentCamera();
 
@@ -157,109 +320,104 @@ void ClusterNode::getClusters(osgUtil::CullVisitor* cv, ClusterList& out)
         return;
     }
 
+    buildIndex();
+
     osg::Matrixd mvpw = camera->getViewMatrix() *
         camera->getProjectionMatrix() *
         camera->getViewport()->computeWindowMatrix();
 
-    std::vector<TPoint> points;
+    double bounds[4];
+    unsigned zoom = getZoom(cv, mvpw, bounds);
 
-    osg::NodeList validPlaces;
+    // Clusters at one zoom never change, so keep the ones we have made
+    // (and their markers) until the zoom does.
+    if (zoom != _cacheZoom)
+    {
+        _clusterCache.clear();
+        _cacheZoom = zoom;
+    }
 
-    buildIndex();
+    if (_clusterCache.empty())
+    {
+        _nextLabel = 0;
+    }
+
+    std::vector<ClusterIndex::Cluster> candidates;
+    _clusterIndex.getClusters(bounds[0], bounds[1], bounds[2], bounds[3], zoom, candidates);
+
+    const SpatialReference* geoSRS = _mapNode->getMapSRS()->getGeographicSRS();
+    std::vector<unsigned> points;
 
-    for (osg::NodeList::iterator itr = _clusterIndex.begin(); itr != _clusterIndex.end(); ++itr)
+    for (auto& candidate : candidates)
     {
-        osg::Group* index = static_cast<osg::Group*>(itr->get());
-        if (cv->isCulled(index->getBound()))
-        {
-            continue;
-        }
+        osg::Vec3d world;
 
-        for (unsigned int i = 0; i < index->getNumChildren(); i++)
+        if (candidate.count == 1)
         {
-            osg::Node* node = index->getChild(i);
-            osg::Vec3d world = node->getBound().center();
-
+            osg::Node* node = _indexedNodes[candidate.point].get();
             if (cv->isCulled(*node))
             {
                 continue;
             }
-
-            if (!_horizon->isVisible(world))
-            {
-                continue;
-            }
-
-            osg::Vec3d screen = world * mvpw;
-
-            if (screen.x() >= 0 && screen.x() <= viewport->width() &&
-                screen.y() >= 0 && screen.y() <= viewport->height())
-            {
-                validPlaces.push_back(node);
-                points.push_back(TPoint(screen.x(), screen.y()));
-            }
+            world = node->getBound().center();
+        }
+        else
+        {
+            GeoPoint(geoSRS, candidate.longitude, candidate.latitude, _indexedHeights[candidate.point]).toWorld(world);
         }
-    }
-
-    if (validPlaces.size() == 0) return;
 
-    kdbush::KDBush<TPoint> index(points);
-    std::set< unsigned int > clustered;
+        if (!_horizon->isVisible(world))
+        {
+            continue;
+        }
 
-    for (unsigned int i = 0; i < validPlaces.size(); i++)
-    {
-        TPoint &screen = points[i];
-        osg::Node* node = validPlaces[i].get();
+        osg::Vec3d screen = world * mvpw;
 
-        // If this thing is already part of a cluster then just continue.
-        if (clustered.find(i) != clustered.end())
+        if (screen.x() < 0 || screen.x() > viewport->width() ||
+            screen.y() < 0 || screen.y() > viewport->height())
         {
             continue;
         }
 
-        osg::Vec3d world = node->getBound().center();
+        auto i = _clusterCache.find(candidate.id);
+        if (i == _clusterCache.end())
+        {
+            Cluster& cluster = _clusterCache[candidate.id];
 
-        // Get any matching indices that are part of this cluster.
-        TIds indices;
+            points.clear();
+            _clusterIndex.getPoints(candidate, zoom, points);
+            for (auto id : points)
+            {
+                cluster.nodes.push_back(_indexedNodes[id]);
+            }
 
-        index.range(screen.first - _radius, screen.second - _radius, screen.first + _radius, screen.second + _radius, indices);
+            if (cluster.nodes.empty())
+            {
+                _clusterCache.erase(candidate.id);
+                continue;
+            }
 
-        // Create a new cluster.
-        Cluster cluster;
+            if (cluster.nodes.size() > 1)
+            {
+                std::stringstream buf;
+                buf << cluster.nodes.size() << std::endl;
 
-        unsigned int actualCount = 0;
+                PlaceNode* marker = getOrCreateLabel();
+                marker->setPosition(GeoPoint(geoSRS, candidate.longitude, candidate.latitude, _indexedHeights[candidate.point]));
+                marker->setText(buf.str());
+                cluster.marker = marker;
 
-        // Add all of the points to the cluster.
-        for (unsigned int j = 0; j < indices.size(); j++)
-        {
-            if (clustered.find(indices[j]) == clustered.end())
-            {
-                if (_canClusterCallback.valid())
+                // Style the cluster if need be
+                if (_styleCallback)
                 {
-                    bool canCluster = (*_canClusterCallback)(node, validPlaces[indices[j]].get());
-                    if (!canCluster) {
-                        continue;
-                    }
+                    (*_styleCallback)(cluster);
                 }
-                cluster.nodes.push_back(validPlaces[indices[j]]);
-                actualCount++;
-                clustered.insert(indices[j]);
             }
-        }
-
-        std::stringstream buf;
-        buf << actualCount << std::endl;
 
-        PlaceNode* marker = getOrCreateLabel();
-        GeoPoint markerPos;
-        markerPos.fromWorld(_mapNode->getMapSRS(), world);
-        marker->setPosition(markerPos);
-        marker->setText(buf.str());
-
-        cluster.marker = marker;
-        out.push_back(cluster);
+            i = _clusterCache.find(candidate.id);
+        }
 
-        clustered.insert(i);
+        _visibleClusters.push_back(&i->second);
     }
 }
 
@@ -289,33 +447,26 @@ void ClusterNode::traverse(osg::NodeVisitor& nv)
 
                     _horizon->setEye(eye, cv->getProjectionMatrix());
 
-                    _clusters.clear();
-                    getClusters(cv, _clusters);
-
-                    // Style the clusters if need be
-                    if (_styleCallback)
+                    // settings or contents changed; remake the clusters in view
+                    if (_dirty)
                     {
-                        for (ClusterList::iterator itr = _clusters.begin(); itr != _clusters.end(); ++itr)
-                        {
-                            Cluster& cluster = *itr;
-                            (*_styleCallback)(cluster);
-                        }
+                        _clusterCache.clear();
                     }
+
+                    cullClusters(cv);
                 }
 
-                for (ClusterList::iterator itr = _clusters.begin(); itr != _clusters.end(); ++itr)
+                for (auto cluster : _visibleClusters)
                 {
-                    Cluster& cluster = *itr;
-
                     // If we have more than 1 place, traverse the representative marker
-                    if (cluster.nodes.size() > 1)
+                    if (cluster->nodes.size() > 1)
                     {
-                        itr->marker->accept(nv);
+                        cluster->marker->accept(nv);
                     }
                     else
                     {
                         // Otherwise just traverse the first node
-                        cluster.nodes[0]->accept(nv);
+                        cluster->nodes[0]->accept(nv);
                     }
                 }
                 _dirty = false;
@@ -0,0 +1,498 @@
+/* osgEarth
+ * Copyright 2025 Pelican Mapping
+ * MIT License
+ */
+#include <osgEarth/CompiledExpression>
+#include <osgEarth/FilterContext>
+#include <osgEarth/ScriptEngine>
+#include <osgEarth/StringUtils>
+#include <algorithm>
+#include <unordered_map>
+
+#define LC "[CompiledExpression] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    // Registers to keep on the stack when evaluating a single feature
+    constexpr unsigned LOCAL_REGISTERS = 32u;
+
+    // Finds the attribute column for a variable, trying the column
+    // it was found in last time before searching the table.
+    template<typename SLOT>
+    inline int findColumn(const Feature* feature, const SLOT& slot)
+    {
+        const AttributeTable& attrs = feature->getAttrs();
+        int col = slot.column;
+        if (col < 0 || col >= attrs.size() || attrs._container[col].first != slot.key)
+        {
+            col = feature->indexOf(slot.key);
+            slot.column = col;
+        }
+        return col;
+    }
+
+    // Runs a variable's script for the listed features in one call to the
+    // session's script engine. Returns false if there is no engine.
+    bool runScripts(
+        const std::string& code,
+        const FeatureList& features,
+        const std::vector<unsigned>& which,
+        const FilterContext* context,
+        std::vector<ScriptResult>& results)
+    {
+        results.clear();
+        if (which.empty() || !context || !context->getSession())
+            return false;
+
+        ScriptEngine* engine = context->getSession()->getScriptEngine();
+        if (!engine)
+            return false;
+
+        FeatureList subset;
+        subset.reserve(which.size());
+        for (auto i : which)
+            subset.push_back(features[i]);
+
+        results.reserve(which.size());
+        engine->run(code, subset, results, context);
+        results.resize(which.size(), ScriptResult(EMPTY_STRING, false, "Script did not run"));
+        return true;
+    }
+}
+
+CompiledNumericExpression::CompiledNumericExpression(const NumericExpression& expr) :
+    _src(expr._src)
+{
+    using Op = NumericExpression::Op;
+
+    // An expression without variables always evaluates the same way, and may
+    // carry a literal value more precise than its source string.
+    if (expr._vars.empty())
+    {
+        _constantValue = expr.eval();
+        return;
+    }
+
+    // Which variable (if any) sits at each RPN position
+    std::unordered_map<unsigned, const std::string*> varAt;
+    for (auto& var : expr._vars)
+        varAt[var.second] = &var.first;
+
+    // Operands live in one of three register banks, which are laid out
+    // once compilation knows how big each one is.
+    enum Bank { SLOT, CONSTANT, TEMP };
+    struct Operand
+    {
+        Bank bank;
+        unsigned index;
+        double value; // for constants
+    };
+    struct Pending
+    {
+        OpCode op;
+        unsigned dst;
+        Operand a, b;
+    };
+
+    std::vector<Operand> stack;
+    std::vector<Pending> pending;
+    unsigned maxDepth = 0u;
+
+    auto fold = [](Op op, double a, double b) -> double
+    {
+        switch (op)
+        {
+        case NumericExpression::ADD: return a + b;
+        case NumericExpression::SUB: return a - b;
+        case NumericExpression::MULT: return a * b;
+        case NumericExpression::DIV: return a / b;
+        case NumericExpression::MOD: return fmod(a, b);
+        case NumericExpression::MIN: return osg::minimum(a, b);
+        default: return osg::maximum(a, b);
+        }
+    };
+
+    for (unsigned i = 0; i < expr._rpn.size(); ++i)
+    {
+        const auto& atom = expr._rpn[i];
+        Op op = atom.first;
+
+        bool isOperator =
+            op == NumericExpression::ADD || op == NumericExpression::SUB ||
+            op == NumericExpression::MULT || op == NumericExpression::DIV ||
+            op == NumericExpression::MOD || op == NumericExpression::MIN ||
+            op == NumericExpression::MAX;
+
+        if (isOperator)
+        {
+            // the interpreter ignores an operator without two operands
+            if (stack.size() < 2)
+                continue;
+
+            Operand b = stack.back(); stack.pop_back();
+            Operand a = stack.back(); stack.pop_back();
+
+            if (a.bank == CONSTANT && b.bank == CONSTANT)
+            {
+                stack.push_back(Operand{ CONSTANT, 0u, fold(op, a.value, b.value) });
+            }
+            else
+            {
+                OpCode code =
+                    op == NumericExpression::ADD ? ADD :
+                    op == NumericExpression::SUB ? SUB :
+                    op == NumericExpression::MULT ? MULT :
+                    op == NumericExpression::DIV ? DIV :
+                    op == NumericExpression::MOD ? MOD :
+                    op == NumericExpression::MIN ? MIN : MAX;
+
+                unsigned depth = (unsigned)stack.size();
+                pending.push_back(Pending{ code, depth, a, b });
+                stack.push_back(Operand{ TEMP, depth, 0.0 });
+                maxDepth = std::max(maxDepth, depth + 1);
+            }
+        }
+        else if (op == NumericExpression::VARIABLE && varAt.count(i))
+        {
+            const std::string& name = *varAt[i];
+            unsigned s = 0;
+            while (s < _slots.size() && _slots[s].name != name)
+                ++s;
+            if (s == _slots.size())
+            {
+                _slots.emplace_back();
+                _slots.back().name = name;
+                _slots.back().key = toLower(name);
+            }
+            stack.push_back(Operand{ SLOT, s, 0.0 });
+        }
+        else
+        {
+            // operands, and anything else the interpreter would push as-is
+            stack.push_back(Operand{ CONSTANT, 0u, atom.second });
+        }
+    }
+
+    if (stack.empty() || stack.back().bank == CONSTANT)
+    {
+        _constantValue = stack.empty() ? 0.0 : stack.back().value;
+        _constantValue = !osg::isNaN(_constantValue) ? _constantValue : 0.0;
+        _slots.clear();
+        return;
+    }
+
+    // Lay out the registers: variables, then constants, then temporaries.
+    unsigned numConstants = 0u;
+    for (auto& p : pending)
+    {
+        if (p.a.bank == CONSTANT) ++numConstants;
+        if (p.b.bank == CONSTANT) ++numConstants;
+    }
+
+    unsigned numSlots = (unsigned)_slots.size();
+    unsigned tempBase = numSlots + numConstants;
+    _numRegisters = tempBase + maxDepth;
+
+    if (_numRegisters > 0xFFFF)
+    {
+        OE_WARN << LC << "Expression too large to compile: " << _src << std::endl;
+        _slots.clear();
+        return;
+    }
+
+    auto resolve = [&](const Operand& operand) -> unsigned short
+    {
+        if (operand.bank == SLOT)
+            return (unsigned short)operand.index;
+        if (operand.bank == TEMP)
+            return (unsigned short)(tempBase + operand.index);
+        _constants.push_back(operand.value);
+        return (unsigned short)(numSlots + _constants.size() - 1);
+    };
+
+    _code.reserve(pending.size());
+    for (auto& p : pending)
+    {
+        Instruction instr;
+        instr.op = p.op;
+        instr.a = resolve(p.a);
+        instr.b = resolve(p.b);
+        instr.dst = (unsigned short)(tempBase + p.dst);
+        _code.push_back(instr);
+    }
+
+    const Operand& result = stack.back();
+    _result = result.bank == SLOT ? result.index : tempBase + result.index;
+    _constant = false;
+}
+
+void
+CompiledNumericExpression::fetch(const Feature* feature, const FilterContext* context, double* registers) const
+{
+    for (unsigned s = 0; s < _slots.size(); ++s)
+    {
+        const Slot& slot = _slots[s];
+        double val = 0.0;
+
+        int col = feature ? findColumn(feature, slot) : -1;
+        if (col >= 0)
+        {
+            val = feature->getDouble(col);
+        }
+        else if (feature && context && context->getSession())
+        {
+            //No attr found, look for script
+            ScriptEngine* engine = context->getSession()->getScriptEngine();
+            if (engine)
+            {
+                ScriptResult result = engine->run(slot.name, feature, context);
+                if (result.success())
+                    val = result.asDouble();
+                else {
+                    OE_WARN << LC << "Feature Script error on '" << _src << "': " << result.message() << std::endl;
+                }
+            }
+        }
+
+        registers[s] = val;
+    }
+}
+
+double
+CompiledNumericExpression::run(double* r) const
+{
+    for (const auto& i : _code)
+    {
+        switch (i.op)
+        {
+        case ADD:  r[i.dst] = r[i.a] + r[i.b]; break;
+        case SUB:  r[i.dst] = r[i.a] - r[i.b]; break;
+        case MULT: r[i.dst] = r[i.a] * r[i.b]; break;
+        case DIV:  r[i.dst] = r[i.a] / r[i.b]; break;
+        case MOD:  r[i.dst] = fmod(r[i.a], r[i.b]); break;
+        case MIN:  r[i.dst] = osg::minimum(r[i.a], r[i.b]); break;
+        case MAX:  r[i.dst] = osg::maximum(r[i.a], r[i.b]); break;
+        }
+    }
+
+    double value = r[_result];
+    return !osg::isNaN(value) ? value : 0.0;
+}
+
+double
+CompiledNumericExpression::eval(const Feature* feature, const FilterContext* context) const
+{
+    if (_constant)
+        return _constantValue;
+
+    double local[LOCAL_REGISTERS];
+    std::vector<double> heap;
+    double* registers = local;
+    if (_numRegisters > LOCAL_REGISTERS)
+    {
+        heap.resize(_numRegisters);
+        registers = heap.data();
+    }
+
+    std::copy(_constants.begin(), _constants.end(), registers + _slots.size());
+    fetch(feature, context, registers);
+    return run(registers);
+}
+
+void
+CompiledNumericExpression::eval(const FeatureList& features, std::vector<double>& output, const FilterContext* context) const
+{
+    const unsigned n = (unsigned)features.size();
+    output.resize(n);
+
+    if (_constant)
+    {
+        std::fill(output.begin(), output.end(), _constantValue);
+        return;
+    }
+
+    // Gather each variable for the whole batch first, so a variable that
+    // comes from a script goes through the engine once instead of per feature.
+    std::vector<double> values(_slots.size() * n, 0.0);
+    std::vector<unsigned> scripted;
+    std::vector<ScriptResult> results;
+
+    for (unsigned s = 0; s < _slots.size(); ++s)
+    {
+        double* column = &values[s * n];
+        scripted.clear();
+
+        for (unsigned i = 0; i < n; ++i)
+        {
+            const Feature* feature = features[i].get();
+            int col = feature ? findColumn(feature, _slots[s]) : -1;
+            if (col >= 0)
+                column[i] = feature->getDouble(col);
+            else if (feature)
+                scripted.push_back(i);
+        }
+
+        if (runScripts(_slots[s].name, features, scripted, context, results))
+        {
+            for (unsigned k = 0; k < scripted.size(); ++k)
+            {
+                if (results[k].success())
+                    column[scripted[k]] = results[k].asDouble();
+                else {
+                    OE_WARN << LC << "Feature Script error on '" << _src << "': " << results[k].message() << std::endl;
+                }
+            }
+        }
+    }
+
+    // constants stay put; only the variables change per feature
+    std::vector<double> registers(_numRegisters);
+    std::copy(_constants.begin(), _constants.end(), registers.begin() + _slots.size());
+
+    for (unsigned i = 0; i < n; ++i)
+    {
+        for (unsigned s = 0; s < _slots.size(); ++s)
+            registers[s] = values[s * n + i];
+        output[i] = run(registers.data());
+    }
+}
+
+//------------------------------------------------------------------------
+
+CompiledStringExpression::CompiledStringExpression(const StringExpression& expr) :
+    _src(expr._src)
+{
+    if (expr._vars.empty())
+    {
+        _parts.emplace_back();
+        _parts.back().literal = expr.eval();
+        return;
+    }
+
+    for (unsigned i = 0; i < expr._infix.size(); ++i)
+    {
+        const auto& atom = expr._infix[i];
+        if (atom.first == StringExpression::VARIABLE)
+        {
+            unsigned s = 0;
+            while (s < _slots.size() && _slots[s].name != atom.second)
+                ++s;
+            if (s == _slots.size())
+            {
+                _slots.emplace_back();
+                _slots.back().name = atom.second;
+                _slots.back().key = toLower(atom.second);
+            }
+            _parts.emplace_back();
+            _parts.back().slot = (int)s;
+        }
+        else if (!_parts.empty() && _parts.back().slot < 0)
+        {
+            // fold adjacent literals together
+            _parts.back().literal += atom.second;
+        }
+        else
+        {
+            _parts.emplace_back();
+            _parts.back().literal = atom.second;
+        }
+    }
+
+    _values.resize(_slots.size());
+}
+
+const std::string&
+CompiledStringExpression::eval(const Feature* feature, const FilterContext* context) const
+{
+    if (isConstant())
+    {
+        _buffer = _parts.empty() ? std::string() : _parts.front().literal;
+        return _buffer;
+    }
+
+    for (unsigned s = 0; s < _slots.size(); ++s)
+    {
+        const Slot& slot = _slots[s];
+        std::string& val = _values[s];
+        val.clear();
+
+        int col = feature ? findColumn(feature, slot) : -1;
+        if (col >= 0)
+        {
+            val = feature->getString(col);
+        }
+        else if (feature && context && context->getSession())
+        {
+            //No attr found, look for script
+            ScriptEngine* engine = context->getSession()->getScriptEngine();
+            if (engine)
+            {
+                ScriptResult result = engine->run(slot.name, feature, context);
+                if (result.success())
+                    val = result.asString();
+                else
+                    val = slot.name; // take it as a string literal
+            }
+        }
+    }
+
+    _buffer.clear();
+    for (const auto& part : _parts)
+        _buffer += part.slot >= 0 ? _values[part.slot] : part.literal;
+
+    return _buffer;
+}
+
+void
+CompiledStringExpression::eval(const FeatureList& features, std::vector<std::string>& output, const FilterContext* context) const
+{
+    const unsigned n = (unsigned)features.size();
+    output.resize(n);
+
+    if (isConstant())
+    {
+        std::fill(output.begin(), output.end(), _parts.empty() ? std::string() : _parts.front().literal);
+        return;
+    }
+
+    // Gather each variable for the whole batch first (see the numeric version)
+    std::vector<std::string> values(_slots.size() * n);
+    std::vector<unsigned> scripted;
+    std::vector<ScriptResult> results;
+
+    for (unsigned s = 0; s < _slots.size(); ++s)
+    {
+        std::string* column = &values[s * n];
+        scripted.clear();
+
+        for (unsigned i = 0; i < n; ++i)
+        {
+            const Feature* feature = features[i].get();
+            int col = feature ? findColumn(feature, _slots[s]) : -1;
+            if (col >= 0)
+                column[i] = feature->getString(col);
+            else if (feature)
+                scripted.push_back(i);
+        }
+
+        if (runScripts(_slots[s].name, features, scripted, context, results))
+        {
+            for (unsigned k = 0; k < scripted.size(); ++k)
+            {
+                // Couldn't execute it as code, just take it as a string literal.
+                column[scripted[k]] = results[k].success() ? results[k].asString() : _slots[s].name;
+            }
+        }
+    }
+
+    for (unsigned i = 0; i < n; ++i)
+    {
+        std::string& out = output[i];
+        out.clear();
+        for (const auto& part : _parts)
+            out += part.slot >= 0 ? values[part.slot * n + i] : part.literal;
+    }
+}
@@ -0,0 +1,671 @@
+/* osgEarth
+ * Copyright 2025 Pelican Mapping
+ * MIT License
+ */
+#include <osgEarth/ContourFeatureSource>
+#include <osgEarth/FeatureCursor>
+#include <osgEarth/Elevation>
+#include <osgEarth/Map>
+#include <osgEarth/Threading>
+#include <osgEarth/Metrics>
+#include <cmath>
+#include <map>
+#include <tuple>
+
+#define LC "[ContourFeatureSource] " << getName() << " : "
+
+#define ARENA_CONTOURS "oe.contours"
+
+using namespace osgEarth;
+
+//........................................................................
+
+Config
+ContourFeatureSource::Options::getConfig() const
+{
+    Config conf = super::Options::getConfig();
+    conf.set("interval", _interval);
+    conf.set("offset", _offset);
+    conf.set("simplify_tolerance", _simplifyTolerance);
+    conf.set("attribute", _attribute);
+    conf.set("max_tiles_per_query", _maxTilesPerQuery);
+    return conf;
+}
+
+void
+ContourFeatureSource::Options::fromConfig(const Config& conf)
+{
+    conf.get("interval", _interval);
+    conf.get("offset", _offset);
+    conf.get("simplify_tolerance", _simplifyTolerance);
+    conf.get("attribute", _attribute);
+    conf.get("max_tiles_per_query", _maxTilesPerQuery);
+}
+
+//........................................................................
+
+namespace
+{
+    // Identifies a contour crossing on a grid edge that is shared by
+    // adjacent tiles of the same LOD: (contour index, global post column,
+    // global post row, direction). Direction 0 runs east from the post,
+    // direction 1 runs north.
+    using EdgeKey = std::tuple<int, long long, long long, int>;
+
+    struct ContourLine
+    {
+        int level = 0;
+        bool closed = false;
+        EdgeKey head, tail;
+        std::vector<osg::Vec3d> points;
+    };
+
+    // Contour line in grid units (column, row) before conversion to map
+    // coordinates. Head and tail are the local ids of the end edges.
+    struct GridLine
+    {
+        bool closed = false;
+        int head = 0, tail = 0;
+        std::vector<osg::Vec2d> points;
+    };
+
+    inline double cross2(const osg::Vec2d& a, const osg::Vec2d& b)
+    {
+        return a.x() * b.y() - a.y() * b.x();
+    }
+
+    // Squared distance from p to the segment (a, b)
+    inline double distance2(const osg::Vec2d& p, const osg::Vec2d& a, const osg::Vec2d& b)
+    {
+        osg::Vec2d ab = b - a, ap = p - a;
+        double len2 = ab.length2();
+        double t = len2 > 0.0 ? osg::clampBetween((ap * ab) / len2, 0.0, 1.0) : 0.0;
+        return (ap - ab * t).length2();
+    }
+
+    // Douglas-Peucker simplification that always keeps the end points,
+    // so lines still meet their neighbors across tile boundaries.
+    void simplify(std::vector<osg::Vec2d>& points, double tolerance, bool closed)
+    {
+        if (tolerance <= 0.0 || points.size() <= 2)
+            return;
+
+        const double tol2 = tolerance * tolerance;
+        std::vector<char> keep(points.size(), 0);
+        keep.front() = keep.back() = 1;
+
+        std::vector<std::pair<unsigned, unsigned>> stack;
+        stack.emplace_back(0u, (unsigned)points.size() - 1u);
+        while (!stack.empty())
+        {
+            unsigned i = stack.back().first, j = stack.back().second;
+            stack.pop_back();
+
+            double dmax = -1.0;
+            unsigned kmax = 0;
+            for (unsigned k = i + 1; k < j; ++k)
+            {
+                double d = distance2(points[k], points[i], points[j]);
+                if (d > dmax)
+                    dmax = d, kmax = k;
+            }
+
+            if (dmax > tol2)
+            {
+                keep[kmax] = 1;
+                stack.emplace_back(i, kmax);
+                stack.emplace_back(kmax, j);
+            }
+        }
+
+        unsigned count = 0;
+        for (auto k : keep)
+            count += k;
+
+        // a ring needs at least three distinct points to stay a ring
+        if (closed && count < 4u)
+            return;
+
+        unsigned n = 0;
+        for (unsigned k = 0; k < points.size(); ++k)
+            if (keep[k])
+                points[n++] = points[k];
+        points.resize(n);
+    }
+
+    // Marching squares over a grid of heights stored row by row from the
+    // south-west corner. Posts holding NO_DATA_VALUE void their cells.
+    class Marcher
+    {
+    public:
+        Marcher(const float* heights, int cols, int rows) :
+            _h(heights), _cols(cols), _rows(rows)
+        {
+            _succ.assign((size_t)cols * (size_t)rows * 2u, -1);
+            _pred.assign(_succ.size(), 0);
+            _above0.resize(cols);
+            _above1.resize(cols);
+            _cases.resize(cols);
+
+            // height range of each row of cells, so a contour only
+            // visits the rows it actually crosses
+            _rowMin.assign(rows, FLT_MAX);
+            _rowMax.assign(rows, -FLT_MAX);
+            for (int r = 0; r < rows; ++r)
+            {
+                for (int c = 0; c < cols; ++c)
+                {
+                    float v = _h[r * cols + c];
+                    if (v != NO_DATA_VALUE)
+                    {
+                        _rowMin[r] = std::min(_rowMin[r], v);
+                        _rowMax[r] = std::max(_rowMax[r], v);
+                    }
+                }
+            }
+            for (int r = 0; r + 1 < rows; ++r)
+            {
+                _rowMin[r] = std::min(_rowMin[r], _rowMin[r + 1]);
+                _rowMax[r] = std::max(_rowMax[r], _rowMax[r + 1]);
+            }
+        }
+
+        //! Appends the chained lines of one contour elevation
+        void run(float iso, double tolerance, std::vector<GridLine>& output)
+        {
+            _segments.clear();
+
+            for (int r = 0; r + 1 < _rows; ++r)
+            {
+                if (!(_rowMax[r] > iso && _rowMin[r] <= iso))
+                    continue;
+
+                const float* lo = _h + r * _cols;
+                const float* hi = lo + _cols;
+
+                // classify posts and build the cell cases with straight-line
+                // loops the compiler can vectorize
+                for (int c = 0; c < _cols; ++c)
+                    _above0[c] = lo[c] > iso ? 1 : 0;
+                for (int c = 0; c < _cols; ++c)
+                    _above1[c] = hi[c] > iso ? 1 : 0;
+                for (int c = 0; c + 1 < _cols; ++c)
+                    _cases[c] = _above0[c] | (_above0[c + 1] << 1) | (_above1[c + 1] << 2) | (_above1[c] << 3);
+
+                for (int c = 0; c + 1 < _cols; ++c)
+                {
+                    unsigned char cs = _cases[c];
+                    if (cs == 0 || cs == 15)
+                        continue;
+
+                    float v0 = lo[c], v1 = lo[c + 1], v2 = hi[c + 1], v3 = hi[c];
+                    if (v0 == NO_DATA_VALUE || v1 == NO_DATA_VALUE || v2 == NO_DATA_VALUE || v3 == NO_DATA_VALUE)
+                        continue;
+
+                    // cell edges: bottom, right, top, left
+                    int base = (r * _cols + c) << 1;
+                    int e[4] = { base, ((r * _cols + c + 1) << 1) | 1, ((r + 1) * _cols + c) << 1, base | 1 };
+
+                    if (cs == 5 || cs == 10)
+                    {
+                        // saddle: the average of the corners decides whether
+                        // the high or the low corners connect through the cell
+                        bool centerAbove = 0.25f * (v0 + v1 + v2 + v3) > iso;
+                        if ((cs == 5) != centerAbove)
+                        {
+                            addSegment(e[3], e[0], iso);
+                            addSegment(e[1], e[2], iso);
+                        }
+                        else
+                        {
+                            addSegment(e[0], e[1], iso);
+                            addSegment(e[2], e[3], iso);
+                        }
+                    }
+                    else
+                    {
+                        int crossed[2], n = 0;
+                        for (int i = 0; i < 4; ++i)
+                        {
+                            if (((cs >> i) & 1) != ((cs >> ((i + 1) & 3)) & 1))
+                                crossed[n++] = e[i];
+                        }
+                        addSegment(crossed[0], crossed[1], iso);
+                    }
+                }
+            }
+
+            chain(iso, tolerance, output);
+        }
+
+        //! Location of the contour crossing on an edge, in grid units
+        osg::Vec2d crossing(int edge, float iso) const
+        {
+            int post = edge >> 1;
+            int c = post % _cols, r = post / _cols;
+            float a = _h[post];
+            float b = (edge & 1) ? _h[post + _cols] : _h[post + 1];
+            double t = ((double)iso - (double)a) / ((double)b - (double)a);
+            return (edge & 1) ?
+                osg::Vec2d((double)c, (double)r + t) :
+                osg::Vec2d((double)c + t, (double)r);
+        }
+
+    private:
+        const float* _h;
+        int _cols, _rows;
+        std::vector<int> _succ;
+        std::vector<unsigned char> _pred;
+        std::vector<unsigned char> _above0, _above1, _cases;
+        std::vector<float> _rowMin, _rowMax;
+        std::vector<std::pair<int, int>> _segments;
+
+        // The end of an edge that lies above the contour
+        osg::Vec2d aboveEnd(int edge, float iso) const
+        {
+            int post = edge >> 1;
+            int c = post % _cols, r = post / _cols;
+            if (_h[post] > iso)
+                return osg::Vec2d(c, r);
+            return (edge & 1) ? osg::Vec2d(c, r + 1) : osg::Vec2d(c + 1, r);
+        }
+
+        // Orients every segment with the high ground on its left. The
+        // orientation is then consistent across cells (and tiles), so each
+        // crossing is the end of one segment and the start of the next.
+        void addSegment(int p, int q, float iso)
+        {
+            osg::Vec2d P = crossing(p, iso), Q = crossing(q, iso);
+            double side = cross2(Q - P, aboveEnd(p, iso) - P);
+            if (side == 0.0)
+                side = cross2(Q - P, aboveEnd(q, iso) - P);
+            if (side < 0.0)
+                std::swap(p, q);
+            _segments.emplace_back(p, q);
+        }
+
+        void chain(float iso, double tolerance, std::vector<GridLine>& output)
+        {
+            for (auto& s : _segments)
+            {
+                _succ[s.first] = s.second;
+                _pred[s.second] = 1;
+            }
+
+            auto walk = [&](int start)
+            {
+                GridLine line;
+                int e = start;
+                line.head = start;
+                line.points.push_back(crossing(e, iso));
+                for (int n = _succ[e]; n >= 0; n = _succ[e])
+                {
+                    _succ[e] = -1;
+                    e = n;
+                    osg::Vec2d p = crossing(e, iso);
+                    if (p != line.points.back())
+                        line.points.push_back(p);
+                }
+                line.tail = e;
+                line.closed = (e == start);
+
+                if (line.points.size() >= (line.closed ? 4u : 2u))
+                {
+                    if (line.closed)
+                        line.points.back() = line.points.front();
+                    simplify(line.points, tolerance, line.closed);
+                    output.emplace_back(std::move(line));
+                }
+            };
+
+            // open lines start where nothing leads in (grid border or a
+            // void); anything left over after that is a closed ring.
+            for (auto& s : _segments)
+                if (_pred[s.first] == 0 && _succ[s.first] >= 0)
+                    walk(s.first);
+
+            for (auto& s : _segments)
+                if (_succ[s.first] >= 0)
+                    walk(s.first);
+
+            for (auto& s : _segments)
+                _pred[s.second] = 0;
+        }
+    };
+}
+
+struct ContourFeatureSource::TileLines
+{
+    std::vector<ContourLine> lines;
+};
+
+//........................................................................
+
+REGISTER_OSGEARTH_LAYER(contourfeatures, ContourFeatureSource);
+REGISTER_OSGEARTH_LAYER(contour_features, ContourFeatureSource);
+
+OE_LAYER_PROPERTY_IMPL(ContourFeatureSource, double, Interval, interval);
+OE_LAYER_PROPERTY_IMPL(ContourFeatureSource, double, Offset, offset);
+OE_LAYER_PROPERTY_IMPL(ContourFeatureSource, float, SimplifyTolerance, simplifyTolerance);
+OE_LAYER_PROPERTY_IMPL(ContourFeatureSource, std::string, Attribute, attribute);
+OE_LAYER_PROPERTY_IMPL(ContourFeatureSource, unsigned, MaxTilesPerQuery, maxTilesPerQuery);
+
+void
+ContourFeatureSource::init()
+{
+    super::init();
+
+    // tiles are cached in _tileCache against the elevation revision; the
+    // feature cache is keyed on the tile alone and would serve stale lines
+    if (!options().l2CacheSize().isSet())
+    {
+        options().l2CacheSize() = 0u;
+    }
+}
+
+Status
+ContourFeatureSource::openImplementation()
+{
+    if (options().interval().get() <= 0.0)
+    {
+        return Status(Status::ConfigurationError, "Contour interval must be greater than zero");
+    }
+
+    if (getFeatureProfile() == nullptr)
+    {
+        osg::ref_ptr<const Profile> profile = options().profile().isSet() ?
+            Profile::create(options().profile().get()) :
+            Profile::create(Profile::GLOBAL_GEODETIC);
+
+        if (!profile.valid())
+        {
+            return Status(Status::ConfigurationError, "Failed to create the tiling profile");
+        }
+
+        FeatureProfile* fp = new FeatureProfile(profile->getExtent());
+        fp->setFirstLevel(options().minLevel().getOrUse(0));
+        fp->setMaxLevel(options().maxLevel().getOrUse(14));
+        fp->setTilingProfile(profile.get());
+
+        if (options().geoInterp().isSet())
+        {
+            fp->geoInterp() = options().geoInterp().get();
+        }
+
+        setFeatureProfile(fp);
+    }
+
+    _schema.clear();
+    _schema[options().attribute().get()] = ATTRTYPE_DOUBLE;
+
+    return super::openImplementation();
+}
+
+void
+ContourFeatureSource::addedToMap(const Map* map)
+{
+    _pool = map->getElevationPool();
+    _tileCache.clear();
+    super::addedToMap(map);
+}
+
+void
+ContourFeatureSource::removedFromMap(const Map* map)
+{
+    super::removedFromMap(map);
+    _pool = nullptr;
+    _tileCache.clear();
+}
+
+void
+ContourFeatureSource::dirty()
+{
+    _tileCache.clear();
+    super::dirty();
+}
+
+std::shared_ptr<const ContourFeatureSource::TileLines>
+ContourFeatureSource::getTileLines(const TileKey& key, ProgressCallback* progress) const
+{
+    OE_PROFILING_ZONE;
+
+    osg::ref_ptr<ElevationPool> pool = _pool;
+    if (!pool.valid())
+        return nullptr;
+
+    // key on the elevation revision too, so lines contoured from
+    // elevation data that has since changed are not reused
+    Internal::RevElevationKey cacheKey;
+    cacheKey._tilekey = key;
+    cacheKey._revision = pool->getRevision();
+
+    Util::LRUCache<Internal::RevElevationKey, std::shared_ptr<const TileLines>>::Record record;
+    if (_tileCache.get(cacheKey, record))
+    {
+        return record.value();
+    }
+
+    osg::ref_ptr<ElevationTexture> tex;
+    if (!pool->getTile(key, false, tex, nullptr, progress) || !tex.valid())
+        return nullptr;
+
+    const osg::HeightField* hf = tex->getHeightField();
+    if (!hf || hf->getNumColumns() < 2 || hf->getNumRows() < 2 || !hf->getFloatArray())
+        return nullptr;
+
+    const int cols = (int)hf->getNumColumns();
+    const int rows = (int)hf->getNumRows();
+    const float* heights = &hf->getFloatArray()->front();
+
+    float minH = FLT_MAX, maxH = -FLT_MAX;
+    for (int i = 0; i < cols * rows; ++i)
+    {
+        if (heights[i] != NO_DATA_VALUE)
+        {
+            minH = std::min(minH, heights[i]);
+            maxH = std::max(maxH, heights[i]);
+        }
+    }
+
+    auto result = std::make_shared<TileLines>();
+
+    const double interval = options().interval().get();
+    const double offset = options().offset().get();
+
+    if (minH <= maxH)
+    {
+        const GeoExtent& ex = tex->getExtent();
+        const double dx = ex.width() / (double)(cols - 1);
+        const double dy = ex.height() / (double)(rows - 1);
+        const double tolerance = (double)options().simplifyTolerance().get();
+
+        // global post index of this tile's south-west corner, so crossings on a
+        // shared border resolve to the same key from either side
+        const long long gx0 = (long long)key.getTileX() * (long long)(cols - 1);
+        const long long gy0 = -(long long)key.getTileY() * (long long)(rows - 1);
+
+        auto edgeKey = [&](int level, int edge)
+        {
+            int post = edge >> 1;
+            return EdgeKey(level, gx0 + post % cols, gy0 + post / cols, edge & 1);
+        };
+
+        auto toMap = [&](double g, int last, double lo, double hi, double spacing)
+        {
+            return g <= 0.0 ? lo : g >= (double)last ? hi : lo + g * spacing;
+        };
+
+        Marcher marcher(heights, cols, rows);
+        std::vector<GridLine> gridLines;
+
+        int firstLevel = (int)std::ceil((minH - offset) / interval);
+        int lastLevel = (int)std::floor((maxH - offset) / interval);
+
+        for (int level = firstLevel; level <= lastLevel; ++level)
+        {
+            if (progress && progress->isCanceled())
+                return nullptr;
+
+            double elevation = offset + (double)level * interval;
+
+            gridLines.clear();
+            marcher.run((float)elevation, tolerance, gridLines);
+
+            for (auto& g : gridLines)
+            {
+                ContourLine line;
+                line.level = level;
+                line.closed = g.closed;
+                line.head = edgeKey(level, g.head);
+                line.tail = edgeKey(level, g.tail);
+                line.points.reserve(g.points.size());
+                for (auto& p : g.points)
+                {
+                    line.points.emplace_back(
+                        toMap(p.x(), cols - 1, ex.xMin(), ex.xMax(), dx),
+                        toMap(p.y(), rows - 1, ex.yMin(), ex.yMax(), dy),
+                        elevation);
+                }
+                result->lines.emplace_back(std::move(line));
+            }
+        }
+    }
+
+    _tileCache.insert(cacheKey, result);
+    return result;
+}
+
+FeatureCursor*
+ContourFeatureSource::createFeatureCursorImplementation(const Query& query, ProgressCallback* progress) const
+{
+    OE_PROFILING_ZONE;
+
+    const FeatureProfile* fp = getFeatureProfile();
+    if (!fp || !fp->getTilingProfile())
+        return nullptr;
+
+    const Profile* profile = fp->getTilingProfile();
+    const int minLevel = options().minLevel().getOrUse(fp->getFirstLevel());
+    const int maxLevel = options().maxLevel().getOrUse(fp->getMaxLevel());
+
+    std::vector<TileKey> keys;
+
+    if (query.tileKey().isSet())
+    {
+        TileKey key = query.tileKey().get();
+        if ((int)key.getLOD() < minLevel)
+            return nullptr;
+
+        if ((int)key.getLOD() > maxLevel)
+            key = key.createAncestorKey(maxLevel);
+
+        keys.push_back(key);
+    }
+    else
+    {
+        GeoExtent extent = query.bounds().isSet() ?
+            GeoExtent(fp->getSRS(), query.bounds().get()) :
+            profile->getExtent();
+
+        // finest LOD at which the query still fits in the tile budget
+        const unsigned maxTiles = std::max(1u, options().maxTilesPerQuery().get());
+        for (int lod = maxLevel; lod >= minLevel; --lod)
+        {
+            keys.clear();
+            profile->getIntersectingTiles(extent, lod, keys);
+            if (keys.size() <= maxTiles)
+                break;
+        }
+    }
+
+    if (keys.empty())
+        return nullptr;
+
+    // contour the tiles, in parallel when there are several
+    std::vector<std::shared_ptr<const TileLines>> tiles(keys.size());
+
+    jobs::parallel_for(ARENA_CONTOURS, (unsigned)keys.size(), [&](unsigned begin, unsigned end)
+        {
+            for (unsigned i = begin; i < end; ++i)
+            {
+                if (progress && progress->isCanceled())
+                    break;
+                tiles[i] = getTileLines(keys[i], progress);
+            }
+        });
+
+    if (progress && progress->isCanceled())
+        return nullptr;
+
+    std::vector<const ContourLine*> lines;
+    for (auto& tile : tiles)
+        if (tile)
+            for (auto& line : tile->lines)
+                lines.push_back(&line);
+
+    // stitch open lines end to end where they cross a shared tile edge;
+    // every line keeps the high ground on its left, so the tail of one
+    // line is the head of its continuation.
+    std::vector<int> succ(lines.size(), -1);
+    std::vector<char> hasPred(lines.size(), 0), used(lines.size(), 0);
+
+    if (keys.size() > 1u)
+    {
+        std::map<EdgeKey, int> heads;
+        for (unsigned i = 0; i < lines.size(); ++i)
+            if (!lines[i]->closed)
+                heads[lines[i]->head] = (int)i;
+
+        for (unsigned i = 0; i < lines.size(); ++i)
+        {
+            if (lines[i]->closed)
+                continue;
+            auto iter = heads.find(lines[i]->tail);
+            if (iter != heads.end() && iter->second != (int)i)
+            {
+                succ[i] = iter->second;
+                hasPred[iter->second] = 1;
+            }
+        }
+    }
+
+    const SpatialReference* srs = fp->getSRS();
+    const std::string& attribute = options().attribute().get();
+    const double interval = options().interval().get();
+    const double offset = options().offset().get();
+
+    FeatureList features;
+
+    auto emit = [&](int start)
+    {
+        LineString* geom = new LineString(&lines[start]->points);
+        used[start] = 1;
+
+        int i = succ[start];
+        for (; i >= 0 && !used[i]; i = succ[i])
+        {
+            used[i] = 1;
+            geom->insert(geom->end(), lines[i]->points.begin() + 1, lines[i]->points.end());
+        }
+        if (i == start)
+            geom->back() = geom->front();
+
+        Feature* feature = new Feature(geom, srs);
+        feature->set(attribute, offset + (double)lines[start]->level * interval);
+        features.push_back(feature);
+    };
+
+    for (unsigned i = 0; i < lines.size(); ++i)
+        if (!used[i] && (lines[i]->closed || !hasPred[i]))
+            emit((int)i);
+
+    // rings that span more than one tile
+    for (unsigned i = 0; i < lines.size(); ++i)
+        if (!used[i])
+            emit((int)i);
+
+    if (features.empty())
+        return nullptr;
+
+    return new FeatureListCursor(std::move(features));
+}
@@ -172,6 +172,12 @@ ElevationLayer::normalizeNoDataValues(osg::HeightField* hf) const
     }
 }
 
+std::string
+ElevationLayer::getTileCacheKey(const TileKey& key) const
+{
+    return Cache::makeCacheKey(key.str() + "-" + key.getProfile()->getHorizSignature(), "elevation");
+}
+
 void
 ElevationLayer::applyProfileOverrides(osg::ref_ptr<const Profile>& inOutProfile) const
 {
@@ -403,7 +409,7 @@ ElevationLayer::createHeightFieldInKeyProfile(const TileKey& key, ProgressCallba
 
     // cache key combines the key with the full signature (incl vdatum)
     // the cache key combines the Key and the horizontal profile.
-    auto cacheKey = Cache::makeCacheKey(key.str() + "-" + key.getProfile()->getHorizSignature(), "elevation");
+    auto cacheKey = getTileCacheKey(key);
     std::string memCacheKey;
 
     // see if there's a persistent cache.
@@ -221,6 +221,19 @@ ElevationPool::getLOD(double x, double y, WorkingSet* ws)
     return maxiestMaxLevel;
 }
 
+std::size_t
+ElevationPool::getRevision()
+{
+    osg::ref_ptr<const Map> map;
+    if (_map.lock(map))
+    {
+        sync(map.get(), nullptr);
+    }
+
+    ScopedReadLock lk(_mutex);
+    return getElevationHash(nullptr);
+}
+
 bool
 ElevationPool::needsRefresh()
 {
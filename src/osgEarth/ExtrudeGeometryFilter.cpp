@@ -10,15 +10,23 @@
 #include <osgEarth/Utils>
 #include <osgEarth/Tessellator>
 #include <osgEarth/LineDrawable>
+#include <osgEarth/Threading>
+#include <osgEarth/CompiledExpression>
 
 #include <osg/Geode>
 #include <osg/Geometry>
 #include <osgUtil/Tessellator>
 #include <osg/PolygonOffset>
 #include <osg/LineWidth>
+#include <osg/TriangleIndexFunctor>
 
 #define LC "[ExtrudeGeometryFilter] "
 
+#define ARENA_TESSELLATE "oe.tessellate"
+
+// fewest roofs worth handing to a tessellation thread
+#define MIN_ROOFS_PER_THREAD 8u
+
 using namespace osgEarth;
 
 namespace
@@ -52,6 +60,22 @@ namespace
     double sign_of(double a)     {
         return a < 0.0 ? -1.0 : 1.0;
     }
+
+    // Collects triangle indices that refer to the first _numVerts verts.
+    struct CollectRoofTriangles
+    {
+        unsigned _numVerts = 0u;
+        std::vector<uint32_t>* _indices = nullptr;
+        void operator()(unsigned a, unsigned b, unsigned c)
+        {
+            if (a < _numVerts && b < _numVerts && c < _numVerts)
+            {
+                _indices->push_back(a);
+                _indices->push_back(b);
+                _indices->push_back(c);
+            }
+        }
+    };
 }
 
 #define AS_VEC4(V3, X) osg::Vec4f( (V3).x(), (V3).y(), (V3).z(), X )
@@ -788,12 +812,62 @@ ExtrudeGeometryFilter::buildWallGeometry(
     return madeGeom;
 }
 
+bool
+ExtrudeGeometryFilter::tessellateRoof(const Structure&       structure,
+                                      std::vector<uint32_t>& out_indices) const
+{
+    osg::ref_ptr< osg::Geometry > tempGeom = new osg::Geometry;
+    osg::Vec3Array* tempVerts = new osg::Vec3Array;
+    tempGeom->setVertexArray(tempVerts);
+
+    // Create a series of line loops that the tessellator can reorganize
+    // into polygons.
+    for(auto& elev : structure.elevations)
+    {
+        unsigned elevptr = tempVerts->size();
+
+        for(auto& face : elev.faces)
+        {
+            // Same source-vert filter as buildRoofGeometry.
+            if ( face.left.isFromSource )
+            {
+                tempVerts->push_back(face.left.roof);
+            }
+        }
+        tempGeom->addPrimitiveSet( new osg::DrawArrays(GL_LINE_LOOP, elevptr, tempVerts->size()-elevptr) );
+    }
+
+    const unsigned numVerts = tempVerts->size();
+    osg::Geometry::PrimitiveSetList outlines = tempGeom->getPrimitiveSetList();
+
+    // Tessellate the roof lines into polygons.
+    Tessellator oeTess(_extrusionSymbol->tessellation().value());
+    if (!oeTess.tessellateGeometry(*tempGeom) && oeTess.getTechnique() != Tessellator::TECHNIQUE_GLU)
+    {
+        // fallback to osg tessellator
+        tempGeom->setPrimitiveSetList(outlines);
+        Tessellator glu(Tessellator::TECHNIQUE_GLU);
+        glu.tessellateGeometry(*tempGeom);
+    }
+
+    // Collect the triangles regardless of the primitive types the tessellator
+    // produced. Skip any that use vertices GLU inserted at self-intersections,
+    // since those do not exist in the roof.
+    osg::TriangleIndexFunctor<CollectRoofTriangles> collect;
+    collect._numVerts = numVerts;
+    collect._indices = &out_indices;
+    tempGeom->accept(collect);
+
+    return !out_indices.empty();
+}
+
 bool
 ExtrudeGeometryFilter::buildRoofGeometry(const Structure&     structure,
                                          Feature* feature,
                                          osg::Geometry*       roof,                                         
                                          const osg::Vec4&     roofColor,
                                          const SkinResource*  roofSkin,
+                                         const std::vector<uint32_t>& roofIndices,
                                          FeatureIndexBuilder* index)
 {    
     osg::Vec3Array* verts = static_cast<osg::Vec3Array*>(roof->getVertexArray());
@@ -858,19 +932,13 @@ ExtrudeGeometryFilter::buildRoofGeometry(const Structure&     structure,
         _style.get<ExtrusionSymbol>()->flatten() == true;
 
 
-    osg::ref_ptr< osg::Geometry > tempGeom = new osg::Geometry;
-    osg::Vec3Array* tempVerts = new osg::Vec3Array;
-    tempGeom->setVertexArray(tempVerts);
-
-    // Create a series of line loops that the tessellator can reorganize
-    // into polygons.
-    unsigned int vertptr = 0;// verts->size();
+    // Add the roof line verts. The roof indices were computed from
+    // the same source verts, in the same order, by tessellateRoof.
+    unsigned int vertptr = 0;
     unsigned int startVertPtr = verts->size();
 
     for(auto& elev : structure.elevations)
     {
-        unsigned elevptr = vertptr;
-
         for(auto& face : elev.faces)
         {
             // Only use source verts; we skip interim verts inserted by the 
@@ -879,7 +947,6 @@ ExtrudeGeometryFilter::buildRoofGeometry(const Structure&     structure,
             if ( face.left.isFromSource )
             {
                 verts->push_back(face.left.roof);
-                tempVerts->push_back(face.left.roof);
                 color->push_back( roofColor );
                 normal->push_back(osg::Vec3(0, 0, 1));
 
@@ -907,20 +974,8 @@ ExtrudeGeometryFilter::buildRoofGeometry(const Structure&     structure,
                 ++vertptr;
             }
         }
-        tempGeom->addPrimitiveSet( new osg::DrawArrays(GL_LINE_LOOP, elevptr, vertptr-elevptr) );
     } 
 
-    // Tessellate the roof lines into polygons.
-    osgEarth::Tessellator oeTess;
-    if (!oeTess.tessellateGeometry(*tempGeom))
-    {
-        // fallback to osg tessellator
-        osgUtil::Tessellator tess;
-        tess.setTessellationType( osgUtil::Tessellator::TESS_TYPE_GEOMETRY );
-        tess.setWindingType( osgUtil::Tessellator::TESS_WINDING_ODD );
-        tess.retessellatePolygons( *tempGeom);
-    }
-
     // Get or create the primitive set
     osg::DrawElementsUInt* de = nullptr;
     if (roof->getNumPrimitiveSets() == 0)
@@ -935,18 +990,12 @@ ExtrudeGeometryFilter::buildRoofGeometry(const Structure&     structure,
 
     auto deptr = de->size();
 
-    // Add the tesselated polygon to the main DrawElements, offseting the indices since the tesselation is going to 
-    // return values based a zero index.  This might be something we need to address later.
-    for (unsigned int i = 0; i < tempGeom->getNumPrimitiveSets(); ++i)
+    // Add the tessellated polygon to the main DrawElements, offsetting the
+    // indices since the tessellation is zero-based.
+    de->reserveElements(de->size() + roofIndices.size());
+    for (auto i : roofIndices)
     {
-        osg::DrawElementsUInt* p = static_cast<osg::DrawElementsUInt*>(tempGeom->getPrimitiveSet(i));
-        if (p)
-        {
-            for (unsigned int j = 0; j < p->size(); ++j)
-            {
-                de->addElement(p->at(j) + startVertPtr);
-            }
-        }        
+        de->addElement(i + startVertPtr);
     }
 
     // inverted? flip the triangles and the normals.
@@ -1147,6 +1196,27 @@ ExtrudeGeometryFilter::addDrawable(osg::Drawable*       drawable,
 bool
 ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
 {
+    // Roofs waiting for tessellation.
+    struct PendingRoof
+    {
+        Structure structure;
+        osg::ref_ptr<osg::Geometry> roof;
+        osg::ref_ptr<Feature> feature;
+        osg::Vec4f color;
+        osg::ref_ptr<SkinResource> skin;
+        std::vector<uint32_t> indices;
+    };
+    std::vector<PendingRoof> roofs;
+
+    // compile the per-feature expressions once for the whole batch.
+    CompiledNumericExpression heightExpr;
+    if (_heightExpr.isSet())
+        heightExpr = CompiledNumericExpression(_heightExpr.get());
+
+    CompiledStringExpression featureNameExpr;
+    if (!_featureNameExpr.empty())
+        featureNameExpr = CompiledStringExpression(_featureNameExpr);
+
     for( FeatureList::iterator f = features.begin(); f != features.end(); ++f )
     {
         Feature* input = f->get();
@@ -1188,7 +1258,7 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
             }
             else if (_heightExpr.isSet())
             {
-                height = input->eval(_heightExpr.mutable_value(), &context);
+                height = heightExpr.eval(input, &context);
             }
             else
             {
@@ -1198,7 +1268,7 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
             // Set up for feature naming and feature indexing:
             std::string name;
             if (!_featureNameExpr.empty())
-                name = input->eval(_featureNameExpr, &context);
+                name = featureNameExpr.eval(input, &context);
 
             osg::ref_ptr<osg::StateSet> wallStateSet;
             osg::ref_ptr<osg::StateSet> roofStateSet;
@@ -1372,7 +1442,7 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
                 buildWallGeometry(structure, input, walls.get(), wallColor, wallBaseColor, wallSkin, shadeMin, context.featureIndex());
             }
 
-            // tessellate and add the roofs if necessary:
+            // queue the roof for tessellation if necessary:
             if ( rooflines.valid() )
             {
                 osg::Vec4f roofColor(1,1,1,1);
@@ -1380,7 +1450,14 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
                 {
                     roofColor = _roofPolygonSymbol->fill()->color();
                 }
-                buildRoofGeometry(structure, input, rooflines.get(), roofColor, roofSkin, context.featureIndex());                
+                // defer the roof so all roofs can be tessellated in parallel
+                PendingRoof roof;
+                roof.structure = structure;
+                roof.roof = rooflines;
+                roof.feature = input;
+                roof.color = roofColor;
+                roof.skin = roofSkin;
+                roofs.emplace_back(std::move(roof));
             }
 
             if (_outlineSymbol.valid())
@@ -1399,6 +1476,21 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
         }
     }
 
+    // Tessellate the roofs. Each roof only reads its own structure,
+    // so this runs in parallel across features.
+    jobs::parallel_for(ARENA_TESSELLATE, (unsigned)roofs.size(), [&](unsigned begin, unsigned end)
+        {
+            for (unsigned i = begin; i < end; ++i)
+                tessellateRoof(roofs[i].structure, roofs[i].indices);
+        },
+        MIN_ROOFS_PER_THREAD);
+
+    // Append the roofs in feature order.
+    for (auto& roof : roofs)
+    {
+        buildRoofGeometry(roof.structure, roof.feature.get(), roof.roof.get(), roof.color, roof.skin.get(), roof.indices, context.featureIndex());
+    }
+
     return true;
 }
 
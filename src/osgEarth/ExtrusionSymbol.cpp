@@ -22,6 +22,7 @@ ExtrusionSymbol::ExtrusionSymbol(const ExtrusionSymbol& rhs, const osg::CopyOp&
     _wallSkinName = rhs._wallSkinName;
     _roofSkinName = rhs._roofSkinName;
     _direction = rhs._direction;
+    _tessellation = rhs._tessellation;
 }
 
 ExtrusionSymbol::ExtrusionSymbol(const Config& conf) :
@@ -47,6 +48,9 @@ ExtrusionSymbol::getConfig() const
     conf.set("roof_skin", _roofSkinName);
     conf.set("direction", "up", direction(), DIRECTION_UP);
     conf.set("direction", "down", direction(), DIRECTION_DOWN);
+    conf.set("tessellation", "earcut", tessellation(), Util::Tessellator::TECHNIQUE_EARCUT);
+    conf.set("tessellation", "earclip", tessellation(), Util::Tessellator::TECHNIQUE_EARCLIP);
+    conf.set("tessellation", "glu", tessellation(), Util::Tessellator::TECHNIQUE_GLU);
     return conf;
 }
 
@@ -64,6 +68,9 @@ ExtrusionSymbol::mergeConfig(const Config& conf)
     conf.get("roof_skin", _roofSkinName);
     conf.get("direction", "up", direction(), DIRECTION_UP);
     conf.get("direction", "down", direction(), DIRECTION_DOWN);
+    conf.get("tessellation", "earcut", tessellation(), Util::Tessellator::TECHNIQUE_EARCUT);
+    conf.get("tessellation", "earclip", tessellation(), Util::Tessellator::TECHNIQUE_EARCLIP);
+    conf.get("tessellation", "glu", tessellation(), Util::Tessellator::TECHNIQUE_GLU);
 }
 
 void
@@ -107,4 +114,12 @@ ExtrusionSymbol::parseSLD(const Config& c, Style& style)
         else if (ci_equals(c.value(), "down"))
             style.getOrCreate<ExtrusionSymbol>()->direction() = ExtrusionSymbol::DIRECTION_DOWN;
     }
+    else if (match(c.key(), "extrusion-tessellation")) {
+        if (ci_equals(c.value(), "earcut"))
+            style.getOrCreate<ExtrusionSymbol>()->tessellation() = Util::Tessellator::TECHNIQUE_EARCUT;
+        else if (ci_equals(c.value(), "earclip"))
+            style.getOrCreate<ExtrusionSymbol>()->tessellation() = Util::Tessellator::TECHNIQUE_EARCLIP;
+        else if (ci_equals(c.value(), "glu"))
+            style.getOrCreate<ExtrusionSymbol>()->tessellation() = Util::Tessellator::TECHNIQUE_GLU;
+    }
 }
@@ -9,11 +9,15 @@
 #include <osgEarth/Progress>
 #include <osgEarth/LandCover>
 #include <osgEarth/FeatureStyleSorter>
+#include <osgEarth/Threading>
+#include <unordered_set>
 
 using namespace osgEarth;
 
 #define LC "[FeatureImageLayer] " << getName() << ": "
 
+#define ARENA_FEATURE_IMAGE "oe.featureimage"
+
 
 REGISTER_OSGEARTH_LAYER(featureimage, FeatureImageLayer);
 REGISTER_OSGEARTH_LAYER(feature_image, FeatureImageLayer);
@@ -30,6 +34,7 @@ FeatureImageLayer::Options::getConfig() const
     conf.set("gamma", gamma());
     conf.set("sdf", sdf());
     conf.set("sdf_invert", sdf_invert());
+    conf.set("batch_tiles", batchTiles());
 
     if (filters().empty() == false)
     {
@@ -48,6 +53,7 @@ FeatureImageLayer::Options::fromConfig(const Config& conf)
     gamma().setDefault(1.3);
     sdf().setDefault(false);
     sdf_invert().setDefault(false);
+    batchTiles().setDefault(false);
 
     featureSource().get(conf, "features");
     styleSheet().get(conf, "styles");
@@ -55,6 +61,7 @@ FeatureImageLayer::Options::fromConfig(const Config& conf)
     conf.get("gamma", gamma());
     conf.get("sdf", sdf());
     conf.get("sdf_invert", sdf_invert());
+    conf.get("batch_tiles", batchTiles());
 
     const Config& filtersConf = conf.child("filters");
     for (ConfigSet::const_iterator i = filtersConf.children().begin(); i != filtersConf.children().end(); ++i)
@@ -331,3 +338,93 @@ FeatureImageLayer::createImageImplementation(const TileKey& key, ProgressCallbac
 
     return result;
 }
+
+std::vector<GeoImage>
+FeatureImageLayer::createImagesImplementation(const std::vector<TileKey>& keys, ProgressCallback* progress) const
+{
+    if (options().batchTiles() == false || keys.size() < 2 || getStatus().isError())
+    {
+        return ImageLayer::createImagesImplementation(keys, progress);
+    }
+
+    // take local refs to prevent threading issues.
+    Isolate local(_global);
+
+    if (!local._session.valid() || !local._session->getFeatureSource())
+    {
+        return ImageLayer::createImagesImplementation(keys, progress);
+    }
+
+    // Coverage rendering alters the features it draws, so they cannot
+    // be shared among tiles.
+    if (local._session->styles())
+    {
+        for (auto& style : local._session->styles()->getStyles())
+        {
+            if (style.second.getSymbol<CoverageSymbol>())
+            {
+                return ImageLayer::createImagesImplementation(keys, progress);
+            }
+        }
+    }
+
+    std::vector<std::vector<FeatureStyleSorter::Bucket>> buckets;
+
+    FeatureStyleSorter sorter;
+
+    if (!sorter.sort(
+        keys,
+        options().bufferWidth().value(),
+        local._session.get(),
+        local._filterChain,
+        buckets,
+        progress))
+    {
+        return ImageLayer::createImagesImplementation(keys, progress);
+    }
+
+    std::vector<GeoImage> results(keys.size(), GeoImage::INVALID);
+
+    if (progress && progress->isCanceled())
+    {
+        return results;
+    }
+
+    // Tiles share features, so transform them all up front rather than
+    // letting each tile's rasterizer transform them in place.
+    const SpatialReference* srs = keys.front().getExtent().getSRS();
+    std::unordered_set<Feature*> transformed;
+    for (auto& key_buckets : buckets)
+    {
+        for (auto& bucket : key_buckets)
+        {
+            for (auto& feature : bucket.features)
+            {
+                if (transformed.insert(feature.get()).second &&
+                    feature->getSRS() &&
+                    !feature->getSRS()->isHorizEquivalentTo(srs))
+                {
+                    feature->transform(srs);
+                }
+            }
+        }
+    }
+
+    jobs::parallel_for(ARENA_FEATURE_IMAGE, (unsigned)keys.size(), [&](unsigned begin, unsigned end)
+        {
+            for (unsigned i = begin; i < end; ++i)
+            {
+                FeatureRasterizer rasterizer(getTileSize(), getTileSize(), keys[i].getExtent());
+                FilterContext context(local._session.get(), keys[i].getExtent());
+
+                for (auto& bucket : buckets[i])
+                {
+                    rasterizer.render(bucket.features, bucket.style, context);
+                }
+
+                results[i] = rasterizer.finalize();
+            }
+        });
+
+    return results;
+}
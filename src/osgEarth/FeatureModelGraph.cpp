@@ -8,6 +8,7 @@
 #include <osgEarth/CropFilter>
 #include <osgEarth/FeatureSourceIndexNode>
 #include <osgEarth/FilterContext>
+#include <osgEarth/CompiledExpression>
 
 #include <osgEarth/CullingUtils>
 #include <osgEarth/ElevationLOD>
@@ -1626,6 +1627,9 @@ FeatureModelGraph::createOrUpdateNode(FeatureCursor*           cursor,
                 _texturesCache, _texturesCacheMutex));
 
         osg::ref_ptr<ChonkDrawable> drawable = new ChonkDrawable();
+
+        if (_session->getMapSRS() && _session->getMapSRS()->isGeographic())
+            drawable->setEllipsoid(_session->getMapSRS()->getEllipsoid());
         
         if (xform)
         {
@@ -1731,26 +1735,33 @@ FeatureModelGraph::queryAndSortIntoStyleGroups(
     if (!cursor.valid())
         return;
 
-    StringExpression styleExprCopy(styleExpr);
-
-    // visit each feature and run the expression to sort it into a bin.
-    vector_map<std::string, FeatureList> styleBins;
+    // read the features, then run the expression over all of them at once
+    // so a scripted selector goes through the script engine in one batch.
+    FeatureList features;
     while (cursor->hasMore())
     {
         osg::ref_ptr<Feature> feature = cursor->nextFeature();
         if (feature.valid())
-        {
-            const std::string& styleString = feature->eval(styleExprCopy, &context);
-            if (!styleString.empty() && styleString != "null")
-            {
-                styleBins[styleString].push_back(feature.get());
-            }
-        }
+            features.emplace_back(feature);
 
         if (progress && progress->isCanceled())
             return;
     }
 
+    std::vector<std::string> styleStrings;
+    CompiledStringExpression(styleExpr).eval(features, styleStrings, &context);
+
+    // sort each feature into a bin.
+    vector_map<std::string, FeatureList> styleBins;
+    for (unsigned i = 0; i < features.size(); ++i)
+    {
+        const std::string& styleString = styleStrings[i];
+        if (!styleString.empty() && styleString != "null")
+        {
+            styleBins[styleString].push_back(features[i]);
+        }
+    }
+
     // next create a style group per bin.
     for(auto& i : styleBins)
     {
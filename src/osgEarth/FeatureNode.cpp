@@ -313,34 +313,37 @@ FeatureNode::onTileUpdate(const TileKey&          key,
                          osg::Node*              graph,
                          TerrainCallbackContext& context)
 {
-    if (!_clampDirty)
+    bool needsClamp;
+
+    if (key.valid())
+    {
+        osg::Polytope tope;
+        key.getExtent().createPolytope(tope);
+        needsClamp = tope.contains(this->getBound());
+    }
+    else
     {
-        bool needsClamp;
+        // without a valid tilekey we don't know the extent of the change,
+        // so clamping is required.
+        needsClamp = true;
+    }
 
-        if (key.valid())
-        {
-            osg::Polytope tope;
-            key.getExtent().createPolytope(tope);
-            needsClamp = tope.contains(this->getBound());
-        }
-        else
-        {
-            // without a valid tilekey we don't know the extent of the change,
-            // so clamping is required.
-            needsClamp = true;
-        }
+    if (needsClamp)
+    {
+        // queue the tile; the update traversal reclamps just the
+        // vertices it covers
+        _dirtyTiles.push(key, graph);
 
-        if (needsClamp)
+        if (!_clampDirty)
         {
             _clampDirty = true;
             ADJUST_UPDATE_TRAV_COUNT(this, +1);
-            //clamp(graph, context.getTerrain());
         }
     }
 }
 
 void
-FeatureNode::clamp(osg::Node* graph, const Terrain* terrain)
+FeatureNode::clamp(osg::Node* graph, const Terrain* terrain, const TileKey& key)
 {
     if ( terrain && graph )
     {
@@ -352,7 +355,10 @@ FeatureNode::clamp(osg::Node* graph, const Terrain* terrain)
         float offset = alt ? alt->verticalOffset()->eval() : 0.0f;
 
         GeometryClamper clamper(_clamperData);
-        clamper.setTerrainPatch( graph );
+        if (key.valid())
+            clamper.setTerrainTile( key, graph );
+        else
+            clamper.setTerrainPatch( graph );
         clamper.setTerrainSRS( terrain->getSRS() );
         clamper.setUseVertexZ( relative );
         clamper.setOffset( offset );
@@ -370,10 +376,26 @@ FeatureNode::traverse(osg::NodeVisitor& nv)
         {
             osg::ref_ptr<Terrain> terrain = getMapNode()->getTerrain();
             if (terrain.valid())
-                clamp(terrain->getGraph(), terrain.get());
+            {
+                // reclamp as many queued tiles as this frame's budget allows
+                _dirtyTiles.drain(nv.getFrameStamp(), [&](const TileKey& key, osg::Node* tile)
+                    {
+                        if (key.valid())
+                            clamp(tile, terrain.get(), key);
+                        else
+                            clamp(terrain->getGraph(), terrain.get());
+                    });
+            }
+            else
+            {
+                _dirtyTiles.clear();
+            }
 
-            ADJUST_UPDATE_TRAV_COUNT(this, -1);
-            _clampDirty = false;
+            if (_dirtyTiles.empty())
+            {
+                ADJUST_UPDATE_TRAV_COUNT(this, -1);
+                _clampDirty = false;
+            }
         }
     }
     AnnotationNode::traverse(nv);
@@ -9,6 +9,7 @@
 #include <osgEarth/BuildConfig>
 
 using namespace osgEarth;
+using namespace osgEarth::Util;
 
 #define LC "[FeatureRasterizer] : "
 
@@ -20,7 +21,7 @@ using namespace osgEarth;
 #include <blend2d.h>
 #endif
 
-#include <osgEarth/AGG.h>
+#include <osgEarth/ScanlineRasterizer>
 #include <osgEarth/BufferFilter>
 #include <osgEarth/ResampleFilter>
 
@@ -35,120 +36,36 @@ namespace osgEarth {
             double xf, yf;
         };
 
-        struct float32
-        {
-            float32() : value(NO_DATA_VALUE) { }
-            float32(float v) : value(v) { }
-            float value;
-        };
-
-        struct span_coverage32
-        {
-            static void render(unsigned char* ptr,
-                int x,
-                unsigned count,
-                const unsigned char* covers,
-                const float32& c)
-            {
-                unsigned char* p = ptr + (x << 2);
-                float* f = (float*)p;
-                do
-                {
-                    unsigned char cover = *covers++;
-                    if (cover > 0)
-                        *f = c.value;
-                    f++;
-                } while (--count);
-            }
-
-            static void hline(unsigned char* ptr,
-                int x,
-                unsigned count,
-                const float32& c)
-            {
-                unsigned char* p = ptr + (x << 2);
-                float* f = (float*)p;
-                do {
-                    *f++ = c.value;
-                } while (--count);
-            }
-
-            static float32 get(unsigned char* ptr, int x)
-            {
-                unsigned char* p = ptr + (x << 2);
-                float* f = (float*)p;
-                return float32(*f);
-            }
-        };
-
         // rasterizes a geometry to color
-        void rasterize_agglite(
+        void rasterize_scanline(
             const Geometry* geometry,
             const osg::Vec4& color,
             RenderFrame& frame,
-            agg::rasterizer& ras,
-            agg::rendering_buffer& buffer)
+            ScanlineRasterizer& ras,
+            osg::Image* image)
         {
-            unsigned a = (unsigned)(127.0f + (color.a()*255.0f) / 2.0f); // scale alpha up
-
-            agg::rgba8 fgColor = agg::rgba8(
-                (unsigned)(color.r()*255.0f),
-                (unsigned)(color.g()*255.0f),
-                (unsigned)(color.b()*255.0f),
-                a);
-
-            ConstGeometryIterator gi(geometry);
-            while (gi.hasMore())
-            {
-                const Geometry* g = gi.next();
-
-                for (Geometry::const_iterator p = g->begin(); p != g->end(); p++)
-                {
-                    const osg::Vec3d& p0 = *p;
-                    double x0 = frame.xf*(p0.x() - frame.xmin);
-                    double y0 = frame.yf*(p0.y() - frame.ymin);
-
-                    if (p == g->begin())
-                        ras.move_to_d(x0, y0);
-                    else
-                        ras.line_to_d(x0, y0);
-                }
-            }
-            agg::renderer<agg::span_abgr32, agg::rgba8> ren(buffer);
-            ras.render(ren, fgColor);
+            osg::Vec4f fgColor = color;
+            fgColor.a() = (127.0f + (color.a()*255.0f) / 2.0f) / 255.0f; // scale alpha up
 
             ras.reset();
+            ras.addGeometry(geometry, frame.xmin, frame.ymin, frame.xf, frame.yf);
+            ras.renderRGBA(image->data(), image->getRowStepInBytes(), fgColor);
         }
 
-
-        void rasterizeCoverage_agglite(
+        // rasterizes a geometry to a coverage value
+        void rasterizeCoverage_scanline(
             const Geometry* geometry,
             float value,
             RenderFrame& frame,
-            agg::rasterizer& ras,
-            agg::rendering_buffer& buffer)
+            ScanlineRasterizer& ras,
+            osg::Image* image)
         {
-            ConstGeometryIterator gi(geometry);
-            while (gi.hasMore())
-            {
-                const Geometry* g = gi.next();
-
-                for (Geometry::const_iterator p = g->begin(); p != g->end(); p++)
-                {
-                    const osg::Vec3d& p0 = *p;
-                    double x0 = frame.xf*(p0.x() - frame.xmin);
-                    double y0 = frame.yf*(p0.y() - frame.ymin);
-
-                    if (p == g->begin())
-                        ras.move_to_d(x0, y0);
-                    else
-                        ras.line_to_d(x0, y0);
-                }
-            }
-
-            agg::renderer<span_coverage32, float32> ren(buffer);
-            ras.render(ren, value);
             ras.reset();
+            ras.addGeometry(geometry, frame.xmin, frame.ymin, frame.xf, frame.yf);
+
+            // like the old 8-bit rasterizer, claim every pixel the geometry
+            // touches by more than a sliver:
+            ras.renderValue((float*)image->data(), image->getRowStepInBytes() / sizeof(float), value, 2.0f / 256.0f);
         }
 
 #ifdef USE_BLEND2D
@@ -674,8 +591,8 @@ FeatureRasterizer::FeatureRasterizer(
     _implPixelFormat = RF_BGRA;
     _inverted = true;
 #else
-    osg::Vec4 bg(backgroundColor.a(), backgroundColor.b(), backgroundColor.g(), backgroundColor.r());
-    _implPixelFormat = RF_ABGR;
+    osg::Vec4 bg(backgroundColor.r(), backgroundColor.g(), backgroundColor.b(), backgroundColor.a());
+    _implPixelFormat = RF_RGBA;
     _inverted = false;
 #endif
 
@@ -924,7 +841,7 @@ FeatureRasterizer::render_blend2d(
 }
 
 void
-FeatureRasterizer::render_agglite(
+FeatureRasterizer::render_scanline(
     const FeatureList& features,
     const Style& style,
     FilterContext& context)
@@ -932,8 +849,8 @@ FeatureRasterizer::render_agglite(
     auto* featureProfile = context.featureProfile();
     auto* sheet = context.getSession() ? context.getSession()->styles() : nullptr;
 
-    // agglite renders in this format:
-    _implPixelFormat = RF_ABGR;
+    // the scanline rasterizer renders in this format:
+    _implPixelFormat = RF_RGBA;
     _inverted = false;
 
     // find the symbology:
@@ -1119,15 +1036,9 @@ FeatureRasterizer::render_agglite(
     for (auto& line : lines)
         line->transform(_extent.getSRS());
 
-    // set up the AGG renderer:
-    agg::rendering_buffer rbuf(
-        _image->data(),
-        _image->s(), _image->t(),
-        _image->s() * 4);
-
-    // Create the renderer and the rasterizer
-    agg::rasterizer ras;
-    ras.filling_rule(agg::fill_even_odd);
+    // Create the rasterizer
+    ScanlineRasterizer ras(_image->s(), _image->t());
+    ras.setFillRule(ScanlineRasterizer::FILL_EVEN_ODD);
 
     // construct an extent for cropping the geometry to our tile.
     // extend just outside the actual extents so we don't get edge artifacts:
@@ -1178,7 +1089,7 @@ FeatureRasterizer::render_agglite(
             if (covValue.isSet())
             {
                 float value = feature->eval(covValue.mutable_value(), &context);
-                rasterizeCoverage_agglite(cropped.get(), value, frame, ras, rbuf);
+                rasterizeCoverage_scanline(cropped.get(), value, frame, ras, _image.get());
             }
             else
             {
@@ -1187,7 +1098,7 @@ FeatureRasterizer::render_agglite(
                     globalPolySymbol;
 
                 Color color = poly ? poly->fill()->color() : Color::White;
-                rasterize_agglite(cropped.get(), color, frame, ras, rbuf);
+                rasterize_scanline(cropped.get(), color, frame, ras, _image.get());
             }
         }
     }
@@ -1202,7 +1113,7 @@ FeatureRasterizer::render_agglite(
             if (covValue.isSet())
             {
                 float value = feature->eval(covValue.mutable_value(), &context);
-                rasterizeCoverage_agglite(cropped.get(), value, frame, ras, rbuf);
+                rasterizeCoverage_scanline(cropped.get(), value, frame, ras, _image.get());
             }
             else
             {
@@ -1211,7 +1122,7 @@ FeatureRasterizer::render_agglite(
                     globalLineSymbol;
 
                 osg::Vec4f color = line ? static_cast<osg::Vec4>(line->stroke()->color()) : osg::Vec4(1, 1, 1, 1);
-                rasterize_agglite(cropped.get(), color, frame, ras, rbuf);
+                rasterize_scanline(cropped.get(), color, frame, ras, _image.get());
             }
         }
     }
@@ -1241,11 +1152,11 @@ FeatureRasterizer::render(
 
 #ifdef USE_BLEND2D
     if (style.get<CoverageSymbol>())
-        render_agglite(features, style, context);
+        render_scanline(features, style, context);
     else
         render_blend2d(features, style, context);
 #else
-    render_agglite(features, style, context);
+    render_scanline(features, style, context);
 #endif
 }
 
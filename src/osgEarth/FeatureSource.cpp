@@ -588,6 +588,7 @@ TiledFeatureSource::Options::getConfig() const
     conf.set("min_level", minLevel());
     conf.set("max_level", maxLevel());
     conf.set("layers", layers());
+    conf.set("attributes", attributes());
     patch().set(conf, "patch");
     return conf;
 }
@@ -598,6 +599,7 @@ TiledFeatureSource::Options::fromConfig(const Config& conf)
     conf.get("min_level", minLevel());
     conf.get("max_level", maxLevel());
     conf.get("layers", layers());
+    conf.get("attributes", attributes());
     patch().get(conf, "patch");
 }
 
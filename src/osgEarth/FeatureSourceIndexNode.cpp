@@ -89,7 +89,11 @@ FeatureSourceIndexNode::tagDrawable(osg::Drawable* drawable, Feature* feature)
 {
     if ( !feature || !_index.valid() ) return OSGEARTH_OBJECTID_EMPTY;
     RefIDPair* r = _index->tagDrawable( drawable, feature );
-    if ( r ) _fids[ feature->getFID() ] = r;
+    if ( r )
+    {
+        std::lock_guard<std::mutex> lock(_fidsMutex);
+        _fids[ feature->getFID() ] = r;
+    }
     return r ? r->_oid : OSGEARTH_OBJECTID_EMPTY;
 }
 
@@ -98,7 +102,11 @@ FeatureSourceIndexNode::tagAllDrawables(osg::Node* node, Feature* feature)
 {
     if ( !feature || !_index.valid() ) return OSGEARTH_OBJECTID_EMPTY;
     RefIDPair* r = _index->tagAllDrawables( node, feature );
-    if ( r ) _fids[ feature->getFID() ] = r;
+    if ( r )
+    {
+        std::lock_guard<std::mutex> lock(_fidsMutex);
+        _fids[ feature->getFID() ] = r;
+    }
     return r ? r->_oid : OSGEARTH_OBJECTID_EMPTY;
 }
 
@@ -107,7 +115,11 @@ FeatureSourceIndexNode::tagNode(osg::Node* node, Feature* feature)
 {
     if ( !feature || !_index.valid() ) return OSGEARTH_OBJECTID_EMPTY;
     RefIDPair* r = _index->tagNode( node, feature );
-    if ( r ) _fids[ feature->getFID() ] = r;
+    if ( r )
+    {
+        std::lock_guard<std::mutex> lock(_fidsMutex);
+        _fids[ feature->getFID() ] = r;
+    }
     return r ? r->_oid : OSGEARTH_OBJECTID_EMPTY;
 }
 
@@ -116,7 +128,24 @@ FeatureSourceIndexNode::tagRange(osg::Drawable* drawable, Feature* feature, unsi
 {
     if (!feature || !_index.valid()) return OSGEARTH_OBJECTID_EMPTY;
     RefIDPair* r = _index->tagRange(drawable, feature, start, count);
-    if (r) _fids[feature->getFID()] = r;
+    if (r)
+    {
+        std::lock_guard<std::mutex> lock(_fidsMutex);
+        _fids[feature->getFID()] = r;
+    }
+    return r ? r->_oid : OSGEARTH_OBJECTID_EMPTY;
+}
+
+ObjectID
+FeatureSourceIndexNode::insert(Feature* feature)
+{
+    if (!feature || !_index.valid()) return OSGEARTH_OBJECTID_EMPTY;
+    RefIDPair* r = _index->insert(feature);
+    if (r)
+    {
+        std::lock_guard<std::mutex> lock(_fidsMutex);
+        _fids[feature->getFID()] = r;
+    }
     return r ? r->_oid : OSGEARTH_OBJECTID_EMPTY;
 }
 
@@ -438,6 +467,32 @@ FeatureSourceIndex::tagRange(osg::Drawable* drawable, Feature* feature, unsigned
     return p;
 }
 
+RefIDPair*
+FeatureSourceIndex::insert(Feature* feature)
+{
+    if (!feature) return 0L;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    FeatureID fid = feature->getFID();
+
+    FID_to_RefIDPair::const_iterator f = _fids.find(fid);
+    if (f != _fids.end())
+        return f->second.get();
+
+    ObjectID oid = _masterIndex->insert(this);
+    RefIDPair* p = new RefIDPair(fid, oid);
+    _fids[fid] = p;
+    _oids[oid] = fid;
+
+    if (_embed)
+    {
+        _embeddedFeatures[fid] = feature;
+    }
+
+    return p;
+}
+
 RefIDPair*
 FeatureSourceIndex::tagNode(osg::Node* node, Feature* feature)
 {
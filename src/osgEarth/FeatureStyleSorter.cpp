@@ -5,9 +5,105 @@
 #include <osgEarth/FeatureStyleSorter>
 #include <osgEarth/FeatureSource>
 #include <osgEarth/StyleSheet>
+#include <map>
+#include <unordered_set>
 
 using namespace osgEarth;
 
+namespace
+{
+    // Whether the segment p-q touches the closed rectangle (Liang-Barsky)
+    bool segmentTouches(const osg::Vec3d& p, const osg::Vec3d& q, const Bounds& b)
+    {
+        double dx = q.x() - p.x(), dy = q.y() - p.y();
+        double P[4] = { -dx, dx, -dy, dy };
+        double Q[4] = { p.x() - b.xMin(), b.xMax() - p.x(), p.y() - b.yMin(), b.yMax() - p.y() };
+        double t0 = 0.0, t1 = 1.0;
+        for (int i = 0; i < 4; ++i)
+        {
+            if (P[i] == 0.0)
+            {
+                if (Q[i] < 0.0)
+                    return false;
+            }
+            else
+            {
+                double t = Q[i] / P[i];
+                if (P[i] < 0.0)
+                {
+                    if (t > t1) return false;
+                    if (t > t0) t0 = t;
+                }
+                else
+                {
+                    if (t < t0) return false;
+                    if (t < t1) t1 = t;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Whether any edge of a part touches the closed rectangle
+    bool edgesTouch(const Geometry* part, const Bounds& b)
+    {
+        if (part->size() == 0)
+            return false;
+
+        for (auto& p : *part)
+        {
+            if (p.x() >= b.xMin() && p.x() <= b.xMax() && p.y() >= b.yMin() && p.y() <= b.yMax())
+                return true;
+        }
+
+        if (part->isLinear() || part->isRing())
+        {
+            for (unsigned i = 0; i + 1 < part->size(); ++i)
+            {
+                if (segmentTouches((*part)[i], (*part)[i + 1], b))
+                    return true;
+            }
+
+            // rings close implicitly
+            if (part->isRing() && segmentTouches(part->back(), part->front(), b))
+                return true;
+        }
+        return false;
+    }
+
+    // Whether a geometry touches the closed rectangle. This is the exact
+    // test a data source's spatial filter applies to a tile query, so a
+    // batch divided with it gives each tile what its own query would.
+    bool touches(const Geometry* geom, const Bounds& b)
+    {
+        if (geom->getType() == Geometry::TYPE_MULTI)
+        {
+            for (auto& part : static_cast<const MultiGeometry*>(geom)->getComponents())
+            {
+                if (part.valid() && touches(part.get(), b))
+                    return true;
+            }
+            return false;
+        }
+
+        if (edgesTouch(geom, b))
+            return true;
+
+        if (geom->getType() == Geometry::TYPE_POLYGON)
+        {
+            for (auto& hole : static_cast<const Polygon*>(geom)->getHoles())
+            {
+                if (hole.valid() && edgesTouch(hole.get(), b))
+                    return true;
+            }
+        }
+
+        // no boundary reaches the rectangle, so an area either holds all
+        // of it or none of it
+        return geom->isRing() && geom->contains2D(b.xMin(), b.yMin());
+    }
+}
+
 void
 FeatureStyleSorter::sort_usingEmbeddedStyles(
     const TileKey& key,
@@ -46,6 +142,102 @@ FeatureStyleSorter::sort_usingEmbeddedStyles(
     }
 }
 
+void
+FeatureStyleSorter::resolveStyles(
+    Session* session,
+    const StyleSelector& sel,
+    const FeatureList& features,
+    std::unordered_map<std::string, Style>& literal_styles,
+    std::vector<ResolvedStyles>& output) const
+{
+    // establish the working bounds and a context:
+    FilterContext context(session, session->getFeatureSource()->getFeatureProfile());
+    StringExpression styleExprCopy(sel.styleExpression().get());
+
+    output.resize(features.size());
+
+    for (unsigned i = 0; i < features.size(); ++i)
+    {
+        const std::string& delimitedStyleStrings = features[i]->eval(styleExprCopy, &context);
+        if (!delimitedStyleStrings.empty() && delimitedStyleStrings != "null")
+        {
+            auto styleStrings = StringTokenizer()
+                .delim(",")
+                .standardQuotes()
+                .tokenize(delimitedStyleStrings);
+
+            for (auto& styleString : styleStrings)
+            {
+                // if the style string begins with an open bracket, it's an inline style definition.
+                if (styleString.length() > 0 && styleString[0] == '{')
+                {
+                    Config conf("style", styleString);
+                    conf.setReferrer(sel.styleExpression().get().uriContext().referrer());
+                    conf.set("type", "text/css");
+                    auto& literal_style = literal_styles[conf.toJSON()];
+                    if (literal_style.empty())
+                    {
+                        literal_style = Style(conf);
+                    }
+                    output[i].emplace_back(&literal_style, -1);
+                }
+
+                // otherwise, look up the style in the stylesheet. Do NOT fall back on a default
+                // style in this case: for style expressions, the user must be explicit about
+                // default styling; this is because there is no other way to exclude unwanted
+                // features.
+                else
+                {
+                    auto style_and_index = session->styles()->getStyleAndIndex(styleString);
+                    if (style_and_index.first)
+                    {
+                        output[i].emplace_back(style_and_index.first, style_and_index.second);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void
+FeatureStyleSorter::bucketStyles(
+    Session* session,
+    const FeatureList& features,
+    const std::vector<ResolvedStyles>& styles,
+    std::vector<Bucket>& output) const
+{
+    // literal styles always come AFTER sheet styles
+    int numSheetStyles = session->styles()->getStyles().size();
+    std::unordered_map<const Style*, int> literal_indices;
+
+    // keep ordered.
+    std::map<int, std::pair<const Style*, FeatureList>> style_buckets;
+
+    for (unsigned i = 0; i < features.size() && i < styles.size(); ++i)
+    {
+        for (auto& style_and_index : styles[i])
+        {
+            int index = style_and_index.second;
+            if (index < 0)
+            {
+                auto iter = literal_indices.emplace(style_and_index.first, 0);
+                if (iter.second)
+                    iter.first->second = literal_indices.size() + numSheetStyles;
+                index = iter.first->second;
+            }
+
+            auto& bucket = style_buckets[index];
+            bucket.first = style_and_index.first;
+            bucket.second.emplace_back(features[i]);
+        }
+    }
+
+    for (auto& iter : style_buckets)
+    {
+        output.emplace_back(Bucket{ *iter.second.first, std::move(iter.second.second) });
+    }
+}
+
 void
 FeatureStyleSorter::sort_usingSelectors(
     const TileKey& key,
@@ -56,8 +248,6 @@ FeatureStyleSorter::sort_usingSelectors(
     StyleFunction processFeaturesForStyle,
     ProgressCallback* progress) const
 {
-    FeatureSource* features = session->getFeatureSource();
-
     Query query;
     query.tileKey() = key;
     query.buffer() = buffer;
@@ -67,88 +257,21 @@ FeatureStyleSorter::sort_usingSelectors(
         const StyleSelector& sel = iter.second;
         if (sel.styleExpression().isSet())
         {
-            const FeatureProfile* featureProfile = features->getFeatureProfile();
-
-            // establish the working bounds and a context:
-            FilterContext context(session, featureProfile);
-            StringExpression styleExprCopy(sel.styleExpression().get());
-
             FeatureList features;
             getFeatures(session, query, key.getExtent(), filters, preprocessor, features, progress);
             if (!features.empty())
             {
-                std::unordered_map<std::string, std::pair<Style, int>> literal_styles;
-
-                // keep ordered.
-                std::map<int, std::pair<const Style*, FeatureList>> style_buckets;
-
-                for (FeatureList::iterator itr = features.begin(); itr != features.end(); ++itr)
-                {
-                    Feature* feature = itr->get();
+                std::unordered_map<std::string, Style> literal_styles;
+                std::vector<ResolvedStyles> resolved;
+                resolveStyles(session, sel, features, literal_styles, resolved);
 
-                    const std::string& delimitedStyleStrings = feature->eval(styleExprCopy, &context);
-                    if (!delimitedStyleStrings.empty() && delimitedStyleStrings != "null")
-                    {
-                        auto styleStrings = StringTokenizer()
-                            .delim(",")
-                            .standardQuotes()
-                            .tokenize(delimitedStyleStrings);
-
-                        for (auto& styleString : styleStrings)
-                        {
-                            // resolve the style:
-                            const Style* resolved_style = nullptr;
-                            int resolved_index = 0;
-
-                            // if the style string begins with an open bracket, it's an inline style definition.
-                            if (styleString.length() > 0 && styleString[0] == '{')
-                            {
-                                Config conf("style", styleString);
-                                conf.setReferrer(sel.styleExpression().get().uriContext().referrer());
-                                conf.set("type", "text/css");
-                                auto& literal_style_and_index = literal_styles[conf.toJSON()];
-                                if (literal_style_and_index.first.empty())
-                                {
-                                    literal_style_and_index.first = Style(conf);
-                                    // literal styles always come AFTER sheet styles
-                                    literal_style_and_index.second = literal_styles.size() + session->styles()->getStyles().size();
-                                }
-                                resolved_style = &literal_style_and_index.first;
-                                resolved_index = literal_style_and_index.second;
-                            }
-
-                            // otherwise, look up the style in the stylesheet. Do NOT fall back on a default
-                            // style in this case: for style expressions, the user must be explicit about
-                            // default styling; this is because there is no other way to exclude unwanted
-                            // features.
-                            else
-                            {
-                                auto style_and_index = session->styles()->getStyleAndIndex(styleString);
-
-                                //const Style* selected_style = session->styles()->getStyle(styleString, false);
-                                if (style_and_index.first)
-                                {
-                                    resolved_style = style_and_index.first;
-                                    resolved_index = style_and_index.second;
-                                }
-                            }
-
-                            if (resolved_style)
-                            {
-                                auto& bucket = style_buckets[resolved_index];
-                                bucket.first = resolved_style;
-                                bucket.second.emplace_back(feature);
-                            }
-                        }
-                    }
-                }
+                std::vector<Bucket> buckets;
+                bucketStyles(session, features, resolved, buckets);
 
                 // in order:
-                for (auto& iter : style_buckets)
+                for (auto& bucket : buckets)
                 {
-                    const Style* style = iter.second.first;
-                    FeatureList& list = iter.second.second;
-                    processFeaturesForStyle(*style, list, progress);
+                    processFeaturesForStyle(bucket.style, bucket.features, progress);
                 }
             }
         }
@@ -256,6 +379,225 @@ FeatureStyleSorter::sort(
     }
 }
 
+bool
+FeatureStyleSorter::sort(
+    const std::vector<TileKey>& keys,
+    const Distance& buffer,
+    Session* session,
+    const FeatureFilterChain& filters,
+    std::vector<std::vector<Bucket>>& output,
+    ProgressCallback* progress) const
+{
+    OE_SOFT_ASSERT_AND_RETURN(session, false);
+    OE_SOFT_ASSERT_AND_RETURN(session->getFeatureSource(), false);
+    OE_SOFT_ASSERT_AND_RETURN(session->getFeatureSource()->getFeatureProfile(), false);
+
+    if (keys.empty())
+        return false;
+
+    FeatureSource* source = session->getFeatureSource();
+    const FeatureProfile* profile = source->getFeatureProfile();
+
+    // A tiled source has different data at each level, and a buffered query
+    // reads whole neighboring tiles, so neither can be divided up by extent.
+    if (profile->isTiled() ||
+        buffer.getValue() != 0.0 ||
+        (source->options().bufferWidth().isSet() && source->options().bufferWidth()->getValue() != 0.0) ||
+        source->options().bufferWidthAsPercentage().isSet())
+    {
+        return false;
+    }
+
+    // Find the common ancestor of the keys; that is the one we query.
+    TileKey ancestor = keys.front();
+    for (auto& key : keys)
+    {
+        if (!key.valid() || !key.getProfile()->isHorizEquivalentTo(keys.front().getProfile()))
+            return false;
+
+        // past its max level, the source answers with an ancestor key's data
+        if (profile->getMaxLevel() >= 0 && (int)key.getLOD() > profile->getMaxLevel())
+            return false;
+
+        while (ancestor.valid() && key.createAncestorKey(ancestor.getLOD()) != ancestor)
+            ancestor = ancestor.createParentKey();
+
+        if (!ancestor.valid())
+            return false;
+    }
+
+    if ((int)ancestor.getLOD() < profile->getFirstLevel())
+        return false;
+
+    const SpatialReference* featureSRS = profile->getSRS();
+    const SpatialReference* geoSRS = featureSRS->getGeographicSRS();
+    GeoExtent featuresExtentWGS84 = profile->getExtent().transform(geoSRS);
+
+    // Divides features queried for the ancestor among the keys, giving each
+    // key (as indices into the list) the features a query for that key would
+    // have returned. With fallback, a key with no features gets those of its
+    // nearest ancestor that has some, as in getFeatures().
+    auto divide = [&](const FeatureList& features, bool fellBack, bool fallback, std::vector<std::vector<unsigned>>& shares)
+    {
+        std::vector<Bounds> bounds(features.size());
+        for (unsigned i = 0; i < features.size(); ++i)
+        {
+            if (features[i]->getGeometry())
+                bounds[i] = features[i]->getGeometry()->getBounds();
+        }
+
+        shares.assign(keys.size(), {});
+
+        for (unsigned k = 0; k < keys.size(); ++k)
+        {
+            // getFeatures() does not query a key outside the features' extent
+            if (fallback)
+            {
+                GeoExtent keyExtentWGS84 = keys[k].getExtent().transform(geoSRS);
+                if (!featuresExtentWGS84.intersectionSameSRS(keyExtentWGS84).isValid())
+                    continue;
+            }
+
+            bool all = fellBack;
+            for (TileKey key = keys[k]; !all; key = key.createParentKey())
+            {
+                if (key == ancestor)
+                {
+                    all = true;
+                    break;
+                }
+
+                Bounds extent = key.getExtent().transform(featureSRS).bounds();
+                for (unsigned i = 0; i < features.size(); ++i)
+                {
+                    if (!bounds[i].valid() || !intersects2d(bounds[i], extent))
+                        continue;
+
+                    // a feature wholly inside needs no closer look
+                    bool inside =
+                        bounds[i].xMin() >= extent.xMin() && bounds[i].xMax() <= extent.xMax() &&
+                        bounds[i].yMin() >= extent.yMin() && bounds[i].yMax() <= extent.yMax();
+
+                    if (inside || touches(features[i]->getGeometry(), extent))
+                        shares[k].push_back(i);
+                }
+
+                if (!shares[k].empty() || !fallback)
+                    break;
+            }
+
+            if (all)
+            {
+                shares[k].resize(features.size());
+                for (unsigned i = 0; i < features.size(); ++i)
+                    shares[k][i] = i;
+            }
+        }
+    };
+
+    // Adds a single-style bucket to each key's output
+    auto divideOneStyle = [&](const Style& style, const FeatureList& features, bool fellBack)
+    {
+        std::vector<std::vector<unsigned>> shares;
+        divide(features, fellBack, true, shares);
+        for (unsigned k = 0; k < keys.size(); ++k)
+        {
+            if (!shares[k].empty())
+            {
+                Bucket bucket{ style, {} };
+                for (auto i : shares[k])
+                    bucket.features.emplace_back(features[i]);
+                output[k].emplace_back(std::move(bucket));
+            }
+        }
+    };
+
+    output.assign(keys.size(), {});
+
+    Query query;
+    query.tileKey() = ancestor;
+    query.buffer() = buffer;
+
+    if (source->hasEmbeddedStyles())
+    {
+        // Each feature has its own embedded style data, so use that:
+        FilterContext context;
+        FeatureList features;
+
+        auto cursor = source->createFeatureCursor(query, filters, &context, progress);
+        if (cursor.valid() && cursor->hasMore())
+            cursor->fill(features);
+
+        std::vector<std::vector<unsigned>> shares;
+        divide(features, false, false, shares);
+        for (unsigned k = 0; k < keys.size(); ++k)
+        {
+            for (auto i : shares[k])
+                output[k].emplace_back(Bucket{ features[i]->style().get(), { features[i] } });
+        }
+    }
+
+    else if (session->styles() && session->styles()->getSelectors().size() > 0)
+    {
+        for (auto& iter : session->styles()->getSelectors())
+        {
+            const StyleSelector& sel = iter.second;
+            if (sel.styleExpression().isSet())
+            {
+                FeatureList features;
+                bool fellBack = false;
+                getFeatures(session, query, ancestor.getExtent(), filters, nullptr, features, progress, &fellBack);
+                if (features.empty())
+                    continue;
+
+                // Evaluate the style expression once for all keys:
+                std::unordered_map<std::string, Style> literal_styles;
+                std::vector<ResolvedStyles> resolved;
+                resolveStyles(session, sel, features, literal_styles, resolved);
+
+                std::vector<std::vector<unsigned>> shares;
+                divide(features, fellBack, true, shares);
+
+                // Bucket each key's share separately, since literal styles
+                // are ordered by their first use.
+                for (unsigned k = 0; k < keys.size(); ++k)
+                {
+                    FeatureList share_features;
+                    std::vector<ResolvedStyles> share_resolved;
+                    for (auto i : shares[k])
+                    {
+                        share_features.emplace_back(features[i]);
+                        share_resolved.emplace_back(resolved[i]);
+                    }
+                    bucketStyles(session, share_features, share_resolved, output[k]);
+                }
+            }
+            else
+            {
+                const Style* style = session->styles()->getStyle(sel.getSelectedStyleName());
+                Query selQuery = sel.query().get();
+                selQuery.tileKey() = ancestor;
+                selQuery.buffer() = buffer;
+
+                FeatureList features;
+                bool fellBack = false;
+                getFeatures(session, selQuery, ancestor.getExtent(), filters, nullptr, features, progress, &fellBack);
+                divideOneStyle(*style, features, fellBack);
+            }
+        }
+    }
+
+    else
+    {
+        FeatureList features;
+        bool fellBack = false;
+        getFeatures(session, query, ancestor.getExtent(), filters, nullptr, features, progress, &fellBack);
+        divideOneStyle(session->styles() ? *session->styles()->getDefaultStyle() : Style(), features, fellBack);
+    }
+
+    return true;
+}
+
 void
 FeatureStyleSorter::getFeatures(
     Session* session,
@@ -264,8 +606,12 @@ FeatureStyleSorter::getFeatures(
     const FeatureFilterChain& filters,
     PreprocessorFunction featurePreprocessor,
     FeatureList& features,
-    ProgressCallback* progress) const
+    ProgressCallback* progress,
+    bool* fellBack) const
 {
+    if (fellBack)
+        *fellBack = false;
+
     OE_SOFT_ASSERT_AND_RETURN(session != nullptr, void());
     OE_SOFT_ASSERT_AND_RETURN(session->getFeatureSource() != nullptr, void());
     OE_SOFT_ASSERT_AND_RETURN(session->getFeatureSource()->getFeatureProfile() != nullptr, void());
@@ -331,6 +677,9 @@ FeatureStyleSorter::getFeatures(
                     // We fell back all the way to lod 0 and got nothing, so bail.
                     break;
                 }
+
+                if (fellBack)
+                    *fellBack = true;
             }
             else
             {
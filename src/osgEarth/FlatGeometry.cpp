@@ -0,0 +1,521 @@
+/* osgEarth
+ * Copyright 2025 Pelican Mapping
+ * MIT License
+ */
+#include <osgEarth/FlatGeometry>
+#include <osgEarth/SpatialReference>
+#include <osgEarth/Math>
+#include <algorithm>
+#include <cfloat>
+
+#define LC "[FlatGeometry] "
+
+using namespace osgEarth;
+
+namespace
+{
+    struct Vert
+    {
+        double x, y, z;
+    };
+
+    // Vertex range of a ring without its closing point, if it has one
+    inline unsigned ringEnd(const FlatGeometry& g, const FlatGeometry::Part& part)
+    {
+        unsigned e = part.end;
+        if (part.size() > 1 &&
+            g.x[part.begin] == g.x[e - 1] &&
+            g.y[part.begin] == g.y[e - 1] &&
+            g.z[part.begin] == g.z[e - 1])
+        {
+            --e;
+        }
+        return e;
+    }
+
+    // Same as Ring::contains2D (even-odd rule)
+    bool ringContains(const double* px, const double* py, unsigned b, unsigned e, double x, double y)
+    {
+        bool result = false;
+        for (unsigned i = b, j = e - 1; i < e; j = i++)
+        {
+            if ((((py[i] <= y) && (y < py[j])) ||
+                 ((py[j] <= y) && (y < py[i]))) &&
+                (x < (px[j] - px[i]) * (y - py[i]) / (py[j] - py[i]) + px[i]))
+            {
+                result = !result;
+            }
+        }
+        return result;
+    }
+
+    // Sutherland-Hodgman clip of a closed polygon against one box edge.
+    // axis 0 = x, 1 = y; keeps the side >= value when "greater" is set.
+    void clipEdge(const std::vector<Vert>& in, std::vector<Vert>& out, int axis, double value, bool greater)
+    {
+        out.clear();
+        if (in.empty())
+            return;
+
+        auto coord = [axis](const Vert& v) { return axis == 0 ? v.x : v.y; };
+        auto inside = [&](const Vert& v) { return greater ? coord(v) >= value : coord(v) <= value; };
+        auto cross = [&](const Vert& a, const Vert& b) {
+            double t = (value - coord(a)) / (coord(b) - coord(a));
+            Vert v{ a.x + t * (b.x - a.x), a.y + t * (b.y - a.y), a.z + t * (b.z - a.z) };
+            // snap exactly onto the edge to avoid round-off slivers
+            if (axis == 0) v.x = value; else v.y = value;
+            return v;
+        };
+
+        const Vert* prev = &in.back();
+        bool prevInside = inside(*prev);
+        for (const auto& curr : in)
+        {
+            bool currInside = inside(curr);
+            if (currInside)
+            {
+                if (!prevInside)
+                    out.push_back(cross(*prev, curr));
+                out.push_back(curr);
+            }
+            else if (prevInside)
+            {
+                out.push_back(cross(*prev, curr));
+            }
+            prev = &curr;
+            prevInside = currInside;
+        }
+    }
+
+    // Liang-Barsky: clips the segment a->b to the box, returning the
+    // parametric range [t0, t1] that survives, or false if none does.
+    bool clipSegment(const Vert& a, const Vert& b, const Bounds& box, double& t0, double& t1)
+    {
+        double dx = b.x - a.x, dy = b.y - a.y;
+        double p[4] = { -dx, dx, -dy, dy };
+        double q[4] = { a.x - box.xMin(), box.xMax() - a.x, a.y - box.yMin(), box.yMax() - a.y };
+        t0 = 0.0, t1 = 1.0;
+        for (int i = 0; i < 4; ++i)
+        {
+            if (p[i] == 0.0)
+            {
+                if (q[i] < 0.0)
+                    return false;
+            }
+            else
+            {
+                double t = q[i] / p[i];
+                if (p[i] < 0.0)
+                {
+                    if (t > t1) return false;
+                    if (t > t0) t0 = t;
+                }
+                else
+                {
+                    if (t < t0) return false;
+                    if (t < t1) t1 = t;
+                }
+            }
+        }
+        return true;
+    }
+
+    inline Vert lerp(const Vert& a, const Vert& b, double t)
+    {
+        return Vert{ a.x + t * (b.x - a.x), a.y + t * (b.y - a.y), a.z + t * (b.z - a.z) };
+    }
+}
+
+FlatGeometry::FlatGeometry(const Geometry* geom)
+{
+    set(geom);
+}
+
+void
+FlatGeometry::clear()
+{
+    x.clear();
+    y.clear();
+    z.clear();
+    parts.clear();
+}
+
+void
+FlatGeometry::set(const Geometry* geom)
+{
+    clear();
+    if (geom)
+    {
+        unsigned total = geom->getTotalPointCount();
+        x.reserve(total);
+        y.reserve(total);
+        z.reserve(total);
+        append(geom);
+    }
+}
+
+void
+FlatGeometry::append(const Geometry* geom)
+{
+    if (geom->getType() == Geometry::TYPE_MULTI)
+    {
+        for (auto& component : static_cast<const MultiGeometry*>(geom)->getComponents())
+        {
+            if (component.valid())
+                append(component.get());
+        }
+        return;
+    }
+
+    auto push = [this](const Geometry* g, Geometry::Type type, int polygon)
+    {
+        Part part;
+        part.type = type;
+        part.begin = size();
+        for (auto& v : *g)
+        {
+            x.push_back(v.x());
+            y.push_back(v.y());
+            z.push_back(v.z());
+        }
+        part.end = size();
+        part.polygon = polygon;
+        parts.push_back(part);
+    };
+
+    push(geom, geom->getType(), -1);
+
+    if (geom->getType() == Geometry::TYPE_POLYGON)
+    {
+        int owner = (int)parts.size() - 1;
+        for (auto& hole : static_cast<const Polygon*>(geom)->getHoles())
+        {
+            if (hole.valid())
+                push(hole.get(), Geometry::TYPE_RING, owner);
+        }
+    }
+}
+
+bool
+FlatGeometry::write(Geometry* geom, unsigned& p) const
+{
+    if (geom->getType() == Geometry::TYPE_MULTI)
+    {
+        for (auto& component : static_cast<MultiGeometry*>(geom)->getComponents())
+        {
+            if (component.valid() && !write(component.get(), p))
+                return false;
+        }
+        return true;
+    }
+
+    auto pull = [this, &p](Geometry* g)
+    {
+        if (p >= parts.size() || parts[p].size() != g->size())
+            return false;
+        const Part& part = parts[p++];
+        for (unsigned i = part.begin, k = 0; i < part.end; ++i, ++k)
+            (*g)[k].set(x[i], y[i], z[i]);
+        return true;
+    };
+
+    if (!pull(geom))
+        return false;
+
+    if (geom->getType() == Geometry::TYPE_POLYGON)
+    {
+        for (auto& hole : static_cast<Polygon*>(geom)->getHoles())
+        {
+            if (hole.valid() && !pull(hole.get()))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool
+FlatGeometry::writeTo(Geometry* geom) const
+{
+    OE_SOFT_ASSERT_AND_RETURN(geom != nullptr, false);
+    unsigned p = 0u;
+    return write(geom, p) && p == parts.size();
+}
+
+Geometry*
+FlatGeometry::makePart(const Part& part) const
+{
+    Geometry* g = nullptr;
+    switch (part.type)
+    {
+    case Geometry::TYPE_POINT: g = new Point(part.size()); break;
+    case Geometry::TYPE_LINESTRING: g = new LineString(part.size()); break;
+    case Geometry::TYPE_RING: g = new Ring(part.size()); break;
+    case Geometry::TYPE_POLYGON: g = new Polygon(part.size()); break;
+    default: g = new PointSet(part.size()); break;
+    }
+
+    for (unsigned i = part.begin; i < part.end; ++i)
+        g->push_back(osg::Vec3d(x[i], y[i], z[i]));
+
+    return g;
+}
+
+Geometry*
+FlatGeometry::toGeometry() const
+{
+    std::vector<Geometry*> made(parts.size(), nullptr);
+    std::vector<Geometry*> top;
+
+    for (unsigned p = 0; p < parts.size(); ++p)
+    {
+        const Part& part = parts[p];
+        if (part.isHole())
+        {
+            Geometry* owner = made[part.polygon];
+            if (owner && owner->getType() == Geometry::TYPE_POLYGON)
+            {
+                static_cast<Polygon*>(owner)->getHoles().push_back(
+                    static_cast<Ring*>(makePart(part)));
+            }
+        }
+        else
+        {
+            made[p] = makePart(part);
+            top.push_back(made[p]);
+        }
+    }
+
+    if (top.empty())
+        return nullptr;
+
+    if (top.size() == 1)
+        return top.front();
+
+    MultiGeometry* multi = new MultiGeometry();
+    for (auto g : top)
+        multi->add(g);
+    return multi;
+}
+
+bool
+FlatGeometry::transform(const SpatialReference* fromSRS, const SpatialReference* toSRS)
+{
+    OE_SOFT_ASSERT_AND_RETURN(fromSRS != nullptr && toSRS != nullptr, false);
+
+    if (empty())
+        return true;
+
+    return fromSRS->transform(x.data(), y.data(), z.data(), size(), toSRS);
+}
+
+Bounds
+FlatGeometry::getBounds() const
+{
+    Bounds bounds;
+    if (empty())
+        return bounds;
+
+    // separate branch-free passes over each array so they vectorize
+    auto minmax = [](const std::vector<double>& a, double& lo, double& hi)
+    {
+        lo = a[0], hi = a[0];
+        const double* d = a.data();
+        for (std::size_t i = 1; i < a.size(); ++i)
+        {
+            lo = std::min(lo, d[i]);
+            hi = std::max(hi, d[i]);
+        }
+    };
+
+    minmax(x, bounds.xMin(), bounds.xMax());
+    minmax(y, bounds.yMin(), bounds.yMax());
+    minmax(z, bounds.zMin(), bounds.zMax());
+    return bounds;
+}
+
+double
+FlatGeometry::getSignedDistance2D(double px, double py) const
+{
+    // The per-type rules mirror the Geometry subclasses. A polygon's result is
+    // the minimum over its outer ring and holes, so every ring (outer, hole,
+    // or standalone) can simply contribute to one global minimum.
+    const osg::Vec3d point(px, py, 0.0);
+    Segment2d seg;
+    double r = DBL_MAX;
+
+    for (const auto& part : parts)
+    {
+        if (part.size() == 0)
+            continue;
+
+        switch (part.type)
+        {
+        case Geometry::TYPE_LINESTRING:
+        {
+            double r2 = DBL_MAX;
+            for (unsigned i = part.begin; i + 1 < part.end; ++i)
+            {
+                seg._a.set(x[i], y[i], 0.0);
+                seg._b.set(x[i + 1], y[i + 1], 0.0);
+                r2 = std::min(r2, seg.squaredDistanceTo(point));
+            }
+            r = std::min(r, sqrt(r2));
+            break;
+        }
+
+        case Geometry::TYPE_RING:
+        case Geometry::TYPE_POLYGON:
+        {
+            unsigned e = ringEnd(*this, part);
+            double r2 = DBL_MAX;
+            for (unsigned i = part.begin, j = e - 1; i < e; j = i++)
+            {
+                seg._a.set(x[i], y[i], 0.0);
+                seg._b.set(x[j], y[j], 0.0);
+                r2 = std::min(r2, seg.squaredDistanceTo(point));
+            }
+            double d = sqrt(r2);
+            r = std::min(r, ringContains(x.data(), y.data(), part.begin, e, px, py) ? -d : d);
+            break;
+        }
+
+        default:
+        {
+            double r2 = DBL_MAX;
+            for (unsigned i = part.begin; i < part.end; ++i)
+            {
+                double dx = x[i] - px, dy = y[i] - py;
+                r2 = std::min(r2, dx * dx + dy * dy);
+            }
+            r = std::min(r, sqrt(r2));
+            break;
+        }
+        }
+    }
+
+    return r;
+}
+
+FlatGeometry
+FlatGeometry::crop(const Bounds& box) const
+{
+    FlatGeometry out;
+    if (empty() || box.xMin() > box.xMax() || box.yMin() > box.yMax())
+        return out;
+
+    auto emit = [&out](const Vert& v)
+    {
+        out.x.push_back(v.x);
+        out.y.push_back(v.y);
+        out.z.push_back(v.z);
+    };
+
+    // maps part indices in this object to those in the output (-1 = dropped)
+    std::vector<int> remap(parts.size(), -1);
+    std::vector<Vert> ring, scratch;
+
+    for (unsigned p = 0; p < parts.size(); ++p)
+    {
+        const Part& part = parts[p];
+
+        if (part.isHole() && remap[part.polygon] < 0)
+            continue;
+
+        switch (part.type)
+        {
+        case Geometry::TYPE_LINESTRING:
+        {
+            Part run;
+            run.type = part.type;
+            run.begin = out.size();
+            bool open = false;
+
+            auto close = [&]()
+            {
+                if (open)
+                {
+                    run.end = out.size();
+                    out.parts.push_back(run);
+                    open = false;
+                }
+            };
+
+            for (unsigned i = part.begin; i + 1 < part.end; ++i)
+            {
+                Vert a{ x[i], y[i], z[i] }, b{ x[i + 1], y[i + 1], z[i + 1] };
+                double t0, t1;
+                if (!clipSegment(a, b, box, t0, t1))
+                {
+                    close();
+                    continue;
+                }
+
+                // continue the current run only if this segment starts where
+                // the last one ended, i.e. neither was clipped at the joint.
+                if (!open || t0 > 0.0)
+                {
+                    close();
+                    run.begin = out.size();
+                    emit(lerp(a, b, t0));
+                    open = true;
+                }
+                emit(lerp(a, b, t1));
+
+                if (t1 < 1.0)
+                    close();
+            }
+            close();
+            break;
+        }
+
+        case Geometry::TYPE_RING:
+        case Geometry::TYPE_POLYGON:
+        {
+            ring.clear();
+            unsigned e = ringEnd(*this, part);
+            for (unsigned i = part.begin; i < e; ++i)
+                ring.push_back(Vert{ x[i], y[i], z[i] });
+
+            clipEdge(ring, scratch, 0, box.xMin(), true);
+            clipEdge(scratch, ring, 0, box.xMax(), false);
+            clipEdge(ring, scratch, 1, box.yMin(), true);
+            clipEdge(scratch, ring, 1, box.yMax(), false);
+
+            if (ring.size() >= 3)
+            {
+                Part clipped;
+                clipped.type = part.type;
+                clipped.polygon = part.isHole() ? remap[part.polygon] : -1;
+                clipped.begin = out.size();
+                for (auto& v : ring)
+                    emit(v);
+                clipped.end = out.size();
+                remap[p] = (int)out.parts.size();
+                out.parts.push_back(clipped);
+            }
+            break;
+        }
+
+        default:
+        {
+            Part kept;
+            kept.type = part.type;
+            kept.begin = out.size();
+            for (unsigned i = part.begin; i < part.end; ++i)
+            {
+                if (x[i] >= box.xMin() && x[i] <= box.xMax() &&
+                    y[i] >= box.yMin() && y[i] <= box.yMax())
+                {
+                    emit(Vert{ x[i], y[i], z[i] });
+                }
+            }
+            kept.end = out.size();
+            if (kept.size() > 0)
+                out.parts.push_back(kept);
+            break;
+        }
+        }
+    }
+
+    return out;
+}
@@ -3,12 +3,15 @@
  * MIT License
  */
 #include "FlatteningLayer"
+#include "FlatteningLayerImpl"
 #include "HeightFieldUtils"
 #include "FeatureCursor"
+#include "ScanlineRasterizer"
 #include "rtree.h"
 
 using namespace osgEarth;
 using namespace osgEarth::Contrib;
+using namespace osgEarth::Internal;
 
 REGISTER_OSGEARTH_LAYER(flattenedelevation, FlatteningLayer);
 REGISTER_OSGEARTH_LAYER(flattened_elevation, FlatteningLayer);
@@ -158,22 +161,6 @@ namespace
     }
 
 
-    struct Widths {
-        Widths(const Widths& rhs) {
-            bufferWidth = rhs.bufferWidth;
-            lineWidth = rhs.lineWidth;
-        }
-
-        Widths(double bufferWidth, double lineWidth) {
-            this->bufferWidth = bufferWidth;
-            this->lineWidth = lineWidth;
-        }
-
-        double bufferWidth;
-        double lineWidth;
-    };
-
-    typedef std::vector<Widths> WidthsList;
 
     // Creates a heightfield that flattens an area intersecting the input polygon geometry.
     // The height of the area is found by sampling a point internal to the polygon.
@@ -196,6 +183,61 @@ namespace
         
         ConstGeometryIterator giter;
 
+        // When the polygons share the tile's SRS, rasterize them into a mask
+        // with one cell centered on each post. A post whose cell lies wholly
+        // inside the first polygon to touch it is inside that polygon, so it
+        // can skip the search below.
+        struct MaskPart {
+            const Polygon* polygon;
+            double bufferWidth;
+        };
+        std::vector<MaskPart> maskParts;
+        std::vector<int> maskFirst;
+        std::vector<bool> maskFull;
+        const unsigned numCols = hf->getNumColumns();
+
+        if (!needsTransform)
+        {
+            for (unsigned int geomIndex = 0; geomIndex < geom->getNumComponents(); geomIndex++)
+            {
+                giter.reset(geom->getComponents()[geomIndex].get(), false);
+                while (giter.hasMore())
+                {
+                    auto part = giter.next();
+                    if (part->getType() == Geometry::TYPE_POLYGON)
+                        maskParts.push_back(MaskPart{ static_cast<const Polygon*>(part), widths[geomIndex].bufferWidth });
+                }
+            }
+
+            maskFirst.assign(numCols * hf->getNumRows(), -1);
+            maskFull.assign(numCols * hf->getNumRows(), false);
+
+            Util::ScanlineRasterizer ras(hf->getNumColumns(), hf->getNumRows());
+            ras.setFillRule(Util::ScanlineRasterizer::FILL_EVEN_ODD);
+
+            // in reverse, so the first polygon to touch a cell is the last one written
+            for (int i = (int)maskParts.size() - 1; i >= 0; --i)
+            {
+                ras.reset();
+                ras.addGeometry(maskParts[i].polygon,
+                    ex.xMin() - 0.5 * col_interval, ex.yMin() - 0.5 * row_interval,
+                    1.0 / col_interval, 1.0 / row_interval);
+
+                ras.render([&](int row, int begin, int end, const float* coverage)
+                    {
+                        for (int col = begin; col < end; ++col)
+                        {
+                            // tolerate the rounding of the running coverage sum
+                            if (coverage[col] > 1e-4f)
+                            {
+                                maskFirst[row * numCols + col] = i;
+                                maskFull[row * numCols + col] = coverage[col] > 1.0f - 1e-4f;
+                            }
+                        }
+                    });
+            }
+        }
+
         for (unsigned col = 0; col < hf->getNumColumns(); ++col)
         {
             Pex.x() = ex.xMin() + (double)col * col_interval;
@@ -219,6 +261,19 @@ namespace
 
                 const Polygon* bestPoly = 0L;
 
+                if (!maskFirst.empty())
+                {
+                    int first = maskFirst[row * numCols + col];
+                    if (first >= 0 && maskFull[row * numCols + col] &&
+                        maskParts[first].polygon->contains2D(P.x(), P.y()))
+                    {
+                        done = true;
+                        bestPoly = maskParts[first].polygon;
+                        minD2 = -1.0;
+                        bufferWidth = maskParts[first].bufferWidth;
+                    }
+                }
+
                 for (unsigned int geomIndex = 0; geomIndex < geom->getNumComponents(); geomIndex++)
                 {
                     Geometry* component = geom->getComponents()[geomIndex].get();
@@ -369,27 +424,6 @@ namespace
         return samples.size() > 0 ? (numer / (double)(samples.size())) : FLT_MAX;
     }
 
-    struct LineSegment
-    {
-        LineSegment(const osg::Vec3d& _a, const osg::Vec3d& _b, unsigned int _geomIndex) :
-            A(_a),
-            B(_b),
-            geomIndex(_geomIndex)
-        {
-            AB = B - A;
-            length2 = AB.length2();
-        }
-
-        osg::Vec3d A;
-        osg::Vec3d B;
-        osg::Vec3d AB;
-        double length2;
-        unsigned int geomIndex;
-        double AElev = NO_DATA_VALUE;
-        double BElev = NO_DATA_VALUE;
-    };
-
-    using LineSegmentList = std::vector<LineSegment>;
 
     using LineSegmentIndex = RTree<unsigned, double, 2>;
 
@@ -426,6 +460,9 @@ namespace
         }
     }
 
+
+
+
     /**
      * Create a heightfield that flattens the terrain around linear geometry.
      * lineWidth = width of completely flat area
@@ -460,29 +497,41 @@ namespace
             if (d > maxBufferDistance) maxBufferDistance = d;
         }
 
-        // Sample heights for the line segments
-        std::vector< osg::Vec3d > segmentPoints;        
-        segments.reserve(segments.size() * 2);
-        for (auto itr = segments.begin(); itr != segments.end(); ++itr)
+        GeoExtent keyExtent = key.getExtent();
+        GeoExtent ex = key.getExtent();
+        if (ex.getSRS() != geomSRS)
+        {
+            ex = ex.transform(geomSRS);
+        }
+
+        // Sample heights for the line segments. A segment that can't come within
+        // the maximum buffer distance of the tile will never be found by the row
+        // searches below, so don't bother sampling it.
+        std::vector< osg::Vec3d > segmentPoints;
+        std::vector< unsigned > sampledSegments;
+        segmentPoints.reserve(segments.size() * 2);
+        sampledSegments.reserve(segments.size());
+        for (unsigned int i = 0; i < segments.size(); ++i)
         {
-            segmentPoints.push_back(itr->A);
-            segmentPoints.push_back(itr->B);
+            const LineSegment& seg = segments[i];
+            if (osg::maximum(seg.A.x(), seg.B.x()) >= ex.xMin() - maxBufferDistance &&
+                osg::minimum(seg.A.x(), seg.B.x()) <= ex.xMax() + maxBufferDistance &&
+                osg::maximum(seg.A.y(), seg.B.y()) >= ex.yMin() - maxBufferDistance &&
+                osg::minimum(seg.A.y(), seg.B.y()) <= ex.yMax() + maxBufferDistance)
+            {
+                segmentPoints.push_back(seg.A);
+                segmentPoints.push_back(seg.B);
+                sampledSegments.push_back(i);
+            }
         }
         geomSRS->transform(segmentPoints, pool->getMapSRS());
         Distance samplingResolution = Distance(0.0, Units::METERS);
         pool->sampleMapCoords(segmentPoints.begin(), segmentPoints.end(), samplingResolution, workingSet, nullptr);
         // Assign the samples back to the segments
-        for (unsigned int i = 0; i < segments.size(); ++i)
+        for (unsigned int i = 0; i < sampledSegments.size(); ++i)
         {
-            segments[i].AElev = segmentPoints[i * 2].z();
-            segments[i].BElev = segmentPoints[i * 2 + 1].z();
-        }
-
-        GeoExtent keyExtent = key.getExtent();
-        GeoExtent ex = key.getExtent();
-        if (ex.getSRS() != geomSRS)
-        {
-            ex = ex.transform(geomSRS);
+            segments[sampledSegments[i]].AElev = segmentPoints[i * 2].z();
+            segments[sampledSegments[i]].BElev = segmentPoints[i * 2 + 1].z();
         }
 
         double col_interval = ex.width() / (double)(hf->getNumColumns() - 1);
@@ -509,13 +558,23 @@ namespace
 
         bool wroteChanges = false;
        
-        osg::Vec3d P, PROJ;
+        osg::Vec3d P;
+
+        const unsigned numCols = hf->getNumColumns();
+
+        // Blocks of columns about one buffer width across:
+        SegmentBins bins;
+        bins.blockSize = (unsigned)clamp(std::ceil(maxBufferDistance / col_interval), 8.0, 64.0);
+
+        std::vector<unsigned> hits;
+        std::vector<unsigned> colRanges;
+        std::vector<double> kernelT, kernelD2;
 
         for (unsigned row = 0; row < hf->getNumRows(); ++row)
         {
             P.y() = ex.yMin() + (double)row * row_interval;
 
-            std::vector<unsigned> hits;
+            hits.clear();
 
             double searchMin[2] = { ex.xMin() - maxBufferDistance, P.y() - maxBufferDistance };
             double searchMax[2] = { ex.xMax() + maxBufferDistance, P.y() + maxBufferDistance };
@@ -532,66 +591,58 @@ namespace
                 continue;
             }
 
+            // Bin the hits by the blocks of columns they can reach.
+            binSegments(hits, segments, widths, P.y(), ex.xMin(), col_interval, numCols, colRanges, bins);
+
             static const unsigned Maxsamples = 4;
             Samples samples;
 
-            for (unsigned col = 0; col < hf->getNumColumns(); ++col)
+            for (unsigned col = 0; col < numCols; ++col)
             {
                 P.x() = ex.xMin() + (double)col * col_interval;
 
+                unsigned block = col / bins.blockSize;
+                unsigned begin = bins.offsets[block];
+                unsigned end = bins.offsets[block + 1];
+
+                // Nothing reaches this block of columns.
+                if (begin == end)
+                {
+                    if (fillAllPixels)
+                    {
+                        float h = pixelPoints[row * numCols + col].z();
+                        hf->setHeight(col, row, h);
+                    }
+                    continue;
+                }
+
                 // For each point, we need to find the closest line segments to that point
                 // because the elevation values on these line segments will be the flattening
                 // value. There may be more than one line segment that falls within the search
                 // radius; we will collect up to MaxSamples of these for each heightfield point.
                 samples.clear();
 
-                unsigned int hitIndex = 0;
-                // What is the maximum number of hits we see in this area?
-                for (auto hit : hits)
-                {
-                    LineSegment& segment = segments[hit];
+                kernelT.resize(end - begin);
+                kernelD2.resize(end - begin);
+                nearestPointsOnSegments(P.x(), P.y(), bins, begin, end, kernelT.data(), kernelD2.data());
 
-                    const Widths& w = widths[segment.geomIndex];
+                for (unsigned e = begin; e < end; ++e)
+                {
+                    LineSegment& segment = segments[bins.segment[e]];
 
-                    double innerRadius = w.lineWidth * 0.5;
-                    double outerRadius = innerRadius + w.bufferWidth;
-                    double outerRadius2 = outerRadius * outerRadius;
+                    double innerRadius = bins.innerRadius[e];
+                    double outerRadius = bins.outerRadius[e];
 
                     // AB is a candidate line segment:
                     const osg::Vec3d& A = segment.A;
                     const osg::Vec3d& B = segment.B;
 
-                    //osg::Vec3d AB = B - A;    // current segment AB
-                    const osg::Vec3d& AB = segment.AB;
-
-                    double t;                 // parameter [0..1] on segment AB
-                    double D2;                // shortest distance from point P to segment AB, squared
-                    double L2 = segment.length2; // length (squared) of segment AB
-
-                    osg::Vec3d AP = P - A;    // vector from endpoint A to point P
-
-                    if (L2 == 0.0)
-                    {
-                        // trivial case: zero-length segment
-                        t = 0.0;
-                        D2 = AP.length2();
-                    }
-                    else
-                    {
-                        // Calculate parameter "t" [0..1] which will yield the closest point on AB to P.
-                        // Clamping it means the closest point won't be beyond the endpoints of the segment.
-                        t = clamp((AP * AB) / L2, 0.0, 1.0);
-
-                        // project our point P onto segment AB:
-                        PROJ.set(A + AB * t);
-
-                        // measure the distance (squared) from P to the projected point on AB:
-                        D2 = (P - PROJ).length2();
-                    }
+                    double t = kernelT[e - begin];   // parameter [0..1] on segment AB
+                    double D2 = kernelD2[e - begin]; // shortest distance from point P to segment AB, squared
 
                     // If the distance from our point to the line segment falls within
                     // the maximum flattening distance, store it.
-                    if (D2 <= outerRadius2)
+                    if (D2 <= bins.outerRadius2[e])
                     {
                         // see if P is a new sample.
                         Sample* b;
@@ -739,6 +790,114 @@ namespace
 
 //........................................................................
 
+void
+osgEarth::Internal::binSegments(
+    const std::vector<unsigned>& hits,
+    const LineSegmentList& segments,
+    const WidthsList& widths,
+    double y, double xmin, double col_interval, unsigned numCols,
+    std::vector<unsigned>& colRanges,
+    SegmentBins& bins)
+{
+    unsigned numBlocks = (numCols + bins.blockSize - 1) / bins.blockSize;
+    bins.offsets.assign(numBlocks + 1, 0u);
+    colRanges.clear();
+
+    // first pass: count the entries in each block
+    for (auto hit : hits)
+    {
+        const LineSegment& seg = segments[hit];
+        const Widths& w = widths[seg.geomIndex];
+        double outerRadius = w.lineWidth * 0.5 + w.bufferWidth;
+
+        // pad the reach a little so rounding never drops a post the
+        // exact distance test would accept
+        double reach = outerRadius + 1e-6 * (outerRadius + col_interval);
+
+        if (y < osg::minimum(seg.A.y(), seg.B.y()) - reach ||
+            y > osg::maximum(seg.A.y(), seg.B.y()) + reach)
+            continue;
+
+        double c0 = std::ceil((osg::minimum(seg.A.x(), seg.B.x()) - reach - xmin) / col_interval);
+        double c1 = std::floor((osg::maximum(seg.A.x(), seg.B.x()) + reach - xmin) / col_interval);
+        if (c1 < 0.0 || c0 > (double)(numCols - 1) || c0 > c1)
+            continue;
+
+        unsigned b0 = (unsigned)osg::maximum(c0, 0.0) / bins.blockSize;
+        unsigned b1 = (unsigned)osg::minimum(c1, (double)(numCols - 1)) / bins.blockSize;
+        for (unsigned b = b0; b <= b1; ++b)
+            bins.offsets[b + 1]++;
+
+        colRanges.push_back(hit);
+        colRanges.push_back(b0);
+        colRanges.push_back(b1);
+    }
+
+    for (unsigned b = 0; b < numBlocks; ++b)
+        bins.offsets[b + 1] += bins.offsets[b];
+
+    bins.resize(bins.offsets[numBlocks]);
+
+    // second pass: fill the blocks, keeping the search order within each
+    std::vector<unsigned> next(bins.offsets.begin(), bins.offsets.end() - 1);
+    for (unsigned r = 0; r < colRanges.size(); r += 3)
+    {
+        unsigned hit = colRanges[r];
+        const LineSegment& seg = segments[hit];
+        const Widths& w = widths[seg.geomIndex];
+        double innerRadius = w.lineWidth * 0.5;
+        double outerRadius = innerRadius + w.bufferWidth;
+
+        for (unsigned b = colRanges[r + 1]; b <= colRanges[r + 2]; ++b)
+        {
+            unsigned i = next[b]++;
+            bins.segment[i] = hit;
+            bins.ax[i] = seg.A.x(), bins.ay[i] = seg.A.y(), bins.az[i] = seg.A.z();
+            bins.abx[i] = seg.AB.x(), bins.aby[i] = seg.AB.y(), bins.abz[i] = seg.AB.z();
+            bins.length2[i] = seg.length2;
+            bins.innerRadius[i] = innerRadius;
+            bins.outerRadius[i] = outerRadius;
+            bins.outerRadius2[i] = outerRadius * outerRadius;
+        }
+    }
+}
+
+void
+osgEarth::Internal::nearestPointsOnSegments(
+    double px, double py,
+    const SegmentBins& bins,
+    unsigned begin, unsigned end,
+    double* t,
+    double* D2)
+{
+    const double* ax = bins.ax.data();
+    const double* ay = bins.ay.data();
+    const double* az = bins.az.data();
+    const double* abx = bins.abx.data();
+    const double* aby = bins.aby.data();
+    const double* abz = bins.abz.data();
+    const double* length2 = bins.length2.data();
+
+    for (unsigned i = begin; i < end; ++i)
+    {
+        double apx = px - ax[i], apy = py - ay[i], apz = 0.0 - az[i];
+        double L2 = length2[i];
+
+        // zero-length segment: t = 0, and the projection below reduces to A
+        double tt = (apx * abx[i] + apy * aby[i] + apz * abz[i]) / (L2 == 0.0 ? 1.0 : L2);
+        tt = L2 == 0.0 ? 0.0 : clamp(tt, 0.0, 1.0);
+
+        double dx = px - (ax[i] + abx[i] * tt);
+        double dy = py - (ay[i] + aby[i] * tt);
+        double dz = 0.0 - (az[i] + abz[i] * tt);
+
+        t[i - begin] = tt;
+        D2[i - begin] = dx * dx + dy * dy + dz * dz;
+    }
+}
+
+//........................................................................
+
 Config
 FlatteningLayer::Options::getConfig() const
 {
@@ -407,6 +407,30 @@ namespace osgEarth
 
         return (err == CE_None);
     }
+
+    // Reads a window 1:1 from one level of a tiled GeoTIFF (no resampling).
+    // Scale and offset come from the full-resolution band.
+    bool rasterIOCOG(
+        GDALRasterBand* band,
+        int overview,
+        int xoff,
+        int yoff,
+        void* pData,
+        int nBufXSize,
+        int nBufYSize,
+        GDALDataType eBufType)
+    {
+        GDALRasterBand* level = overview < 0 ? band : band->GetOverview(overview);
+        if (!level)
+            return false;
+
+        CPLErr err = level->RasterIO(GF_Read, xoff, yoff, nBufXSize, nBufYSize, pData, nBufXSize, nBufYSize, eBufType, 0, 0, nullptr);
+        if (err != CE_None)
+            return false;
+
+        applyScaleAndOffset(band, pData, eBufType, nBufXSize, nBufYSize);
+        return true;
+    }
 } // namespace osgEarth
 
 //...................................................................
@@ -498,6 +522,17 @@ GDAL::Driver::open(
                 input = found;
         }
 
+        // Let the GeoTIFF driver decode the blocks of a multi-block read in
+        // parallel. The setting is read when the dataset opens.
+        std::string oldNumThreads;
+        bool setNumThreads = gdalOptions().useCOG() == true && gdalOptions().cogThreads().get() > 1u;
+        if (setNumThreads)
+        {
+            const char* value = CPLGetThreadLocalConfigOption("GDAL_NUM_THREADS", nullptr);
+            if (value) oldNumThreads = value;
+            CPLSetThreadLocalConfigOption("GDAL_NUM_THREADS", std::to_string(gdalOptions().cogThreads().get()).c_str());
+        }
+
         // Create the source dataset:
         _srcDS = (GDALDataset*)GDALOpen(input.c_str(), GA_ReadOnly);
         if (_srcDS)
@@ -518,6 +553,11 @@ GDAL::Driver::open(
             }
         }
 
+        if (setNumThreads)
+        {
+            CPLSetThreadLocalConfigOption("GDAL_NUM_THREADS", oldNumThreads.empty() ? nullptr : oldNumThreads.c_str());
+        }
+
         if (!_srcDS)
         {
             return Status::Error(Status::ResourceUnavailable, Stringify() << "Failed to open " << input);
@@ -666,6 +706,8 @@ GDAL::Driver::open(
         OE_DEBUG << LC << "GDALInvGeoTransform failed" << std::endl;
     }
 
+    initCOG(verbose);
+
     int ds_ysize = _warpedDS->GetRasterYSize();
     int ds_xsize = _warpedDS->GetRasterXSize();
 
@@ -972,6 +1014,105 @@ GDAL::Driver::intersects(const TileKey& key)
     return key.getExtent().intersects(_extents);
 }
 
+void
+GDAL::Driver::initCOG(bool verbose)
+{
+    _cogLevels.clear();
+    _cogAdviseRead = false;
+
+    // Only applies when reading the source directly (no warping)
+    if (gdalOptions().useCOG() == false || _warpedDS != _srcDS || _srcDS->GetRasterCount() < 1)
+        return;
+
+    GDALDriverH driver = GDALGetDatasetDriver(_srcDS);
+    if (!driver || !ciEquals(GDALGetDriverShortName(driver), "GTiff"))
+        return;
+
+    // Strip-organized files have full-width blocks; those don't benefit.
+    GDALRasterBand* band = _srcDS->GetRasterBand(1);
+    int blockX = 0, blockY = 0;
+    band->GetBlockSize(&blockX, &blockY);
+    if (blockX <= 1 || blockY <= 1 || (blockX >= band->GetXSize() && blockX != blockY))
+        return;
+
+    _cogLevels.push_back({ -1, band->GetXSize(), band->GetYSize(), 1.0, 1.0 });
+
+    for (int i = 0; i < band->GetOverviewCount(); ++i)
+    {
+        GDALRasterBand* overview = band->GetOverview(i);
+        if (overview && overview->GetXSize() > 0 && overview->GetYSize() > 0)
+        {
+            _cogLevels.push_back({ i, overview->GetXSize(), overview->GetYSize(),
+                (double)band->GetXSize() / (double)overview->GetXSize(),
+                (double)band->GetYSize() / (double)overview->GetYSize() });
+        }
+    }
+
+    // Over a network file system, tell GDAL up front which blocks a read
+    // will need so it can fetch them with merged range requests.
+    std::string description = _srcDS->GetDescription();
+    _cogAdviseRead = startsWith(description, "/vsi") && !startsWith(description, "/vsimem/");
+
+    if (verbose)
+    {
+        OE_INFO << LC << getName() << ": tiled GeoTIFF, " << blockX << "x" << blockY
+            << " blocks, " << (_cogLevels.size() - 1) << " overviews" << std::endl;
+    }
+}
+
+bool
+GDAL::Driver::findCOGWindow(double x, double y, double w, double h, int bufW, int bufH, int& overview, int& xoff, int& yoff) const
+{
+    if (_cogLevels.empty() || bufW <= 0 || bufH <= 0)
+        return false;
+
+    // pixels of the full-resolution raster per output pixel:
+    double scaleX = w / (double)bufW;
+    double scaleY = h / (double)bufH;
+
+    for (auto& level : _cogLevels)
+    {
+        if (!equivalent(scaleX, level.scaleX, level.scaleX * 1e-3) ||
+            !equivalent(scaleY, level.scaleY, level.scaleY * 1e-3))
+        {
+            continue;
+        }
+
+        // the window has to start on a pixel boundary of the level:
+        double lx = x / level.scaleX;
+        double ly = y / level.scaleY;
+        if (!equivalent(lx, std::round(lx), 1e-3) || !equivalent(ly, std::round(ly), 1e-3))
+            return false;
+
+        xoff = (int)std::round(lx);
+        yoff = (int)std::round(ly);
+        if (xoff < 0 || yoff < 0 || xoff + bufW > level.width || yoff + bufH > level.height)
+            return false;
+
+        overview = level.overview;
+        return true;
+    }
+
+    return false;
+}
+
+void
+GDAL::Driver::adviseRead(double x, double y, double w, double h, int bufW, int bufH)
+{
+    if (!_cogAdviseRead)
+        return;
+
+    int x0 = (int)floor(x), y0 = (int)floor(y);
+    int x1 = std::min((int)ceil(x + w), _srcDS->GetRasterXSize());
+    int y1 = std::min((int)ceil(y + h), _srcDS->GetRasterYSize());
+    if (x1 <= x0 || y1 <= y0)
+        return;
+
+    // The GeoTIFF driver picks the matching overview and fetches all the
+    // blocks for all the bands, merging adjacent byte ranges.
+    _srcDS->AdviseRead(x0, y0, x1 - x0, y1 - y0, bufW, bufH, GDT_Byte, _srcDS->GetRasterCount(), nullptr, nullptr);
+}
+
 osg::Image*
 GDAL::Driver::createImage(const TileKey& key,
     unsigned tileSize,
@@ -1116,6 +1257,21 @@ GDAL::Driver::createImage(const TileKey& key,
 
 
 
+    // Tiles that line up with a level of a tiled GeoTIFF are read directly
+    // from that level; anything else goes through a resampling RasterIO.
+    int cogOverview = -1, cogX = 0, cogY = 0;
+    bool cogWindow = findCOGWindow(src_min_x, src_min_y, src_width, src_height, target_width, target_height, cogOverview, cogX, cogY);
+
+    auto readWindow = [&](GDALRasterBand* band, void* data, GDALDataType type, RasterInterpolation interpolation)
+    {
+        if (cogWindow && rasterIOCOG(band, cogOverview, cogX, cogY, data, target_width, target_height, type))
+            return true;
+
+        return rasterIO(band, GF_Read, src_min_x, src_min_y, src_width, src_height, data, target_width, target_height, type, 0, 0, interpolation);
+    };
+
+    adviseRead(src_min_x, src_min_y, src_width, src_height, target_width, target_height);
+
     //The pixel format is always RGBA to support transparency
     GLenum pixelFormat = GL_RGBA;
 
@@ -1137,13 +1293,13 @@ GDAL::Driver::createImage(const TileKey& key,
         image->allocateImage(tileSize, tileSize, 1, pixelFormat, GL_UNSIGNED_BYTE);
         memset(image->data(), 0, image->getImageSizeInBytes());
 
-        rasterIO(bandRed, GF_Read, src_min_x, src_min_y, src_width, src_height, red.data(), target_width, target_height, GDT_Byte, 0, 0, gdalOptions().interpolation().get());
-        rasterIO(bandGreen, GF_Read, src_min_x, src_min_y, src_width, src_height, green.data(), target_width, target_height, GDT_Byte, 0, 0, gdalOptions().interpolation().get());
-        rasterIO(bandBlue, GF_Read, src_min_x, src_min_y, src_width, src_height, blue.data(), target_width, target_height, GDT_Byte, 0, 0, gdalOptions().interpolation().get());
+        readWindow(bandRed, red.data(), GDT_Byte, gdalOptions().interpolation().get());
+        readWindow(bandGreen, green.data(), GDT_Byte, gdalOptions().interpolation().get());
+        readWindow(bandBlue, blue.data(), GDT_Byte, gdalOptions().interpolation().get());
 
         if (bandAlpha)
         {
-            rasterIO(bandAlpha, GF_Read, src_min_x, src_min_y, src_width, src_height, alpha.data(), target_width, target_height, GDT_Byte, 0, 0, gdalOptions().interpolation().get());
+            readWindow(bandAlpha, alpha.data(), GDT_Byte, gdalOptions().interpolation().get());
         }
 
         for (int src_row = 0, dst_row = tile_offset_top;
@@ -1206,7 +1362,7 @@ GDAL::Driver::createImage(const TileKey& key,
             if (!success)
                 nodata = NO_DATA_VALUE;
 
-            if (rasterIO(bandGray, GF_Read, src_min_x, src_min_y, src_width, src_height, data.data(), target_width, target_height, gdalDataType, 0, 0, INTERP_NEAREST))
+            if (readWindow(bandGray, data.data(), gdalDataType, INTERP_NEAREST))
             {
                 // copy from data to image.
                 for (int src_row = 0, dst_row = tile_offset_top; src_row < target_height; src_row++, dst_row++)
@@ -1253,11 +1409,11 @@ GDAL::Driver::createImage(const TileKey& key,
             memset(image->data(), 0, image->getImageSizeInBytes());
 
 
-            rasterIO(bandGray, GF_Read, src_min_x, src_min_y, src_width, src_height, gray.data(), target_width, target_height, GDT_Byte, 0, 0, gdalOptions().interpolation().get());
+            readWindow(bandGray, gray.data(), GDT_Byte, gdalOptions().interpolation().get());
 
             if (bandAlpha)
             {
-                rasterIO(bandAlpha, GF_Read, src_min_x, src_min_y, src_width, src_height, alpha.data(), target_width, target_height, GDT_Byte, 0, 0, gdalOptions().interpolation().get());
+                readWindow(bandAlpha, alpha.data(), GDT_Byte, gdalOptions().interpolation().get());
             }
 
             for (int src_row = 0, dst_row = tile_offset_top;
@@ -1309,7 +1465,7 @@ GDAL::Driver::createImage(const TileKey& key,
             memset(image->data(), 0, image->getImageSizeInBytes());
         }
 
-        rasterIO(bandPalette, GF_Read, src_min_x, src_min_y, src_width, src_height, palette.data(), target_width, target_height, GDT_Byte, 0, 0, INTERP_NEAREST);
+        readWindow(bandPalette, palette.data(), GDT_Byte, INTERP_NEAREST);
 
         ImageUtils::PixelWriter write(image.get());
 
@@ -1467,9 +1623,30 @@ GDAL::Driver::createHeightField(const TileKey& key, unsigned tileSize, ProgressC
             row_min = clamp(row_min, 0.0, (double)band->GetYSize() - 1.0);
             row_max = clamp(row_max, 0.0, (double)band->GetYSize() - 1.0);
 
-            auto read_error = band->RasterIO(GF_Read,
-                (int)col_min, (int)row_min,
-                (int)col_max - (int)col_min + 1, (int)row_max - (int)row_min + 1,
+            int win_x = (int)col_min, win_y = (int)row_min;
+            int win_width = (int)col_max - (int)col_min + 1;
+            int win_height = (int)row_max - (int)row_min + 1;
+
+            adviseRead(win_x, win_y, win_width, win_height, tileSize, tileSize);
+
+            // If the window lines up with a level of a tiled GeoTIFF,
+            // read that level 1:1 instead of decimating the full resolution.
+            GDALRasterBand* source = band;
+            int cogOverview = -1, cogX = 0, cogY = 0;
+            if (findCOGWindow(win_x, win_y, win_width, win_height, tileSize, tileSize, cogOverview, cogX, cogY))
+            {
+                GDALRasterBand* level = cogOverview < 0 ? band : band->GetOverview(cogOverview);
+                if (level)
+                {
+                    source = level;
+                    win_x = cogX, win_y = cogY;
+                    win_width = tileSize, win_height = tileSize;
+                }
+            }
+
+            auto read_error = source->RasterIO(GF_Read,
+                win_x, win_y,
+                win_width, win_height,
                 (void*)hf_raw, tileSize, tileSize,
                 GDT_Float32, 0, 0);
 
@@ -1644,6 +1821,8 @@ GDAL::Options::readFrom(const Config& conf)
     conf.get("single_threaded", singleThreaded());
     conf.get("use_vrt", useVRT());
     conf.get("fallback_profile", fallbackProfile());
+    conf.get("use_cog", useCOG());
+    conf.get("cog_threads", cogThreads());
 
     // report on deprecated usage
     const std::string deprecated_keys[] = {
@@ -1669,6 +1848,8 @@ GDAL::Options::writeTo(Config& conf) const
     conf.set("coverage_uses_palette_index", coverageUsesPaletteIndex());
     conf.set("single_threaded", singleThreaded());
     conf.set("fallback_profile", fallbackProfile());
+    conf.set("use_cog", useCOG());
+    conf.set("cog_threads", cogThreads());
 }
 
 //......................................................................
@@ -1742,6 +1923,7 @@ OE_LAYER_PROPERTY_IMPL(GDALImageLayer, URI, URL, url);
 OE_LAYER_PROPERTY_IMPL(GDALImageLayer, std::string, Connection, connection);
 OE_LAYER_PROPERTY_IMPL(GDALImageLayer, unsigned, SubDataSet, subDataSet);
 OE_LAYER_PROPERTY_IMPL(GDALImageLayer, RasterInterpolation, Interpolation, interpolation);
+OE_LAYER_PROPERTY_IMPL(GDALImageLayer, bool, UseCOG, useCOG);
 
 
 void GDALImageLayer::setSingleThreaded(bool value) { options().singleThreaded() = value; }
@@ -1885,6 +2067,7 @@ OE_LAYER_PROPERTY_IMPL(GDALElevationLayer, std::string, Connection, connection);
 OE_LAYER_PROPERTY_IMPL(GDALElevationLayer, unsigned, SubDataSet, subDataSet);
 OE_LAYER_PROPERTY_IMPL(GDALElevationLayer, RasterInterpolation, Interpolation, interpolation);
 OE_LAYER_PROPERTY_IMPL(GDALElevationLayer, bool, UseVRT, useVRT);
+OE_LAYER_PROPERTY_IMPL(GDALElevationLayer, bool, UseCOG, useCOG);
 
 void GDALElevationLayer::setSingleThreaded(bool value) { options().singleThreaded() = value; }
 bool GDALElevationLayer::getSingleThreaded() const { return options().singleThreaded().get(); }
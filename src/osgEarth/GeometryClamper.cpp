@@ -4,7 +4,12 @@
  */
 #include <osgEarth/GeometryClamper>
 #include <osgEarth/LineDrawable>
+#include <osgEarth/TerrainTileNode>
 #include <osg/Geometry>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <mutex>
 
 #define LC "[GeometryClamper] "
 
@@ -27,6 +32,55 @@ _offset( 0.0f )
     _lsi = new osgUtil::LineSegmentIntersector(osg::Vec3d(0,0,0), osg::Vec3d(0,0,0));
 }
 
+void
+GeometryClamper::setTerrainTile(const TileKey& key, osg::Node* tile)
+{
+    _tileKey = key;
+    _terrainPatch = tile;
+}
+
+void
+GeometryClamper::index(GeometryData& data, const osg::Matrixd& local2world) const
+{
+    // Locate the original (unclamped) vertices in the terrain SRS.
+    const osg::Vec3Array& verts = *data._verts;
+    const Ellipsoid& em = _terrainSRS->getEllipsoid();
+    bool isGeocentric = _terrainSRS->isGeographic();
+
+    data._coords.resize(verts.size());
+    data._min.set(DBL_MAX, DBL_MAX);
+    data._max.set(-DBL_MAX, -DBL_MAX);
+
+    for (unsigned k = 0; k < verts.size(); ++k)
+    {
+        osg::Vec3d vw = osg::Vec3d(verts[k]) * local2world;
+        osg::Vec2d p;
+        if (isGeocentric)
+        {
+            osg::Vec3d lla = em.geocentricToGeodetic(vw);
+            p.set(lla.x(), lla.y());
+        }
+        else
+        {
+            p.set(vw.x(), vw.y());
+        }
+
+        data._coords[k] = p;
+        data._min.set(std::min(data._min.x(), p.x()), std::min(data._min.y(), p.y()));
+        data._max.set(std::max(data._max.x(), p.x()), std::max(data._max.y(), p.y()));
+    }
+
+    data._order.resize(verts.size());
+    for (unsigned k = 0; k < verts.size(); ++k)
+        data._order[k] = k;
+
+    std::sort(data._order.begin(), data._order.end(),
+        [&](unsigned a, unsigned b) { return data._coords[a].x() < data._coords[b].x(); });
+
+    data._local2world = local2world;
+    data._indexed = true;
+}
+
 void
 GeometryClamper::apply(osg::Transform& xform)
 {
@@ -110,42 +164,153 @@ GeometryClamper::apply(osg::Drawable& drawable)
     // Use the vertex array on the geometry as the lookup instead of the verts array as it might be a temporary array for a LineDrawable.
     GeometryData& data = _localData[&drawable];
 
-    bool storeAltitudes = false;
-
     if (!data._verts.valid() || data._verts->size() != verts->size())
     {
         data._verts = osg::clone(verts.get(), osg::CopyOp::DEEP_COPY_ALL);
         data._altitudes = new osg::FloatArray();
         data._altitudes->reserve(verts->size());
-        storeAltitudes = true;
+        data._indexed = false;
+
+        for (unsigned k = 0; k < verts->size(); ++k)
+        {
+            if (isGeocentric)
+            {
+                // should really be the alt along the n_vector but leave for now
+                // since most scene-clamped geometry will be in relative to a
+                // local tangent plane anyway -gw
+                data._altitudes->push_back((*verts)[k].z());
+            }
+            else
+            {
+                osg::Vec3d vw = osg::Vec3d((*verts)[k]) * local2world;
+                data._altitudes->push_back(float(vw.z()) - _offset);
+            }
+        }
     }
 
-    for( unsigned k=0; k<verts->size(); ++k )
+    // Pick the vertices to clamp. A tile update only touches the vertices
+    // inside the tile, found through the drawable's index.
+    std::vector<unsigned> subset;
+    const std::vector<unsigned>* indices = nullptr;
+
+    osg::ref_ptr<const osg::Image> raster;
+    osg::Matrixd rasterMatrix;
+    GeoExtent tileExtent;
+
+    if (_tileKey.valid())
     {
-        osg::Vec3d vw = (*verts)[k];
-        vw = vw * local2world;
+        if (!data._indexed || data._local2world != local2world)
+        {
+            index(data, local2world);
+        }
 
-        if ( isGeocentric )
+        tileExtent = _tileKey.getExtent();
+        bool sameSRS = tileExtent.getSRS()->isHorizEquivalentTo(_terrainSRS.get());
+        if (!sameSRS)
         {
-            // normal to the ellipsoid:
-            n_vector = em.geocentricToUpVector(vw);
+            tileExtent = tileExtent.transform(_terrainSRS.get());
+        }
 
-            // if we need to store the original altitudes:
-            if (storeAltitudes)
+        if (!tileExtent.isValid() ||
+            data._max.x() < tileExtent.xMin() || data._min.x() > tileExtent.xMax() ||
+            data._max.y() < tileExtent.yMin() || data._min.y() > tileExtent.yMax())
+        {
+            return;
+        }
+
+        auto first = std::lower_bound(data._order.begin(), data._order.end(), tileExtent.xMin(),
+            [&](unsigned i, double x) { return data._coords[i].x() < x; });
+        auto last = std::upper_bound(first, data._order.end(), tileExtent.xMax(),
+            [&](double x, unsigned i) { return x < data._coords[i].x(); });
+
+        for (auto i = first; i != last; ++i)
+        {
+            double y = data._coords[*i].y();
+            if (y >= tileExtent.yMin() && y <= tileExtent.yMax())
+                subset.push_back(*i);
+        }
+
+        if (subset.empty())
+            return;
+
+        indices = &subset;
+
+        // the tile's own elevation raster, when the engine exposes one we can read
+        auto* tile = dynamic_cast<const TerrainTile*>(_terrainPatch.get());
+        if (tile && sameSRS)
+        {
+            raster = tile->getElevationRaster();
+            if (raster.valid() &&
+                raster->data() != nullptr &&
+                raster->getPixelFormat() == GL_RED &&
+                raster->getDataType() == GL_FLOAT &&
+                raster->s() > 1 && raster->t() > 1)
             {
-                // should really be the alt along the n_vector but leave for now
-                // since most scene-clamped geometry will be in relative to a
-                // local tangent plane anyway -gw
-                data._altitudes->push_back( (*verts)[k].z() );
+                rasterMatrix = tile->getElevationMatrix();
+            }
+            else
+            {
+                raster = nullptr;
             }
         }
+    }
 
-        else
+    unsigned numVerts = indices ? (unsigned)indices->size() : (unsigned)verts->size();
+
+    for( unsigned i=0; i<numVerts; ++i )
+    {
+        unsigned k = indices ? (*indices)[i] : i;
+
+        osg::Vec3d vw = (*verts)[k];
+        vw = vw * local2world;
+
+        if (raster.valid())
         {
-            if (storeAltitudes)
+            // bilinear sample of the raster at the vertex's tile coordinates
+            const osg::Vec2d& p = data._coords[k];
+            osg::Vec3d uv = osg::Vec3d(
+                (p.x() - tileExtent.xMin()) / tileExtent.width(),
+                (p.y() - tileExtent.yMin()) / tileExtent.height(),
+                0.0) * rasterMatrix;
+
+            double sf = osg::clampBetween(uv.x(), 0.0, 1.0) * (double)(raster->s() - 1);
+            double tf = osg::clampBetween(uv.y(), 0.0, 1.0) * (double)(raster->t() - 1);
+            int s0 = std::min((int)sf, raster->s() - 2);
+            int t0 = std::min((int)tf, raster->t() - 2);
+            double ds = sf - (double)s0, dt = tf - (double)t0;
+
+            const float* row0 = reinterpret_cast<const float*>(raster->data(0, t0));
+            const float* row1 = reinterpret_cast<const float*>(raster->data(0, t0 + 1));
+            float h00 = row0[s0], h10 = row0[s0 + 1], h01 = row1[s0], h11 = row1[s0 + 1];
+
+            if (h00 == NO_DATA_VALUE || h10 == NO_DATA_VALUE || h01 == NO_DATA_VALUE || h11 == NO_DATA_VALUE)
+                continue;
+
+            double h =
+                ((double)h00 * (1.0 - ds) + (double)h10 * ds) * (1.0 - dt) +
+                ((double)h01 * (1.0 - ds) + (double)h11 * ds) * dt;
+
+            h += _offset;
+
+            if (_useVertexZ)
             {
-                data._altitudes->push_back( float(vw.z()) - _offset);
+                h += (*data._altitudes)[k];
             }
+
+            osg::Vec3d fw = isGeocentric ?
+                em.geodeticToGeocentric(osg::Vec3d(p.x(), p.y(), h)) :
+                osg::Vec3d(p.x(), p.y(), h);
+
+            (*verts)[k] = (fw * world2local);
+            geomDirty = true;
+            ++count;
+            continue;
+        }
+
+        if ( isGeocentric )
+        {
+            // normal to the ellipsoid:
+            n_vector = em.geocentricToUpVector(vw);
         }
 
         _lsi->reset();
@@ -207,6 +372,127 @@ GeometryClamper::apply(osg::Drawable& drawable)
 }
 
 
+//-----------------------------------------------------------------------
+
+namespace
+{
+    // Per-frame time budget shared by every DirtyTiles queue
+    struct FrameBudget
+    {
+        std::mutex mutex;
+        double milliseconds = 2.0;
+        unsigned frame = ~0u;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    FrameBudget& frameBudget()
+    {
+        static FrameBudget s_budget;
+        return s_budget;
+    }
+
+    bool hasFrameBudget(const osg::FrameStamp* stamp)
+    {
+        if (!stamp)
+            return true;
+
+        auto& budget = frameBudget();
+        std::lock_guard<std::mutex> lock(budget.mutex);
+
+        auto now = std::chrono::steady_clock::now();
+
+        // the first request in a new frame starts its clock, so every
+        // frame makes some progress
+        if (budget.frame != stamp->getFrameNumber())
+        {
+            budget.frame = stamp->getFrameNumber();
+            budget.start = now;
+            return true;
+        }
+
+        return std::chrono::duration<double, std::milli>(now - budget.start).count() < budget.milliseconds;
+    }
+}
+
+void
+GeometryClamper::setFrameBudget(double milliseconds)
+{
+    auto& budget = frameBudget();
+    std::lock_guard<std::mutex> lock(budget.mutex);
+    budget.milliseconds = milliseconds;
+}
+
+double
+GeometryClamper::getFrameBudget()
+{
+    auto& budget = frameBudget();
+    std::lock_guard<std::mutex> lock(budget.mutex);
+    return budget.milliseconds;
+}
+
+void
+GeometryClamper::DirtyTiles::push(const TileKey& key, osg::Node* tile)
+{
+    if (_all)
+        return;
+
+    if (!key.valid())
+    {
+        _all = true;
+        _tiles.clear();
+        return;
+    }
+
+    // a newer update of a queued tile replaces the older one
+    for (auto& entry : _tiles)
+    {
+        if (entry.first == key)
+        {
+            entry.second = tile;
+            return;
+        }
+    }
+
+    _tiles.emplace_back(key, tile);
+}
+
+void
+GeometryClamper::DirtyTiles::clear()
+{
+    _all = false;
+    _tiles.clear();
+}
+
+void
+GeometryClamper::DirtyTiles::drain(
+    const osg::FrameStamp* stamp,
+    const std::function<void(const TileKey&, osg::Node*)>& func)
+{
+    if (_all)
+    {
+        if (hasFrameBudget(stamp))
+        {
+            _all = false;
+            func(TileKey::INVALID, nullptr);
+        }
+        return;
+    }
+
+    unsigned i = 0;
+    for (; i < _tiles.size() && hasFrameBudget(stamp); ++i)
+    {
+        // tiles that have since left the scene graph have nothing to offer
+        osg::ref_ptr<osg::Node> tile;
+        if (_tiles[i].second.lock(tile))
+        {
+            func(_tiles[i].first, tile.get());
+        }
+    }
+    _tiles.erase(_tiles.begin(), _tiles.begin() + i);
+}
+
+//-----------------------------------------------------------------------
+
 void
 GeometryClamperCallback::onTileUpdate(const TileKey&          key,
                                      osg::Node*              tile,
@@ -20,11 +20,16 @@
 #include <osgEarth/ShaderGenerator>
 #include <osgEarth/ShaderUtils>
 #include <osgEarth/Metrics>
+#include <osgEarth/Threading>
+#include <osgEarth/MeshOptimizer>
 
 #include <osg/KdTree>
+#include <algorithm>
 
 #define LC "[GeometryCompiler] "
 
+#define ARENA_GEOMETRY_COMPILER "oe.geometrycompiler"
+
 using namespace osgEarth;
 using namespace osgEarth::Util;
 using namespace osgEarth::Util;
@@ -56,7 +61,12 @@ _optimizeVertexOrdering( true ),
 _validate              ( false ),
 _maxPolyTilingAngle    ( 45.0f ),
 _useOSGTessellator     ( false ),
-_buildKDTrees          ( true )
+_buildKDTrees          ( true ),
+_parallelCompile       ( false ),
+_parallelChunkSize     ( 1000u ),
+_optimizeMeshes        ( false ),
+_meshLODLevels         ( 0u ),
+_meshLODRatio          ( 0.5f )
 {
     //nop
 }
@@ -77,7 +87,12 @@ _optimizeVertexOrdering( s_defaults.optimizeVertexOrdering().value() ),
 _validate              ( s_defaults.validate().value() ),
 _maxPolyTilingAngle    ( s_defaults.maxPolygonTilingAngle().value() ),
 _useOSGTessellator     (s_defaults.useOSGTessellator().value()),
-_buildKDTrees          ( s_defaults.buildKDTrees().value() )
+_buildKDTrees          ( s_defaults.buildKDTrees().value() ),
+_parallelCompile       ( s_defaults.parallelCompile().value() ),
+_parallelChunkSize     ( s_defaults.parallelChunkSize().value() ),
+_optimizeMeshes        ( s_defaults.optimizeMeshes().value() ),
+_meshLODLevels         ( s_defaults.meshLODLevels().value() ),
+_meshLODRatio          ( s_defaults.meshLODRatio().value() )
 {
     fromConfig(conf.getConfig());
 }
@@ -100,6 +115,11 @@ GeometryCompilerOptions::fromConfig( const Config& conf )
     conf.get( "max_polygon_tiling_angle", _maxPolyTilingAngle );
     conf.get( "use_osg_tessellator", _useOSGTessellator);
     conf.get( "build_kdtrees", _buildKDTrees );
+    conf.get( "parallel_compile", _parallelCompile );
+    conf.get( "parallel_chunk_size", _parallelChunkSize );
+    conf.get( "optimize_meshes", _optimizeMeshes );
+    conf.get( "mesh_lod_levels", _meshLODLevels );
+    conf.get( "mesh_lod_ratio", _meshLODRatio );
 
     conf.get( "shader_policy", "disable",  _shaderPolicy, SHADERPOLICY_DISABLE );
     conf.get( "shader_policy", "inherit",  _shaderPolicy, SHADERPOLICY_INHERIT );
@@ -125,6 +145,11 @@ GeometryCompilerOptions::getConfig() const
     conf.set( "max_polygon_tiling_angle", _maxPolyTilingAngle );
     conf.set( "use_osg_tessellator", _useOSGTessellator);
     conf.set( "build_kdtrees", _buildKDTrees );
+    conf.set( "parallel_compile", _parallelCompile );
+    conf.set( "parallel_chunk_size", _parallelChunkSize );
+    conf.set( "optimize_meshes", _optimizeMeshes );
+    conf.set( "mesh_lod_levels", _meshLODLevels );
+    conf.set( "mesh_lod_ratio", _meshLODRatio );
 
     conf.set( "shader_policy", "disable",  _shaderPolicy, SHADERPOLICY_DISABLE );
     conf.set( "shader_policy", "inherit",  _shaderPolicy, SHADERPOLICY_INHERIT );
@@ -200,6 +225,236 @@ GeometryCompiler::compile(FeatureCursor*        cursor,
     return compile(workingSet, style, context);
 }
 
+namespace
+{
+    // Symbols that drive the per-feature filters, including any
+    // defaults picked for an empty style.
+    struct FilterSymbols
+    {
+        const PointSymbol*     point;
+        const LineSymbol*      line;
+        const PolygonSymbol*   polygon;
+        const ExtrusionSymbol* extrusion;
+        const AltitudeSymbol*  altitude;
+        const TextSymbol*      text;
+        const IconSymbol*      icon;
+        const ModelSymbol*     model;
+        const RenderSymbol*    render;
+    };
+
+    // Runs the per-feature filter chain on a set of features and adds the
+    // resulting nodes to "output". Everything here only touches the features
+    // in "workingSet", so disjoint sets can run concurrently.
+    void runFilters(
+        FeatureList&                   workingSet,
+        const Style&                   style,
+        const FilterSymbols&           sym,
+        const GeometryCompilerOptions& options,
+        FilterContext&                 sharedCX,
+        osg::Group*                    output,
+        std::vector<std::string>*      history)
+    {
+        // Perform tessellation first.
+        if ( sym.line )
+        {
+            if ( sym.line->tessellation().isSet() )
+            {
+                TessellateOperator filter;
+                filter.setNumPartitions( *sym.line->tessellation() );
+                filter.setDefaultGeoInterp( options.geoInterp().get() );
+                sharedCX = filter.push( workingSet, sharedCX );
+                if ( history ) history->push_back( "tessellation" );
+            }
+            else if ( sym.line->tessellationSize().isSet() )
+            {
+                TessellateOperator filter;
+                filter.setMaxPartitionSize( *sym.line->tessellationSize() );
+                filter.setDefaultGeoInterp( options.geoInterp().get() );
+                sharedCX = filter.push( workingSet, sharedCX );
+                if ( history ) history->push_back( "tessellationSize" );
+            }
+        }
+
+        // resample the geometry if necessary:
+        // @deprecated, remove this, dupe of the ResampleFilter
+        if (options.resampleMode().isSet())
+        {
+            ResampleFilter resample;
+            resample.resampleMode() = *options.resampleMode();
+            if (options.resampleMaxLength().isSet())
+            {
+                resample.maxLength() = *options.resampleMaxLength();
+            }
+            sharedCX = resample.push( workingSet, sharedCX );
+            if ( history ) history->push_back( "resample" );
+        }
+
+        // check whether we need to do elevation adjustment:
+        bool altRequired =
+            options.ignoreAltitudeSymbol() != true &&
+            sym.altitude && (
+                sym.altitude->clamping() != AltitudeSymbol::CLAMP_NONE ||
+                sym.altitude->verticalOffset().isSet() ||
+                sym.altitude->verticalScale().isSet() ||
+                sym.altitude->script().isSet() );
+
+        // instance substitution:
+        if ( sym.model )
+        {
+            const InstanceSymbol* instance = (const InstanceSymbol*)sym.model;
+
+            // use a separate filter context since we'll be munging the data
+            FilterContext localCX = sharedCX;
+
+            if ( history ) history->push_back( "model");
+
+            if ( instance->placement() == InstanceSymbol::PLACEMENT_RANDOM   ||
+                 instance->placement() == InstanceSymbol::PLACEMENT_INTERVAL )
+            {
+                ScatterFilter scatter;
+                scatter.setDensity( *instance->density() );
+                scatter.setRandom( instance->placement() == InstanceSymbol::PLACEMENT_RANDOM );
+                scatter.setRandomSeed( *instance->randomSeed() );
+                localCX = scatter.push( workingSet, localCX );
+                if ( history ) history->push_back( "scatter" );
+            }
+            else if ( instance->placement() == InstanceSymbol::PLACEMENT_CENTROID )
+            {
+                CentroidFilter centroid;
+                localCX = centroid.push( workingSet, localCX );
+                if ( history ) history->push_back( "centroid" );
+            }
+
+            if ( altRequired )
+            {
+                AltitudeFilter clamp;
+                clamp.setPropertiesFromStyle( style );
+                localCX = clamp.push( workingSet, localCX );
+                if ( history ) history->push_back( "altitude" );
+            }
+
+            SubstituteModelFilter sub( style );
+
+            // activate clustering
+            sub.setClustering( *options.clustering() );
+
+            // activate draw-instancing
+            sub.setUseDrawInstanced( *options.instancing() );
+
+            // activate feature naming
+            if ( options.featureName().isSet() )
+                sub.setFeatureNameExpr( *options.featureName() );
+
+
+            osg::Node* node = sub.push( workingSet, localCX );
+            if ( node )
+            {
+                if ( history ) history->push_back( "substitute" );
+
+                output->addChild( node );
+            }
+        }
+
+        // extruded geometry
+        if ( sym.extrusion )
+        {
+            if ( altRequired )
+            {
+                AltitudeFilter clamp;
+                clamp.setPropertiesFromStyle( style );
+                sharedCX = clamp.push( workingSet, sharedCX );
+                if ( history ) history->push_back( "altitude" );
+                altRequired = false;
+            }
+
+            ExtrudeGeometryFilter extrude;
+            extrude.setStyle( style );
+
+            // apply per-feature naming if requested.
+            if ( options.featureName().isSet() )
+                extrude.setFeatureNameExpr( *options.featureName() );
+
+            if (options.mergeGeometry().isSet())
+                extrude.setMergeGeometry(*options.mergeGeometry());            
+
+            osg::Node* node = extrude.push( workingSet, sharedCX );
+            if ( node )
+            {
+                if ( history ) history->push_back( "extrude" );
+                output->addChild( node );
+            }
+        }
+
+        // simple geometry
+        else if ( sym.point || sym.line || sym.polygon )
+        {
+            if ( altRequired )
+            {
+                AltitudeFilter clamp;
+                clamp.setPropertiesFromStyle( style );
+                sharedCX = clamp.push( workingSet, sharedCX );
+                if ( history ) history->push_back( "altitude" );
+                altRequired = false;
+            }
+
+            BuildGeometryFilter filter( style );
+
+            filter.maxGranularity() = *options.maxGranularity();
+            filter.geoInterp() = *options.geoInterp();
+            filter.useOSGTessellator() = *options.useOSGTessellator();
+            filter.mergeGeometry() = *options.mergeGeometry();
+
+
+
+            if (options.maxPolygonTilingAngle().isSet())
+                filter.maxPolygonTilingAngle() = *options.maxPolygonTilingAngle();
+
+            if ( options.featureName().isSet() )
+                filter.featureName() = *options.featureName();
+
+            if (options.optimizeVertexOrdering().isSet())
+                filter.optimizeVertexOrdering() = *options.optimizeVertexOrdering();
+
+            if (sym.render && sym.render->maxCreaseAngle().isSet())
+                filter.maxCreaseAngle() = sym.render->maxCreaseAngle().get();
+
+            osg::Node* node = filter.push( workingSet, sharedCX );
+            if ( node )
+            {
+                if ( history ) history->push_back( "geometry" );
+                output->addChild( node );
+            }
+        }
+
+        if ( sym.text || sym.icon )
+        {
+            // Only clamp annotation types when the technique is
+            // explicity set to MAP. Otherwise, the annotation subsystem
+            // will automatically use SCENE clamping.
+            bool altRequiredForAnnotations =
+                altRequired &&
+                sym.altitude->technique().isSetTo(sym.altitude->TECHNIQUE_MAP);
+
+            if ( altRequiredForAnnotations )
+            {
+                AltitudeFilter clamp;
+                clamp.setPropertiesFromStyle( style );
+                sharedCX = clamp.push( workingSet, sharedCX );
+                if ( history ) history->push_back( "altitude" );
+                altRequired = false;
+            }
+
+            BuildTextFilter filter( style );
+            osg::Node* node = filter.push( workingSet, sharedCX );
+            if ( node )
+            {
+                if ( history ) history->push_back( "text" );
+                output->addChild( node );
+            }
+        }
+    }
+}
+
 osg::Node*
 GeometryCompiler::compile(FeatureList&          workingSet,
                           const Style&          style,
@@ -232,40 +487,20 @@ GeometryCompiler::compile(FeatureList&          workingSet,
     osg::ref_ptr<PolygonSymbol> defaultPolygon;
 
     // go through the Style and figure out which filters to use.
-    const PointSymbol*     point     = style.get<PointSymbol>();
-    const LineSymbol*      line      = style.get<LineSymbol>();
-    const PolygonSymbol*   polygon   = style.get<PolygonSymbol>();
-    const ExtrusionSymbol* extrusion = style.get<ExtrusionSymbol>();
-    const AltitudeSymbol*  altitude  = style.get<AltitudeSymbol>();
-    const TextSymbol*      text      = style.get<TextSymbol>();
-    const IconSymbol*      icon      = style.get<IconSymbol>();
-    const ModelSymbol*     model     = style.get<ModelSymbol>();
-    const RenderSymbol*    render    = style.get<RenderSymbol>();
-
-    // Perform tessellation first.
-    if ( line )
-    {
-        if ( line->tessellation().isSet() )
-        {
-            TessellateOperator filter;
-            filter.setNumPartitions( *line->tessellation() );
-            filter.setDefaultGeoInterp( _options.geoInterp().get() );
-            sharedCX = filter.push( workingSet, sharedCX );
-            if ( trackHistory ) history.push_back( "tessellation" );
-        }
-        else if ( line->tessellationSize().isSet() )
-        {
-            TessellateOperator filter;
-            filter.setMaxPartitionSize( *line->tessellationSize() );
-            filter.setDefaultGeoInterp( _options.geoInterp().get() );
-            sharedCX = filter.push( workingSet, sharedCX );
-            if ( trackHistory ) history.push_back( "tessellationSize" );
-        }
-    }
+    FilterSymbols sym;
+    sym.point     = style.get<PointSymbol>();
+    sym.line      = style.get<LineSymbol>();
+    sym.polygon   = style.get<PolygonSymbol>();
+    sym.extrusion = style.get<ExtrusionSymbol>();
+    sym.altitude  = style.get<AltitudeSymbol>();
+    sym.text      = style.get<TextSymbol>();
+    sym.icon      = style.get<IconSymbol>();
+    sym.model     = style.get<ModelSymbol>();
+    sym.render    = style.get<RenderSymbol>();
 
     // if the style was empty, use some defaults based on the geometry type of the
     // first feature.
-    if ( !point && !line && !polygon && !extrusion && !text && !model && !icon && workingSet.size() > 0 )
+    if ( !sym.point && !sym.line && !sym.polygon && !sym.extrusion && !sym.text && !sym.model && !sym.icon && workingSet.size() > 0 )
     {
         Feature* first = workingSet.begin()->get();
         Geometry* geom = first->getGeometry();
@@ -276,16 +511,16 @@ GeometryCompiler::compile(FeatureList&          workingSet,
             case Geometry::TYPE_LINESTRING:
             case Geometry::TYPE_RING:
                 defaultLine = new LineSymbol();
-                line = defaultLine.get();
+                sym.line = defaultLine.get();
                 break;
             case Geometry::TYPE_POINT:
             case Geometry::TYPE_POINTSET:
                 defaultPoint = new PointSymbol();
-                point = defaultPoint.get();
+                sym.point = defaultPoint.get();
                 break;
             case Geometry::TYPE_POLYGON:
                 defaultPolygon = new PolygonSymbol();
-                polygon = defaultPolygon.get();
+                sym.polygon = defaultPolygon.get();
                 break;
             case Geometry::TYPE_MULTI:
             case Geometry::TYPE_UNKNOWN:
@@ -294,187 +529,84 @@ GeometryCompiler::compile(FeatureList&          workingSet,
         }
     }
 
-    // resample the geometry if necessary:
-    // @deprecated, remove this, dupe of the ResampleFilter
-    if (_options.resampleMode().isSet())
-    {
-        ResampleFilter resample;
-        resample.resampleMode() = *_options.resampleMode();
-        if (_options.resampleMaxLength().isSet())
-        {
-            resample.maxLength() = *_options.resampleMaxLength();
-        }
-        sharedCX = resample.push( workingSet, sharedCX );
-        if ( trackHistory ) history.push_back( "resample" );
-    }
+    unsigned chunkSize = std::max(1u, _options.parallelChunkSize().get());
+    unsigned numChunks = (workingSet.size() + chunkSize - 1) / chunkSize;
 
-    // check whether we need to do elevation adjustment:
-    bool altRequired =
-        _options.ignoreAltitudeSymbol() != true &&
-        altitude && (
-            altitude->clamping() != AltitudeSymbol::CLAMP_NONE ||
-            altitude->verticalOffset().isSet() ||
-            altitude->verticalScale().isSet() ||
-            altitude->script().isSet() );
-
-    // instance substitution:
-    if ( model )
+    if (_options.parallelCompile() == true && numChunks > 1u)
     {
-        const InstanceSymbol* instance = (const InstanceSymbol*)model;
-
-        // use a separate filter context since we'll be munging the data
-        FilterContext localCX = sharedCX;
-
-        if ( trackHistory ) history.push_back( "model");
-
-        if ( instance->placement() == InstanceSymbol::PLACEMENT_RANDOM   ||
-             instance->placement() == InstanceSymbol::PLACEMENT_INTERVAL )
-        {
-            ScatterFilter scatter;
-            scatter.setDensity( *instance->density() );
-            scatter.setRandom( instance->placement() == InstanceSymbol::PLACEMENT_RANDOM );
-            scatter.setRandomSeed( *instance->randomSeed() );
-            localCX = scatter.push( workingSet, localCX );
-            if ( trackHistory ) history.push_back( "scatter" );
-        }
-        else if ( instance->placement() == InstanceSymbol::PLACEMENT_CENTROID )
-        {
-            CentroidFilter centroid;
-            localCX = centroid.push( workingSet, localCX );
-            if ( trackHistory ) history.push_back( "centroid" );
-        }
-
-        if ( altRequired )
+        // Register every feature with the index in input order first, so the
+        // object IDs do not depend on which chunk happens to tag first.
+        if (sharedCX.featureIndex())
         {
-            AltitudeFilter clamp;
-            clamp.setPropertiesFromStyle( style );
-            localCX = clamp.push( workingSet, localCX );
-            if ( trackHistory ) history.push_back( "altitude" );
+            for (auto& feature : workingSet)
+                sharedCX.featureIndex()->insert(feature.get());
         }
 
-        SubstituteModelFilter sub( style );
+        // Split into contiguous chunks. Each chunk compiles under its own
+        // copy of the filter context into its own group.
+        std::vector<FeatureList> chunks(numChunks);
+        unsigned n = 0;
+        for (auto& feature : workingSet)
+            chunks[n++ / chunkSize].push_back(feature);
 
-        // activate clustering
-        sub.setClustering( *_options.clustering() );
+        std::vector<osg::ref_ptr<osg::Group>> results(numChunks);
 
-        // activate draw-instancing
-        sub.setUseDrawInstanced( *_options.instancing() );
+        std::vector<std::vector<std::string>> histories(trackHistory ? numChunks : 0u);
 
-        // activate feature naming
-        if ( _options.featureName().isSet() )
-            sub.setFeatureNameExpr( *_options.featureName() );
-
-
-        osg::Node* node = sub.push( workingSet, localCX );
-        if ( node )
+        // Filters that parallelize internally (tessellation, extrusion) see
+        // that they're inside this loop and run serially, so the pools don't
+        // multiply up past the core count.
+        jobs::parallel_for(ARENA_GEOMETRY_COMPILER, numChunks, [&](unsigned begin, unsigned end)
+            {
+                for (unsigned i = begin; i < end; ++i)
+                {
+                    FilterContext localCX = sharedCX;
+                    results[i] = new osg::Group();
+                    runFilters(chunks[i], style, sym, _options, localCX, results[i].get(), trackHistory ? &histories[i] : nullptr);
+                }
+            });
+
+        // Merge in chunk order so the output is the same from run to run.
+        workingSet.clear();
+        for (unsigned i = 0; i < numChunks; ++i)
         {
-            if ( trackHistory ) history.push_back( "substitute" );
-
-            resultGroup->addChild( node );
-        }
-    }
+            for (unsigned c = 0; c < results[i]->getNumChildren(); ++c)
+                resultGroup->addChild(results[i]->getChild(c));
 
-    // extruded geometry
-    if ( extrusion )
-    {
-        if ( altRequired )
-        {
-            AltitudeFilter clamp;
-            clamp.setPropertiesFromStyle( style );
-            sharedCX = clamp.push( workingSet, sharedCX );
-            if ( trackHistory ) history.push_back( "altitude" );
-            altRequired = false;
+            workingSet.insert(workingSet.end(), chunks[i].begin(), chunks[i].end());
         }
 
-        ExtrudeGeometryFilter extrude;
-        extrude.setStyle( style );
-
-        // apply per-feature naming if requested.
-        if ( _options.featureName().isSet() )
-            extrude.setFeatureNameExpr( *_options.featureName() );
-
-        if (_options.mergeGeometry().isSet())
-            extrude.setMergeGeometry(*_options.mergeGeometry());            
-
-        osg::Node* node = extrude.push( workingSet, sharedCX );
-        if ( node )
+        if ( trackHistory )
         {
-            if ( trackHistory ) history.push_back( "extrude" );
-            resultGroup->addChild( node );
+            // every chunk runs the same filters, but a chunk that produces
+            // no geometry skips some entries; report the fullest one
+            history.push_back( "parallel" );
+            auto fullest = std::max_element(histories.begin(), histories.end(),
+                [](const std::vector<std::string>& a, const std::vector<std::string>& b) { return a.size() < b.size(); });
+            if (fullest != histories.end())
+                history.insert(history.end(), fullest->begin(), fullest->end());
         }
     }
-
-    // simple geometry
-    else if ( point || line || polygon )
+    else
     {
-        if ( altRequired )
-        {
-            AltitudeFilter clamp;
-            clamp.setPropertiesFromStyle( style );
-            sharedCX = clamp.push( workingSet, sharedCX );
-            if ( trackHistory ) history.push_back( "altitude" );
-            altRequired = false;
-        }
-
-        BuildGeometryFilter filter( style );
-
-        filter.maxGranularity() = *_options.maxGranularity();
-        filter.geoInterp() = *_options.geoInterp();
-        filter.useOSGTessellator() = *_options.useOSGTessellator();
-        filter.mergeGeometry() = *_options.mergeGeometry();
-
-
-
-        if (_options.maxPolygonTilingAngle().isSet())
-            filter.maxPolygonTilingAngle() = *_options.maxPolygonTilingAngle();
-
-        if ( _options.featureName().isSet() )
-            filter.featureName() = *_options.featureName();
-
-        if (_options.optimizeVertexOrdering().isSet())
-            filter.optimizeVertexOrdering() = *_options.optimizeVertexOrdering();
-
-        if (render && render->maxCreaseAngle().isSet())
-            filter.maxCreaseAngle() = render->maxCreaseAngle().get();
-
-        osg::Node* node = filter.push( workingSet, sharedCX );
-        if ( node )
-        {
-            if ( trackHistory ) history.push_back( "geometry" );
-            resultGroup->addChild( node );
-        }
+        runFilters(workingSet, style, sym, _options, sharedCX, resultGroup.get(), trackHistory ? &history : nullptr);
     }
 
-    if ( text || icon )
+    if (sym.render)
     {
-        // Only clamp annotation types when the technique is
-        // explicity set to MAP. Otherwise, the annotation subsystem
-        // will automatically use SCENE clamping.
-        bool altRequiredForAnnotations =
-            altRequired &&
-            altitude->technique().isSetTo(altitude->TECHNIQUE_MAP);
-
-        if ( altRequiredForAnnotations )
-        {
-            AltitudeFilter clamp;
-            clamp.setPropertiesFromStyle( style );
-            sharedCX = clamp.push( workingSet, sharedCX );
-            if ( trackHistory ) history.push_back( "altitude" );
-            altRequired = false;
-        }
-
-        BuildTextFilter filter( style );
-        osg::Node* node = filter.push( workingSet, sharedCX );
-        if ( node )
-        {
-            if ( trackHistory ) history.push_back( "text" );
-            resultGroup->addChild( node );
-        }
+        sym.render->applyTo(resultGroup.get());
     }
 
-    if (render)
+    // Weld, reorder and compact the compiled meshes.
+    if (_options.optimizeMeshes() == true)
     {
-        render->applyTo(resultGroup.get());
+        MeshOptimizer optimizer;
+        optimizer.simplifyLevels() = _options.meshLODLevels().get();
+        optimizer.simplifyRatio() = _options.meshLODRatio().get();
+        optimizer.run(resultGroup.get());
+
+        OE_DEBUG << LC << "Mesh optimization: " << optimizer.getStats().toString() << std::endl;
+        if ( trackHistory ) history.push_back( "optimize meshes" );
     }
 
     if (Registry::capabilities().supportsGLSL())
@@ -339,6 +339,136 @@ ImageLayer::createImage(const TileKey& key)
 
 GeoImage
 ImageLayer::createImage(const TileKey& key, ProgressCallback* progress)
+{
+    return createImage(key, progress, nullptr);
+}
+
+std::vector<GeoImage>
+ImageLayer::createImages(const std::vector<TileKey>& keys, ProgressCallback* progress)
+{
+    OE_PROFILING_ZONE;
+    OE_PROFILING_ZONE_TEXT(getName());
+
+    std::vector<GeoImage> results(keys.size(), GeoImage::INVALID);
+
+    if (keys.empty() || !isOpen())
+    {
+        return results;
+    }
+
+    // Batching only applies when all keys share a profile, which is
+    // always true for the children of a single tile.
+    const Profile* keyProfile = keys.front().getProfile();
+    for (auto& key : keys)
+    {
+        if (!key.valid() || !key.getProfile()->isHorizEquivalentTo(keyProfile))
+        {
+            for (unsigned i = 0; i < keys.size(); ++i)
+                results[i] = createImage(keys[i], progress);
+            return results;
+        }
+    }
+
+    NetworkMonitor::ScopedRequestLayer layerRequest(getName());
+
+    std::vector<Prefetched> prefetched(keys.size());
+
+    const CachePolicy& policy = getCacheSettings()->cachePolicy().get();
+
+    // Batch the cache lookups:
+    CacheBin* cacheBin = getCacheBin(keyProfile);
+    if (cacheBin && policy.isCacheReadable())
+    {
+        std::vector<std::string> cacheKeys;
+        cacheKeys.reserve(keys.size());
+        for (auto& key : keys)
+            cacheKeys.emplace_back(getImageCacheKey(key));
+
+        std::vector<ReadResult> cached = cacheBin->readImages(cacheKeys, nullptr);
+        for (unsigned i = 0; i < keys.size() && i < cached.size(); ++i)
+        {
+            prefetched[i].fromCache = true;
+            prefetched[i].cacheResult = cached[i];
+        }
+    }
+
+    // Batch the source reads for the keys the cache could not satisfy.
+    // Upsampling and mosaicing have their own per-key logic, so
+    // those cases go through the normal path.
+    if (!policy.isCacheOnly() &&
+        getProfile() &&
+        keyProfile->isHorizEquivalentTo(getProfile()) &&
+        getUpsample() == false)
+    {
+        std::vector<TileKey> sourceKeys;
+        std::vector<unsigned> sourceIndices;
+
+        for (unsigned i = 0; i < keys.size(); ++i)
+        {
+            const ReadResult& r = prefetched[i].cacheResult;
+            bool cached = prefetched[i].fromCache && r.succeeded() && !policy.isExpired(r.lastModifiedTime());
+
+            if (!cached && isKeyInLegalRange(keys[i]))
+            {
+                sourceKeys.push_back(keys[i]);
+                sourceIndices.push_back(i);
+            }
+        }
+
+        if (sourceKeys.size() > 1)
+        {
+            std::vector<GeoImage> images;
+            {
+                Threading::ScopedReadLock lock(inUseMutex());
+                images = createImagesImplementation(sourceKeys, progress);
+            }
+
+            for (unsigned j = 0; j < sourceIndices.size() && j < images.size(); ++j)
+            {
+                prefetched[sourceIndices[j]].fromSource = true;
+                prefetched[sourceIndices[j]].sourceImage = images[j];
+            }
+        }
+    }
+
+    if (progress && progress->isCanceled())
+    {
+        return results;
+    }
+
+    // Finish each image through the normal path (validation, cache writes,
+    // post layers) using the prefetched data.
+    for (unsigned i = 0; i < keys.size(); ++i)
+    {
+        results[i] = createImage(keys[i], progress, &prefetched[i]);
+    }
+
+    return results;
+}
+
+std::vector<GeoImage>
+ImageLayer::createImagesImplementation(const std::vector<TileKey>& keys, ProgressCallback* progress) const
+{
+    std::vector<GeoImage> results;
+    results.reserve(keys.size());
+    for (auto& key : keys)
+    {
+        results.emplace_back(createImageImplementation(key, progress));
+    }
+    return results;
+}
+
+std::string
+ImageLayer::getImageCacheKey(const TileKey& key) const
+{
+    // the cache key combines the Key and the horizontal profile.
+    return Cache::makeCacheKey(
+        Stringify() << key.str() << "-" << std::hex << key.getProfile()->getHorizSignature(),
+        "image");
+}
+
+GeoImage
+ImageLayer::createImage(const TileKey& key, ProgressCallback* progress, const Prefetched* prefetched)
 {
     OE_PROFILING_ZONE;
     OE_PROFILING_ZONE_TEXT(getName() + " " + key.str());
@@ -356,7 +486,7 @@ ImageLayer::createImage(const TileKey& key, ProgressCallback* progress)
 
     NetworkMonitor::ScopedRequestLayer layerRequest(getName());
 
-    GeoImage result = createImageInKeyProfile(key, progress);
+    GeoImage result = createImageInKeyProfile(key, progress, prefetched);
 
     // Post-cache operations:
 
@@ -403,7 +533,7 @@ ImageLayer::createImage(const GeoImage& canvas, const TileKey& key, ProgressCall
 }
 
 GeoImage
-ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progress)
+ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progress, const Prefetched* prefetched)
 {
     // If the layer is disabled, bail out.
     if ( !isOpen() )
@@ -428,10 +558,7 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
 
     GeoImage result;
 
-    // the cache key combines the Key and the horizontal profile.
-    std::string cacheKey = Cache::makeCacheKey(
-        Stringify() << key.str() << "-" << std::hex << key.getProfile()->getHorizSignature(),
-        "image");
+    std::string cacheKey = getImageCacheKey(key);
 
     // The L2 cache key includes the layer revision of course!
     std::string memCacheKey;
@@ -467,7 +594,9 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
     // map profile, we can try this first.
     if ( cacheBin && policy.isCacheReadable() )
     {
-        ReadResult r = cacheBin->readImage(cacheKey, 0L);
+        ReadResult r = (prefetched && prefetched->fromCache) ?
+            prefetched->cacheResult :
+            cacheBin->readImage(cacheKey, 0L);
         if ( r.succeeded() )
         {
             cachedImage = r.releaseImage();
@@ -514,6 +643,10 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
         {
             result = createFractalUpsampledImage(key, progress);
         }
+        else if (prefetched && prefetched->fromSource)
+        {
+            result = prefetched->sourceImage;
+        }
         else
         {
             Threading::ScopedReadLock lock(inUseMutex());
@@ -200,10 +200,6 @@ LocalGeometryNode::onTileUpdate(const TileKey&          key,
                                 osg::Node*              graph, 
                                 TerrainCallbackContext& context)
 {
-    // If we are already set to clamp, ignore this
-    if (_clampInUpdateTraversal)
-        return;
-
     bool needsClamp;
 
     // Does the tile key's polytope intersect the world bounds or this object?
@@ -222,8 +218,15 @@ LocalGeometryNode::onTileUpdate(const TileKey&          key,
 
     if (needsClamp)
     {
-        _clampInUpdateTraversal = true;
-        ADJUST_UPDATE_TRAV_COUNT(this, +1);
+        // queue the tile; the update traversal reclamps just the
+        // vertices it covers
+        _dirtyTiles.push(key, graph);
+
+        if (!_clampInUpdateTraversal)
+        {
+            _clampInUpdateTraversal = true;
+            ADJUST_UPDATE_TRAV_COUNT(this, +1);
+        }
     }
 }
 
@@ -261,15 +264,47 @@ LocalGeometryNode::clamp(osg::Node* graph, const Terrain* terrain)
     }
 }
 
+void
+LocalGeometryNode::clampTile(const TileKey& key, osg::Node* tile, const Terrain* terrain)
+{
+    if (terrain && tile)
+    {
+        GeometryClamper clamper(_clamperData);
+        clamper.setTerrainTile( key, tile );
+        clamper.setTerrainSRS( terrain->getSRS() );
+        clamper.setOffset(getPosition().alt());
+
+        this->accept( clamper );
+    }
+}
+
 void
 LocalGeometryNode::traverse(osg::NodeVisitor& nv)
 {
     if (nv.getVisitorType() == nv.UPDATE_VISITOR && _clampInUpdateTraversal)
     {
-        reclamp();
+        osg::ref_ptr<Terrain> terrain = getGeoTransform()->getTerrain();
+        if (_perVertexClampingEnabled && terrain.valid())
+        {
+            // reclamp as many queued tiles as this frame's budget allows
+            _dirtyTiles.drain(nv.getFrameStamp(), [&](const TileKey& key, osg::Node* tile)
+                {
+                    if (key.valid())
+                        clampTile(key, tile, terrain.get());
+                    else
+                        clamp(terrain->getGraph(), terrain.get());
+                });
+        }
+        else
+        {
+            _dirtyTiles.clear();
+        }
 
-        _clampInUpdateTraversal = false;
-        ADJUST_UPDATE_TRAV_COUNT(this, -1);
+        if (_dirtyTiles.empty())
+        {
+            _clampInUpdateTraversal = false;
+            ADJUST_UPDATE_TRAV_COUNT(this, -1);
+        }
     }
     GeoPositionNode::traverse(nv);
 }
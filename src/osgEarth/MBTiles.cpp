@@ -155,6 +155,30 @@ MBTilesImageLayer::createImageImplementation(const TileKey& key, ProgressCallbac
         return GeoImage(Status(r.errorDetail()));
 }
 
+std::vector<GeoImage>
+MBTilesImageLayer::createImagesImplementation(const std::vector<TileKey>& keys, ProgressCallback* progress) const
+{
+    std::vector<GeoImage> results;
+    results.reserve(keys.size());
+
+    if (getStatus().isError())
+    {
+        results.resize(keys.size(), GeoImage(getStatus()));
+        return results;
+    }
+
+    std::vector<ReadResult> reads = _driver.read(keys, progress, getReadOptions());
+
+    for (unsigned i = 0; i < keys.size(); ++i)
+    {
+        if (reads[i].succeeded())
+            results.emplace_back(reads[i].releaseImage(), keys[i].getExtent());
+        else
+            results.emplace_back(Status(reads[i].errorDetail()));
+    }
+    return results;
+}
+
 Status
 MBTilesImageLayer::writeImageImplementation(const TileKey& key, const osg::Image* image, ProgressCallback* progress) const
 {
@@ -673,8 +697,6 @@ MBTiles::Driver::read(
         return ReadResult::RESULT_READER_ERROR;
     }
 
-    bool valid = true;
-
     sqlite3_bind_int( select, 1, z );
     sqlite3_bind_int( select, 2, x );
     sqlite3_bind_int( select, 3, y );
@@ -688,44 +710,116 @@ MBTiles::Driver::read(
         int dataLen = sqlite3_column_bytes( select, 0 );
 
         std::string dataBuffer( data, dataLen );
+        result = decode( dataBuffer );
+    }
+    else
+    {
+        OE_DEBUG << LC << "SQL QUERY failed for " << query << ": " << std::endl;
+    }
+
+    sqlite3_finalize( select );
+
+    return ReadResult(result);
+}
+
+std::vector<ReadResult>
+MBTiles::Driver::read(
+    const std::vector<TileKey>& keys,
+    ProgressCallback* progress,
+    const osgDB::Options* readOptions) const
+{
+    std::vector<ReadResult> results(keys.size(), ReadResult(ReadResult::RESULT_NOT_FOUND));
+    std::vector<std::string> buffers(keys.size());
+    std::vector<bool> found(keys.size(), false);
+
+    // Fetch the raw tile blobs under the lock, reusing one statement:
+    {
+        std::lock_guard<std::mutex> exclusiveLock(_mutex);
+
+        sqlite3* database = (sqlite3*)_database;
 
-        // decompress if necessary:
-        if ( _compressor.valid() )
+        sqlite3_stmt* select = NULL;
+        std::string query = "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
+        int rc = sqlite3_prepare_v2( database, query.c_str(), -1, &select, 0L );
+        if ( rc != SQLITE_OK )
         {
-            std::istringstream inputStream(dataBuffer);
-            std::string value;
-            if ( !_compressor->decompress(inputStream, value) )
-            {
-                OE_WARN << LC << "Decompression failed" << std::endl;
-                valid = false;
-            }
-            else
-            {
-                dataBuffer = value;
-            }
+            OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(database) << std::endl;
+            for (auto& r : results)
+                r = ReadResult(ReadResult::RESULT_READER_ERROR);
+            return results;
         }
 
-        // decode the raw image data:
-        if ( valid )
+        for (unsigned i = 0; i < keys.size(); ++i)
         {
-            std::istringstream inputStream(dataBuffer);
-            result = ImageUtils::readStream(inputStream, _dbOptions.get());
-            // If we couldn't load the image automatically try the reader instead.
-            if (!result && _rw.valid())
+            const TileKey& key = keys[i];
+            int z = key.getLevelOfDetail();
+            if (z < (int)_minLevel || z > (int)_maxLevel)
+                continue;
+
+            unsigned int numRows, numCols;
+            key.getProfile()->getNumTiles(key.getLevelOfDetail(), numCols, numRows);
+            int x = key.getTileX();
+            int y = numRows - key.getTileY() - 1;
+
+            sqlite3_bind_int( select, 1, z );
+            sqlite3_bind_int( select, 2, x );
+            sqlite3_bind_int( select, 3, y );
+
+            if ( sqlite3_step( select ) == SQLITE_ROW )
             {
-                result = _rw->readImage(inputStream, _dbOptions.get()).takeImage();
+                const char* data = (const char*)sqlite3_column_blob( select, 0 );
+                int dataLen = sqlite3_column_bytes( select, 0 );
+                buffers[i].assign( data, dataLen );
+                found[i] = true;
             }
+
+            sqlite3_reset( select );
+            sqlite3_clear_bindings( select );
         }
+
+        sqlite3_finalize( select );
     }
-    else
+
+    // Decompress and decode without holding the database lock:
+    for (unsigned i = 0; i < keys.size(); ++i)
     {
-        OE_DEBUG << LC << "SQL QUERY failed for " << query << ": " << std::endl;
-        valid = false;
+        if (progress && progress->isCanceled())
+            break;
+
+        if (found[i])
+        {
+            results[i] = ReadResult(decode(buffers[i]));
+        }
     }
 
-    sqlite3_finalize( select );
+    return results;
+}
 
-    return ReadResult(result);
+osg::Image*
+MBTiles::Driver::decode(std::string& dataBuffer) const
+{
+    // decompress if necessary:
+    if ( _compressor.valid() )
+    {
+        std::istringstream inputStream(dataBuffer);
+        std::string value;
+        if ( !_compressor->decompress(inputStream, value) )
+        {
+            OE_WARN << LC << "Decompression failed" << std::endl;
+            return nullptr;
+        }
+        dataBuffer = value;
+    }
+
+    // decode the raw image data:
+    std::istringstream inputStream(dataBuffer);
+    osg::Image* result = ImageUtils::readStream(inputStream, _dbOptions.get());
+    // If we couldn't load the image automatically try the reader instead.
+    if (!result && _rw.valid())
+    {
+        result = _rw->readImage(inputStream, _dbOptions.get()).takeImage();
+    }
+    return result;
 }
 
 
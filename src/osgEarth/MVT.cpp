@@ -10,7 +10,12 @@
 #include <osgEarth/GeoData>
 #include <osgEarth/FeatureSource>
 #include <osgDB/Registry>
-#include "vector_tile.pb.h"
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
 
 #include <sqlite3.h>
 
@@ -26,14 +31,6 @@ using namespace osgEarth::MVT;
 
 namespace osgEarth { namespace MVT
 {
-    // https://github.com/mapbox/mapnik-vector-tile/blob/master/examples/c%2B%2B/tileinfo.cpp
-    enum CommandType {
-        SEG_END    = 0,
-        SEG_MOVETO = 1,
-        SEG_LINETO = 2,
-        SEG_CLOSE = (0x40 | 0x0f)
-    };
-
     enum eGeomType {
         Unknown = 0,
         Point = 1,
@@ -41,67 +38,426 @@ namespace osgEarth { namespace MVT
         Polygon = 3
     };
 
-    int zig_zag_decode(int n)
+    // Field numbers from the vector tile spec
+    // https://github.com/mapbox/vector-tile-spec/blob/master/2.1/vector_tile.proto
+    enum {
+        TILE_LAYERS = 3,
+
+        LAYER_NAME = 1,
+        LAYER_FEATURES = 2,
+        LAYER_KEYS = 3,
+        LAYER_VALUES = 4,
+        LAYER_EXTENT = 5,
+        LAYER_VERSION = 15,
+
+        FEATURE_ID = 1,
+        FEATURE_TAGS = 2,
+        FEATURE_TYPE = 3,
+        FEATURE_GEOMETRY = 4,
+
+        VALUE_STRING = 1,
+        VALUE_FLOAT = 2,
+        VALUE_DOUBLE = 3,
+        VALUE_INT = 4,
+        VALUE_UINT = 5,
+        VALUE_SINT = 6,
+        VALUE_BOOL = 7
+    };
+
+    // Protobuf wire types
+    enum {
+        WIRE_VARINT = 0,
+        WIRE_FIXED64 = 1,
+        WIRE_BYTES = 2,
+        WIRE_FIXED32 = 5
+    };
+
+    inline std::int32_t zig_zag_decode(std::uint32_t n)
     {
-        return (n >> 1) ^ (-(n & 1));
+        return (std::int32_t)((n >> 1) ^ (~(n & 1) + 1));
     }
 
-    Geometry* decodeLine(const mapnik::vector::tile_feature& feature, const TileKey& key, unsigned int tileres)
+    inline std::int64_t zig_zag_decode64(std::uint64_t n)
     {
-        unsigned int length = 0;
-        int cmd = -1;
-        const int cmd_bits = 3;
+        return (std::int64_t)((n >> 1) ^ (~(n & 1) + 1));
+    }
 
-        int x = 0;
-        int y = 0;
+    inline std::uint32_t zig_zag_encode(std::int32_t n)
+    {
+        return ((std::uint32_t)n << 1) ^ (std::uint32_t)(n >> 31);
+    }
 
-        std::vector< osg::ref_ptr< osgEarth::LineString > > lines;
-        osg::ref_ptr< osgEarth::LineString > currentLine;
+    inline std::uint64_t zig_zag_encode64(std::int64_t n)
+    {
+        return ((std::uint64_t)n << 1) ^ (std::uint64_t)(n >> 63);
+    }
+
+    // A view of bytes inside the tile buffer; nothing is copied.
+    struct View
+    {
+        const char* data = nullptr;
+        std::size_t size = 0;
+
+        bool operator == (const std::string& rhs) const {
+            return size == rhs.size() && (size == 0 || rhs.compare(0, size, data, size) == 0);
+        }
+        std::string str() const { return std::string(data, size); }
+    };
+
+    /**
+     * Reads protobuf wire format directly from a memory buffer, one field
+     * at a time. Any malformed input puts the reader in an error state
+     * and ends iteration.
+     */
+    class PbfReader
+    {
+    public:
+        PbfReader(const char* data, std::size_t size) :
+            _p((const std::uint8_t*)data),
+            _end((const std::uint8_t*)data + size) { }
+
+        PbfReader(const View& view) :
+            PbfReader(view.data, view.size) { }
+
+        //! Advance to the next field. Returns false at the end or on error.
+        bool next()
+        {
+            if (_p >= _end)
+                return false;
+
+            std::uint64_t key;
+            if (!varint(key))
+                return false;
+
+            _tag = (std::uint32_t)(key >> 3);
+            _type = (unsigned)(key & 0x7);
+            return true;
+        }
+
+        std::uint32_t tag() const { return _tag; }
+        unsigned type() const { return _type; }
+        bool error() const { return _error; }
+        bool atEnd() const { return _p >= _end; }
+        std::size_t remaining() const { return (std::size_t)(_end - _p); }
+
+        std::uint64_t getVarint()
+        {
+            std::uint64_t value = 0;
+            varint(value);
+            return value;
+        }
+
+        View getView()
+        {
+            View view;
+            std::uint64_t size;
+            if (varint(size))
+            {
+                if (size <= (std::uint64_t)(_end - _p))
+                {
+                    view.data = (const char*)_p;
+                    view.size = (std::size_t)size;
+                    _p += size;
+                }
+                else fail();
+            }
+            return view;
+        }
+
+        float getFloat()
+        {
+            std::uint32_t bits = (std::uint32_t)fixed(4);
+            float value;
+            std::memcpy(&value, &bits, 4);
+            return value;
+        }
+
+        double getDouble()
+        {
+            std::uint64_t bits = fixed(8);
+            double value;
+            std::memcpy(&value, &bits, 8);
+            return value;
+        }
+
+        //! Skip the value of the current field.
+        void skip()
+        {
+            switch (_type)
+            {
+            case WIRE_VARINT: getVarint(); break;
+            case WIRE_FIXED64: fixed(8); break;
+            case WIRE_BYTES: getView(); break;
+            case WIRE_FIXED32: fixed(4); break;
+            default: fail(); break;
+            }
+        }
 
-        GeoExtent extent = key.getExtent();
+        //! Reads a varint; false on error.
+        bool varint(std::uint64_t& value)
+        {
+            value = 0;
+            for (unsigned shift = 0; shift < 64 && _p < _end; shift += 7)
+            {
+                std::uint8_t b = *_p++;
+                value |= (std::uint64_t)(b & 0x7f) << shift;
+                if ((b & 0x80) == 0)
+                    return true;
+            }
+            fail();
+            return false;
+        }
 
-        for (int k = 0; k < feature.geometry_size();)
+    private:
+        std::uint64_t fixed(unsigned bytes)
         {
-            if (!length)
+            std::uint64_t value = 0;
+            if ((std::size_t)(_end - _p) < bytes)
             {
-                unsigned int cmd_length = feature.geometry(k++);
-                cmd = cmd_length & ((1 << cmd_bits) - 1);
-                length = cmd_length >> cmd_bits;
+                fail();
+                return 0;
             }
-            if (length > 0)
+            for (unsigned i = 0; i < bytes; ++i)
+                value |= (std::uint64_t)_p[i] << (8 * i);
+            _p += bytes;
+            return value;
+        }
+
+        void fail()
+        {
+            _error = true;
+            _p = _end;
+        }
+
+        const std::uint8_t* _p;
+        const std::uint8_t* _end;
+        std::uint32_t _tag = 0;
+        unsigned _type = 0;
+        bool _error = false;
+    };
+
+    /**
+     * Appends protobuf wire format to a string. Embedded messages are
+     * built in their own string first and then added with addBytes.
+     */
+    class PbfWriter
+    {
+    public:
+        PbfWriter(std::string& out) :
+            _out(out) { }
+
+        void varint(std::uint64_t value)
+        {
+            while (value >= 0x80)
             {
-                length--;
+                _out.push_back((char)((value & 0x7f) | 0x80));
+                value >>= 7;
+            }
+            _out.push_back((char)value);
+        }
+
+        void addVarint(std::uint32_t tag, std::uint64_t value)
+        {
+            key(tag, WIRE_VARINT);
+            varint(value);
+        }
+
+        void addBytes(std::uint32_t tag, const std::string& value)
+        {
+            key(tag, WIRE_BYTES);
+            varint(value.size());
+            _out.append(value);
+        }
+
+        void addDouble(std::uint32_t tag, double value)
+        {
+            std::uint64_t bits;
+            std::memcpy(&bits, &value, 8);
+            key(tag, WIRE_FIXED64);
+            for (unsigned i = 0; i < 8; ++i)
+                _out.push_back((char)((bits >> (8 * i)) & 0xff));
+        }
+
+        //! Writes a packed repeated uint32 field.
+        void addPacked(std::uint32_t tag, const std::vector<std::uint32_t>& values)
+        {
+            std::string packed;
+            PbfWriter writer(packed);
+            for (auto value : values)
+                writer.varint(value);
+            addBytes(tag, packed);
+        }
+
+    private:
+        void key(std::uint32_t tag, unsigned type)
+        {
+            varint(((std::uint64_t)tag << 3) | type);
+        }
+
+        std::string& _out;
+    };
 
-                if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
+    /**
+     * A repeated uint32 field (tags, geometry) as one run of varints.
+     * The spec packs these, but protobuf allows any mix of packed runs and
+     * unpacked values (one varint field each), so both are accepted. A
+     * single packed run is viewed in place; anything else is copied.
+     */
+    struct RepeatedVarints
+    {
+        //! Reads the current field of the reader, skipping it if its
+        //! wire type can't hold a uint32
+        void add(PbfReader& reader)
+        {
+            if (reader.type() == WIRE_BYTES)
+            {
+                View run = reader.getView();
+                if (_runs == 0)
                 {
-                    if (cmd == SEG_MOVETO)
-                    {
-                        currentLine = new osgEarth::LineString;
-                        lines.push_back( currentLine.get() );
-                    }
-                    int px = feature.geometry(k++);
-                    int py = feature.geometry(k++);
-                    px = zig_zag_decode(px);
-                    py = zig_zag_decode(py);
+                    _view = run;
+                }
+                else
+                {
+                    spill();
+                    if (run.size > 0)
+                        _buffer.append(run.data, run.size);
+                }
+                ++_runs;
+            }
+            else if (reader.type() == WIRE_VARINT)
+            {
+                std::uint64_t value = reader.getVarint();
+                spill();
+                PbfWriter(_buffer).varint(value);
+                ++_runs;
+            }
+            else
+            {
+                reader.skip();
+            }
+        }
 
-                    x += px;
-                    y += py;
+        View view() const
+        {
+            return _spilled ? View{ _buffer.data(), _buffer.size() } : _view;
+        }
 
-                    double width = extent.width();
-                    double height = extent.height();
+    private:
+        View _view;
+        std::string _buffer;
+        unsigned _runs = 0;
+        bool _spilled = false;
+
+        void spill()
+        {
+            if (!_spilled)
+            {
+                _buffer.assign(_view.data ? _view.data : "", _view.size);
+                _spilled = true;
+            }
+        }
+    };
 
-                    double geoX = extent.xMin() + (width/(double)tileres) * (double)x;
-                    double geoY = extent.yMax() - (height/(double)tileres) * (double)y;
+    // Read-only stream buffer over existing memory
+    struct MemoryStreamBuf : public std::streambuf
+    {
+        MemoryStreamBuf(const char* data, std::size_t size)
+        {
+            char* p = const_cast<char*>(data);
+            setg(p, p, p + size);
+        }
+    };
 
-                    if (currentLine.valid())
-                    {
-                        currentLine->push_back(geoX, geoY, 0);
-                    }
+    // Walks the command stream of a feature's packed "geometry" field
+    // and reports each vertex in tile coordinates.
+    class GeometryDecoder
+    {
+    public:
+        GeometryDecoder(const View& geometry, const TileKey& key, unsigned tileres) :
+            _in(geometry)
+        {
+            const GeoExtent& extent = key.getExtent();
+            _xmin = extent.xMin();
+            _ymax = extent.yMax();
+            _sx = extent.width() / (double)tileres;
+            _sy = extent.height() / (double)tileres;
+        }
+
+        //! Reads the next command; returns false at the end of the stream.
+        //! For MOVETO and LINETO, "out" holds the vertex in map coordinates.
+        bool next(unsigned& cmd, osg::Vec3d& out)
+        {
+            // a zero count is legal but does nothing; skip it (iteratively,
+            // so a long run of them can't exhaust the stack)
+            while (_length == 0)
+            {
+                std::uint64_t cmd_length;
+                if (_in.atEnd() || !_in.varint(cmd_length))
+                    return false;
+                _cmd = (unsigned)(cmd_length & ((1 << CMD_BITS) - 1));
+                _length = (unsigned)std::min(cmd_length >> CMD_BITS, (std::uint64_t)UINT_MAX);
+
+                if (_cmd == CMD_MOVETO || _cmd == CMD_LINETO)
+                {
+                    // each vertex takes at least two bytes, which bounds a
+                    // bogus count before it turns into a long loop
+                    if (_length > _in.remaining() / 2)
+                        return false;
+                }
+                else if (_cmd == CMD_CLOSEPATH)
+                {
+                    // the spec requires a count of 1
+                    _length = std::min(_length, 1u);
                 }
+                else return false;
+            }
+
+            --_length;
+            cmd = _cmd;
+
+            if (_cmd == CMD_MOVETO || _cmd == CMD_LINETO)
+            {
+                std::uint64_t px, py;
+                if (!_in.varint(px) || !_in.varint(py))
+                    return false;
+
+                _x += zig_zag_decode((std::uint32_t)px);
+                _y += zig_zag_decode((std::uint32_t)py);
+
+                out.set(_xmin + _sx * (double)_x, _ymax - _sy * (double)_y, 0.0);
             }
+            return true;
         }
 
-        currentLine = 0;
+    private:
+        PbfReader _in;
+        unsigned _cmd = 0;
+        unsigned _length = 0;
+        std::int32_t _x = 0, _y = 0;
+        double _xmin, _ymax, _sx, _sy;
+    };
+
+    Geometry* decodeLine(const View& geom, const TileKey& key, unsigned int tileres)
+    {
+        std::vector< osg::ref_ptr< osgEarth::LineString > > lines;
+        osgEarth::LineString* currentLine = nullptr;
+
+        GeometryDecoder decoder(geom, key, tileres);
+        unsigned cmd;
+        osg::Vec3d point;
+        while (decoder.next(cmd, point))
+        {
+            if (cmd == CMD_MOVETO)
+            {
+                currentLine = new osgEarth::LineString;
+                lines.push_back(currentLine);
+            }
+
+            if ((cmd == CMD_MOVETO || cmd == CMD_LINETO) && currentLine)
+            {
+                currentLine->push_back(point);
+            }
+        }
 
         if (lines.size() == 0)
         {
@@ -124,54 +480,25 @@ namespace osgEarth { namespace MVT
         }
     }
 
-    Geometry* decodePoint(const mapnik::vector::tile_feature& feature, const TileKey& key, unsigned int tileres)
+    Geometry* decodePoint(const View& geom, const TileKey& key, unsigned int tileres)
     {
-        unsigned int length = 0;
-        int cmd = -1;
-        const int cmd_bits = 3;
-
-        int x = 0;
-        int y = 0;
-
         osgEarth::PointSet *geometry = new osgEarth::PointSet();
 
-        GeoExtent extent = key.getExtent();
-
-        for (int k = 0; k < feature.geometry_size();)
+        GeometryDecoder decoder(geom, key, tileres);
+        unsigned cmd;
+        osg::Vec3d point;
+        while (decoder.next(cmd, point))
         {
-            if (!length)
+            if (cmd == CMD_MOVETO || cmd == CMD_LINETO)
             {
-                unsigned int cmd_length = feature.geometry(k++);
-                cmd = cmd_length & ((1 << cmd_bits) - 1);
-                length = cmd_length >> cmd_bits;
-            }
-            if (length > 0)
-            {
-                length--;
-                if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
-                {
-                    int px = feature.geometry(k++);
-                    int py = feature.geometry(k++);
-                    px = zig_zag_decode(px);
-                    py = zig_zag_decode(py);
-
-                    x += px;
-                    y += py;
-
-                    double width = extent.width();
-                    double height = extent.height();
-
-                    double geoX = extent.xMin() + (width/(double)tileres) * (double)x;
-                    double geoY = extent.yMax() - (height/(double)tileres) * (double)y;
-                    geometry->push_back(geoX, geoY, 0);
-                }
+                geometry->push_back(point);
             }
         }
 
         return geometry;
     }
 
-    Geometry* decodePolygon(const mapnik::vector::tile_feature& feature, const  TileKey& key, unsigned int tileres)
+    Geometry* decodePolygon(const View& geom, const TileKey& key, unsigned int tileres)
     {
         /*
          https://github.com/mapbox/vector-tile-spec/tree/master/2.1
@@ -181,14 +508,6 @@ namespace osgEarth { namespace MVT
          interior ring (inner polygon of the current polygon).
          */
 
-
-        unsigned int length = 0;
-        int cmd = -1;
-        const int cmd_bits = 3;
-
-        int x = 0;
-        int y = 0;
-
         // The list of polygons we've collected
         std::vector< osg::ref_ptr< osgEarth::Polygon > > polygons;
 
@@ -196,74 +515,51 @@ namespace osgEarth { namespace MVT
 
         osg::ref_ptr< osgEarth::Ring > currentRing;
 
-        GeoExtent extent = key.getExtent();
-
-        for (int k = 0; k < feature.geometry_size();)
+        GeometryDecoder decoder(geom, key, tileres);
+        unsigned cmd;
+        osg::Vec3d point;
+        while (decoder.next(cmd, point))
         {
-            if (!length)
+            if (cmd == CMD_MOVETO || cmd == CMD_LINETO)
             {
-                unsigned int cmd_length = feature.geometry(k++);
-                cmd = cmd_length & ((1 << cmd_bits) - 1);
-                length = cmd_length >> cmd_bits;
+                if (!currentRing)
+                {
+                    currentRing = new osgEarth::Ring();
+                }
+                currentRing->push_back(point);
             }
-            if (length > 0)
+            else if (cmd == CMD_CLOSEPATH && currentRing.valid())
             {
-                length--;
-                if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
-                {
-                    if (!currentRing)
-                    {
-                        currentRing = new osgEarth::Ring();
-                    }
-
-                    int px = feature.geometry(k++);
-                    int py = feature.geometry(k++);
-                    px = zig_zag_decode(px);
-                    py = zig_zag_decode(py);
+                double area = currentRing->getSignedArea2D();
 
-                    x += px;
-                    y += py;
+                // Close the ring.
+                currentRing->close();
 
-                    double width = extent.width();
-                    double height = extent.height();
-
-                    double geoX = extent.xMin() + (width/(double)tileres) * (double)x;
-                    double geoY = extent.yMax() - (height/(double)tileres) * (double)y;
-                    currentRing->push_back(geoX, geoY, 0);
+                // New polygon
+                if (area > 0)
+                {
+                    currentRing->rewind(Geometry::ORIENTATION_CCW);
+                    currentPolygon = new osgEarth::Polygon(&currentRing->asVector());
+                    polygons.push_back(currentPolygon.get());
                 }
-                else if (cmd == (SEG_CLOSE & ((1 << cmd_bits) - 1)))
-                {                    
-                    double area = currentRing->getSignedArea2D();
-
-                    // Close the ring.
-                    currentRing->close();
-                    
-                    // New polygon
-                    if (area > 0)
+                // Hole
+                else if (area < 0)
+                {
+                    if (currentPolygon.valid())
                     {
-                        currentRing->rewind(Geometry::ORIENTATION_CCW);
-                        currentPolygon = new osgEarth::Polygon(&currentRing->asVector());
-                        polygons.push_back(currentPolygon.get());
+                        currentRing->rewind(Geometry::ORIENTATION_CW);
+                        currentPolygon->getHoles().push_back( currentRing );
                     }
-                    // Hole
-                    else if (area < 0)
+                    else
                     {
-                        if (currentPolygon.valid())
-                        {
-                            currentRing->rewind(Geometry::ORIENTATION_CW);
-                            currentPolygon->getHoles().push_back( currentRing );
-                        }
-                        else
-                        {
-                            // this means we encountered a "hole" without a parent outer ring,
-                            // discard for now -gw
-                            OE_DEBUG << LC << "Discarding improperly wound polygon (hole without an outer ring)\n";
-                        }
+                        // this means we encountered a "hole" without a parent outer ring,
+                        // discard for now -gw
+                        OE_DEBUG << LC << "Discarding improperly wound polygon (hole without an outer ring)\n";
                     }
-
-                    // Start a new ring
-                    currentRing = 0;
                 }
+
+                // Start a new ring
+                currentRing = 0;
             }
         }
 
@@ -291,165 +587,571 @@ namespace osgEarth { namespace MVT
         }
     }
 
-    bool readTile(std::istream& in, const TileKey& key, FeatureList& features, const std::vector<std::string>& layers_to_include)
+    // Decodes one entry of a layer's value table into a feature attribute.
+    void setAttribute(Feature* feature, const std::string& name, const View& value)
     {
-        features.clear();
+        PbfReader in(value);
+        while (in.next())
+        {
+            switch (in.tag())
+            {
+            case VALUE_STRING: feature->set(name, in.getView().str()); return;
+            case VALUE_FLOAT: feature->set(name, (double)in.getFloat()); return;
+            case VALUE_DOUBLE: feature->set(name, in.getDouble()); return;
+            case VALUE_INT: feature->set(name, (long long)(std::int64_t)in.getVarint()); return;
+            case VALUE_UINT: feature->set(name, (long long)in.getVarint()); return;
+            case VALUE_SINT: feature->set(name, (long long)zig_zag_decode64(in.getVarint())); return;
+            case VALUE_BOOL: feature->set(name, in.getVarint() != 0); return;
+            default: in.skip(); break;
+            }
+        }
+    }
 
-        // Get the compressor
-        osg::ref_ptr< osgDB::BaseCompressor> compressor = osgDB::Registry::instance()->getObjectWrapperManager()->findCompressor("zlib");
-        if (!compressor.valid())
+    // Special path for getting heights from our test dataset.
+    void setHeightFromOtherTags(Feature* feature, const View& value)
+    {
+        PbfReader in(value);
+        while (in.next())
         {
-            return false;
+            if (in.tag() != VALUE_STRING)
+            {
+                in.skip();
+                continue;
+            }
+
+            auto tized = StringTokenizer()
+                .delim("=")
+                .delim(">")
+                .standardQuotes()
+                .tokenize(in.getView().str());
+
+            if (tized.size() == 3 && tized[0] == "height")
+            {
+                // Remove quotes from the height
+                float height = as<float>(tized[2], FLT_MAX);
+                if (height != FLT_MAX)
+                {
+                    feature->set("height", height);
+                }
+            }
+            return;
         }
+    }
+
+    bool readLayer(
+        const View& data,
+        const TileKey& key,
+        FeatureList& features,
+        const std::vector<std::string>& layers_to_include,
+        const std::vector<std::string>& attributes_to_include)
+    {
+        View name;
+        unsigned extent = 4096;
+        std::vector<View> keys, values, featureViews;
 
-        // Decompress the tile
-        std::string original((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
-        in.seekg (0, std::ios::beg);
-        std::string value;
-        if (!compressor->decompress(in, value))
+        PbfReader layer(data);
+        while (layer.next())
         {
-            value = original;
+            switch (layer.tag())
+            {
+            case LAYER_NAME:
+                name = layer.getView();
+                // if we have specific layers, only load those. The name comes
+                // first in practice, so this skips the rest of the layer unread.
+                if (!layers_to_include.empty() &&
+                    std::find_if(layers_to_include.begin(), layers_to_include.end(),
+                        [&](const std::string& n) { return name == n; }) == layers_to_include.end())
+                {
+                    return true;
+                }
+                break;
+            case LAYER_FEATURES: featureViews.push_back(layer.getView()); break;
+            case LAYER_KEYS: keys.push_back(layer.getView()); break;
+            case LAYER_VALUES: values.push_back(layer.getView()); break;
+            case LAYER_EXTENT: extent = (unsigned)layer.getVarint(); break;
+            default: layer.skip(); break;
+            }
         }
 
+        if (layer.error())
+            return false;
+
+        std::string layerName = name.str();
 
-        mapnik::vector::tile tile;
+        // the attribute projection, resolved once per layer:
+        std::vector<std::string> keyNames(keys.size());
+        std::vector<bool> keepKey(keys.size(), attributes_to_include.empty());
+        int otherTags = -1;
+        bool wantHeight = attributes_to_include.empty() ||
+            std::find(attributes_to_include.begin(), attributes_to_include.end(), "height") != attributes_to_include.end();
 
-        if (tile.ParseFromString(value))
+        for (unsigned i = 0; i < keys.size(); ++i)
         {
-            for (int i = 0; i < tile.layers().size(); i++)
+            keyNames[i] = keys[i].str();
+            if (!attributes_to_include.empty())
+                keepKey[i] = std::find(attributes_to_include.begin(), attributes_to_include.end(), keyNames[i]) != attributes_to_include.end();
+            if (keyNames[i] == "other_tags")
+                otherTags = i;
+        }
+
+        for (auto& featureView : featureViews)
+        {
+            std::uint64_t id = 0;
+            unsigned type = Unknown;
+            RepeatedVarints tagsField, geomField;
+
+            PbfReader feature(featureView);
+            while (feature.next())
+            {
+                switch (feature.tag())
+                {
+                case FEATURE_ID:
+                    if (feature.type() == WIRE_VARINT) id = feature.getVarint();
+                    else feature.skip();
+                    break;
+                case FEATURE_TAGS: tagsField.add(feature); break;
+                case FEATURE_TYPE:
+                    if (feature.type() == WIRE_VARINT) type = (unsigned)feature.getVarint();
+                    else feature.skip();
+                    break;
+                case FEATURE_GEOMETRY: geomField.add(feature); break;
+                default: feature.skip(); break;
+                }
+            }
+
+            if (feature.error())
+                return false;
+
+            View tags = tagsField.view(), geom = geomField.view();
+
+            osg::ref_ptr< osgEarth::Geometry > geometry;
+
+            eGeomType geomType = static_cast<eGeomType>(type);
+            if (geomType == MVT::Polygon)
+            {
+                geometry = decodePolygon(geom, key, extent);
+            }
+            else if (geomType == MVT::LineString)
+            {
+                geometry = decodeLine(geom, key, extent);
+            }
+            else if (geomType == MVT::Point)
             {
-                const mapnik::vector::tile_layer &layer = tile.layers().Get(i);
+                geometry = decodePoint(geom, key, extent);
 
-                // if we have specific layers, only load those.
-                if (!layers_to_include.empty())
+                // This is a bit of a hack, but if a point is outside of the extents we remove it.
+                // Lines and Polygons that extend outside of the tileset we keep though b/c we assume that they are just slightly going outside of the
+                // extent.  Should probably make this an option somewhere.
+                if (geometry)
                 {
-                    if (std::find(layers_to_include.begin(), layers_to_include.end(), layer.name()) == layers_to_include.end())
+                    if (!key.getExtent().contains(geometry->getBounds().center()))
                     {
-                        continue;
+                        geometry = NULL;
                     }
                 }
+            }
+            else
+            {
+                OE_SOFT_ASSERT(false, "MVT: unsupported geometry type \"" << type << "\"");
+                geometry = decodeLine(geom, key, extent);
+            }
+
+            if (!geometry)
+                continue;
+
+            osg::ref_ptr< Feature > oeFeature = new Feature(0, key.getProfile()->getSRS());
+
+            // Set the layer name as "mvt_layer" so we can filter it later
+            oeFeature->set("mvt_layer", layerName);
+
+            // Read attributes (key/value index pairs)
+            PbfReader tagReader(tags);
+            std::uint64_t k, v;
+            while (!tagReader.atEnd() && tagReader.varint(k) && tagReader.varint(v))
+            {
+                if (k >= keys.size() || v >= values.size())
+                    continue;
+
+                if (keepKey[k])
+                    setAttribute(oeFeature.get(), keyNames[k], values[v]);
+
+                if ((int)k == otherTags && wantHeight)
+                    setHeightFromOtherTags(oeFeature.get(), values[v]);
+            }
 
-                for (int j = 0; j < layer.features().size(); j++)
+            oeFeature->setFID(id);
+            oeFeature->setGeometry(geometry.get());
+            features.push_back(oeFeature.get());
+        }
+
+        return true;
+    }
+
+    bool readTile(
+        const char* data,
+        std::size_t size,
+        const TileKey& key,
+        FeatureList& features,
+        const std::vector<std::string>& layers_to_include,
+        const std::vector<std::string>& attributes_to_include)
+    {
+        features.clear();
+
+        // An uncompressed tile starts with the "layers" field key (0x1a).
+        // Anything else is expected to be zlib/gzip compressed.
+        std::string inflated;
+        if (size > 0 && data[0] != (char)((TILE_LAYERS << 3) | WIRE_BYTES))
+        {
+            osg::ref_ptr< osgDB::BaseCompressor> compressor = osgDB::Registry::instance()->getObjectWrapperManager()->findCompressor("zlib");
+            if (!compressor.valid())
+            {
+                return false;
+            }
+
+            MemoryStreamBuf buf(data, size);
+            std::istream in(&buf);
+            if (compressor->decompress(in, inflated))
+            {
+                data = inflated.data();
+                size = inflated.size();
+            }
+        }
+
+        PbfReader tile(data, size);
+        while (tile.next())
+        {
+            if (tile.tag() == TILE_LAYERS && tile.type() == WIRE_BYTES)
+            {
+                if (!readLayer(tile.getView(), key, features, layers_to_include, attributes_to_include))
                 {
-                    const mapnik::vector::tile_feature &feature = layer.features().Get(j);
+                    OE_WARN << LC << "Failed to parse mvt " << key.str() << std::endl;
+                    return false;
+                }
+            }
+            else
+            {
+                tile.skip();
+            }
+        }
 
-                    osg::ref_ptr< Feature > oeFeature = new Feature(0, key.getProfile()->getSRS());
+        if (tile.error())
+        {
+            OE_WARN << LC << "Failed to parse mvt " << key.str() << std::endl;
+            return false;
+        }
 
-                    // Set the layer name as "mvt_layer" so we can filter it later
-                    oeFeature->set("mvt_layer", layer.name());
-                        
-                    // Read attributes
-                    for (int k = 0; k < feature.tags().size(); k+=2)
-                    {
-                        std::string key = layer.keys().Get(feature.tags().Get(k));
-                        mapnik::vector::tile_value value = layer.values().Get(feature.tags().Get(k+1));
+        return true;
+    }
 
-                        if (value.has_bool_value())
-                        {
-                            oeFeature->set(key, value.bool_value());
-                        }
-                        else if (value.has_double_value())
-                        {
-                            oeFeature->set(key, value.double_value());
-                        }
-                        else if (value.has_float_value())
-                        {
-                            oeFeature->set(key, value.float_value());
-                        }
-                        else if (value.has_int_value())
-                        {
-                            oeFeature->set(key, (long long)value.int_value());
-                        }
-                        else if (value.has_sint_value())
-                        {
-                            oeFeature->set(key, (long long)value.sint_value());
-                        }
-                        else if (value.has_string_value())
-                        {
-                            oeFeature->set(key, value.string_value());
-                        }
-                        else if (value.has_uint_value())
-                        {
-                            oeFeature->set(key, (long long)value.uint_value());
-                        }
+    bool readTile(std::istream& in, const TileKey& key, FeatureList& features, const std::vector<std::string>& layers_to_include)
+    {
+        std::string buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        return readTile(buffer.data(), buffer.size(), key, features, layers_to_include, {});
+    }
 
-                        // Special path for getting heights from our test dataset.
-                        if (key == "other_tags")
-                        {
-                            std::string other_tags = value.string_value();
 
-                            auto tized = StringTokenizer()
-                                .delim("=")
-                                .delim(">")
-                                .standardQuotes()
-                                .tokenize(other_tags);
+    // Builds the command stream for one feature's "geometry" field from
+    // map coordinates, quantizing each vertex to the tile's integer grid.
+    class GeometryEncoder
+    {
+    public:
+        using Vertex = std::pair<std::int32_t, std::int32_t>;
 
-                            if (tized.size() == 3)
-                            {
-                                if (tized[0] == "height")
-                                {
-                                    std::string value = tized[2];
-                                    // Remove quotes from the height
-                                    float height = as<float>(value, FLT_MAX);
-                                    if (height != FLT_MAX)
-                                    {
-                                        oeFeature->set("height", height);
-                                    }
-                                }
-                            }
-                        }
-                    }
+        GeometryEncoder(const TileKey& key, unsigned tileres)
+        {
+            const GeoExtent& extent = key.getExtent();
+            _xmin = extent.xMin();
+            _ymax = extent.yMax();
+            _sx = (double)tileres / extent.width();
+            _sy = (double)tileres / extent.height();
+        }
+
+        //! Quantizes a part, dropping vertices that land on the same
+        //! grid cell as the one before them.
+        void quantize(const Geometry* part, std::vector<Vertex>& out) const
+        {
+            out.clear();
+            out.reserve(part->size());
+            for (auto& p : *part)
+            {
+                Vertex v(quantize(p.x() - _xmin, _sx), quantize(_ymax - p.y(), _sy));
+                if (out.empty() || out.back() != v)
+                    out.push_back(v);
+            }
+        }
+
+        void addPoints(const std::vector<Vertex>& points)
+        {
+            if (points.empty())
+                return;
+            command(CMD_MOVETO, points.size());
+            for (auto& v : points)
+                vertex(v);
+        }
+
+        void addLine(const std::vector<Vertex>& line)
+        {
+            if (line.size() < 2)
+                return;
+            command(CMD_MOVETO, 1);
+            vertex(line[0]);
+            command(CMD_LINETO, line.size() - 1);
+            for (unsigned i = 1; i < line.size(); ++i)
+                vertex(line[i]);
+        }
+
+        //! Adds a ring, winding it the way the spec requires: exterior
+        //! rings have positive area in tile space (y down), holes negative.
+        //! Returns false if the ring collapsed at this resolution.
+        bool addRing(std::vector<Vertex>& ring, bool exterior)
+        {
+            if (ring.size() > 1 && ring.front() == ring.back())
+                ring.pop_back();
+            if (ring.size() < 3)
+                return false;
+
+            std::int64_t area = 0;
+            for (unsigned i = 0, j = (unsigned)ring.size() - 1; i < ring.size(); j = i++)
+            {
+                area +=
+                    (std::int64_t)ring[j].first * ring[i].second -
+                    (std::int64_t)ring[i].first * ring[j].second;
+            }
+            if (area == 0)
+                return false;
+
+            if ((area > 0) != exterior)
+                std::reverse(ring.begin(), ring.end());
+
+            command(CMD_MOVETO, 1);
+            vertex(ring[0]);
+            command(CMD_LINETO, ring.size() - 1);
+            for (unsigned i = 1; i < ring.size(); ++i)
+                vertex(ring[i]);
+            command(CMD_CLOSEPATH, 1);
+            return true;
+        }
+
+        std::vector<std::uint32_t> commands;
+
+    private:
+        static std::int32_t quantize(double value, double scale)
+        {
+            // Keep well inside int32 so the deltas cannot overflow
+            return (std::int32_t)osg::clampBetween(std::round(value * scale), -1073741824.0, 1073741823.0);
+        }
+
+        void command(unsigned cmd, std::size_t count)
+        {
+            commands.push_back((std::uint32_t)((count << CMD_BITS) | cmd));
+        }
+
+        void vertex(const Vertex& v)
+        {
+            commands.push_back(zig_zag_encode(v.first - _x));
+            commands.push_back(zig_zag_encode(v.second - _y));
+            _x = v.first;
+            _y = v.second;
+        }
+
+        std::int32_t _x = 0, _y = 0;
+        double _xmin, _ymax, _sx, _sy;
+    };
+
+    // Sorts the leaves of a geometry by the MVT type they encode to.
+    void collectParts(
+        const Geometry* geom,
+        std::vector<const Geometry*>& points,
+        std::vector<const Geometry*>& lines,
+        std::vector<const Geometry*>& polygons)
+    {
+        switch (geom->getType())
+        {
+        case Geometry::TYPE_MULTI:
+            for (auto& part : static_cast<const MultiGeometry*>(geom)->getComponents())
+                if (part.valid())
+                    collectParts(part.get(), points, lines, polygons);
+            break;
+        case Geometry::TYPE_POINT:
+        case Geometry::TYPE_POINTSET:
+            points.push_back(geom);
+            break;
+        case Geometry::TYPE_LINESTRING:
+            lines.push_back(geom);
+            break;
+        case Geometry::TYPE_RING:
+        case Geometry::TYPE_POLYGON:
+            polygons.push_back(geom);
+            break;
+        default:
+            break;
+        }
+    }
 
+    // Encodes one attribute as a layer "value" message. Returns false
+    // for types MVT cannot hold.
+    bool encodeValue(const AttributeValue& attr, std::string& out)
+    {
+        if (!attr.value.set)
+            return false;
+
+        PbfWriter value(out);
+        switch (attr.type)
+        {
+        case ATTRTYPE_STRING:
+            value.addBytes(VALUE_STRING, attr.value.stringValue);
+            return true;
+        case ATTRTYPE_INT:
+            if (attr.value.intValue >= 0)
+                value.addVarint(VALUE_UINT, (std::uint64_t)attr.value.intValue);
+            else
+                value.addVarint(VALUE_SINT, zig_zag_encode64(attr.value.intValue));
+            return true;
+        case ATTRTYPE_DOUBLE:
+            value.addDouble(VALUE_DOUBLE, attr.value.doubleValue);
+            return true;
+        case ATTRTYPE_BOOL:
+            value.addVarint(VALUE_BOOL, attr.value.boolValue ? 1 : 0);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool writeTile(
+        const FeatureList& features,
+        const TileKey& key,
+        const std::string& layerName,
+        std::string& output,
+        unsigned extent,
+        const std::vector<std::string>& attributes_to_write)
+    {
+        if (!key.valid() || extent == 0)
+            return false;
+
+        std::string layerData;
+        PbfWriter layer(layerData);
+        layer.addVarint(LAYER_VERSION, 2);
+        layer.addBytes(LAYER_NAME, layerName);
+
+        // key and value tables, shared by all features in the layer:
+        std::unordered_map<std::string, std::uint32_t> keyIndex;
+        std::unordered_map<std::string, std::uint32_t> valueIndex;
+        std::vector<const std::string*> keys, values;
+
+        std::vector<const Geometry*> points, lines, polygons;
+        std::vector<GeometryEncoder::Vertex> verts, pointVerts;
+        std::vector<std::uint32_t> tags;
+        std::string encodedValue, featureData;
+        unsigned count = 0;
+
+        for (auto& feature : features)
+        {
+            if (!feature.valid() || !feature->getGeometry())
+                continue;
+
+            points.clear();
+            lines.clear();
+            polygons.clear();
+            collectParts(feature->getGeometry(), points, lines, polygons);
+
+            tags.clear();
+            for (auto& attr : feature->getAttrs())
+            {
+                if (!attributes_to_write.empty() &&
+                    std::find(attributes_to_write.begin(), attributes_to_write.end(), attr.first) == attributes_to_write.end())
+                {
+                    continue;
+                }
+
+                encodedValue.clear();
+                if (!encodeValue(attr.second, encodedValue))
+                    continue;
+
+                auto k = keyIndex.emplace(attr.first, (std::uint32_t)keys.size());
+                if (k.second)
+                    keys.push_back(&k.first->first);
 
+                auto v = valueIndex.emplace(encodedValue, (std::uint32_t)values.size());
+                if (v.second)
+                    values.push_back(&v.first->first);
 
-                    osg::ref_ptr< osgEarth::Geometry > geometry;
+                tags.push_back(k.first->second);
+                tags.push_back(v.first->second);
+            }
+
+            // A feature of mixed geometry becomes one MVT feature per type,
+            // each carrying the same id and tags.
+            for (unsigned type = Point; type <= Polygon; ++type)
+            {
+                GeometryEncoder encoder(key, extent);
 
-                    eGeomType geomType = static_cast<eGeomType>(feature.type());
-                    if (geomType == MVT::Polygon)
+                if (type == Point)
+                {
+                    // a multipoint is a single MoveTo carrying every point
+                    pointVerts.clear();
+                    for (auto part : points)
                     {
-                        geometry = decodePolygon(feature, key, layer.extent());
+                        encoder.quantize(part, verts);
+                        pointVerts.insert(pointVerts.end(), verts.begin(), verts.end());
                     }
-                    else if (geomType == MVT::LineString)
+                    encoder.addPoints(pointVerts);
+                }
+                else if (type == LineString)
+                {
+                    for (auto part : lines)
                     {
-                        geometry = decodeLine(feature, key, layer.extent());
+                        encoder.quantize(part, verts);
+                        encoder.addLine(verts);
                     }
-                    else if (geomType == MVT::Point)
+                }
+                else
+                {
+                    for (auto part : polygons)
                     {
-                        geometry = decodePoint(feature, key, layer.extent());
+                        encoder.quantize(part, verts);
+                        if (!encoder.addRing(verts, true))
+                            continue;
 
-                        // This is a bit of a hack, but if a point is outside of the extents we remove it.
-                        // Lines and Polygons that extend outside of the tileset we keep though b/c we assume that they are just slightly going outside of the
-                        // extent.  Should probably make this an option somewhere.
-                        if (geometry)
+                        if (part->getType() == Geometry::TYPE_POLYGON)
                         {
-                            if (!key.getExtent().contains(geometry->getBounds().center()))
+                            for (auto& hole : static_cast<const osgEarth::Polygon*>(part)->getHoles())
                             {
-                                geometry = NULL;
+                                encoder.quantize(hole.get(), verts);
+                                encoder.addRing(verts, false);
                             }
                         }
                     }
-                    else
-                    {
-                        OE_SOFT_ASSERT(false, "MVT: unsupported geometry type \"" << feature.type() << "\"");
-                        geometry = decodeLine(feature, key, layer.extent());
-                    }
+                }
 
-                    if (geometry)
-                    {
-                        oeFeature->setFID(feature.id());
-                        oeFeature->setGeometry(geometry.get());
-                        features.push_back(oeFeature.get());
-                    }
+                if (encoder.commands.empty())
+                    continue;
 
-                }
+                featureData.clear();
+                PbfWriter out(featureData);
+                if (feature->getFID() >= 0)
+                    out.addVarint(FEATURE_ID, (std::uint64_t)feature->getFID());
+                if (!tags.empty())
+                    out.addPacked(FEATURE_TAGS, tags);
+                out.addVarint(FEATURE_TYPE, type);
+                out.addPacked(FEATURE_GEOMETRY, encoder.commands);
+
+                layer.addBytes(LAYER_FEATURES, featureData);
+                ++count;
             }
         }
-        else
-        {
-            OE_WARN << "Failed to parse mvt" << key.str() << std::endl;
-            return false;
-        }
 
+        // the spec forbids empty layers
+        if (count == 0)
+            return true;
+
+        for (auto k : keys)
+            layer.addBytes(LAYER_KEYS, *k);
+        for (auto v : values)
+            layer.addBytes(LAYER_VALUES, *v);
+        layer.addVarint(LAYER_EXTENT, extent);
+
+        PbfWriter(output).addBytes(TILE_LAYERS, layerData);
         return true;
     }
 
@@ -611,9 +1313,7 @@ MVTFeatureSource::createFeatureCursorImplementation(const Query& query, Progress
         // the pointer returned from _blob gets freed internally by sqlite, supposedly
         const char* data = (const char*)sqlite3_column_blob(select, 0);
         int dataLen = sqlite3_column_bytes(select, 0);
-        std::string dataBuffer(data, dataLen);
-        std::stringstream in(dataBuffer);
-        MVT::readTile(in, key, features, options().layers());
+        MVT::readTile(data, dataLen, key, features, options().layers(), options().attributes());
     }
     else
     {    
@@ -687,12 +1387,10 @@ MVTFeatureSource::iterateTiles(int zoomLevel, int limit, int offset, const GeoEx
         // the pointer returned from _blob gets freed internally by sqlite, supposedly
         const char* data = (const char*)sqlite3_column_blob(select, 3);
         int dataLen = sqlite3_column_bytes(select, 3);
-        std::string dataBuffer(data, dataLen);
-        std::stringstream in(dataBuffer);
 
         FeatureList features;
 
-        MVT::readTile(in, key, features, options().layers());
+        MVT::readTile(data, dataLen, key, features, options().layers(), options().attributes());
 
         // If we have any features and we have an fid attribute, override the fid of the features
         // NOTE: FeatureSource normally does this, but we're bypassing it here... consider a refactoring...
@@ -0,0 +1,582 @@
+/* osgEarth
+ * Copyright 2025 Pelican Mapping
+ * MIT License
+ */
+#include <osgEarth/MVTTiler>
+
+#ifdef OSGEARTH_HAVE_MVT
+
+#include <osgEarth/MVT>
+#include <osgEarth/TileHandler>
+#include <osgEarth/TileVisitor>
+#include <osgEarth/FlatGeometry>
+#include <osgEarth/SimplifyFilter>
+#include <osgEarth/FilterContext>
+#include <osgEarth/FeatureCursor>
+#include <osgEarth/JsonUtils>
+#include <osgEarth/StringUtils>
+#include <osgEarth/rtree.h>
+#include <osgDB/Registry>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <sqlite3.h>
+
+#define LC "[MVTTiler] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    // Latitude limit of the spherical mercator profile
+    const double MAX_MERCATOR_LATITUDE = 85.0511287798;
+
+    // Everything a writer needs to describe the tileset
+    struct TilesetInfo
+    {
+        std::string name;
+        unsigned minLevel;
+        unsigned maxLevel;
+        GeoExtent extent; // in WGS84
+        std::string vectorLayers; // the "vector_layers" JSON
+        bool compressed;
+    };
+
+    class TileWriter
+    {
+    public:
+        virtual ~TileWriter() { }
+        virtual Status write(const TileKey& key, const std::string& data) = 0;
+        virtual Status close(const TilesetInfo& info) = 0;
+    };
+
+    // Writes tiles into an MBTiles database. Everything goes into a single
+    // transaction that is committed by close().
+    class MBTilesWriter : public TileWriter
+    {
+    public:
+        ~MBTilesWriter()
+        {
+            if (_insert)
+                sqlite3_finalize(_insert);
+            if (_database)
+                sqlite3_close(_database);
+        }
+
+        Status open(const std::string& filename)
+        {
+            int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX;
+            if (sqlite3_open_v2(filename.c_str(), &_database, flags, 0L) != SQLITE_OK)
+            {
+                return Status(Status::ResourceUnavailable, Stringify()
+                    << "Database \"" << filename << "\": " << sqlite3_errmsg(_database));
+            }
+
+            const char* setup =
+                "PRAGMA synchronous=OFF;"
+                "CREATE TABLE IF NOT EXISTS metadata (name text, value text);"
+                "CREATE UNIQUE INDEX IF NOT EXISTS name ON metadata (name);"
+                "CREATE TABLE IF NOT EXISTS tiles (zoom_level integer, tile_column integer, tile_row integer, tile_data blob);"
+                "CREATE UNIQUE INDEX IF NOT EXISTS tile_index ON tiles (zoom_level, tile_column, tile_row);"
+                "BEGIN TRANSACTION;";
+
+            if (!exec(setup))
+            {
+                return Status(Status::GeneralError, Stringify()
+                    << "Failed to create tables: " << sqlite3_errmsg(_database));
+            }
+
+            const char* insert = "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)";
+            if (sqlite3_prepare_v2(_database, insert, -1, &_insert, 0L) != SQLITE_OK)
+            {
+                return Status(Status::GeneralError, Stringify()
+                    << "Failed to prepare insert: " << sqlite3_errmsg(_database));
+            }
+
+            return Status::OK();
+        }
+
+        Status write(const TileKey& key, const std::string& data) override
+        {
+            // flip Y axis
+            unsigned numCols, numRows;
+            key.getProfile()->getNumTiles(key.getLevelOfDetail(), numCols, numRows);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            sqlite3_bind_int(_insert, 1, key.getLevelOfDetail());
+            sqlite3_bind_int(_insert, 2, key.getTileX());
+            sqlite3_bind_int(_insert, 3, numRows - key.getTileY() - 1);
+            sqlite3_bind_blob(_insert, 4, data.data(), (int)data.size(), SQLITE_STATIC);
+
+            int rc = sqlite3_step(_insert);
+            sqlite3_reset(_insert);
+
+            if (rc != SQLITE_DONE)
+            {
+                return Status(Status::GeneralError, Stringify()
+                    << "Failed to write tile " << key.str() << ": " << sqlite3_errmsg(_database));
+            }
+            return Status::OK();
+        }
+
+        Status close(const TilesetInfo& info) override
+        {
+            const GeoExtent& e = info.extent;
+            putMetaData("name", info.name);
+            putMetaData("format", "pbf");
+            putMetaData("type", "overlay");
+            putMetaData("minzoom", std::to_string(info.minLevel));
+            putMetaData("maxzoom", std::to_string(info.maxLevel));
+            putMetaData("bounds", Stringify() << e.xMin() << "," << e.yMin() << "," << e.xMax() << "," << e.yMax());
+            putMetaData("center", Stringify() << e.getCentroid().x() << "," << e.getCentroid().y() << "," << info.minLevel);
+            putMetaData("json", "{\"vector_layers\":" + info.vectorLayers + "}");
+
+            if (!exec("COMMIT;"))
+            {
+                return Status(Status::GeneralError, Stringify()
+                    << "Failed to commit tiles: " << sqlite3_errmsg(_database));
+            }
+            return Status::OK();
+        }
+
+    private:
+        sqlite3* _database = nullptr;
+        sqlite3_stmt* _insert = nullptr;
+        std::mutex _mutex;
+
+        bool exec(const char* sql)
+        {
+            return sqlite3_exec(_database, sql, 0L, 0L, 0L) == SQLITE_OK;
+        }
+
+        void putMetaData(const std::string& name, const std::string& value)
+        {
+            sqlite3_stmt* stmt = nullptr;
+            const char* sql = "INSERT OR REPLACE INTO metadata (name, value) VALUES (?, ?)";
+            if (sqlite3_prepare_v2(_database, sql, -1, &stmt, 0L) == SQLITE_OK)
+            {
+                sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_bind_text(stmt, 2, value.c_str(), -1, SQLITE_TRANSIENT);
+                if (sqlite3_step(stmt) != SQLITE_DONE)
+                {
+                    OE_WARN << LC << "Failed to write metadata \"" << name << "\": " << sqlite3_errmsg(_database) << std::endl;
+                }
+                sqlite3_finalize(stmt);
+            }
+        }
+    };
+
+    // Writes tiles as {z}/{x}/{y}.pbf files under a directory, with the
+    // tileset description in metadata.json.
+    class DirectoryWriter : public TileWriter
+    {
+    public:
+        DirectoryWriter(const std::string& root) :
+            _root(root) { }
+
+        Status write(const TileKey& key, const std::string& data) override
+        {
+            std::string filename = Stringify()
+                << _root << "/" << key.getLevelOfDetail() << "/" << key.getTileX() << "/" << key.getTileY() << ".pbf";
+
+            if (!osgDB::makeDirectoryForFile(filename))
+            {
+                return Status(Status::ResourceUnavailable, "Failed to create directory for " + filename);
+            }
+
+            std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+            out.write(data.data(), data.size());
+            if (!out)
+            {
+                return Status(Status::GeneralError, "Failed to write " + filename);
+            }
+            return Status::OK();
+        }
+
+        Status close(const TilesetInfo& info) override
+        {
+            const GeoExtent& e = info.extent;
+
+            Json::Value root(Json::objectValue);
+            root["name"] = info.name;
+            root["format"] = "pbf";
+            root["minzoom"] = info.minLevel;
+            root["maxzoom"] = info.maxLevel;
+            root["bounds"] = Json::Value(Json::arrayValue);
+            root["bounds"].append(e.xMin());
+            root["bounds"].append(e.yMin());
+            root["bounds"].append(e.xMax());
+            root["bounds"].append(e.yMax());
+            root["compression"] = info.compressed ? "gzip" : "none";
+
+            Json::Value layers;
+            Json::Reader().parse(info.vectorLayers, layers);
+            root["vector_layers"] = layers;
+
+            std::string filename = _root + "/metadata.json";
+            osgDB::makeDirectoryForFile(filename);
+            std::ofstream out(filename.c_str());
+            out << Json::StyledWriter().write(root);
+            if (!out)
+            {
+                return Status(Status::GeneralError, "Failed to write " + filename);
+            }
+            return Status::OK();
+        }
+
+    private:
+        std::string _root;
+    };
+
+    // Moves a feature into the output SRS in one batch transform.
+    // Geographic input is clamped to the mercator latitude limit first.
+    bool toOutputSRS(Feature* feature, const SpatialReference* srs, FlatGeometry& flat)
+    {
+        if (feature->getSRS()->isHorizEquivalentTo(srs))
+            return true;
+
+        flat.set(feature->getGeometry());
+        if (feature->getSRS()->isGeographic())
+        {
+            for (auto& y : flat.y)
+                y = osg::clampBetween(y, -MAX_MERCATOR_LATITUDE, MAX_MERCATOR_LATITUDE);
+        }
+
+        if (!flat.transform(feature->getSRS(), srs) || !flat.writeTo(feature->getGeometry()))
+            return false;
+
+        feature->setSRS(srs);
+        return true;
+    }
+
+    /**
+     * Builds and encodes one tile per call. hasData() consults an R-tree
+     * of feature bounds so the visitor never descends into empty space.
+     */
+    class MVTTileHandler : public TileHandler
+    {
+    public:
+        using Index = RTree<unsigned, double, 2>;
+
+        MVTTileHandler(
+            FeatureSource* source,
+            const Query& query,
+            const Index& index,
+            TileWriter& writer,
+            const MVTTiler& options) :
+            _source(source),
+            _query(query),
+            _index(index),
+            _writer(writer),
+            _options(options),
+            _tilesWritten(0u),
+            _bytesWritten(0u)
+        {
+            for (auto& name : options.getAttributes())
+                _attributes.push_back(toLower(name));
+        }
+
+        bool hasData(const TileKey& key) const override
+        {
+            Bounds b = getBufferedBounds(key);
+            double a_min[2] = { b.xMin(), b.yMin() };
+            double a_max[2] = { b.xMax(), b.yMax() };
+            auto stop_on_any_hit = [](const unsigned&) { return RTREE_STOP_SEARCHING; };
+            return _index.Search(a_min, a_max, stop_on_any_hit) > 0;
+        }
+
+        bool handleTile(const TileKey& key, const TileVisitor& tv) override
+        {
+            const SpatialReference* srs = key.getProfile()->getSRS();
+            Bounds buffered = getBufferedBounds(key);
+
+            // Let the source's own spatial filter find the candidates.
+            Query tileQuery;
+            tileQuery.bounds() = GeoExtent(srs, buffered).transform(_source->getFeatureProfile()->getSRS()).bounds();
+            Query query = _query.combineWith(tileQuery);
+
+            FeatureList features, points;
+            FlatGeometry flat;
+
+            osg::ref_ptr<FeatureCursor> cursor = _source->createFeatureCursor(query, {}, nullptr, tv.getProgressCallback());
+            while (cursor.valid() && cursor->hasMore())
+            {
+                osg::ref_ptr<Feature> feature = cursor->nextFeature();
+                if (!feature.valid() || !feature->getGeometry())
+                    continue;
+
+                if (!toOutputSRS(feature.get(), srs, flat))
+                    continue;
+
+                Bounds bounds = feature->getGeometry()->getBounds();
+                if (!intersects2d(bounds, buffered))
+                    continue;
+
+                if (!contains(buffered, bounds))
+                {
+                    osg::ref_ptr<Geometry> cropped;
+#ifdef OSGEARTH_HAVE_GEOS
+                    cropped = feature->getGeometry()->crop(buffered);
+#else
+                    flat.set(feature->getGeometry());
+                    cropped = flat.crop(buffered).toGeometry();
+#endif
+                    if (!cropped.valid())
+                        continue;
+                    feature->setGeometry(cropped.get());
+                }
+
+                if (feature->getGeometry()->isPointSet())
+                    points.push_back(feature);
+                else
+                    features.push_back(feature);
+            }
+
+#ifdef OSGEARTH_HAVE_GEOS
+            if (_options.getSimplifyTolerance() > 0.0 && !features.empty())
+            {
+                SimplifyFilter simplify;
+                simplify.setTolerance(_options.getSimplifyTolerance() * key.getExtent().width() / (double)_options.getExtent());
+                simplify.setPreserveTopology(true);
+                FilterContext context;
+                simplify.push(features, context);
+            }
+#endif
+
+            features.insert(features.end(), points.begin(), points.end());
+            if (features.empty())
+                return true;
+
+            std::string tile;
+            MVT::writeTile(features, key, _options.getLayerName(), tile, _options.getExtent(), _attributes);
+            if (tile.empty())
+                return true;
+
+            if (_compressor.valid())
+            {
+                std::ostringstream output;
+                if (!_compressor->compress(output, tile))
+                {
+                    OE_WARN << LC << "Failed to compress tile " << key.str() << std::endl;
+                    return false;
+                }
+                tile = output.str();
+            }
+
+            Status status = _writer.write(key, tile);
+            if (status.isError())
+            {
+                OE_WARN << LC << status.message() << std::endl;
+                return false;
+            }
+
+            _tilesWritten++;
+            _bytesWritten += tile.size();
+            return true;
+        }
+
+        unsigned getEstimatedTileCount(
+            const std::vector<GeoExtent>& extents,
+            unsigned minLevel,
+            unsigned maxLevel) const override
+        {
+            if (extents.empty())
+                return 0u;
+
+            double count = 0.0;
+            for (auto& extent : extents)
+            {
+                for (unsigned lod = minLevel; lod <= maxLevel; ++lod)
+                {
+                    double w = _profileExtent.width() / (double)(1u << lod);
+                    double h = _profileExtent.height() / (double)(1u << lod);
+                    double cols = std::floor((extent.xMax() - _profileExtent.xMin()) / w) - std::floor((extent.xMin() - _profileExtent.xMin()) / w) + 1.0;
+                    double rows = std::floor((_profileExtent.yMax() - extent.yMin()) / h) - std::floor((_profileExtent.yMax() - extent.yMax()) / h) + 1.0;
+                    count += cols * rows;
+                }
+            }
+            return (unsigned)std::min(count, 4294967295.0);
+        }
+
+        void setProfileExtent(const GeoExtent& value) { _profileExtent = value; }
+
+        void setCompressor(osgDB::BaseCompressor* value) { _compressor = value; }
+
+        unsigned getTilesWritten() const { return _tilesWritten; }
+
+        std::uint64_t getBytesWritten() const { return _bytesWritten; }
+
+    private:
+        osg::ref_ptr<FeatureSource> _source;
+        Query _query;
+        const Index& _index;
+        TileWriter& _writer;
+        const MVTTiler& _options;
+        std::vector<std::string> _attributes;
+        GeoExtent _profileExtent;
+        osg::ref_ptr<osgDB::BaseCompressor> _compressor;
+        std::atomic<unsigned> _tilesWritten;
+        std::atomic<std::uint64_t> _bytesWritten;
+
+        Bounds getBufferedBounds(const TileKey& key) const
+        {
+            const GeoExtent& e = key.getExtent();
+            double bx = e.width() * (double)_options.getBuffer() / (double)_options.getExtent();
+            double by = e.height() * (double)_options.getBuffer() / (double)_options.getExtent();
+            return Bounds(e.xMin() - bx, e.yMin() - by, 0.0, e.xMax() + bx, e.yMax() + by, 0.0);
+        }
+    };
+
+    // Describes the layer for the tileset metadata, in the form
+    // [{"id": name, "fields": {attr: type}, "minzoom": n, "maxzoom": n}]
+    std::string describeLayer(const FeatureSource* source, const MVTTiler& options)
+    {
+        Json::Value fields(Json::objectValue);
+        for (auto& field : source->getSchema())
+        {
+            std::string name = toLower(field.first);
+            if (!options.getAttributes().empty() &&
+                std::find_if(options.getAttributes().begin(), options.getAttributes().end(),
+                    [&](const std::string& a) { return toLower(a) == name; }) == options.getAttributes().end())
+            {
+                continue;
+            }
+
+            fields[name] =
+                field.second == ATTRTYPE_INT || field.second == ATTRTYPE_DOUBLE ? "Number" :
+                field.second == ATTRTYPE_BOOL ? "Boolean" :
+                "String";
+        }
+
+        Json::Value layer(Json::objectValue);
+        layer["id"] = options.getLayerName();
+        layer["fields"] = fields;
+        layer["minzoom"] = options.getMinLevel();
+        layer["maxzoom"] = options.getMaxLevel();
+
+        Json::Value layers(Json::arrayValue);
+        layers.append(layer);
+        return Json::FastWriter().write(layers);
+    }
+}
+
+MVTTiler::MVTTiler() :
+    _minLevel(0u),
+    _maxLevel(14u),
+    _layerName("features"),
+    _extent(4096u),
+    _buffer(64u),
+    _simplify(1.0),
+    _compress(true),
+    _numThreads(std::max(1u, std::thread::hardware_concurrency()))
+{
+    //nop
+}
+
+Status
+MVTTiler::run(FeatureSource* source, const std::string& destination, ProgressCallback* progress)
+{
+    if (!source || !source->isOpen())
+        return Status(Status::ServiceUnavailable, "Feature source is not open");
+
+    if (_extent == 0u || _minLevel > _maxLevel)
+        return Status(Status::ConfigurationError, "Illegal extent or level range");
+
+    osg::ref_ptr<const Profile> profile = Profile::create(Profile::SPHERICAL_MERCATOR);
+    const SpatialReference* srs = profile->getSRS();
+
+    // Pass 1: stream every feature once and keep only its bounds.
+    source->buildSpatialIndex();
+
+    MVTTileHandler::Index index;
+    Bounds dataBounds;
+    unsigned count = 0u;
+    FlatGeometry flat;
+
+    osg::ref_ptr<FeatureCursor> cursor = source->createFeatureCursor(_query, {}, nullptr, progress);
+    while (cursor.valid() && cursor->hasMore())
+    {
+        if (progress && progress->isCanceled())
+            return Status(Status::GeneralError, "Canceled");
+
+        osg::ref_ptr<Feature> feature = cursor->nextFeature();
+        if (!feature.valid() || !feature->getGeometry() || !toOutputSRS(feature.get(), srs, flat))
+            continue;
+
+        Bounds b = feature->getGeometry()->getBounds();
+        if (!b.valid())
+            continue;
+
+        double a_min[2] = { b.xMin(), b.yMin() };
+        double a_max[2] = { b.xMax(), b.yMax() };
+        index.Insert(a_min, a_max, count++);
+        dataBounds.expandBy(b);
+    }
+    cursor = nullptr;
+
+    if (count == 0u)
+        return Status(Status::ResourceUnavailable, "No features to tile");
+
+    OE_INFO << LC << "Indexed " << count << " features" << std::endl;
+
+    // Pass 2: visit the tiles that have data and encode them.
+    std::unique_ptr<TileWriter> writer;
+    if (osgDB::getLowerCaseFileExtension(destination) == "mbtiles")
+    {
+        auto mbtiles = new MBTilesWriter();
+        writer.reset(mbtiles);
+        Status status = mbtiles->open(destination);
+        if (status.isError())
+            return status;
+    }
+    else
+    {
+        writer.reset(new DirectoryWriter(destination));
+    }
+
+    osg::ref_ptr<MVTTileHandler> handler = new MVTTileHandler(source, _query, index, *writer, *this);
+    handler->setProfileExtent(profile->getExtent());
+    if (_compress)
+    {
+        handler->setCompressor(osgDB::Registry::instance()->getObjectWrapperManager()->findCompressor("zlib"));
+    }
+
+    GeoExtent dataExtent(srs, dataBounds);
+
+    osg::ref_ptr<MultithreadedTileVisitor> visitor = new MultithreadedTileVisitor();
+    visitor->setTileHandler(handler.get());
+    visitor->setNumThreads(_numThreads);
+    visitor->setMinLevel(_minLevel);
+    visitor->setMaxLevel(_maxLevel);
+    visitor->addExtentToVisit(dataExtent);
+    visitor->setProgressCallback(progress);
+    visitor->run(profile.get());
+
+    if (progress && progress->isCanceled())
+        return Status(Status::GeneralError, "Canceled");
+
+    TilesetInfo info;
+    info.name = _layerName;
+    info.minLevel = _minLevel;
+    info.maxLevel = _maxLevel;
+    info.extent = dataExtent.transform(srs->getGeographicSRS());
+    info.vectorLayers = describeLayer(source, *this);
+    info.compressed = _compress;
+
+    Status status = writer->close(info);
+
+    OE_INFO << LC << "Wrote " << handler->getTilesWritten() << " tiles ("
+        << handler->getBytesWritten() / 1024 << " KB) to " << destination << std::endl;
+
+    return status;
+}
+
+#endif // OSGEARTH_HAVE_MVT
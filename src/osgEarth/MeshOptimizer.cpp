@@ -0,0 +1,515 @@
+/* osgEarth
+ * Copyright 2025 Pelican Mapping
+ * MIT License
+ */
+#include <osgEarth/MeshOptimizer>
+#include <osgEarth/DrawInstanced>
+#include <osgEarth/StringUtils>
+#include <osgEarth/Notify>
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/LOD>
+#include <osg/TriangleIndexFunctor>
+#include <osgUtil/MeshOptimizers>
+
+#ifdef OSGEARTH_HAVE_MESH_OPTIMIZER
+#include <meshoptimizer.h>
+#endif
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <functional>
+#include <set>
+#include <unordered_map>
+
+#define LC "[MeshOptimizer] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+std::string
+MeshOptimizer::Stats::toString() const
+{
+    return Stringify()
+        << "geometries=" << geometries << " (skipped " << skipped << ")"
+        << ", vertices=" << verticesBefore << "->" << verticesAfter
+        << ", indices=" << indicesBefore << "->" << indicesAfter
+        << ", bytes=" << bytesBefore << "->" << bytesAfter;
+}
+
+namespace
+{
+    struct CollectTriangles
+    {
+        std::vector<unsigned>* indices = nullptr;
+
+        void operator()(unsigned i0, unsigned i1, unsigned i2)
+        {
+            // degenerate triangles are dropped here
+            if (i0 != i1 && i1 != i2 && i0 != i2)
+            {
+                indices->push_back(i0);
+                indices->push_back(i1);
+                indices->push_back(i2);
+            }
+        }
+    };
+
+    void collectTriangles(osg::Geometry& geom, std::vector<unsigned>& indices)
+    {
+        indices.clear();
+        osg::TriangleIndexFunctor<CollectTriangles> functor;
+        functor.indices = &indices;
+        geom.accept(functor);
+    }
+
+    // One per-vertex array and the means to replace it on the geometry.
+    struct Stream
+    {
+        osg::ref_ptr<osg::Array> array;
+        std::function<void(osg::Array*)> set;
+        bool collapsible; // may become an overall binding if constant
+    };
+
+    size_t countBytes(const osg::Geometry& geom)
+    {
+        size_t bytes = 0u;
+        osg::Geometry::ArrayList arrays;
+        geom.getArrayList(arrays);
+        for (auto* array : arrays)
+            bytes += array->getTotalDataSize();
+
+        for (unsigned i = 0; i < geom.getNumPrimitiveSets(); ++i)
+        {
+            const osg::DrawElements* de = geom.getPrimitiveSet(i)->getDrawElements();
+            if (de)
+                bytes += de->getTotalDataSize();
+        }
+        return bytes;
+    }
+
+    size_t countIndices(const osg::Geometry& geom)
+    {
+        size_t count = 0u;
+        for (unsigned i = 0; i < geom.getNumPrimitiveSets(); ++i)
+            count += geom.getPrimitiveSet(i)->getNumIndices();
+        return count;
+    }
+
+    // Only plain, non-instanced triangle primitives qualify.
+    bool hasOnlyTriangles(const osg::Geometry& geom)
+    {
+        if (geom.getNumPrimitiveSets() == 0)
+            return false;
+
+        for (unsigned i = 0; i < geom.getNumPrimitiveSets(); ++i)
+        {
+            const osg::PrimitiveSet* ps = geom.getPrimitiveSet(i);
+            if (ps->getNumInstances() > 0 || ps->getUserData() != nullptr)
+                return false;
+
+            GLenum mode = ps->getMode();
+            if (mode != GL_TRIANGLES && mode != GL_TRIANGLE_STRIP && mode != GL_TRIANGLE_FAN)
+                return false;
+        }
+        return true;
+    }
+
+    // Gathers every per-vertex array on the geometry. Returns false if any
+    // array is bound in a way the optimizer can't preserve.
+    bool collectStreams(osg::Geometry& geom, unsigned numVerts, std::vector<Stream>& streams)
+    {
+        bool ok = true;
+
+        auto add = [&](osg::Array* array, std::function<void(osg::Array*)> set, bool collapsible)
+        {
+            if (!array || !ok)
+                return;
+
+            osg::Array::Binding binding = array->getBinding();
+            if (binding == osg::Array::BIND_OFF || binding == osg::Array::BIND_OVERALL)
+                return;
+
+            if (binding == osg::Array::BIND_PER_PRIMITIVE_SET)
+            {
+                ok = false;
+                return;
+            }
+
+            if (array->getNumElements() == numVerts && array->getDataPointer() != nullptr)
+                streams.push_back({ array, set, collapsible });
+            else if (binding == osg::Array::BIND_UNDEFINED && array->getNumElements() == 1u)
+                return;
+            else
+                ok = false;
+        };
+
+        osg::Geometry* g = &geom;
+        add(geom.getVertexArray(), [g](osg::Array* a) { g->setVertexArray(a); }, false);
+        add(geom.getNormalArray(), [g](osg::Array* a) { g->setNormalArray(a); }, true);
+        add(geom.getColorArray(), [g](osg::Array* a) { g->setColorArray(a); }, true);
+        add(geom.getSecondaryColorArray(), [g](osg::Array* a) { g->setSecondaryColorArray(a); }, false);
+        add(geom.getFogCoordArray(), [g](osg::Array* a) { g->setFogCoordArray(a); }, false);
+
+        for (unsigned i = 0; i < geom.getNumTexCoordArrays(); ++i)
+            add(geom.getTexCoordArray(i), [g, i](osg::Array* a) { g->setTexCoordArray(i, a); }, false);
+
+        for (unsigned i = 0; i < geom.getNumVertexAttribArrays(); ++i)
+            add(geom.getVertexAttribArray(i), [g, i](osg::Array* a) { g->setVertexAttribArray(i, a); }, false);
+
+        return ok;
+    }
+
+    // New array of the same type in which element i of the input lands at
+    // remap[i]; elements mapped to ~0u are dropped.
+    osg::Array* remapArray(const osg::Array* input, const std::vector<unsigned>& remap, unsigned newCount)
+    {
+        osg::Array* output = static_cast<osg::Array*>(input->cloneType());
+        output->setBinding(input->getBinding());
+        output->setNormalize(input->getNormalize());
+        output->setPreserveDataType(input->getPreserveDataType());
+        output->resizeArray(newCount);
+
+        if (newCount > 0)
+        {
+            unsigned stride = input->getElementSize();
+            const char* src = static_cast<const char*>(input->getDataPointer());
+            char* dst = static_cast<char*>(const_cast<GLvoid*>(output->getDataPointer()));
+            for (unsigned i = 0; i < remap.size(); ++i)
+            {
+                if (remap[i] != ~0u)
+                    std::memcpy(dst + (size_t)remap[i] * stride, src + (size_t)i * stride, stride);
+            }
+        }
+        return output;
+    }
+
+    void applyRemap(std::vector<Stream>& streams, std::vector<unsigned>& indices, const std::vector<unsigned>& remap, unsigned newCount)
+    {
+        for (auto& stream : streams)
+        {
+            stream.array = remapArray(stream.array.get(), remap, newCount);
+            stream.set(stream.array.get());
+        }
+
+        for (auto& i : indices)
+            i = remap[i];
+    }
+
+    // Builds a remap table that merges vertices whose bytes match in every
+    // stream and drops unreferenced ones. Returns the new vertex count.
+    unsigned weldVertices(const std::vector<Stream>& streams, unsigned numVerts, const std::vector<unsigned>& indices, std::vector<unsigned>& remap)
+    {
+        remap.assign(numVerts, ~0u);
+
+#ifdef OSGEARTH_HAVE_MESH_OPTIMIZER
+        std::vector<meshopt_Stream> ms;
+        ms.reserve(streams.size());
+        for (auto& stream : streams)
+        {
+            size_t size = stream.array->getElementSize();
+            ms.push_back({ stream.array->getDataPointer(), size, size });
+        }
+        return (unsigned)meshopt_generateVertexRemapMulti(
+            remap.data(), indices.data(), indices.size(), numVerts, ms.data(), ms.size());
+#else
+        // first-use order, which also gives decent fetch locality
+        std::unordered_map<std::string, unsigned> unique;
+        std::string key;
+        unsigned next = 0u;
+        for (auto i : indices)
+        {
+            if (remap[i] != ~0u)
+                continue;
+
+            key.clear();
+            for (auto& stream : streams)
+            {
+                unsigned size = stream.array->getElementSize();
+                key.append(static_cast<const char*>(stream.array->getDataPointer()) + (size_t)i * size, size);
+            }
+
+            auto result = unique.emplace(key, next);
+            if (result.second)
+                ++next;
+            remap[i] = result.first->second;
+        }
+        return next;
+#endif
+    }
+
+    bool isConstant(const osg::Array* array)
+    {
+        unsigned size = array->getElementSize();
+        const char* data = static_cast<const char*>(array->getDataPointer());
+        for (unsigned i = 1; i < array->getNumElements(); ++i)
+        {
+            if (std::memcmp(data, data + (size_t)i * size, size) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    osg::DrawElements* makeElements(const std::vector<unsigned>& indices, unsigned numVerts, bool allowShort)
+    {
+        if (allowShort && numVerts <= 0xFFFF)
+        {
+            osg::DrawElementsUShort* de = new osg::DrawElementsUShort(GL_TRIANGLES);
+            de->reserve(indices.size());
+            for (auto i : indices)
+                de->push_back((GLushort)i);
+            return de;
+        }
+        return new osg::DrawElementsUInt(GL_TRIANGLES, indices.begin(), indices.end());
+    }
+
+    struct Optimize : public osg::NodeVisitor
+    {
+        const MeshOptimizer& _options;
+        MeshOptimizer::Stats& _stats;
+        std::set<osg::Geometry*> _visited;
+        std::vector<osg::ref_ptr<osg::Geode>> _geodes;
+
+        // simplified index sets, per geometry, coarsest last
+        std::unordered_map<osg::Geometry*, std::vector<osg::ref_ptr<osg::DrawElements>>> _levels;
+
+        Optimize(const MeshOptimizer& options, MeshOptimizer::Stats& stats) :
+            osg::NodeVisitor(TRAVERSE_ALL_CHILDREN),
+            _options(options),
+            _stats(stats)
+        {
+            setNodeMaskOverride(~0);
+        }
+
+        void apply(osg::Geode& geode) override
+        {
+            _geodes.push_back(&geode);
+            traverse(geode);
+        }
+
+        void apply(osg::Geometry& geom) override
+        {
+            if (!_visited.insert(&geom).second)
+                return;
+
+            if (dynamic_cast<DrawInstanced::InstanceGeometry*>(&geom) ||
+                dynamic_cast<osg::Vec3Array*>(geom.getVertexArray()) == nullptr ||
+                !hasOnlyTriangles(geom))
+            {
+                ++_stats.skipped;
+                return;
+            }
+
+            unsigned numVerts = geom.getVertexArray()->getNumElements();
+
+            std::vector<Stream> streams;
+            if (numVerts == 0u || !collectStreams(geom, numVerts, streams))
+            {
+                ++_stats.skipped;
+                return;
+            }
+
+            std::vector<unsigned> indices;
+            collectTriangles(geom, indices);
+            if (indices.empty())
+            {
+                ++_stats.skipped;
+                return;
+            }
+
+            _stats.verticesBefore += numVerts;
+            _stats.indicesBefore += countIndices(geom);
+            _stats.bytesBefore += countBytes(geom);
+
+            std::vector<unsigned> remap;
+
+            if (_options.weld())
+            {
+                unsigned count = weldVertices(streams, numVerts, indices, remap);
+                applyRemap(streams, indices, remap, count);
+                numVerts = count;
+            }
+
+            if (_options.reorder())
+            {
+#ifdef OSGEARTH_HAVE_MESH_OPTIMIZER
+                meshopt_optimizeVertexCache(indices.data(), indices.data(), indices.size(), numVerts);
+
+                const osg::Vec3Array* verts = static_cast<const osg::Vec3Array*>(geom.getVertexArray());
+                meshopt_optimizeOverdraw(indices.data(), indices.data(), indices.size(),
+                    &verts->front().x(), numVerts, sizeof(osg::Vec3f), 1.05f);
+
+                remap.resize(numVerts);
+                unsigned count = (unsigned)meshopt_optimizeVertexFetchRemap(
+                    remap.data(), indices.data(), indices.size(), numVerts);
+                applyRemap(streams, indices, remap, count);
+                numVerts = count;
+#else
+                geom.removePrimitiveSet(0, geom.getNumPrimitiveSets());
+                geom.addPrimitiveSet(new osg::DrawElementsUInt(GL_TRIANGLES, indices.begin(), indices.end()));
+
+                osgUtil::VertexCacheVisitor cache;
+                cache.optimizeVertices(geom);
+                osgUtil::VertexAccessOrderVisitor order;
+                order.optimizeOrder(geom);
+
+                // the osgUtil passes replace arrays and primitives, so start over
+                numVerts = geom.getVertexArray()->getNumElements();
+                streams.clear();
+                collectStreams(geom, numVerts, streams);
+                collectTriangles(geom, indices);
+#endif
+            }
+
+#ifdef OSGEARTH_HAVE_MESH_OPTIMIZER
+            if (_options.simplifyLevels() > 0u)
+            {
+                const osg::Vec3Array* verts = static_cast<const osg::Vec3Array*>(geom.getVertexArray());
+                std::vector<unsigned> source = indices;
+                auto& levels = _levels[&geom];
+
+                for (unsigned level = 0; level < _options.simplifyLevels(); ++level)
+                {
+                    size_t target = (size_t)(source.size() * _options.simplifyRatio()) / 3u * 3u;
+                    if (target < 3u)
+                        break;
+
+                    std::vector<unsigned> simplified(source.size());
+                    simplified.resize(meshopt_simplify(
+                        simplified.data(), source.data(), source.size(),
+                        &verts->front().x(), numVerts, sizeof(osg::Vec3f),
+                        target, _options.simplifyError()));
+
+                    // no progress; further levels would be the same
+                    if (simplified.empty() || simplified.size() >= source.size())
+                        break;
+
+                    if (_options.reorder())
+                        meshopt_optimizeVertexCache(simplified.data(), simplified.data(), simplified.size(), numVerts);
+
+                    levels.push_back(makeElements(simplified, numVerts, _options.stripLayout()));
+                    source.swap(simplified);
+                }
+
+                for (auto& de : levels)
+                    _stats.bytesAfter += de->getTotalDataSize();
+            }
+#endif
+
+            if (_options.stripLayout())
+            {
+                for (auto& stream : streams)
+                {
+                    if (stream.collapsible && numVerts > 1u && isConstant(stream.array.get()))
+                    {
+                        std::vector<unsigned> first(1u, 0u);
+                        osg::ref_ptr<osg::Array> overall = remapArray(stream.array.get(), first, 1u);
+                        overall->setBinding(osg::Array::BIND_OVERALL);
+                        stream.set(overall.get());
+                    }
+                }
+            }
+
+            geom.removePrimitiveSet(0, geom.getNumPrimitiveSets());
+            geom.addPrimitiveSet(makeElements(indices, numVerts, _options.stripLayout()));
+            geom.setShape(nullptr);
+            geom.dirtyBound();
+
+            ++_stats.geometries;
+            _stats.verticesAfter += numVerts;
+            _stats.indicesAfter += indices.size();
+            _stats.bytesAfter += countBytes(geom);
+        }
+
+        // Replaces each Geode that has simplified geometry with an LOD
+        // over the full-detail Geode and one Geode per simplified level.
+        osg::Node* buildLODs(osg::Node* root)
+        {
+            for (auto& geode : _geodes)
+            {
+                unsigned numLevels = 0u;
+                for (unsigned i = 0; i < geode->getNumDrawables(); ++i)
+                {
+                    auto level = _levels.find(geode->getDrawable(i)->asGeometry());
+                    if (level != _levels.end())
+                        numLevels = std::max(numLevels, (unsigned)level->second.size());
+                }
+
+                if (numLevels == 0u)
+                    continue;
+
+                float range = geode->getBound().radius() * _options.lodRangeFactor();
+
+                osg::ref_ptr<osg::LOD> lod = new osg::LOD();
+                lod->setName(geode->getName());
+                lod->addChild(geode.get(), 0.0f, range);
+
+                for (unsigned k = 0; k < numLevels; ++k)
+                {
+                    osg::ref_ptr<osg::Geode> coarse = new osg::Geode();
+                    coarse->setStateSet(geode->getStateSet());
+
+                    for (unsigned i = 0; i < geode->getNumDrawables(); ++i)
+                    {
+                        osg::Drawable* drawable = geode->getDrawable(i);
+                        auto level = _levels.find(drawable->asGeometry());
+                        if (level != _levels.end() && !level->second.empty())
+                        {
+                            // share the vertex arrays; only the indices differ
+                            auto& elements = level->second[std::min(k, (unsigned)level->second.size() - 1u)];
+                            osg::Geometry* geom = new osg::Geometry(*drawable->asGeometry(), osg::CopyOp::SHALLOW_COPY);
+                            geom->removePrimitiveSet(0, geom->getNumPrimitiveSets());
+                            geom->addPrimitiveSet(elements.get());
+                            coarse->addDrawable(geom);
+                        }
+                        else
+                        {
+                            coarse->addDrawable(drawable);
+                        }
+                    }
+
+                    float next = (k + 1u < numLevels) ? range * 2.0f : FLT_MAX;
+                    lod->addChild(coarse.get(), range, next);
+                    range = next;
+                }
+
+                if (geode.get() == root)
+                {
+                    root = lod.get();
+                }
+
+                osg::Node::ParentList parents = geode->getParents();
+                for (auto* parent : parents)
+                {
+                    parent->replaceChild(geode.get(), lod.get());
+                }
+
+                if (root == lod.get())
+                    lod.release();
+            }
+            return root;
+        }
+    };
+}
+
+osg::Node*
+MeshOptimizer::run(osg::Node* node)
+{
+    _stats = Stats();
+
+    if (!node)
+        return node;
+
+#ifndef OSGEARTH_HAVE_MESH_OPTIMIZER
+    if (simplifyLevels() > 0u)
+    {
+        OE_DEBUG << LC << "Mesh simplification requires meshoptimizer; skipping" << std::endl;
+    }
+#endif
+
+    Optimize optimize(*this, _stats);
+    node->accept(optimize);
+    return optimize.buildLODs(node);
+}
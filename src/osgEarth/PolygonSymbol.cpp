@@ -12,7 +12,9 @@ OSGEARTH_REGISTER_SIMPLE_SYMBOL(polygon, PolygonSymbol);
 PolygonSymbol::PolygonSymbol(const PolygonSymbol& rhs, const osg::CopyOp& copyop) :
     Symbol(rhs, copyop),
     _fill(rhs._fill),
-    _outline(rhs._outline)
+    _outline(rhs._outline),
+    _material(rhs._material),
+    _tessellation(rhs._tessellation)
 {
     //nop
 }
@@ -31,6 +33,9 @@ PolygonSymbol::getConfig() const
     conf.set("fill", fill());
     conf.set("outline", outline());
     conf.set("material", material());
+    conf.set("tessellation", "earcut", tessellation(), Util::Tessellator::TECHNIQUE_EARCUT);
+    conf.set("tessellation", "earclip", tessellation(), Util::Tessellator::TECHNIQUE_EARCLIP);
+    conf.set("tessellation", "glu", tessellation(), Util::Tessellator::TECHNIQUE_GLU);
     return conf;
 }
 
@@ -40,6 +45,9 @@ PolygonSymbol::mergeConfig(const Config& conf)
     conf.get("fill", fill());
     conf.get("outline", outline());
     conf.get("material", material());
+    conf.get("tessellation", "earcut", tessellation(), Util::Tessellator::TECHNIQUE_EARCUT);
+    conf.get("tessellation", "earclip", tessellation(), Util::Tessellator::TECHNIQUE_EARCLIP);
+    conf.get("tessellation", "glu", tessellation(), Util::Tessellator::TECHNIQUE_GLU);
 }
 
 void
@@ -65,4 +73,12 @@ PolygonSymbol::parseSLD(const Config& c, Style& style)
     else if (match(c.key(), "fill-material")) {
         style.getOrCreate<PolygonSymbol>()->material() = URI(c.value(), c.referrer());
     }
+    else if (match(c.key(), "fill-tessellation")) {
+        if (ci_equals(c.value(), "earcut"))
+            style.getOrCreate<PolygonSymbol>()->tessellation() = Util::Tessellator::TECHNIQUE_EARCUT;
+        else if (ci_equals(c.value(), "earclip"))
+            style.getOrCreate<PolygonSymbol>()->tessellation() = Util::Tessellator::TECHNIQUE_EARCLIP;
+        else if (ci_equals(c.value(), "glu"))
+            style.getOrCreate<PolygonSymbol>()->tessellation() = Util::Tessellator::TECHNIQUE_GLU;
+    }
 }
@@ -0,0 +1,375 @@
+/* osgEarth
+ * Copyright 2025 Pelican Mapping
+ * MIT License
+ */
+#include <osgEarth/ScanlineRasterizer>
+#include <osgEarth/Threading>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OE_SCANLINE_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+#define ARENA_SCANLINE_RASTERIZER "oe.rasterizer"
+
+// Rows per band when rendering with multiple threads
+#define BAND_HEIGHT 32
+
+ScanlineRasterizer::ScanlineRasterizer(int width, int height) :
+    _width(std::max(width, 0)),
+    _height(std::max(height, 0)),
+    _fillRule(FILL_NON_ZERO),
+    _numThreads(1u),
+    _startX(0.0), _startY(0.0),
+    _lastX(0.0), _lastY(0.0),
+    _open(false)
+{
+    //nop
+}
+
+void
+ScanlineRasterizer::moveTo(double x, double y)
+{
+    close();
+    _startX = _lastX = x;
+    _startY = _lastY = y;
+    _open = true;
+}
+
+void
+ScanlineRasterizer::lineTo(double x, double y)
+{
+    if (!_open)
+    {
+        moveTo(x, y);
+        return;
+    }
+    addEdge(_lastX, _lastY, x, y);
+    _lastX = x;
+    _lastY = y;
+}
+
+void
+ScanlineRasterizer::close()
+{
+    if (_open)
+    {
+        addEdge(_lastX, _lastY, _startX, _startY);
+        _lastX = _startX;
+        _lastY = _startY;
+        _open = false;
+    }
+}
+
+void
+ScanlineRasterizer::addGeometry(const Geometry* geometry, double xmin, double ymin, double xf, double yf)
+{
+    if (!geometry)
+        return;
+
+    ConstGeometryIterator gi(geometry);
+    while (gi.hasMore())
+    {
+        const Geometry* part = gi.next();
+        for (auto p = part->begin(); p != part->end(); ++p)
+        {
+            double x = xf * (p->x() - xmin);
+            double y = yf * (p->y() - ymin);
+            if (p == part->begin())
+                moveTo(x, y);
+            else
+                lineTo(x, y);
+        }
+        close();
+    }
+}
+
+void
+ScanlineRasterizer::reset()
+{
+    _edges.clear();
+    _open = false;
+}
+
+void
+ScanlineRasterizer::addEdge(double x0, double y0, double x1, double y1)
+{
+    if (y0 == y1 || !std::isfinite(x0) || !std::isfinite(y0) || !std::isfinite(x1) || !std::isfinite(y1))
+        return;
+
+    // rows are independent, so edges wholly above or below the buffer
+    // contribute nothing:
+    if (std::max(y0, y1) <= 0.0 || std::min(y0, y1) >= (double)_height)
+        return;
+
+    // Everything right of the buffer is never read, and everything left of
+    // it only matters for the winding it adds; so after splitting the edge
+    // where it crosses the left and right borders we can clamp each piece
+    // into [0..width] without changing the coverage of any pixel.
+    double t[4] = { 0.0, 1.0, 1.0, 1.0 };
+    int n = 1;
+    const double borders[2] = { 0.0, (double)_width };
+    for (double b : borders)
+    {
+        if ((x0 - b) * (x1 - b) < 0.0)
+            t[n++] = (b - x0) / (x1 - x0);
+    }
+    t[n++] = 1.0;
+    std::sort(t + 1, t + n - 1);
+
+    double dx = x1 - x0, dy = y1 - y0;
+    for (int i = 0; i + 1 < n; ++i)
+    {
+        double ax = x0 + dx * t[i], ay = y0 + dy * t[i];
+        double bx = i + 2 == n ? x1 : x0 + dx * t[i + 1];
+        double by = i + 2 == n ? y1 : y0 + dy * t[i + 1];
+
+        // pieces entirely right of the buffer don't matter
+        if (std::min(ax, bx) >= (double)_width)
+            continue;
+
+        ax = osg::clampBetween(ax, 0.0, (double)_width);
+        bx = osg::clampBetween(bx, 0.0, (double)_width);
+
+        if (ay < by)
+            _edges.push_back(Edge{ ax, ay, bx, by, 1.0f });
+        else if (ay > by)
+            _edges.push_back(Edge{ bx, by, ax, ay, -1.0f });
+    }
+}
+
+void
+ScanlineRasterizer::renderBand(
+    int rowBegin, int rowEnd,
+    std::vector<float>& accum,
+    std::vector<int>& rowStart,
+    std::vector<float>& coverage,
+    RowFunction func, void* user) const
+{
+    // Each row of the accumulation buffer holds two extra cells, because
+    // an edge on the right border deposits area just past it.
+    const int stride = _width + 2;
+    const int numRows = rowEnd - rowBegin;
+
+    accum.assign((std::size_t)numRows * stride, 0.0f);
+    rowStart.assign(numRows, INT_MAX);
+    coverage.resize(_width + 4);
+
+    // Walk each edge one row at a time. Within a row the edge is a straight
+    // segment; the area between it and the right edge of every cell it
+    // touches goes to that cell, and whatever remains of the edge's height
+    // goes to the next cell so that the running sum carries it to the end
+    // of the row. The technique is the one popularized by font-rs.
+    for (auto& edge : _edges)
+    {
+        double ys = std::max(edge.y0, (double)rowBegin);
+        double ye = std::min(edge.y1, (double)rowEnd);
+        if (ys >= ye)
+            continue;
+
+        double dxdy = (edge.x1 - edge.x0) / (edge.y1 - edge.y0);
+        double x = edge.x0 + (ys - edge.y0) * dxdy;
+
+        int yfirst = (int)std::floor(ys);
+        int ylast = (int)std::ceil(ye);
+
+        for (int y = yfirst; y < ylast; ++y)
+        {
+            double dy = std::min((double)(y + 1), ye) - std::max((double)y, ys);
+            double xnext = x + dxdy * dy;
+            float d = (float)dy * edge.dir;
+
+            float* a = &accum[(std::size_t)(y - rowBegin) * stride];
+
+            double xa = osg::clampBetween(std::min(x, xnext), 0.0, (double)_width);
+            double xb = osg::clampBetween(std::max(x, xnext), 0.0, (double)_width);
+            double xafloor = std::floor(xa);
+            int xai = (int)xafloor;
+            int xbi = (int)std::ceil(xb);
+
+            int& start = rowStart[y - rowBegin];
+            start = std::min(start, xai);
+
+            if (xbi <= xai + 1)
+            {
+                // edge stays within one cell
+                float xmf = (float)(0.5 * (xa + xb) - xafloor);
+                a[xai] += d - d * xmf;
+                a[xai + 1] += d * xmf;
+            }
+            else
+            {
+                // edge crosses several cells: a triangle in the first,
+                // trapezoids in the middle, and a triangle in the last
+                double s = 1.0 / (xb - xa);
+                double xaf = xa - xafloor;
+                double a0 = 0.5 * s * (1.0 - xaf) * (1.0 - xaf);
+                double xbf = xb - (double)xbi + 1.0;
+                double am = 0.5 * s * xbf * xbf;
+
+                a[xai] += d * (float)a0;
+
+                if (xbi == xai + 2)
+                {
+                    a[xai + 1] += d * (float)(1.0 - a0 - am);
+                }
+                else
+                {
+                    double a1 = s * (1.5 - xaf);
+                    a[xai + 1] += d * (float)(a1 - a0);
+                    float ds = d * (float)s;
+                    for (int xi = xai + 2; xi < xbi - 1; ++xi)
+                        a[xi] += ds;
+                    double a2 = a1 + (double)(xbi - xai - 3) * s;
+                    a[xbi - 1] += d * (float)(1.0 - a2 - am);
+                }
+
+                a[xbi] += d * (float)am;
+            }
+
+            x = xnext;
+        }
+    }
+
+    const bool evenOdd = (_fillRule == FILL_EVEN_ODD);
+
+    // Integrate each row into coverage
+    for (int r = 0; r < numRows; ++r)
+    {
+        int begin = rowStart[r];
+        if (begin >= _width)
+            continue;
+
+        const float* a = &accum[(std::size_t)r * stride];
+        float* c = coverage.data();
+        int x = begin;
+        float sum = 0.0f;
+
+#ifdef OE_SCANLINE_SSE2
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 two = _mm_set1_ps(2.0f);
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 signBit = _mm_set1_ps(-0.0f);
+        __m128 carry = _mm_setzero_ps();
+
+        for (; x + 4 <= _width; x += 4)
+        {
+            // prefix sum of four cells in two shift-and-add steps:
+            __m128 v = _mm_loadu_ps(a + x);
+            v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)));
+            v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8)));
+            v = _mm_add_ps(v, carry);
+            carry = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+
+            __m128 w = _mm_andnot_ps(signBit, v);
+            if (evenOdd)
+            {
+                // fold the winding into [0..1]: w mod 2, mirrored above 1
+                __m128 k = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(w, half)));
+                w = _mm_sub_ps(w, _mm_mul_ps(k, two));
+                w = _mm_min_ps(w, _mm_sub_ps(two, w));
+            }
+            _mm_storeu_ps(c + x, _mm_min_ps(w, one));
+        }
+        sum = _mm_cvtss_f32(carry);
+#endif
+
+        for (; x < _width; ++x)
+        {
+            sum += a[x];
+            float w = std::fabs(sum);
+            if (evenOdd)
+            {
+                w -= 2.0f * std::floor(w * 0.5f);
+                w = std::min(w, 2.0f - w);
+            }
+            c[x] = std::min(w, 1.0f);
+        }
+
+        func(user, rowBegin + r, begin, _width, c);
+    }
+}
+
+void
+ScanlineRasterizer::renderRows(RowFunction func, void* user)
+{
+    close();
+
+    if (_edges.empty() || _width == 0 || _height == 0)
+        return;
+
+    unsigned numBands = (unsigned)((_height + BAND_HEIGHT - 1) / BAND_HEIGHT);
+
+    jobs::parallel_for(ARENA_SCANLINE_RASTERIZER, numBands, [&](unsigned begin, unsigned end)
+        {
+            std::vector<float> accum, coverage;
+            std::vector<int> rowStart;
+            int rowBegin = (int)begin * BAND_HEIGHT;
+            int rowEnd = std::min((int)end * BAND_HEIGHT, _height);
+            renderBand(rowBegin, rowEnd, accum, rowStart, coverage, func, user);
+        },
+        1u, _numThreads);
+}
+
+void
+ScanlineRasterizer::renderCoverage(unsigned char* data, unsigned rowStride)
+{
+    render([&](int row, int begin, int end, const float* coverage)
+        {
+            unsigned char* p = data + (std::size_t)row * rowStride;
+            for (int x = begin; x < end; ++x)
+            {
+                float c = coverage[x];
+                if (c > 0.0f)
+                {
+                    p[x] = (unsigned char)((float)p[x] + (255.0f - (float)p[x]) * c + 0.5f);
+                }
+            }
+        });
+}
+
+void
+ScanlineRasterizer::renderRGBA(unsigned char* data, unsigned rowStride, const osg::Vec4f& color)
+{
+    const float src[4] = {
+        osg::clampBetween(color.r(), 0.0f, 1.0f) * 255.0f,
+        osg::clampBetween(color.g(), 0.0f, 1.0f) * 255.0f,
+        osg::clampBetween(color.b(), 0.0f, 1.0f) * 255.0f,
+        osg::clampBetween(color.a(), 0.0f, 1.0f) * 255.0f };
+
+    const float alpha = osg::clampBetween(color.a(), 0.0f, 1.0f);
+
+    render([&](int row, int begin, int end, const float* coverage)
+        {
+            unsigned char* p = data + (std::size_t)row * rowStride + begin * 4;
+            for (int x = begin; x < end; ++x, p += 4)
+            {
+                float k = coverage[x] * alpha;
+                if (k > 0.0f)
+                {
+                    for (int i = 0; i < 4; ++i)
+                        p[i] = (unsigned char)((float)p[i] + (src[i] - (float)p[i]) * k + 0.5f);
+                }
+            }
+        });
+}
+
+void
+ScanlineRasterizer::renderValue(float* data, unsigned rowStride, float value, float minCoverage)
+{
+    render([&](int row, int begin, int end, const float* coverage)
+        {
+            float* p = data + (std::size_t)row * rowStride;
+            for (int x = begin; x < end; ++x)
+            {
+                if (coverage[x] >= minCoverage && coverage[x] > 0.0f)
+                    p[x] = value;
+            }
+        });
+}
@@ -0,0 +1,434 @@
+/* osgEarth
+ * Copyright 2025 Pelican Mapping
+ * MIT License
+ */
+#include <osgEarth/SpatialJoin>
+#include <osgEarth/FeatureSource>
+#include <osgEarth/FeatureCursor>
+#include <osgEarth/Progress>
+#include <osgEarth/StringUtils>
+#include <osgEarth/Threading>
+#include <osgEarth/Metrics>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+
+#define LC "[SpatialJoin] "
+
+#define ARENA_SPATIAL_JOIN "oe.spatialjoin"
+
+// R-tree fan-out
+#define NODE_CAPACITY 16u
+
+// Fewest probes worth giving a thread of their own
+#define MIN_PROBES_PER_THREAD 4096u
+
+// Polygons with more rings than this fall back to Ring::contains2D
+#define MAX_PREPARED_RINGS 64u
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+//........................................................................
+
+void
+SpatialJoin::RTree::build(const std::vector<Box>& boxes)
+{
+    _levels.clear();
+    _boxes = boxes;
+    _entries.resize(boxes.size());
+    for (unsigned i = 0; i < boxes.size(); ++i)
+        _entries[i] = i;
+
+    if (boxes.empty())
+        return;
+
+    // Sort-Tile-Recursive: order items into vertical slices by x, each
+    // slice by y, and group consecutive runs into nodes. Returns the
+    // nodes covering the (reordered) items.
+    auto pack = [](std::vector<unsigned>& items, const std::function<const Box&(unsigned)>& boxOf)
+    {
+        auto cx = [&](unsigned i) { const Box& b = boxOf(i); return b.xmin + b.xmax; };
+        auto cy = [&](unsigned i) { const Box& b = boxOf(i); return b.ymin + b.ymax; };
+
+        size_t numNodes = (items.size() + NODE_CAPACITY - 1) / NODE_CAPACITY;
+        size_t numSlices = (size_t)std::ceil(std::sqrt((double)numNodes));
+        size_t sliceSize = numSlices * NODE_CAPACITY;
+
+        std::sort(items.begin(), items.end(), [&](unsigned a, unsigned b) { return cx(a) < cx(b); });
+        for (size_t s = 0; s < items.size(); s += sliceSize)
+        {
+            auto end = items.begin() + std::min(s + sliceSize, items.size());
+            std::sort(items.begin() + s, end, [&](unsigned a, unsigned b) { return cy(a) < cy(b); });
+        }
+
+        std::vector<Node> nodes;
+        nodes.reserve(numNodes);
+        for (size_t first = 0; first < items.size(); first += NODE_CAPACITY)
+        {
+            Node node;
+            node.first = (unsigned)first;
+            node.count = (unsigned)std::min((size_t)NODE_CAPACITY, items.size() - first);
+            node.box = boxOf(items[first]);
+            for (unsigned i = 1; i < node.count; ++i)
+            {
+                const Box& b = boxOf(items[first + i]);
+                node.box.xmin = std::min(node.box.xmin, b.xmin);
+                node.box.ymin = std::min(node.box.ymin, b.ymin);
+                node.box.xmax = std::max(node.box.xmax, b.xmax);
+                node.box.ymax = std::max(node.box.ymax, b.ymax);
+            }
+            nodes.push_back(node);
+        }
+        return nodes;
+    };
+
+    _levels.push_back(pack(_entries, [&](unsigned i) -> const Box& { return _boxes[i]; }));
+
+    while (_levels.back().size() > 1)
+    {
+        // reorder the level below into STR order, then group it
+        std::vector<Node>& below = _levels.back();
+        std::vector<unsigned> order(below.size());
+        for (unsigned i = 0; i < order.size(); ++i)
+            order[i] = i;
+
+        std::vector<Node> parents = pack(order, [&](unsigned i) -> const Box& { return below[i].box; });
+
+        std::vector<Node> reordered(below.size());
+        for (unsigned i = 0; i < order.size(); ++i)
+            reordered[i] = below[order[i]];
+        below.swap(reordered);
+
+        _levels.push_back(std::move(parents));
+    }
+}
+
+template<typename FUNC>
+void
+SpatialJoin::RTree::query(const Box& box, FUNC&& func) const
+{
+    if (_levels.empty())
+        return;
+
+    auto overlaps = [&](const Box& b)
+    {
+        return b.xmin <= box.xmax && b.xmax >= box.xmin && b.ymin <= box.ymax && b.ymax >= box.ymin;
+    };
+
+    // (level, node) pairs still to visit; depth first, so this holds at
+    // most (NODE_CAPACITY-1) entries per level
+    std::pair<unsigned, unsigned> stack[256];
+    int top = 0;
+
+    const unsigned root = (unsigned)_levels.size() - 1u;
+    for (unsigned i = 0; i < _levels[root].size(); ++i)
+        stack[top++] = { root, i };
+
+    while (top > 0)
+    {
+        auto item = stack[--top];
+        const Node& node = _levels[item.first][item.second];
+        if (!overlaps(node.box))
+            continue;
+
+        if (item.first == 0u)
+        {
+            for (unsigned i = node.first; i < node.first + node.count; ++i)
+            {
+                if (overlaps(_boxes[_entries[i]]))
+                    func(_entries[i]);
+            }
+        }
+        else
+        {
+            for (unsigned i = node.first; i < node.first + node.count; ++i)
+                stack[top++] = { item.first - 1u, i };
+        }
+    }
+}
+
+//........................................................................
+
+SpatialJoin::SpatialJoin(const FeatureList& boundaries) :
+    _boundaries(boundaries)
+{
+    OE_PROFILING_ZONE;
+
+    std::vector<Box> boundaryBoxes;
+    boundaryBoxes.reserve(_boundaries.size());
+
+    for (unsigned i = 0; i < _boundaries.size(); ++i)
+    {
+        const Geometry* geom = _boundaries[i].valid() ? _boundaries[i]->getGeometry() : nullptr;
+        if (geom && geom->isValid())
+        {
+            Bounds b = geom->getBounds();
+            boundaryBoxes.push_back(Box{ b.xMin(), b.yMin(), b.xMax(), b.yMax() });
+
+            ConstGeometryIterator iter(geom, false);
+            while (iter.hasMore())
+            {
+                const Ring* ring = dynamic_cast<const Ring*>(iter.next());
+                if (ring)
+                    addPart(i, ring);
+            }
+        }
+        else
+        {
+            // an empty box that nothing overlaps keeps the indices aligned
+            boundaryBoxes.push_back(Box{ DBL_MAX, DBL_MAX, -DBL_MAX, -DBL_MAX });
+        }
+    }
+
+    std::vector<Box> partBoxes;
+    partBoxes.reserve(_parts.size());
+    for (auto& part : _parts)
+        partBoxes.push_back(part.box);
+
+    _partTree.build(partBoxes);
+    _boundaryTree.build(boundaryBoxes);
+}
+
+void
+SpatialJoin::addPart(unsigned boundary, const Ring* ring)
+{
+    std::vector<const Ring*> rings{ ring };
+    auto* polygon = dynamic_cast<const Polygon*>(ring);
+    if (polygon)
+    {
+        for (auto& hole : polygon->getHoles())
+            rings.push_back(hole.get());
+    }
+
+    Part part;
+    part.boundary = boundary;
+    part.ring = ring;
+    part.numRings = (unsigned)rings.size();
+    part.box = Box{ DBL_MAX, DBL_MAX, -DBL_MAX, -DBL_MAX };
+    for (auto& p : *ring)
+    {
+        part.box.xmin = std::min(part.box.xmin, p.x());
+        part.box.ymin = std::min(part.box.ymin, p.y());
+        part.box.xmax = std::max(part.box.xmax, p.x());
+        part.box.ymax = std::max(part.box.ymax, p.y());
+    }
+
+    if (ring->size() < 3 || part.box.ymax <= part.box.ymin)
+        return;
+
+    part.firstBand = (unsigned)_bandOffsets.size();
+    part.numBands = 0;
+    part.bandScale = 0.0;
+
+    if (part.numRings <= MAX_PREPARED_RINGS)
+    {
+        // edges in the same order and orientation that Ring::contains2D
+        // walks them, so the crossing arithmetic is identical; horizontal
+        // edges can never be crossed and are dropped
+        std::vector<Edge> edges;
+        for (unsigned r = 0; r < rings.size(); ++r)
+        {
+            const Ring& poly = *rings[r];
+            if (poly.size() < 2)
+                continue;
+
+            bool is_open = poly.isOpen();
+            unsigned i = is_open ? 0 : 1;
+            unsigned j = is_open ? poly.size() - 1 : 0;
+            for (; i < poly.size(); j = i++)
+            {
+                if (poly[i].y() != poly[j].y())
+                    edges.push_back(Edge{ poly[i].x(), poly[i].y(), poly[j].x(), poly[j].y(), r });
+            }
+        }
+
+        part.numBands = osg::clampBetween((unsigned)std::sqrt((double)edges.size()), 1u, 1024u);
+        part.bandScale = (double)part.numBands / (part.box.ymax - part.box.ymin);
+
+        auto band = [&](double y)
+        {
+            return (unsigned)osg::clampBetween((int)((y - part.box.ymin) * part.bandScale), 0, (int)part.numBands - 1);
+        };
+
+        // bucket the edges by the bands they span (counting sort)
+        std::vector<unsigned> counts(part.numBands + 1, 0u);
+        for (auto& e : edges)
+        {
+            unsigned b0 = band(std::min(e.yi, e.yj)), b1 = band(std::max(e.yi, e.yj));
+            for (unsigned b = b0; b <= b1; ++b)
+                ++counts[b + 1];
+        }
+        for (unsigned b = 0; b < part.numBands; ++b)
+            counts[b + 1] += counts[b];
+
+        unsigned base = (unsigned)_edges.size();
+        _edges.resize(base + counts.back());
+        std::vector<unsigned> cursor(counts.begin(), counts.end() - 1);
+        for (auto& e : edges)
+        {
+            unsigned b0 = band(std::min(e.yi, e.yj)), b1 = band(std::max(e.yi, e.yj));
+            for (unsigned b = b0; b <= b1; ++b)
+                _edges[base + cursor[b]++] = e;
+        }
+
+        for (unsigned b = 0; b <= part.numBands; ++b)
+            _bandOffsets.push_back(base + counts[b]);
+    }
+
+    _parts.push_back(part);
+}
+
+bool
+SpatialJoin::contains(const Part& part, double x, double y) const
+{
+    if (x < part.box.xmin || x > part.box.xmax || y < part.box.ymin || y > part.box.ymax)
+        return false;
+
+    if (part.numBands == 0)
+        return part.ring->contains2D(x, y);
+
+    unsigned b = (unsigned)osg::clampBetween((int)((y - part.box.ymin) * part.bandScale), 0, (int)part.numBands - 1);
+    unsigned begin = _bandOffsets[part.firstBand + b];
+    unsigned end = _bandOffsets[part.firstBand + b + 1];
+
+    // one parity bit per ring: inside the outer ring and in no hole
+    unsigned long long parity = 0ull;
+    for (unsigned k = begin; k < end; ++k)
+    {
+        const Edge& e = _edges[k];
+        if ((((e.yi <= y) && (y < e.yj)) ||
+             ((e.yj <= y) && (y < e.yi))) &&
+            (x < (e.xj - e.xi) * (y - e.yi) / (e.yj - e.yi) + e.xi))
+        {
+            parity ^= (1ull << e.ring);
+        }
+    }
+
+    return parity == 1ull;
+}
+
+int
+SpatialJoin::findContaining(double x, double y) const
+{
+    int result = -1;
+    _partTree.query(Box{ x, y, x, y }, [&](unsigned p)
+        {
+            const Part& part = _parts[p];
+            if ((result < 0 || (int)part.boundary < result) && contains(part, x, y))
+                result = (int)part.boundary;
+        });
+    return result;
+}
+
+int
+SpatialJoin::findIntersecting(const Geometry* geometry) const
+{
+    if (!geometry || !geometry->isValid())
+        return -1;
+
+    Bounds b = geometry->getBounds();
+
+    std::vector<unsigned> candidates;
+    _boundaryTree.query(Box{ b.xMin(), b.yMin(), b.xMax(), b.yMax() }, [&](unsigned i)
+        {
+            candidates.push_back(i);
+        });
+
+    // test in original order so the first match wins, as with a plain loop
+    std::sort(candidates.begin(), candidates.end());
+    for (auto i : candidates)
+    {
+        if (_boundaries[i]->getGeometry()->intersects(geometry))
+            return (int)i;
+    }
+    return -1;
+}
+
+void
+SpatialJoin::findContaining(const std::vector<osg::Vec2d>& points, std::vector<int>& output) const
+{
+    output.resize(points.size());
+    jobs::parallel_for(ARENA_SPATIAL_JOIN, (unsigned)points.size(), [&](unsigned begin, unsigned end)
+        {
+            for (unsigned i = begin; i < end; ++i)
+                output[i] = findContaining(points[i].x(), points[i].y());
+        },
+        MIN_PROBES_PER_THREAD);
+}
+
+void
+SpatialJoin::findIntersecting(const std::vector<const Geometry*>& geometries, std::vector<int>& output) const
+{
+    output.resize(geometries.size());
+    jobs::parallel_for(ARENA_SPATIAL_JOIN, (unsigned)geometries.size(), [&](unsigned begin, unsigned end)
+        {
+            for (unsigned i = begin; i < end; ++i)
+                output[i] = findIntersecting(geometries[i]);
+        },
+        MIN_PROBES_PER_THREAD);
+}
+
+//........................................................................
+
+SpatialJoinCache::SpatialJoinCache(unsigned maxSize) :
+    _cache(true, maxSize)
+{
+    //nop
+}
+
+std::shared_ptr<const SpatialJoin>
+SpatialJoinCache::get(FeatureSource* source, const GeoExtent& extent, const SpatialReference* outputSRS, ProgressCallback* progress)
+{
+    if (!source || !source->getFeatureProfile() || !extent.isValid() || !outputSRS)
+        return nullptr;
+
+    OE_PROFILING_ZONE;
+
+    // the source's revision changes when its boundaries do
+    std::string key = Stringify() << std::setprecision(17)
+        << source->getUID() << ':' << source->getRevision() << ','
+        << extent.xMin() << ',' << extent.yMin() << ',' << extent.xMax() << ',' << extent.yMax() << ','
+        << extent.getSRS()->getHorizInitString() << ',' << outputSRS->getHorizInitString();
+
+    LRUCache<std::string, std::shared_ptr<const SpatialJoin>>::Record record;
+    if (_cache.get(key, record))
+        return record.value();
+
+    FeatureList boundaries;
+
+    GeoExtent localExtent = extent.transform(source->getFeatureProfile()->getSRS());
+    if (localExtent.intersects(source->getFeatureProfile()->getExtent()))
+    {
+        Query query;
+        query.bounds() = localExtent.bounds();
+
+        osg::ref_ptr<FeatureCursor> cursor = source->createFeatureCursor(query, {}, nullptr, progress);
+        if (cursor.valid())
+        {
+            cursor->fill(boundaries);
+        }
+    }
+
+    if (progress && progress->isCanceled())
+        return nullptr;
+
+    std::shared_ptr<const SpatialJoin> join;
+
+    if (!boundaries.empty())
+    {
+        // put the boundaries into the coordinate system of the features
+        // they'll be joined with
+        for (auto& boundary : boundaries)
+        {
+            boundary->transform(outputSRS);
+        }
+
+        join = std::make_shared<SpatialJoin>(boundaries);
+    }
+
+    _cache.insert(key, join);
+    return join;
+}
@@ -949,6 +949,66 @@ SpatialReference::transform(std::vector<osg::Vec3d>& points,
 }
 
 
+bool
+SpatialReference::transform(double* x,
+                            double* y,
+                            double* z,
+                            unsigned count,
+                            const SpatialReference* outputSRS) const
+{
+    OE_SOFT_ASSERT_AND_RETURN(outputSRS!=nullptr, false);
+    OE_SOFT_ASSERT_AND_RETURN(x!=nullptr && y!=nullptr, false);
+
+    if (!valid())
+        return false;
+
+    if (count == 0u || isEquivalentTo(outputSRS))
+        return true;
+
+    bool direct =
+        !isGeocentric() && !outputSRS->isGeocentric() &&
+        !isCube() && !outputSRS->isCube() &&
+        !isLTP() && !outputSRS->isLTP() &&
+        getVerticalDatum() == outputSRS->getVerticalDatum();
+
+    if (!direct)
+    {
+        // needs the full treatment; go through the AoS path.
+        std::vector<osg::Vec3d> points(count);
+        for (unsigned i = 0; i < count; ++i)
+            points[i].set(x[i], y[i], z ? z[i] : 0.0);
+
+        if (!transform(points, outputSRS))
+            return false;
+
+        for (unsigned i = 0; i < count; ++i)
+        {
+            x[i] = points[i].x();
+            y[i] = points[i].y();
+            if (z) z[i] = points[i].z();
+        }
+        return true;
+    }
+
+    // Z is unchanged when the vertical datums match, so only X and Y
+    // need to visit OGR, and they are already laid out the way it wants.
+    if (!transformXYPointArrays(getLocal(), x, y, count, outputSRS))
+        return false;
+
+    if (isProjected() && outputSRS->isGeographic())
+    {
+        // same clamp as the vector version
+        for (unsigned i = 0; i < count; ++i)
+        {
+            x[i] = osg::clampBetween(x[i], -180.0, 180.0);
+            y[i] = osg::clampBetween(y[i], -90.0, 90.0);
+        }
+    }
+
+    return true;
+}
+
+
 bool 
 SpatialReference::transform2D(double x, double y,
                               const SpatialReference* outputSRS,
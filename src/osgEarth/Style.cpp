@@ -226,3 +226,47 @@ Style::getConfig( bool keepOrigType ) const
 
     return conf;
 }
+
+//-----------------------------------------------------------------------------
+
+// OSG SERIALIZER for StyleGroup, so that cached feature graphs keep their styles
+#include <osgDB/ObjectWrapper>
+#include <osgDB/InputStream>
+#include <osgDB/OutputStream>
+
+namespace osgEarth { namespace Serializers { namespace StyleGroupClass
+{
+    using namespace osgEarth;
+
+    bool checkStyle(const StyleGroup& group)
+    {
+        return !group.style.empty();
+    }
+
+    bool writeStyle(osgDB::OutputStream& os, const StyleGroup& group)
+    {
+        os.writeWrappedString(group.style.getConfig(false).toJSON());
+        os << std::endl;
+        return true;
+    }
+
+    bool readStyle(osgDB::InputStream& is, StyleGroup& group)
+    {
+        std::string json;
+        is.readWrappedString(json);
+        Config conf;
+        if (conf.fromJSON(json))
+            group.style = Style(conf);
+        return true;
+    }
+
+    REGISTER_OBJECT_WRAPPER(
+        StyleGroup,
+        new osgEarth::StyleGroup,
+        osgEarth::StyleGroup,
+        "osg::Object osg::Node osg::Group osgEarth::StyleGroup")
+    {
+        ADD_USER_SERIALIZER(Style);
+    }
+
+} } }
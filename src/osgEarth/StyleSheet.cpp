@@ -244,12 +244,14 @@ void
 StyleSheet::addStyle( const Style& style )
 {
     options().styles()[ style.getName() ] = style;
+    bumpRevision();
 }
 
 void
 StyleSheet::removeStyle( const std::string& name )
 {
     options().styles().erase( name );
+    bumpRevision();
 }
 
 void
@@ -361,6 +363,7 @@ void
 StyleSheet::addSelector(const StyleSelector& value)
 {
     getSelectors()[value.name().get()] = value;
+    bumpRevision();
 }
 
 Style*
@@ -408,6 +411,7 @@ StyleSheet::addResourceLibrary( ResourceLibrary* lib )
 {
     Threading::ScopedWriteLock exclusive( _resLibsMutex );
     options().libraries()[ lib->getName() ] = lib;
+    bumpRevision();
 }
 
 ResourceLibrary*
@@ -435,6 +439,7 @@ void
 StyleSheet::setScript( ScriptDef* script )
 {
     options().script() = script;
+    bumpRevision();
 }
 
 StyleSheet::ScriptDef*
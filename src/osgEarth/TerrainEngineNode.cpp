@@ -237,6 +237,18 @@ TerrainEngineNode::createTileModel(const Map* map,
     return model.release();
 }
 
+void
+TerrainEngineNode::prefetchTileModels(const Map* map,
+                                      const std::vector<TileKey>& keys,
+                                      const CreateTileManifest& manifest,
+                                      ProgressCallback* progress)
+{
+    if ( _tileModelFactory.valid() )
+    {
+        _tileModelFactory->prefetch(map, keys, manifest, getRequirements(), progress);
+    }
+}
+
 void
 TerrainEngineNode::addCreateTileModelCallback(CreateTileModelCallback* callback)
 {
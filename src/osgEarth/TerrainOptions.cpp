@@ -64,6 +64,8 @@ TerrainOptions::getConfig() const
     conf.set("create_tiles_async", createTilesAsync());
     conf.set("create_tiles_grouped", createTilesGrouped());
     conf.set("restrict_polar_subdivision", restrictPolarSubdivision());
+    conf.set("meshing_method", "split", _meshingMethod, MeshingMethod::SPLIT);
+    conf.set("meshing_method", "cdt", _meshingMethod, MeshingMethod::CDT);
 
     conf.set("expiration_range", minExpiryRange()); // legacy
     conf.set("expiration_threshold", minResidentTiles()); // legacy
@@ -121,6 +123,8 @@ TerrainOptions::fromConfig(const Config& conf)
     conf.get("create_tiles_async", createTilesAsync());
     conf.get("create_tiles_grouped", createTilesGrouped());
     conf.get("restrict_polar_subdivision", restrictPolarSubdivision());
+    conf.get("meshing_method", "split", _meshingMethod, MeshingMethod::SPLIT);
+    conf.get("meshing_method", "cdt", _meshingMethod, MeshingMethod::CDT);
 
     conf.get("expiration_range", minExpiryRange()); // legacy
     conf.get("expiration_threshold", minResidentTiles()); // legacy
@@ -205,6 +209,7 @@ OE_OPTION_IMPL(TerrainOptionsAPI, bool, Visible, visible);
 OE_OPTION_IMPL(TerrainOptionsAPI, bool, CreateTilesAsync, createTilesAsync);
 OE_OPTION_IMPL(TerrainOptionsAPI, bool, CreateTilesGrouped, createTilesGrouped);
 OE_OPTION_IMPL(TerrainOptionsAPI, bool, RestrictPolarSubdivision, restrictPolarSubdivision);
+OE_OPTION_IMPL(TerrainOptionsAPI, MeshingMethod, MeshingMethod, meshingMethod);
 
 bool
 TerrainOptionsAPI::getGPUTessellation() const
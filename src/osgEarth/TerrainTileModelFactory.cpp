@@ -12,6 +12,7 @@
 
 #include <osg/Texture2D>
 #include <osg/Texture2DArray>
+#include <algorithm>
 
 #define LC "[TerrainTileModelFactory] "
 
@@ -22,6 +23,10 @@ using namespace osgEarth;
 #define LABEL_ELEVATION "Terrain textures"
 #define LABEL_COVERAGE "Terrain textures"
 
+// maximum number of prefetched images to hold at once; entries for
+// tiles that never load age out in FIFO order.
+#define MAX_PREFETCHED_IMAGES 256
+
 //.........................................................................
 
 
@@ -201,6 +206,113 @@ TerrainTileModelFactory::createStandaloneTileModel(
     return model.release();
 }
 
+void
+TerrainTileModelFactory::prefetch(
+    const Map*                       map,
+    const std::vector<TileKey>&      keys,
+    const CreateTileManifest&        manifest,
+    const TerrainEngineRequirements& require,
+    ProgressCallback*                progress)
+{
+    OE_PROFILING_ZONE;
+
+    if (keys.empty())
+        return;
+
+    ImageLayerVector layers;
+    map->getLayers(layers);
+
+    for (auto& imageLayer : layers)
+    {
+        if (progress && progress->isCanceled())
+            return;
+
+        // only layers that addImageLayer() would read synchronously:
+        if (!imageLayer->isOpen() ||
+            imageLayer->getRenderType() != imageLayer->RENDERTYPE_TERRAIN_SURFACE ||
+            manifest.excludes(imageLayer.get()) ||
+            imageLayer->useCreateTexture() ||
+            imageLayer->getAsyncLoading())
+        {
+            continue;
+        }
+
+        std::vector<TileKey> layerKeys;
+        for (auto& key : keys)
+        {
+            if (imageLayer->isKeyInLegalRange(key) && imageLayer->mayHaveData(key))
+                layerKeys.push_back(key);
+        }
+
+        if (layerKeys.size() < 2)
+            continue;
+
+        {
+            std::lock_guard<std::mutex> lock(_prefetchMutex);
+            for (auto& key : layerKeys)
+                _prefetchPending.emplace(imageLayer->getUID(), key);
+        }
+
+        int revision = imageLayer->getRevision();
+        std::vector<GeoImage> images = imageLayer->createImages(layerKeys, progress);
+        bool canceled = progress && progress->isCanceled();
+
+        std::lock_guard<std::mutex> lock(_prefetchMutex);
+        for (unsigned i = 0; i < layerKeys.size(); ++i)
+        {
+            // a key no longer pending was loaded by its tile in the meantime
+            PrefetchKey pk(imageLayer->getUID(), layerKeys[i]);
+            if (_prefetchPending.erase(pk) == 0 || canceled)
+                continue;
+
+            if (i < images.size() && images[i].valid())
+            {
+                if (_prefetched.find(pk) == _prefetched.end())
+                    _prefetchOrder.push_back(pk);
+                _prefetched[pk] = PrefetchedImage{ revision, images[i] };
+            }
+        }
+
+        while (_prefetchOrder.size() > MAX_PREFETCHED_IMAGES)
+        {
+            _prefetched.erase(_prefetchOrder.front());
+            _prefetchOrder.pop_front();
+        }
+    }
+}
+
+bool
+TerrainTileModelFactory::takePrefetchedImage(
+    const ImageLayer* layer,
+    const TileKey& key,
+    GeoImage& output)
+{
+    std::lock_guard<std::mutex> lock(_prefetchMutex);
+
+    if (_prefetched.empty() && _prefetchPending.empty())
+        return false;
+
+    PrefetchKey pk(layer->getUID(), key);
+    auto i = _prefetched.find(pk);
+    if (i == _prefetched.end())
+    {
+        _prefetchPending.erase(pk);
+        return false;
+    }
+
+    bool current = (i->second.revision == layer->getRevision());
+    if (current)
+        output = i->second.image;
+
+    // keep the order queue in step, so the trim only counts live images
+    auto k = std::find(_prefetchOrder.begin(), _prefetchOrder.end(), i->first);
+    if (k != _prefetchOrder.end())
+        _prefetchOrder.erase(k);
+
+    _prefetched.erase(i);
+    return current;
+}
+
 bool
 TerrainTileModelFactory::addImageLayer(
     TerrainTileModel* model,
@@ -249,7 +361,9 @@ TerrainTileModelFactory::addImageLayer(
 
         else
         {
-            GeoImage geoImage = imageLayer->createImage(key, progress);
+            GeoImage geoImage;
+            if (!takePrefetchedImage(imageLayer, key, geoImage))
+                geoImage = imageLayer->createImage(key, progress);
 
             if (geoImage.valid())
             {
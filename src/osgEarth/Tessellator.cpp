@@ -4,6 +4,8 @@
 */
 #include <iterator>
 #include <osgEarth/Tessellator>
+#include <osgUtil/Tessellator>
+#include <osg/TriangleIndexFunctor>
 
 #include <osgEarth/earcut.hpp>
 namespace mapbox {
@@ -24,22 +26,20 @@ namespace mapbox {
 
         template <>
         struct nth<0, osg::Vec3d> {
-            inline static float get(const osg::Vec3d &t) {
+            inline static double get(const osg::Vec3d &t) {
                 return t.x();
             };
         };
 
         template <>
         struct nth<1, osg::Vec3d> {
-            inline static float get(const osg::Vec3d &t) {
+            inline static double get(const osg::Vec3d &t) {
                 return t.y();
             };
         };
     }
 }
 
-#define USE_EARCUT
-
 using namespace osgEarth;
 using namespace osgEarth::Util;
 
@@ -51,6 +51,28 @@ using namespace osgEarth::Util;
 namespace
 {
 
+// Lets earcut read the points of a Geometry ring in place.
+struct RingView
+{
+    using value_type = osg::Vec3d;
+    const Geometry* ring;
+    std::size_t size() const { return ring->size(); }
+    bool empty() const { return ring->empty(); }
+    const osg::Vec3d& operator[](std::size_t i) const { return (*ring)[i]; }
+};
+
+// Collects triangle indices from any primitive set type.
+struct CollectTriangleIndices
+{
+    std::vector<uint32_t>* _indices = nullptr;
+    void operator()(unsigned a, unsigned b, unsigned c)
+    {
+        _indices->push_back(a);
+        _indices->push_back(b);
+        _indices->push_back(c);
+    }
+};
+
 // Borrowed from osgUtil/DelaunayTriangulator.cpp
 // Compute the circumcircle of a triangle (only x and y coordinates are used),
 // return (Cx, Cy, r^2)
@@ -228,7 +250,20 @@ void rotateToXY(std::vector<std::vector<osg::Vec3d>>& polygon)
 bool
 Tessellator::tessellateGeometry(osg::Geometry &geom)
 {
-#ifndef USE_EARCUT
+    switch (_technique)
+    {
+    case TECHNIQUE_EARCLIP:
+        return tessellateEarClip(geom);
+    case TECHNIQUE_GLU:
+        return tessellateGLU(geom);
+    default:
+        return tessellateEarcut(geom);
+    }
+}
+
+bool
+Tessellator::tessellateEarClip(osg::Geometry &geom)
+{
     osg::Vec3Array* vertices = dynamic_cast<osg::Vec3Array*>(geom.getVertexArray());
 
     if (!vertices || vertices->empty() || geom.getPrimitiveSetList().empty()) return false;
@@ -297,10 +332,30 @@ Tessellator::tessellateGeometry(osg::Geometry &geom)
         }
     }
     return success;
-#else
+}
+
+bool
+Tessellator::tessellateGLU(osg::Geometry &geom)
+{
+    if (geom.getNumPrimitiveSets() == 0)
+        return false;
+
+    osgUtil::Tessellator tess;
+    tess.setTessellationType(osgUtil::Tessellator::TESS_TYPE_GEOMETRY);
+    tess.setWindingType(osgUtil::Tessellator::TESS_WINDING_ODD);
+    tess.retessellatePolygons(geom);
+    return geom.getNumPrimitiveSets() > 0;
+}
+
+bool
+Tessellator::tessellateEarcut(osg::Geometry &geom)
+{
     // Create array
     std::vector< std::vector< osg::Vec2 > > polygon;
-    osg::Vec3Array* verts = static_cast<osg::Vec3Array*>(geom.getVertexArray());
+    osg::Vec3Array* verts = dynamic_cast<osg::Vec3Array*>(geom.getVertexArray());
+    if (!verts || verts->empty())
+        return false;
+
     int areaPlane = polygonPlane(*verts);
 
     for (unsigned int i = 0; i < geom.getNumPrimitiveSets(); i++)
@@ -336,7 +391,6 @@ Tessellator::tessellateGeometry(osg::Geometry &geom)
     std::copy(indices.begin(), indices.end(), std::back_inserter(*drawElements));
     geom.addPrimitiveSet(drawElements);
     return true;
-#endif
 }
 
 
@@ -547,6 +601,26 @@ Tessellator::tessellate2D(
     std::vector<uint32_t>& out_indices,
     Plane plane) const
 {
+    out_indices.clear();
+
+    if (!input)
+        return false;
+
+    // Fast path: earcut reads the rings in place, no copies.
+    if (_technique == TECHNIQUE_EARCUT && plane == PLANE_XY)
+    {
+        std::vector<RingView> polygon;
+        ConstGeometryIterator iter(input, true);
+        while (iter.hasMore())
+        {
+            const Geometry* part = iter.next();
+            polygon.push_back(RingView{ part });
+        }
+
+        out_indices = mapbox::earcut<uint32_t>(polygon);
+        return true;
+    }
+
     typedef std::vector< std::vector<osg::Vec3d> > poly_t;
 
     // build the data structure to tessellate:
@@ -565,8 +639,44 @@ Tessellator::tessellate2D(
         rotateToXY(polygon);
     }
 
-    // tessellate:
-    out_indices = mapbox::earcut<uint32_t>(polygon);
+    if (_technique == TECHNIQUE_EARCUT || polygon.empty())
+    {
+        out_indices = mapbox::earcut<uint32_t>(polygon);
+        return true;
+    }
+
+    // Other techniques work on an osg::Geometry, one primitive set per ring.
+    // The legacy ear clipper cannot cut holes, so it only sees the outer ring.
+    osg::ref_ptr<osg::Geometry> temp = new osg::Geometry();
+    osg::Vec3Array* verts = new osg::Vec3Array();
+    temp->setVertexArray(verts);
+
+    std::size_t numRings = _technique == TECHNIQUE_EARCLIP ? 1 : polygon.size();
+    for (std::size_t r = 0; r < numRings; ++r)
+    {
+        unsigned first = verts->size();
+        for (auto& p : polygon[r])
+            verts->push_back(osg::Vec3(p.x(), p.y(), 0.0f));
+        temp->addPrimitiveSet(new osg::DrawArrays(GL_POLYGON, first, verts->size() - first));
+    }
+
+    unsigned numVerts = verts->size();
+
+    Tessellator tess(_technique);
+    bool ok = tess.tessellateGeometry(*temp);
+
+    // GLU may insert new vertices at self-intersections, which we cannot
+    // express as indices into the input; fall back to earcut in that case.
+    if (!ok || temp->getVertexArray()->getNumElements() != numVerts)
+    {
+        OE_DEBUG << LC << "Tessellation technique " << (int)_technique << " failed; falling back to earcut" << std::endl;
+        out_indices = mapbox::earcut<uint32_t>(polygon);
+        return true;
+    }
+
+    osg::TriangleIndexFunctor<CollectTriangleIndices> collect;
+    collect._indices = &out_indices;
+    temp->accept(collect);
 
     return true;
 }
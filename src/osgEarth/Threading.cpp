@@ -6,6 +6,9 @@
 #include <cstdlib>
 #include <climits>
 #include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 #ifdef _WIN32
 #   include <Windows.h>
@@ -49,3 +52,63 @@ void osgEarth::setThreadName(const std::string& name)
     }
 #endif
 }
+
+namespace
+{
+    thread_local bool s_inParallelFor = false;
+}
+
+bool
+jobs::in_parallel_for()
+{
+    return s_inParallelFor;
+}
+
+void
+jobs::parallel_for(const std::string& arena, unsigned count, const std::function<void(unsigned, unsigned)>& func, unsigned grain, unsigned maxThreads)
+{
+    if (count == 0u)
+        return;
+
+    grain = std::max(grain, 1u);
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    unsigned numThreads = std::min(count / grain, maxThreads > 0u ? std::min(maxThreads, cores) : cores);
+
+    if (numThreads <= 1u || s_inParallelFor)
+    {
+        func(0u, count);
+        return;
+    }
+
+    // claim small ranges so the threads finish close together,
+    // but no more than one grain at a time
+    unsigned chunk = std::max(1u, std::min(grain, count / (numThreads * 4u)));
+
+    std::atomic<unsigned> next(0u);
+    auto task = [&]()
+    {
+        bool outer = s_inParallelFor;
+        s_inParallelFor = true;
+        for (unsigned begin = next.fetch_add(chunk); begin < count; begin = next.fetch_add(chunk))
+        {
+            func(begin, std::min(begin + chunk, count));
+        }
+        s_inParallelFor = outer;
+    };
+
+    auto pool = get_pool(arena, cores);
+    auto group = jobgroup::create();
+    for (unsigned t = 1; t < numThreads; ++t)
+    {
+        context job;
+        job.name = arena;
+        job.pool = pool;
+        job.group = group;
+        dispatch(task, job);
+    }
+
+    // this thread works too, so progress is made even if the pool is busy
+    task();
+    group->join();
+}
@@ -17,6 +17,11 @@ bool TileHandler::hasData( const TileKey& key ) const
 {
     return true;
 }
+
+std::vector<bool> TileHandler::isComplete( const std::vector<TileKey>& keys ) const
+{
+    return std::vector<bool>(keys.size(), false);
+}
         
 std::string TileHandler::getProcessString() const
 {
@@ -710,7 +710,48 @@ TileLayer::isCached(const TileKey& key) const
     if ( !bin )
         return false;
 
-    return bin->getRecordStatus( key.str() ) == CacheBin::STATUS_OK;
+    return bin->getRecordStatus( getTileCacheKey(key) ) == CacheBin::STATUS_OK;
+}
+
+std::vector<bool>
+TileLayer::isCached(const std::vector<TileKey>& keys) const
+{
+    std::vector<bool> results(keys.size(), false);
+
+    if (keys.empty() || getCacheSettings()->isCacheDisabled())
+        return results;
+
+    else if (getCacheSettings()->cachePolicy()->isCacheOnly())
+        return std::vector<bool>(keys.size(), true);
+
+    // keys may come from different profiles, so group them by bin:
+    std::unordered_map<CacheBin*, std::vector<unsigned>> groups;
+    for (unsigned i = 0; i < keys.size(); ++i)
+    {
+        CacheBin* bin = const_cast<TileLayer*>(this)->getCacheBin(keys[i].getProfile());
+        if (bin)
+            groups[bin].push_back(i);
+    }
+
+    for (auto& group : groups)
+    {
+        std::vector<std::string> cacheKeys;
+        cacheKeys.reserve(group.second.size());
+        for (auto i : group.second)
+            cacheKeys.emplace_back(getTileCacheKey(keys[i]));
+
+        auto statuses = group.first->getRecordStatuses(cacheKeys);
+        for (unsigned j = 0; j < group.second.size() && j < statuses.size(); ++j)
+            results[group.second[j]] = (statuses[j] == CacheBin::STATUS_OK);
+    }
+
+    return results;
+}
+
+std::string
+TileLayer::getTileCacheKey(const TileKey& key) const
+{
+    return key.str();
 }
 
 unsigned int TileLayer::getDataExtentsSize() const
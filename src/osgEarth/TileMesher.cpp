@@ -5,6 +5,7 @@
 #include "TileMesher"
 #include "Locators"
 #include "weemesh.h"
+#include "weemesh_cdt.h"
 
 using namespace osgEarth;
 
@@ -321,7 +322,8 @@ TileMesher::createMeshStandard(const TileKey& key, Cancelable* progress) const
 
 namespace
 {
-    void build_regular_gridded_mesh(weemesh::mesh_t& mesh, unsigned tileSize, const GeoLocator& locator, const osg::Matrix& world2local)
+    template<typename MESH>
+    void build_regular_gridded_mesh(MESH& mesh, unsigned tileSize, const GeoLocator& locator, const osg::Matrix& world2local)
     {
         mesh.set_boundary_marker(VERTEX_BOUNDARY);
         mesh.set_constraint_marker(VERTEX_CONSTRAINT);
@@ -361,7 +363,8 @@ namespace
         }
     }
 
-    void load_mesh(weemesh::mesh_t& mesh, const TileMesh& input)
+    template<typename MESH>
+    void load_mesh(MESH& mesh, const TileMesh& input)
     {
         mesh.set_boundary_marker(VERTEX_BOUNDARY);
         mesh.set_constraint_marker(VERTEX_CONSTRAINT);
@@ -386,123 +389,409 @@ namespace
             mesh.add_triangle(v1, v2, v3);
         }
     }
-}
 
-TileMesh
-TileMesher::createMeshWithConstraints(
-    const TileKey& key,
-    const TileMesh& input_mesh,
-    const MeshConstraints& edits,
-    Cancelable* cancelable) const
-{
-    auto& keyExtent = key.getExtent();
-    auto tileSRS = keyExtent.getSRS();
+    // Everything the meshing engines need to know about the tile
+    struct MeshingContext
+    {
+        const MeshConstraints& edits;
+        const TileMesh& input_mesh;
+        const GeoLocator& locator;
+        const osg::Matrix& world2local;
+        unsigned tileSize;
+        double xmin, ymin, xmax, ymax;
+        Bounds localBounds;
+        Cancelable* cancelable;
+
+        bool canceled() const {
+            return cancelable && cancelable->canceled();
+        }
+    };
 
-    // Establish a local reference frame for the tile:
-    GeoPoint centroid_world = keyExtent.getCentroid();
-    osg::Matrix world2local, local2world;
-    centroid_world.createWorldToLocal(world2local);
-    local2world.invert(world2local);
-    
-    GeoLocator locator(keyExtent);
+    // Output of a meshing engine: an indexed triangle set with markers,
+    // ready for elevation filling and assembly into a TileMesh.
+    struct FlatMesh
+    {
+        weemesh::vert_array_t verts;
+        std::vector<int> markers;
+        std::vector<unsigned> triangles;  // 3 per triangle
+        std::vector<char> degenerate;     // 1 per triangle; kept for edge sets, not drawn
+        bool edited = false;
+
+        unsigned numTriangles() const {
+            return (unsigned)triangles.size() / 3;
+        }
+    };
 
-    unsigned tileSize = _options.getTileSize();
-    float skirtRatio = _options.getHeightFieldSkirtRatio();
+    using EdgeSet = std::unordered_set<weemesh::edge_t, weemesh::edge_t>;
 
-    // calculate the bounding box of the tile in local coords,
-    // for culling purposes:
-    osg::Vec3d c[4];
-    double xmin = DBL_MAX, ymin = DBL_MAX, xmax = -DBL_MAX, ymax = -DBL_MAX, zmin = DBL_MAX;
-    locator.unitToWorld(osg::Vec3d(0, 0, 0), c[0]);
-    locator.unitToWorld(osg::Vec3d(1, 0, 0), c[1]);
-    locator.unitToWorld(osg::Vec3d(0, 1, 0), c[2]);
-    locator.unitToWorld(osg::Vec3d(1, 1, 0), c[3]);
-    for (int i = 0; i < 4; ++i) {
-        c[i] = c[i] * world2local;
-        xmin = std::min(xmin, c[i].x()), xmax = std::max(xmax, c[i].x());
-        ymin = std::min(ymin, c[i].y()), ymax = std::max(ymax, c[i].y());
-        zmin = std::min(zmin, c[i].z());
+    // collect every edge whose endpoints both carry a marker in the mask
+    void collectEdges(const FlatMesh& mesh, int marker_mask, EdgeSet& edges)
+    {
+        for (unsigned i = 0; i < mesh.triangles.size(); i += 3)
+        {
+            int i0 = mesh.triangles[i], i1 = mesh.triangles[i + 1], i2 = mesh.triangles[i + 2];
+            bool m0 = (mesh.markers[i0] & marker_mask) != 0;
+            bool m1 = (mesh.markers[i1] & marker_mask) != 0;
+            bool m2 = (mesh.markers[i2] & marker_mask) != 0;
+
+            if (m0 && m1)
+                edges.emplace(i0, i1);
+            if (m1 && m2)
+                edges.emplace(i1, i2);
+            if (m2 && m0)
+                edges.emplace(i2, i0);
+        }
     }
-    Bounds localBounds(xmin, ymin, -FLT_MAX, xmax, ymax, FLT_MAX);
 
-    TileMesh geom; // final output.
-    geom.localToWorld = local2world;
+    bool pointOnAnyEdgeClosestTo(const EdgeSet& edges, const FlatMesh& mesh, const weemesh::vert_t& p, weemesh::vert_t& closest)
+    {
+        double min_distance2 = DBL_MAX;
 
-    weemesh::mesh_t mesh;
+        for (auto& edge : edges)
+        {
+            const weemesh::vert_t& e1 = mesh.verts[edge._i0];
+            const weemesh::vert_t& e2 = mesh.verts[edge._i1];
+            weemesh::vert_t qp = e2 - e1;
+            double u = (p - e1).dot2d(qp) / qp.dot2d(qp);
+            weemesh::vert_t c = u < 0.0 ? e1 : u > 1.0 ? e2 : e1 + qp * u;
+
+            auto d2 = (c - p).length2d_squared();
+            if (d2 < min_distance2)
+            {
+                min_distance2 = d2;
+                closest = c;
+            }
+        }
+        return min_distance2 < DBL_MAX;
+    }
 
-    // if we have an input mesh, use it. Otherwise, build a regular gridded mesh.
-    if (input_mesh.verts.valid())
+    // Marker to use for the new verts of an edit
+    int getEditMarker(const MeshConstraint& edit)
     {
-        load_mesh(mesh, input_mesh);
+        // we're marking all new verts CONSTRAINT in order to disable morphing.
+        int marker = VERTEX_VISIBLE | VERTEX_CONSTRAINT;
+
+        // this will preserve a "burned-in" Z value in the shader.
+        if (edit.hasElevation)
+        {
+            marker |= VERTEX_HAS_ELEVATION;
+        }
+
+        return marker;
     }
-    else
+
+    // Meshes the constraints by inserting them into a weemesh, splitting
+    // existing triangles as it goes.
+    bool createSplitMesh(const MeshingContext& cx, FlatMesh& out)
     {
-        build_regular_gridded_mesh(mesh, tileSize, locator, world2local);
-    }
+        auto& edits = cx.edits;
+        auto& localBounds = cx.localBounds;
+        double xmin = cx.xmin, ymin = cx.ymin, xmax = cx.xmax, ymax = cx.ymax;
 
-    // keep it real
-    int max_num_triangles = mesh.triangles.size() * 1024;
-    
-    bool have_any_removal_requests = false;
+        weemesh::mesh_t mesh;
 
-    // First transform all our constraint geometry to the local tile system.
-    for (auto& edit : edits)
-    {
-        osg::Vec3d world;
-        for (auto& feature : edit.features)
+        // if we have an input mesh, use it. Otherwise, build a regular gridded mesh.
+        if (cx.input_mesh.verts.valid())
         {
-            feature->transform(tileSRS);
+            load_mesh(mesh, cx.input_mesh);
+        }
+        else
+        {
+            build_regular_gridded_mesh(mesh, cx.tileSize, cx.locator, cx.world2local);
+        }
 
-            GeometryIterator geom_iter(feature->getGeometry(), true);
-            while (geom_iter.hasMore())
+        // keep it real
+        int max_num_triangles = mesh.triangles.size() * 1024;
+
+        bool have_any_removal_requests = false;
+
+        // Make the edits
+        for (auto& edit : edits)
+        {
+            if (edit.removeExterior || edit.removeInterior)
             {
-                Geometry* part = geom_iter.next();
+                have_any_removal_requests = true;
+            }
 
-                // transform the constraint (in place) from world coordinates
-                // to tile-local coordinates
-                for (auto& point : *part)
+            int default_marker = getEditMarker(edit);
+
+            for (auto& feature : edit.features)
+            {
+                GeometryIterator geom_iter(feature->getGeometry(), true);
+                osg::Vec3d world, unit;
+                while (geom_iter.hasMore())
                 {
-                    tileSRS->transformToWorld(point, world);
-                    point = world * world2local;
+                    if (mesh.triangles.size() >= max_num_triangles)
+                    {
+                        // just stop it
+                        //OE_WARN << "WARNING, breaking out of the meshing process. Too many tris bro!" << std::endl;
+                        break;
+                    }
+
+                    Geometry* part = geom_iter.next();
+
+                    if (intersects2d(part->getBounds(), localBounds))
+                    {
+                        if (part->isPointSet())
+                        {
+                            for (int i = 0; i < part->size(); ++i)
+                            {
+                                const weemesh::vert_t v((*part)[i].ptr());
+
+                                if (v.x >= xmin && v.x <= xmax && v.y >= ymin && v.y <= ymax)
+                                {
+                                    mesh.insert(v, default_marker);
+                                }
+                            }
+                        }
+
+                        else
+                        {
+                            // marking as BOUNDARY will allow skirt generation on this part
+                            // for polygons with removed interior/exteriors
+                            int marker = default_marker;
+                            if (part->isRing() && (edit.removeInterior || edit.removeExterior))
+                            {
+                                marker |= VERTEX_BOUNDARY;
+                            }
+
+                            // slice and dice the mesh.
+                            // iterate over segments in the part, closing the loop if it's an open ring.
+                            unsigned i = part->isRing() && part->isOpen() ? 0 : 1;
+                            unsigned j = part->isRing() && part->isOpen() ? part->size() - 1 : 0;
+
+                            for (; i < part->size(); j = i++)
+                            {
+                                const weemesh::vert_t p0((*part)[i].ptr());
+                                const weemesh::vert_t p1((*part)[j].ptr());
+
+                                // cull segment to tile
+                                if ((p0.x >= xmin || p1.x >= xmin) &&
+                                    (p0.x <= xmax || p1.x <= xmax) &&
+                                    (p0.y >= ymin || p1.y >= ymin) &&
+                                    (p0.y <= ymax || p1.y <= ymax))
+                                {
+                                    mesh.insert(weemesh::segment_t(p0, p1), marker);
+                                }
+                            }
+                        }
+                    }
+
+                    if (cx.canceled())
+                        return false;
                 }
             }
         }
-    }    
 
-    // Make the edits
-    for (auto& edit : edits)
+        // Now that meshing is complete, remove interior or exterior triangles
+        // if we find any.
+        // IDEAS:
+        // - remove tri entirely
+        // - change clamping u/v of elevation;
+        // - alter elevation offset based on distance from feature;
+        // - duplicate tris to make water surface+bed
+        // ... pluggable behavior ?
+        if (have_any_removal_requests)
+        {
+            std::unordered_set<weemesh::triangle_t*> insiders;
+            std::unordered_set<weemesh::triangle_t*> insiders_to_remove;
+            std::unordered_set<weemesh::triangle_t*> outsiders_to_possibly_remove;
+            weemesh::vert_t centroid;
+            const double one_third = 1.0 / 3.0;
+            std::vector<weemesh::triangle_t*> tris;
+
+            for (auto& edit : edits)
+            {
+                if (edit.removeInterior || edit.removeExterior)
+                {
+                    for (auto& feature : edit.features)
+                    {
+                        // skip the polygon holes.
+                        GeometryIterator geom_iter(feature->getGeometry(), false);
+                        while (geom_iter.hasMore())
+                        {
+                            Geometry* part = geom_iter.next();
+
+                            // Note: the part was already transformed in a previous step.
+
+                            const auto& bb = part->getBounds();
+
+                            if (part->isPolygon() && intersects2d(bb, localBounds))
+                            {
+                                if (edit.removeExterior)
+                                {
+                                    // expensive path, much check ALL triangles when removing exterior.
+                                    for (auto& tri_iter : mesh.triangles)
+                                    {
+                                        weemesh::triangle_t* tri = &tri_iter.second;
+
+                                        bool inside = part->contains2D(tri->centroid.x, tri->centroid.y);
+
+                                        if (inside)
+                                        {
+                                            insiders.insert(tri);
+                                            if (edit.removeInterior)
+                                            {
+                                                insiders_to_remove.insert(tri);
+                                            }
+                                        }
+                                        else if (edit.removeExterior)
+                                        {
+                                            outsiders_to_possibly_remove.insert(tri);
+                                        }
+                                    }
+                                }
+                                else // removeInterior ONLY
+                                {
+                                    // fast path when we are NOT removing exterior tris.
+                                    mesh.get_triangles(bb.xMin(), bb.yMin(), bb.xMax(), bb.yMax(), tris);
+
+                                    for (auto tri : tris)
+                                    {
+                                        bool inside = part->contains2D(tri->centroid.x, tri->centroid.y);
+                                        if (inside)
+                                        {
+                                            insiders_to_remove.insert(tri);
+                                        }
+                                    }
+                                }
+                            }
+
+                            if (cx.canceled())
+                                return false;
+                        }
+                    }
+                }
+            }
+
+            for (auto tri : insiders_to_remove)
+            {
+                mesh.remove_triangle(*tri);
+            }
+
+            for (auto tri : outsiders_to_possibly_remove)
+            {
+                if (insiders.count(tri) == 0)
+                {
+                    mesh.remove_triangle(*tri);
+                }
+            }
+
+#if 0
+            // do we want to add the constraint triangles back in?
+            if (!insiders_to_remove.empty())
+            {
+                std::set<std::tuple<int, int, int>> unique_tris;
+
+                for (auto& edit : edits)
+                {
+                    if (edit.removeInterior)
+                    {
+                        for (auto& feature : edit.features)
+                        {
+                            // skip the polygon holes.
+                            GeometryIterator geom_iter(feature->getGeometry(), false);
+                            while (geom_iter.hasMore())
+                            {
+                                Geometry* part = geom_iter.next();
+
+                                if (localBounds.contains(part->getBounds().center()))
+                                {
+                                    if (part->isPolygon() && part->size() == 3)
+                                    {
+                                        auto i1 = mesh.get_or_create_vertex(weemesh::vert_t((*part)[0].ptr()), VERTEX_CONSTRAINT);
+                                        auto i2 = mesh.get_or_create_vertex(weemesh::vert_t((*part)[1].ptr()), VERTEX_CONSTRAINT);
+                                        auto i3 = mesh.get_or_create_vertex(weemesh::vert_t((*part)[2].ptr()), VERTEX_CONSTRAINT);
+
+                                        auto unique = std::make_tuple(i1, i2, i3);
+                                        if (unique_tris.count(unique) == 0)
+                                        {
+                                            unique_tris.insert(unique);
+                                            mesh.add_triangle(i1, i2, i3);
+                                        }
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+#endif
+        }
+
+        // flatten for assembly
+        out.verts = std::move(mesh.verts);
+        out.markers = std::move(mesh.markers);
+        out.triangles.reserve(mesh.triangles.size() * 3);
+        out.degenerate.reserve(mesh.triangles.size());
+        for (const auto& tri : mesh.triangles)
+        {
+            out.triangles.push_back(tri.second.i0);
+            out.triangles.push_back(tri.second.i1);
+            out.triangles.push_back(tri.second.i2);
+            out.degenerate.push_back(tri.second.is_2d_degenerate ? 1 : 0);
+        }
+        out.edited = (mesh._num_edits > 0);
+
+        return true;
+    }
+
+    // Meshes the constraints by building a constrained Delaunay
+    // triangulation over the tile grid. All constraint points go in as
+    // one batch, followed by all constraint segments.
+    bool createCDTMesh(const MeshingContext& cx, FlatMesh& out)
     {
-        if (edit.removeExterior || edit.removeInterior)
+        auto& edits = cx.edits;
+        auto& localBounds = cx.localBounds;
+        double xmin = cx.xmin, ymin = cx.ymin, xmax = cx.xmax, ymax = cx.ymax;
+
+        weemesh::cdt_t mesh;
+
+        if (cx.input_mesh.verts.valid())
+        {
+            load_mesh(mesh, cx.input_mesh);
+        }
+        else
         {
-            have_any_removal_requests = true;
+            build_regular_gridded_mesh(mesh, cx.tileSize, cx.locator, cx.world2local);
         }
 
-        // we're marking all new verts CONSTRAINT in order to disable morphing.
-        int default_marker = VERTEX_VISIBLE | VERTEX_CONSTRAINT;
+        mesh.link_seed_triangles();
 
-        // this will preserve a "burned-in" Z value in the shader.
-        if (edit.hasElevation)
+        // keep it real
+        mesh._max_num_triangles = mesh.num_triangles() * 1024;
+
+        // Long constraint segments are broken up at the grid spacing so
+        // the terrain is still sampled densely along them.
+        if (cx.tileSize > 1)
         {
-            default_marker |= VERTEX_HAS_ELEVATION;
+            mesh._max_segment_length = std::min(xmax - xmin, ymax - ymin) / (double)(cx.tileSize - 1);
         }
 
-        for (auto& feature : edit.features)
+        std::vector<weemesh::cdt_t::point_input_t> points;
+        std::vector<weemesh::cdt_t::segment_input_t> segments;
+
+        bool have_any_removal_requests = false;
+
+        for (auto& edit : edits)
         {
-            GeometryIterator geom_iter(feature->getGeometry(), true);
-            osg::Vec3d world, unit;
-            while (geom_iter.hasMore())
+            if (edit.removeExterior || edit.removeInterior)
             {
-                if (mesh.triangles.size() >= max_num_triangles)
-                {
-                    // just stop it
-                    //OE_WARN << "WARNING, breaking out of the meshing process. Too many tris bro!" << std::endl;
-                    break;
-                }
+                have_any_removal_requests = true;
+            }
 
-                Geometry* part = geom_iter.next();
+            int default_marker = getEditMarker(edit);
 
-                if (intersects2d(part->getBounds(), localBounds))
+            for (auto& feature : edit.features)
+            {
+                GeometryIterator geom_iter(feature->getGeometry(), true);
+                while (geom_iter.hasMore())
                 {
+                    Geometry* part = geom_iter.next();
+
+                    if (!intersects2d(part->getBounds(), localBounds))
+                        continue;
+
                     if (part->isPointSet())
                     {
                         for (int i = 0; i < part->size(); ++i)
@@ -511,23 +800,18 @@ TileMesher::createMeshWithConstraints(
 
                             if (v.x >= xmin && v.x <= xmax && v.y >= ymin && v.y <= ymax)
                             {
-                                mesh.insert(v, default_marker);
+                                points.push_back({ v, default_marker });
                             }
                         }
                     }
-
                     else
                     {
-                        // marking as BOUNDARY will allow skirt generation on this part
-                        // for polygons with removed interior/exteriors
                         int marker = default_marker;
                         if (part->isRing() && (edit.removeInterior || edit.removeExterior))
                         {
                             marker |= VERTEX_BOUNDARY;
                         }
 
-                        // slice and dice the mesh.
-                        // iterate over segments in the part, closing the loop if it's an open ring.
                         unsigned i = part->isRing() && part->isOpen() ? 0 : 1;
                         unsigned j = part->isRing() && part->isOpen() ? part->size() - 1 : 0;
 
@@ -536,160 +820,217 @@ TileMesher::createMeshWithConstraints(
                             const weemesh::vert_t p0((*part)[i].ptr());
                             const weemesh::vert_t p1((*part)[j].ptr());
 
-                            // cull segment to tile
                             if ((p0.x >= xmin || p1.x >= xmin) &&
                                 (p0.x <= xmax || p1.x <= xmax) &&
                                 (p0.y >= ymin || p1.y >= ymin) &&
                                 (p0.y <= ymax || p1.y <= ymax))
                             {
-                                mesh.insert(weemesh::segment_t(p0, p1), marker);
+                                segments.push_back({ p0, p1, marker });
                             }
                         }
                     }
                 }
-
-                if (cancelable && cancelable->canceled())
-                    return {};
             }
         }
-    }
 
-    // Now that meshing is complete, remove interior or exterior triangles
-    // if we find any.
-    // IDEAS:
-    // - remove tri entirely
-    // - change clamping u/v of elevation;
-    // - alter elevation offset based on distance from feature;
-    // - duplicate tris to make water surface+bed
-    // ... pluggable behavior ?
-    if (have_any_removal_requests)
-    {
-        std::unordered_set<weemesh::triangle_t*> insiders;
-        std::unordered_set<weemesh::triangle_t*> insiders_to_remove;
-        std::unordered_set<weemesh::triangle_t*> outsiders_to_possibly_remove;
-        weemesh::vert_t centroid;
-        const double one_third = 1.0 / 3.0;
-        std::vector<weemesh::triangle_t*> tris;
+        mesh.insert(points, segments, [&]() { return cx.canceled(); });
 
-        for (auto& edit : edits)
+        if (cx.canceled())
+            return false;
+
+        int numTris = mesh.num_triangles();
+        std::vector<char> keep(numTris, 1);
+
+        // Same removal rules as the split mesher, but over flat arrays:
+        // triangle centroids are binned on a grid so that interior-only
+        // removals only visit triangles near each polygon.
+        if (have_any_removal_requests)
         {
-            if (edit.removeInterior || edit.removeExterior)
+            std::vector<weemesh::vert_t> centroids(numTris);
+            for (int t = 0; t < numTris; ++t)
+                centroids[t] = mesh.centroid(t);
+
+            const int bins = 32;
+            double bx = (xmax - xmin) > 0.0 ? (double)bins / (xmax - xmin) : 0.0;
+            double by = (ymax - ymin) > 0.0 ? (double)bins / (ymax - ymin) : 0.0;
+            auto binx = [&](double x) { return weemesh::clamp((int)((x - xmin) * bx), 0, bins - 1); };
+            auto biny = [&](double y) { return weemesh::clamp((int)((y - ymin) * by), 0, bins - 1); };
+
+            std::vector<int> binStart(bins * bins + 1, 0);
+            std::vector<int> binTris(numTris);
+            for (int t = 0; t < numTris; ++t)
+                ++binStart[biny(centroids[t].y) * bins + binx(centroids[t].x) + 1];
+            for (int b = 0; b < bins * bins; ++b)
+                binStart[b + 1] += binStart[b];
+            std::vector<int> fill(binStart.begin(), binStart.end() - 1);
+            for (int t = 0; t < numTris; ++t)
+                binTris[fill[biny(centroids[t].y) * bins + binx(centroids[t].x)]++] = t;
+
+            std::vector<char> insider(numTris, 0);
+            std::vector<char> removeInside(numTris, 0);
+            std::vector<char> maybeRemoveOutside(numTris, 0);
+
+            for (auto& edit : edits)
             {
-                for (auto& feature : edit.features)
+                if (edit.removeInterior || edit.removeExterior)
                 {
-                    // skip the polygon holes.
-                    GeometryIterator geom_iter(feature->getGeometry(), false);
-                    while (geom_iter.hasMore())
+                    for (auto& feature : edit.features)
                     {
-                        Geometry* part = geom_iter.next();
-
-                        // Note: the part was already transformed in a previous step.
-
-                        const auto& bb = part->getBounds();
-
-                        if (part->isPolygon() && intersects2d(bb, localBounds))
+                        // skip the polygon holes.
+                        GeometryIterator geom_iter(feature->getGeometry(), false);
+                        while (geom_iter.hasMore())
                         {
-                            if (edit.removeExterior)
+                            Geometry* part = geom_iter.next();
+                            const auto& bb = part->getBounds();
+
+                            if (part->isPolygon() && intersects2d(bb, localBounds))
                             {
-                                // expensive path, much check ALL triangles when removing exterior.
-                                for (auto& tri_iter : mesh.triangles)
+                                if (edit.removeExterior)
                                 {
-                                    weemesh::triangle_t* tri = &tri_iter.second;
-
-                                    bool inside = part->contains2D(tri->centroid.x, tri->centroid.y);
-
-                                    if (inside)
+                                    for (int t = 0; t < numTris; ++t)
                                     {
-                                        insiders.insert(tri);
-                                        if (edit.removeInterior)
+                                        if (part->contains2D(centroids[t].x, centroids[t].y))
                                         {
-                                            insiders_to_remove.insert(tri);
+                                            insider[t] = 1;
+                                            if (edit.removeInterior)
+                                                removeInside[t] = 1;
+                                        }
+                                        else
+                                        {
+                                            maybeRemoveOutside[t] = 1;
                                         }
-                                    }
-                                    else if (edit.removeExterior)
-                                    {
-                                        outsiders_to_possibly_remove.insert(tri);
                                     }
                                 }
-                            }
-                            else // removeInterior ONLY
-                            {
-                                // fast path when we are NOT removing exterior tris.
-                                mesh.get_triangles(bb.xMin(), bb.yMin(), bb.xMax(), bb.yMax(), tris);
-
-                                for (auto tri : tris)
+                                else // removeInterior ONLY
                                 {
-                                    bool inside = part->contains2D(tri->centroid.x, tri->centroid.y);
-                                    if (inside)
+                                    int c0 = binx(bb.xMin()), c1 = binx(bb.xMax());
+                                    int r0 = biny(bb.yMin()), r1 = biny(bb.yMax());
+                                    for (int r = r0; r <= r1; ++r)
                                     {
-                                        insiders_to_remove.insert(tri);
+                                        for (int c = c0; c <= c1; ++c)
+                                        {
+                                            int b = r * bins + c;
+                                            for (int k = binStart[b]; k < binStart[b + 1]; ++k)
+                                            {
+                                                int t = binTris[k];
+                                                if (!removeInside[t] && part->contains2D(centroids[t].x, centroids[t].y))
+                                                    removeInside[t] = 1;
+                                            }
+                                        }
                                     }
                                 }
                             }
-                        }
 
-                        if (cancelable && cancelable->canceled())
-                            return {};
+                            if (cx.canceled())
+                                return false;
+                        }
                     }
                 }
             }
-        }
 
-        for (auto tri : insiders_to_remove)
-        {
-            mesh.remove_triangle(*tri);
+            for (int t = 0; t < numTris; ++t)
+            {
+                if (removeInside[t] || (maybeRemoveOutside[t] && !insider[t]))
+                    keep[t] = 0;
+            }
         }
 
-        for (auto tri : outsiders_to_possibly_remove)
+        out.verts = std::move(mesh.verts);
+        out.markers = std::move(mesh.markers);
+        out.triangles.reserve(numTris * 3);
+        for (int t = 0; t < numTris; ++t)
         {
-            if (insiders.count(tri) == 0)
+            if (keep[t])
             {
-                mesh.remove_triangle(*tri);
+                out.triangles.push_back(mesh.tri_verts[3 * t]);
+                out.triangles.push_back(mesh.tri_verts[3 * t + 1]);
+                out.triangles.push_back(mesh.tri_verts[3 * t + 2]);
             }
         }
+        out.degenerate.assign(out.numTriangles(), 0);
+        out.edited = (mesh._num_edits > 0);
 
-#if 0
-        // do we want to add the constraint triangles back in?
-        if (!insiders_to_remove.empty())
+        return true;
+    }
+}
+
+TileMesh
+TileMesher::createMeshWithConstraints(
+    const TileKey& key,
+    const TileMesh& input_mesh,
+    const MeshConstraints& edits,
+    Cancelable* cancelable) const
+{
+    auto& keyExtent = key.getExtent();
+    auto tileSRS = keyExtent.getSRS();
+
+    // Establish a local reference frame for the tile:
+    GeoPoint centroid_world = keyExtent.getCentroid();
+    osg::Matrix world2local, local2world;
+    centroid_world.createWorldToLocal(world2local);
+    local2world.invert(world2local);
+
+    GeoLocator locator(keyExtent);
+
+    unsigned tileSize = _options.getTileSize();
+    float skirtRatio = _options.getHeightFieldSkirtRatio();
+
+    // calculate the bounding box of the tile in local coords,
+    // for culling purposes:
+    osg::Vec3d c[4];
+    double xmin = DBL_MAX, ymin = DBL_MAX, xmax = -DBL_MAX, ymax = -DBL_MAX, zmin = DBL_MAX;
+    locator.unitToWorld(osg::Vec3d(0, 0, 0), c[0]);
+    locator.unitToWorld(osg::Vec3d(1, 0, 0), c[1]);
+    locator.unitToWorld(osg::Vec3d(0, 1, 0), c[2]);
+    locator.unitToWorld(osg::Vec3d(1, 1, 0), c[3]);
+    for (int i = 0; i < 4; ++i) {
+        c[i] = c[i] * world2local;
+        xmin = std::min(xmin, c[i].x()), xmax = std::max(xmax, c[i].x());
+        ymin = std::min(ymin, c[i].y()), ymax = std::max(ymax, c[i].y());
+        zmin = std::min(zmin, c[i].z());
+    }
+    Bounds localBounds(xmin, ymin, -FLT_MAX, xmax, ymax, FLT_MAX);
+
+    TileMesh geom; // final output.
+    geom.localToWorld = local2world;
+
+    // First transform all our constraint geometry to the local tile system.
+    for (auto& edit : edits)
+    {
+        osg::Vec3d world;
+        for (auto& feature : edit.features)
         {
-            std::set<std::tuple<int, int, int>> unique_tris;
+            feature->transform(tileSRS);
 
-            for (auto& edit : edits)
+            GeometryIterator geom_iter(feature->getGeometry(), true);
+            while (geom_iter.hasMore())
             {
-                if (edit.removeInterior)
-                {
-                    for (auto& feature : edit.features)
-                    {
-                        // skip the polygon holes.
-                        GeometryIterator geom_iter(feature->getGeometry(), false);
-                        while (geom_iter.hasMore())
-                        {
-                            Geometry* part = geom_iter.next();
-
-                            if (localBounds.contains(part->getBounds().center()))
-                            {
-                                if (part->isPolygon() && part->size() == 3)
-                                {
-                                    auto i1 = mesh.get_or_create_vertex(weemesh::vert_t((*part)[0].ptr()), VERTEX_CONSTRAINT);
-                                    auto i2 = mesh.get_or_create_vertex(weemesh::vert_t((*part)[1].ptr()), VERTEX_CONSTRAINT);
-                                    auto i3 = mesh.get_or_create_vertex(weemesh::vert_t((*part)[2].ptr()), VERTEX_CONSTRAINT);
+                Geometry* part = geom_iter.next();
 
-                                    auto unique = std::make_tuple(i1, i2, i3);
-                                    if (unique_tris.count(unique) == 0)
-                                    {
-                                        unique_tris.insert(unique);
-                                        mesh.add_triangle(i1, i2, i3);
-                                    }
-                                }
-                            }
-                        }
-                    }
+                // transform the constraint (in place) from world coordinates
+                // to tile-local coordinates
+                for (auto& point : *part)
+                {
+                    tileSRS->transformToWorld(point, world);
+                    point = world * world2local;
                 }
             }
         }
-#endif
     }
 
+    MeshingContext cx{
+        edits, input_mesh, locator, world2local, tileSize,
+        xmin, ymin, xmax, ymax, localBounds, cancelable };
+
+    FlatMesh mesh;
+
+    bool ok = _options.getMeshingMethod() == MeshingMethod::CDT ?
+        createCDTMesh(cx, mesh) :
+        createSplitMesh(cx, mesh);
+
+    if (!ok)
+        return {};
+
     // if ALL triangles are gone, it's an empty tile.
     if (mesh.triangles.empty())
     {
@@ -714,7 +1055,8 @@ TileMesher::createMeshWithConstraints(
             // collect every edge that has valid elevation data in Z.
             // usually the means the caller assigned Z values to the constraint geometry
             // and set edit.hasElevation to true.
-            weemesh::edgeset_t elevated_edges(mesh, VERTEX_HAS_ELEVATION);
+            EdgeSet elevated_edges;
+            collectEdges(mesh, VERTEX_HAS_ELEVATION, elevated_edges);
 
             // find every vertex without elevation, and set its elevation to the same value
             // as that of the closest point on the nearest constrained edge
@@ -722,7 +1064,7 @@ TileMesher::createMeshWithConstraints(
             {
                 if ((mesh.markers[i] & VERTEX_HAS_ELEVATION) == 0)
                 {
-                    if (elevated_edges.point_on_any_edge_closest_to(mesh.verts[i], mesh, closest))
+                    if (pointOnAnyEdgeClosestTo(elevated_edges, mesh, mesh.verts[i], closest))
                     {
                         mesh.verts[i].z = closest.z;
                         mesh.markers[i] |= (VERTEX_CONSTRAINT | VERTEX_HAS_ELEVATION);
@@ -732,7 +1074,7 @@ TileMesher::createMeshWithConstraints(
         }
     }
     // Time to assemble the resulting TileMesh structure.
-   
+
     // TODO:
     // This geometry/index set is now sparse. Any verts that were
     // orphaned due to triangle removal are still present, just not
@@ -766,7 +1108,7 @@ TileMesher::createMeshWithConstraints(
     // generate UVs and neighbor data:
     for (auto& vert : mesh.verts)
     {
-        int marker = mesh.get_marker(vert);
+        int marker = mesh.markers[ptr];
 
         osg::Vec3d v(vert.x, vert.y, vert.z);
         osg::Vec3d unit;
@@ -783,7 +1125,7 @@ TileMesher::createMeshWithConstraints(
         normal.normalize();
         geom.normals->push_back(normal);
 
-        // assign "neighbors" (for morphing) to any "orignal grid" vertex 
+        // assign "neighbors" (for morphing) to any "orignal grid" vertex
         // that is NOT marked as a constraint.
         if (ptr < original_grid_size && !(marker & VERTEX_CONSTRAINT))
         {
@@ -821,14 +1163,14 @@ TileMesher::createMeshWithConstraints(
     // the index set, discarding any degenerate triangles.
     auto mode = _options.getGPUTessellation() == true ? GL_PATCHES : GL_TRIANGLES;
     geom.indices = new osg::DrawElementsUInt(mode);
-    geom.indices->reserveElements(mesh.triangles.size() * 3);
-    for (const auto& tri : mesh.triangles)
+    geom.indices->reserveElements(mesh.triangles.size());
+    for (unsigned t = 0; t < mesh.numTriangles(); ++t)
     {
-        if (!tri.second.is_2d_degenerate)
+        if (!mesh.degenerate[t])
         {
-            geom.indices->addElement(tri.second.i0);
-            geom.indices->addElement(tri.second.i1);
-            geom.indices->addElement(tri.second.i2);
+            geom.indices->addElement(mesh.triangles[3 * t]);
+            geom.indices->addElement(mesh.triangles[3 * t + 1]);
+            geom.indices->addElement(mesh.triangles[3 * t + 2]);
         }
     }
 
@@ -838,12 +1180,13 @@ TileMesher::createMeshWithConstraints(
         double skirtHeight = _options.getHeightFieldSkirtRatio() * tileBound.radius();
 
         // collect all edges marked as boundaries
-        weemesh::edgeset_t boundary_edges(mesh, VERTEX_BOUNDARY);
+        EdgeSet boundary_edges;
+        collectEdges(mesh, VERTEX_BOUNDARY, boundary_edges);
 
         // Add the skirt geometry. We don't share verts with the surface mesh
         // because we need to mark skirts verts so we can conditionally render
         // skirts in the shader.
-        int mem = geom.verts->size() + boundary_edges._edges.size() * 4;
+        int mem = geom.verts->size() + boundary_edges.size() * 4;
         geom.verts->reserve(mem);
         geom.normals->reserve(mem);
         geom.uvs->reserve(mem);
@@ -851,9 +1194,9 @@ TileMesher::createMeshWithConstraints(
             geom.vert_neighbors->reserve(mem);
         if (geom.normal_neighbors.valid())
             geom.normal_neighbors->reserve(mem);
-        geom.indices->reserveElements(geom.indices->getNumIndices() + boundary_edges._edges.size() * 6);
+        geom.indices->reserveElements(geom.indices->getNumIndices() + boundary_edges.size() * 6);
 
-        for (auto& edge : boundary_edges._edges)
+        for (auto& edge : boundary_edges)
         {
             // bail if we run out of UShort space
             if (geom.verts->size() + 4 > 0xFFFF)
@@ -866,7 +1209,7 @@ TileMesher::createMeshWithConstraints(
     }
 
     // Mark the geometry appropriately
-    geom.hasConstraints = (mesh._num_edits > 0);
+    geom.hasConstraints = mesh.edited;
 
     // Assign buffer objects
     auto vbo = new osg::VertexBufferObject();
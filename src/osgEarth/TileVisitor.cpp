@@ -3,7 +3,10 @@
  * MIT License
  */
 #include <osgEarth/TileVisitor>
+#include <osgEarth/StringUtils>
 #include <thread>
+#include <iomanip>
+#include <algorithm>
 
 #include <osg/os_utils>
 #define OS_SYSTEM osg_system
@@ -300,6 +303,417 @@ bool MultithreadedTileVisitor::handleTile(const TileKey& key)
 
 /*****************************************************************************************/
 
+#define LC "[ResumableTileVisitor] "
+
+#define RTV "oe.resumabletilevisitor"
+
+namespace
+{
+    // Interleaves the bits of x and y into a Z-order (Morton) code.
+    inline std::uint64_t morton(std::uint32_t x, std::uint32_t y)
+    {
+        auto spread = [](std::uint64_t v)
+        {
+            v = (v | (v << 16)) & 0x0000ffff0000ffffull;
+            v = (v | (v << 8)) & 0x00ff00ff00ff00ffull;
+            v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0full;
+            v = (v | (v << 2)) & 0x3333333333333333ull;
+            v = (v | (v << 1)) & 0x5555555555555555ull;
+            return v;
+        };
+        return spread(x) | (spread(y) << 1);
+    }
+}
+
+ResumableTileVisitor::ResumableTileVisitor() :
+    _unitLevel(6u),
+    _numThreads(std::max(1u, std::thread::hardware_concurrency())),
+    _workerIndex(0u),
+    _workerCount(1u),
+    _batchSize(256u),
+    _unitsTotal(0u),
+    _unitsDone(0u),
+    _unitsDoneThisRun(0u),
+    _tilesHandled(0u),
+    _tilesSkipped(0u)
+{
+    // same workaround as the MultithreadedTileVisitor
+    osgDB::Registry::instance()->getObjectWrapperManager()->findWrapper("osg::Image");
+}
+
+ResumableTileVisitor::ResumableTileVisitor(TileHandler* handler) :
+    ResumableTileVisitor()
+{
+    setTileHandler(handler);
+}
+
+void ResumableTileVisitor::setWorker(unsigned index, unsigned count)
+{
+    _workerCount = std::max(1u, count);
+    _workerIndex = index % _workerCount;
+}
+
+std::string ResumableTileVisitor::getSignature() const
+{
+    // Everything that changes the set or order of work units goes into the
+    // signature, so that a journal is never applied to a different seed.
+    std::stringstream buf;
+    buf << _profile->getFullSignature()
+        << ";" << _minLevel << ";" << _maxLevel << ";" << _unitLevel
+        << ";" << _workerIndex << "/" << _workerCount;
+    for (auto& extent : _extentsToVisit)
+        buf << ";" << extent.toString();
+
+    return "osgearth-seed-journal 1 " + hashToString(buf.str());
+}
+
+bool ResumableTileVisitor::openJournal(std::set<std::string>& completed)
+{
+    if (_journal.empty())
+        return false;
+
+    std::string signature = getSignature();
+    bool resume = false;
+    {
+        std::ifstream in(_journal.c_str());
+        std::string line;
+        if (in.is_open() && std::getline(in, line))
+        {
+            if (line == signature)
+            {
+                resume = true;
+
+                // A unit only counts if its line was written completely;
+                // a crash can leave a truncated last line behind.
+                while (std::getline(in, line))
+                {
+                    if (line.size() > 1 && line.back() == ';')
+                        completed.insert(line.substr(0, line.size() - 1));
+                }
+            }
+            else
+            {
+                OE_WARN << LC << "Journal \"" << _journal << "\" belongs to a different seed; starting over" << std::endl;
+            }
+        }
+    }
+
+    if (resume)
+    {
+        _journalStream.open(_journal.c_str(), std::ios::out | std::ios::app);
+        // terminate any partial line left by an interrupted run
+        _journalStream << std::endl;
+    }
+    else
+    {
+        _journalStream.open(_journal.c_str(), std::ios::out | std::ios::trunc);
+        _journalStream << signature << std::endl;
+    }
+
+    if (!_journalStream.good())
+    {
+        OE_WARN << LC << "Cannot write to journal \"" << _journal << "\"; progress will not be saved" << std::endl;
+        _journalStream.close();
+        return false;
+    }
+
+    return resume;
+}
+
+void ResumableTileVisitor::completeUnit(const Unit& unit)
+{
+    std::lock_guard<std::mutex> lock(_journalMutex);
+
+    if (_journalStream.is_open())
+    {
+        // std::endl flushes, so the unit is on disk before we move on.
+        _journalStream << unit.id << ";" << std::endl;
+    }
+
+    ++_unitsDone;
+    ++_unitsDoneThisRun;
+}
+
+void ResumableTileVisitor::planUnits(const TileKey& key, unsigned unitLevel, std::vector<std::pair<std::uint64_t, TileKey>>& out)
+{
+    unsigned lod = key.getLevelOfDetail();
+
+    if (lod >= _minLevel && !hasData(key))
+        return;
+
+    if (!intersects(key.getExtent()))
+        return;
+
+    if (lod == unitLevel)
+    {
+        out.emplace_back(morton(key.getTileX(), key.getTileY()), key);
+        return;
+    }
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        planUnits(key.createChildKey(i), unitLevel, out);
+    }
+}
+
+bool ResumableTileVisitor::processUnit(const Unit& unit)
+{
+    // Depth-first traversal, but keys come off the stack in batches
+    // so the handler can check for completed tiles in bulk.
+    std::vector<TileKey> stack(unit.roots.rbegin(), unit.roots.rend());
+    std::vector<TileKey> batch;
+    std::vector<TileKey> traverse;
+    unsigned batchSize = std::max(1u, _batchSize);
+
+    while (!stack.empty())
+    {
+        if (_progress.valid() && _progress->isCanceled())
+            return false;
+
+        batch.clear();
+        while (!stack.empty() && batch.size() < batchSize)
+        {
+            TileKey key = stack.back();
+            stack.pop_back();
+
+            unsigned lod = key.getLevelOfDetail();
+
+            if (lod >= _minLevel && !hasData(key))
+                continue;
+
+            if (!intersects(key.getExtent()))
+                continue;
+
+            // Above the min level, don't do anything but do traverse the children.
+            if (lod < _minLevel)
+            {
+                if (lod < unit.maxLevel)
+                {
+                    for (int i = 3; i >= 0; --i)
+                        stack.push_back(key.createChildKey(i));
+                }
+                continue;
+            }
+
+            batch.push_back(key);
+        }
+
+        if (batch.empty())
+            continue;
+
+        std::vector<bool> complete = _tileHandler.valid() ?
+            _tileHandler->isComplete(batch) :
+            std::vector<bool>(batch.size(), false);
+
+        traverse.clear();
+        for (unsigned i = 0; i < batch.size(); ++i)
+        {
+            bool traverseChildren = false;
+
+            if (i < complete.size() && complete[i])
+            {
+                traverseChildren = true;
+                ++_tilesSkipped;
+            }
+            else
+            {
+                if (_progress.valid() && _progress->isCanceled())
+                    return false;
+
+                if (_tileHandler.valid())
+                    traverseChildren = _tileHandler->handleTile(batch[i], *this);
+                ++_tilesHandled;
+            }
+
+            if (traverseChildren && batch[i].getLevelOfDetail() < unit.maxLevel)
+                traverse.push_back(batch[i]);
+        }
+
+        // push in reverse so the first key's children come off the stack first
+        for (auto key = traverse.rbegin(); key != traverse.rend(); ++key)
+        {
+            for (int i = 3; i >= 0; --i)
+                stack.push_back(key->createChildKey(i));
+        }
+
+        report(false);
+    }
+
+    return true;
+}
+
+void ResumableTileVisitor::report(bool force)
+{
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(_reportMutex);
+        if (!force && now - _lastReport < std::chrono::seconds(5))
+            return;
+        _lastReport = now;
+    }
+
+    double elapsed = std::chrono::duration<double>(now - _startTime).count();
+    unsigned done = _unitsDone;
+    unsigned total = _unitsTotal;
+    unsigned doneThisRun = _unitsDoneThisRun;
+    std::uint64_t handled = _tilesHandled;
+    std::uint64_t skipped = _tilesSkipped;
+
+    double rate = elapsed > 0.0 ? (double)(handled + skipped) / elapsed : 0.0;
+
+    // base the ETA on units finished in this run only, since
+    // units restored from the journal took no time at all.
+    std::string eta = "unknown";
+    if (doneThisRun > 0 && total >= done)
+        eta = prettyPrintTime(elapsed / (double)doneThisRun * (double)(total - done));
+
+    std::stringstream buf;
+    buf << done << "/" << total << " units, "
+        << handled << " tiles seeded, "
+        << skipped << " already cached, "
+        << std::fixed << std::setprecision(1) << rate << " tiles/s, "
+        << "ETA " << eta;
+
+    if (_progress.valid())
+    {
+        if (_progress->reportProgress(done, total, buf.str()))
+        {
+            _progress->cancel();
+        }
+    }
+    else
+    {
+        OE_INFO << LC << buf.str() << std::endl;
+    }
+}
+
+void ResumableTileVisitor::run(const Profile* mapProfile)
+{
+    _profile = mapProfile;
+
+    resetProgress();
+
+    // Units can't start below the deepest level we visit.
+    unsigned unitLevel = std::min(_unitLevel, _maxLevel);
+
+    // Collect the work units in Morton order.
+    std::vector<TileKey> rootKeys;
+    mapProfile->getRootKeys(rootKeys);
+
+    std::vector<std::pair<std::uint64_t, TileKey>> planned;
+    for (auto& key : rootKeys)
+    {
+        planUnits(key, unitLevel, planned);
+    }
+
+    std::sort(planned.begin(), planned.end(),
+        [](const std::pair<std::uint64_t, TileKey>& a, const std::pair<std::uint64_t, TileKey>& b)
+        {
+            return a.first < b.first;
+        });
+
+    std::vector<Unit> units;
+
+    // Keys above the unit level all go into one leading unit.
+    if (unitLevel > 0 && _minLevel < unitLevel)
+    {
+        units.emplace_back();
+        units.back().id = "head";
+        units.back().roots = rootKeys;
+        units.back().maxLevel = unitLevel - 1;
+    }
+
+    for (auto& p : planned)
+    {
+        units.emplace_back();
+        std::stringstream buf;
+        buf << std::hex << p.first;
+        units.back().id = buf.str();
+        units.back().roots.push_back(p.second);
+        units.back().maxLevel = _maxLevel;
+    }
+
+    // Keep only this worker's share of the units.
+    if (_workerCount > 1)
+    {
+        std::vector<Unit> mine;
+        for (unsigned i = _workerIndex; i < units.size(); i += _workerCount)
+            mine.emplace_back(std::move(units[i]));
+        units.swap(mine);
+    }
+
+    std::set<std::string> completed;
+    openJournal(completed);
+
+    std::vector<const Unit*> todo;
+    for (auto& unit : units)
+    {
+        if (completed.count(unit.id) == 0)
+            todo.push_back(&unit);
+    }
+
+    _unitsTotal = units.size();
+    _unitsDone = units.size() - todo.size();
+    _unitsDoneThisRun = 0;
+    _tilesHandled = 0;
+    _tilesSkipped = 0;
+    _startTime = _lastReport = std::chrono::steady_clock::now();
+
+    if (_unitsDone > 0)
+    {
+        OE_NOTICE << LC << "Resuming from \"" << _journal << "\": "
+            << _unitsDone << " of " << _unitsTotal << " work units already complete" << std::endl;
+    }
+
+    // Each thread pulls the next unit off a shared counter.
+    std::atomic<unsigned> next(0u);
+    unsigned numThreads = std::max(1u, std::min(_numThreads, (unsigned)todo.size()));
+
+    auto pool = jobs::get_pool(RTV);
+    pool->set_concurrency(numThreads);
+    auto group = jobs::jobgroup::create();
+
+    auto task = [this, &todo, &next]()
+    {
+        for (;;)
+        {
+            if (_progress.valid() && _progress->isCanceled())
+                return;
+
+            unsigned i = next++;
+            if (i >= todo.size())
+                return;
+
+            // only journal a unit that ran to the end
+            if (processUnit(*todo[i]))
+            {
+                completeUnit(*todo[i]);
+                report(false);
+            }
+        }
+    };
+
+    for (unsigned t = 0; t < numThreads && !todo.empty(); ++t)
+    {
+        jobs::context job;
+        job.name = "processUnit";
+        job.pool = pool;
+        job.group = group;
+        jobs::dispatch(task, job);
+    }
+
+    group->join();
+
+    report(true);
+
+    if (_journalStream.is_open())
+    {
+        _journalStream.close();
+    }
+}
+
+/*****************************************************************************************/
+
 TaskList::TaskList(const Profile* profile):
 _profile( profile )
 {
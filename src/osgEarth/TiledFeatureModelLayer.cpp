@@ -5,6 +5,12 @@
 #include <osgEarth/TiledFeatureModelLayer>
 #include <osgEarth/Registry>
 #include <osgEarth/FeatureStyleSorter>
+#include <osgEarth/FeatureSourceIndexNode>
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/Map>
+#include <osgEarth/Cache>
+#include <osgEarth/CacheBin>
+#include <osgEarth/StringUtils>
 
 using namespace osgEarth;
 
@@ -14,6 +20,17 @@ using namespace osgEarth;
 
 REGISTER_OSGEARTH_LAYER(TiledFeatureModel, TiledFeatureModelLayer);
 
+namespace
+{
+    std::string hashStyleSheet(const StyleSheet* sheet)
+    {
+        if (!sheet)
+            return std::string();
+
+        return hashToString(sheet->getConfig().toJSON()) + "." + std::to_string(sheet->getRevision());
+    }
+}
+
 //...........................................................................
 
 TiledFeatureModelLayer::Options::Options() :
@@ -76,6 +93,8 @@ void
 TiledFeatureModelLayer::init()
 {
     TiledModelLayer::init();
+
+    _nodeCachingImageCache = new osgDB::ObjectCache();
 }
 
 Config
@@ -121,6 +140,10 @@ TiledFeatureModelLayer::setStyleSheet(StyleSheet* value)
     if (getStyleSheet() != value)
     {
         options().styleSheet().setLayer(value);
+        {
+            std::lock_guard<std::mutex> lock(_styleHashMutex);
+            _styleHashSheet = nullptr;
+        }
         dirty();
     }
 }
@@ -245,6 +268,20 @@ TiledFeatureModelLayer::createTileImplementation(const TileKey& key, ProgressCal
         index = new FeatureSourceIndexNode(_featureIndex.get());
     }
 
+    // Try the persistent tile cache first; a hit skips the feature pipeline.
+    std::string cacheKey;
+    if (options().nodeCaching() == true)
+    {
+        cacheKey = makeTileCacheKey(key);
+        osg::ref_ptr<osg::Group> cached = readTileFromCache(cacheKey);
+        if (cached.valid())
+        {
+            if (cached->getNumChildren() == 0)
+                return {};
+            return cached;
+        }
+    }
+
     GeomFeatureNodeFactory factory(options());
 
     if (progress && progress->isCanceled())
@@ -292,8 +329,15 @@ TiledFeatureModelLayer::createTileImplementation(const TileKey& key, ProgressCal
 
     FeatureStyleSorter().sort(key, {}, _session.get(), _filters, nullptr, compile, progress);
 
+    if (progress && progress->isCanceled())
+        return nullptr;
+
     if (group->getNumChildren() == 0 || group->getBound().valid() == false)
     {
+        // cache empty tiles too, so they are not queried again
+        if (!cacheKey.empty())
+            writeTileToCache(cacheKey, new osg::Group());
+
         return {};
     }
 
@@ -303,9 +347,110 @@ TiledFeatureModelLayer::createTileImplementation(const TileKey& key, ProgressCal
         group = index;
     }
 
+    if (!cacheKey.empty())
+    {
+        writeTileToCache(cacheKey, group.get());
+    }
+
     return group;
 }
 
+std::string
+TiledFeatureModelLayer::makeTileCacheKey(const TileKey& key) const
+{
+    // The compiled tile depends on the style and, if clamped, on the terrain,
+    // so both go into the key. Layer options are already covered by the bin.
+    std::stringstream buf;
+    buf << key.str() << ";" << getStyleHash();
+
+    osg::ref_ptr<const Map> map = getMap();
+    if (map.valid())
+    {
+        std::vector<osg::ref_ptr<ElevationLayer>> elevationLayers;
+        map->getOpenLayers(elevationLayers);
+        for (auto& layer : elevationLayers)
+        {
+            if (layer->getVisible())
+                buf << ";" << layer->getCacheID() << "." << layer->getRevision();
+        }
+    }
+
+    return Cache::makeCacheKey(buf.str(), "tfm");
+}
+
+std::string
+TiledFeatureModelLayer::getStyleHash() const
+{
+    std::lock_guard<std::mutex> lock(_styleHashMutex);
+
+    const StyleSheet* sheet = getStyleSheet();
+    int revision = sheet ? sheet->getRevision() : -1;
+
+    if (sheet != _styleHashSheet || revision != _styleHashRevision)
+    {
+        _styleHash = hashStyleSheet(sheet);
+        _styleHashSheet = sheet;
+        _styleHashRevision = revision;
+    }
+
+    return _styleHash;
+}
+
+osg::ref_ptr<osg::Group>
+TiledFeatureModelLayer::readTileFromCache(const std::string& cacheKey) const
+{
+    CacheSettings* cacheSettings = CacheSettings::get(getReadOptions());
+    if (!cacheSettings || !cacheSettings->getCacheBin() || !cacheSettings->cachePolicy()->isCacheReadable())
+        return {};
+
+    // share images (and other external references) across cached tiles
+    osg::ref_ptr<osgDB::Options> localOptions = Registry::instance()->cloneOrCreateOptions(getReadOptions());
+    localOptions->setObjectCache(_nodeCachingImageCache.get());
+    localOptions->setObjectCacheHint(osgDB::Options::CACHE_ALL);
+
+    ReadResult rr = cacheSettings->getCacheBin()->readObject(cacheKey, localOptions.get());
+
+    if (cacheSettings->cachePolicy()->isExpired(rr.lastModifiedTime()))
+        return {};
+
+    if (rr.failed())
+    {
+        if (rr.code() != ReadResult::RESULT_NOT_FOUND)
+        {
+            OE_WARN << LC << "Cache read error (cacheKey=" << cacheKey << ") " << rr.getResultCodeString() << "; " << rr.errorDetail() << std::endl;
+        }
+        return {};
+    }
+
+    osg::ref_ptr<osg::Group> group = dynamic_cast<osg::Group*>(rr.getNode());
+    if (!group.valid())
+        return {};
+
+    // remap the feature index to this session's object IDs.
+    if (_featureIndex.valid())
+    {
+        FeatureSourceIndexNode::reconstitute(group.get(), _featureIndex.get());
+    }
+
+    // share state with tiles already in the scene
+    if (_session.valid() && _session->getStateSetCache())
+    {
+        _session->getStateSetCache()->optimize(group.get());
+    }
+
+    return group;
+}
+
+void
+TiledFeatureModelLayer::writeTileToCache(const std::string& cacheKey, osg::Group* group) const
+{
+    CacheSettings* cacheSettings = CacheSettings::get(getReadOptions());
+    if (cacheSettings && cacheSettings->getCacheBin() && cacheSettings->cachePolicy()->isCacheWriteable())
+    {
+        cacheSettings->getCacheBin()->writeNode(cacheKey, group, Config(), getReadOptions());
+    }
+}
+
 const Profile*
 TiledFeatureModelLayer::getProfile() const
 {
@@ -5,6 +5,7 @@
 #include <osgEarth/TransformFilter>
 #include <osgEarth/Feature>
 #include <osgEarth/FilterContext>
+#include <osgEarth/FlatGeometry>
 
 #define LC "[TransformFilter] "
 
@@ -78,33 +79,39 @@ TransformFilter::push( Feature* input, FilterContext& context )
     if ( !needsSRSXform && !_localize && !needsMatrixXform )
         return true;
 
-    // iterate over the feature geometry.
-    GeometryIterator iter( input->getGeometry() );
-    while( iter.hasMore() )
-    {
-        Geometry* geom = iter.next();
+    Geometry* geometry = input->getGeometry();
 
-        // pre-transform the point before doing an SRS transformation.
-        if ( needsMatrixXform )
+    // pre-transform the points before doing an SRS transformation.
+    if ( needsMatrixXform )
+    {
+        GeometryIterator iter( geometry );
+        while( iter.hasMore() )
         {
+            Geometry* geom = iter.next();
             for( unsigned i=0; i < geom->size(); ++i )
                 (*geom)[i] = (*geom)[i] * _mat;
         }
+    }
 
-        // first transform the geometry to the output SRS:            
-        if ( needsSRSXform )
-        {
-            inputSRS->transform(geom->asVector(), _outputSRS.get());
-            //context.profile()->getSRS()->transform( geom->asVector(), _outputSRS.get() );
-        }
-            //context.profile()->getSRS()->transformPoints( _outputSRS.get(), geom->asVector(), false );
+    if ( !needsSRSXform && !_localize )
+        return true;
 
-        // update the bounding box.
-        if ( _localize )
-        {
-            for( unsigned i=0; i<geom->size(); ++i )
-                _bbox.expandBy( (*geom)[i] );
-        }
+    // gather every part into contiguous coordinate arrays so the whole
+    // feature goes through the SRS transform in one batch:
+    FlatGeometry flat( geometry );
+
+    if ( needsSRSXform )
+    {
+        if ( flat.transform(inputSRS, _outputSRS.get()) )
+            flat.writeTo( geometry );
+        else if ( _localize )
+            flat.set( geometry );
+    }
+
+    // update the bounding box.
+    if ( _localize )
+    {
+        _bbox.expandBy( flat.getBounds() );
     }
 
     return true;
@@ -15,6 +15,8 @@ using namespace osgEarth::XYZ;
 #undef LC
 #define LC "[XYZ] "
 
+#define ARENA_XYZ_BATCH "oe.xyz.batch"
+
 //............................................................................
 
 Status
@@ -229,6 +231,41 @@ XYZImageLayer::createImageImplementation(const TileKey& key, ProgressCallback* p
         return GeoImage(Status(r.errorDetail()));
 }
 
+std::vector<GeoImage>
+XYZImageLayer::createImagesImplementation(const std::vector<TileKey>& keys, ProgressCallback* progress) const
+{
+    std::vector<GeoImage> results(keys.size(), GeoImage::INVALID);
+    if (keys.empty())
+        return results;
+
+    // Issue all but the first request on a job pool so the round trips
+    // overlap, and service the first one on this thread.
+    std::vector<jobs::future<GeoImage>> futures(keys.size());
+    jobs::context context;
+    context.pool = jobs::get_pool(ARENA_XYZ_BATCH);
+
+    for (unsigned i = 1; i < keys.size(); ++i)
+    {
+        TileKey key = keys[i];
+        osg::ref_ptr<ProgressCallback> progress_ref(progress);
+        context.name = key.str();
+        futures[i] = jobs::dispatch([this, key, progress_ref](Cancelable&)
+            {
+                return createImageImplementation(key, progress_ref.get());
+            },
+            context);
+    }
+
+    results[0] = createImageImplementation(keys[0], progress);
+
+    for (unsigned i = 1; i < keys.size(); ++i)
+    {
+        results[i] = futures[i].join();
+    }
+
+    return results;
+}
+
 //........................................................................
 
 REGISTER_OSGEARTH_LAYER(xyzelevation, XYZElevationLayer);
@@ -0,0 +1,1151 @@
+#pragma once
+#include "weemesh.h"
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+#include <cfloat>
+
+namespace weemesh
+{
+    // CONSTRAINED DELAUNAY TRIANGULATION
+    //
+    // Flat half-edge triangulation. Triangle t owns half-edges 3t, 3t+1
+    // and 3t+2; half-edge e runs from tri_verts[e] to tri_verts[next(e)]
+    // and twins[e] is the opposing half-edge in the neighboring triangle
+    // (or NONE on the hull). Triangles are only ever split or flipped in
+    // place, never deleted, so indices stay stable for the life of the
+    // mesh and removal is left to the caller.
+    //
+    // Markers follow the same conventions as mesh_t so the output can
+    // be treated the same way downstream.
+
+    struct cdt_t
+    {
+        enum { NONE = -1 };
+
+        vert_array_t verts;
+        std::vector<int> markers;
+        std::vector<int> tri_verts;
+        std::vector<int> twins;
+        std::vector<std::uint8_t> constrained;
+
+        vert_t::value_type _epsilon = DEFAULT_EPSILON;
+        int _boundary_marker = 1;
+        int _constraint_marker = 16;
+        int _has_elevation_marker = 4;
+        int _num_edits = 0;
+
+        // limits runaway growth on pathological input
+        unsigned _max_num_triangles = UINT_MAX;
+
+        // constraint segments longer than this are subdivided
+        vert_t::value_type _max_segment_length = 0.0;
+
+        // single constraint segment (in)
+        struct segment_input_t
+        {
+            vert_t p0, p1;
+            int marker;
+        };
+
+        // single constraint point (in)
+        struct point_input_t
+        {
+            vert_t p;
+            int marker;
+        };
+
+        cdt_t(double epsilon = DEFAULT_EPSILON) :
+            _epsilon(epsilon) { }
+
+        void set_boundary_marker(int value) {
+            _boundary_marker = value;
+        }
+
+        void set_constraint_marker(int value) {
+            _constraint_marker = value;
+        }
+
+        void set_has_elevation_marker(int value) {
+            _has_elevation_marker = value;
+        }
+
+        inline int num_triangles() const {
+            return (int)tri_verts.size() / 3;
+        }
+
+        static inline int next(int e) {
+            return (e % 3 == 2) ? e - 2 : e + 1;
+        }
+
+        static inline int prev(int e) {
+            return (e % 3 == 0) ? e + 2 : e - 1;
+        }
+
+        // > 0 if c is left of the line a->b
+        static inline double orient(const vert_t& a, const vert_t& b, const vert_t& c) {
+            return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        }
+
+        // adds a vertex without triangulating it; used to seed the mesh
+        int get_or_create_vertex(const vert_t& p, int marker)
+        {
+            auto iter = _vert_lut.find(p);
+            if (iter != _vert_lut.end())
+            {
+                markers[iter->second] |= marker;
+                return iter->second;
+            }
+            int i = (int)verts.size();
+            verts.push_back(p);
+            markers.push_back(marker);
+            _vert_tri.push_back(NONE);
+            _vert_lut[p] = i;
+            return i;
+        }
+
+        // adds a seed triangle, fixing the winding to CCW. Call
+        // link_seed_triangles() after adding them all.
+        int add_triangle(int i0, int i1, int i2)
+        {
+            if (i0 == i1 || i1 == i2 || i2 == i0)
+                return NONE;
+
+            double o = orient(verts[i0], verts[i1], verts[i2]);
+            if (std::abs(o) <= _epsilon * _epsilon)
+                return NONE;
+
+            if (o < 0.0)
+                std::swap(i1, i2);
+
+            int t = new_triangle();
+            set_triangle(t, i0, i1, i2);
+            return t;
+        }
+
+        // connects the twins of all seed triangles.
+        void link_seed_triangles()
+        {
+            std::unordered_map<std::uint64_t, int> open;
+            open.reserve(tri_verts.size());
+
+            for (int e = 0; e < (int)tri_verts.size(); ++e)
+            {
+                int u = tri_verts[e], v = tri_verts[next(e)];
+                auto iter = open.find(key(v, u));
+                if (iter != open.end() && twins[iter->second] == NONE)
+                {
+                    link(e, iter->second);
+                    open.erase(iter);
+                }
+                else
+                {
+                    open.emplace(key(u, v), e);
+                }
+            }
+
+            // the hull never changes shape (we only insert inside it),
+            // so record it once for clipping.
+            _hull.clear();
+            for (int e = 0; e < (int)tri_verts.size(); ++e)
+            {
+                if (twins[e] == NONE)
+                    _hull.emplace_back(verts[tri_verts[e]], verts[tri_verts[next(e)]]);
+            }
+        }
+
+        // inserts a single point. Returns the vertex index, or NONE
+        // if the point falls outside the mesh.
+        int insert_point(const vert_t& p, int marker)
+        {
+            int where = NONE;
+            int type = locate(p, where);
+
+            if (type == LOC_VERTEX)
+            {
+                if ((marker & _has_elevation_marker) && !(markers[where] & _has_elevation_marker))
+                    verts[where].z = p.z;
+                markers[where] |= marker;
+                return where;
+            }
+            else if (type == LOC_EDGE)
+            {
+                return split_edge(where, p, marker);
+            }
+            else if (type == LOC_TRIANGLE)
+            {
+                return split_triangle(where, p, marker);
+            }
+            return NONE;
+        }
+
+        // forces the edge between two existing vertices into the mesh,
+        // adding steiner points where it crosses other constraints.
+        void insert_segment(int a, int b, int marker)
+        {
+            std::vector<std::pair<int, int>> stack;
+            stack.emplace_back(a, b);
+
+            while (!stack.empty() && (unsigned)num_triangles() < _max_num_triangles)
+            {
+                auto seg = stack.back();
+                stack.pop_back();
+                int s0 = seg.first, s1 = seg.second;
+                if (s0 == s1 || s0 == NONE || s1 == NONE)
+                    continue;
+
+                markers[s0] |= marker;
+                markers[s1] |= marker;
+
+                // is the edge already there, or does the segment pass
+                // through a vertex or a constrained edge right away?
+                int e = NONE, stop = NONE;
+                int r = find_first_crossing(s0, s1, e, stop);
+
+                if (r == WALK_FAILED)
+                {
+                    continue;
+                }
+                else if (r == WALK_EDGE_EXISTS)
+                {
+                    set_constrained(e);
+                    continue;
+                }
+                else if (r == WALK_THROUGH_VERTEX)
+                {
+                    set_constrained(e);
+                    markers[stop] |= marker;
+                    stack.emplace_back(stop, s1);
+                    continue;
+                }
+
+                // collect the channel of edges crossed by the segment.
+                std::vector<int> crossings;
+                int target = s1;
+                r = collect_crossings(s0, s1, e, crossings, target, stop);
+
+                if (r == WALK_FAILED)
+                {
+                    continue;
+                }
+                else if (r == WALK_THROUGH_CONSTRAINT)
+                {
+                    // split the constrained edge where we cross it and
+                    // insert the two halves separately.
+                    int v = split_constrained_crossing(stop, s0, s1, marker);
+                    if (v != NONE)
+                    {
+                        stack.emplace_back(v, s1);
+                        stack.emplace_back(s0, v);
+                    }
+                    continue;
+                }
+
+                if (target != s1)
+                {
+                    // segment passes through vertex "target" first
+                    markers[target] |= marker;
+                    stack.emplace_back(target, s1);
+                }
+
+                recover_edge(s0, target, crossings);
+            }
+        }
+
+        // inserts a batch of points and segments. Points are inserted
+        // first in spatially coherent order so each location walk starts
+        // near the previous one; then the segments are recovered.
+        void insert(
+            const std::vector<point_input_t>& points,
+            const std::vector<segment_input_t>& segments,
+            const std::function<bool()>& canceled = nullptr)
+        {
+            if (tri_verts.empty())
+                return;
+
+            struct pending_t {
+                vert_t p;
+                int marker;
+                int segment;  // index of segment, or NONE
+                int end;      // 0 or 1
+                std::uint32_t code;
+            };
+
+            std::vector<pending_t> pending;
+            std::vector<std::pair<int, int>> segment_verts;
+            std::vector<int> segment_markers;
+
+            for (auto& point : points)
+            {
+                if (inside_hull(point.p))
+                    pending.push_back({ point.p, point.marker, NONE, 0, 0u });
+            }
+
+            std::vector<vert_t> pieces;
+            for (auto& seg : segments)
+            {
+                clip_to_hull(seg.p0, seg.p1, pieces);
+
+                for (unsigned i = 0; i + 1 < pieces.size(); i += 2)
+                {
+                    subdivide(pieces[i], pieces[i + 1], seg.marker, pending, segment_verts, segment_markers);
+                }
+            }
+
+            if (pending.empty())
+                return;
+
+            // sort along a morton curve over the mesh bounds
+            vert_t bmin(DBL_MAX, DBL_MAX, 0), bmax(-DBL_MAX, -DBL_MAX, 0);
+            for (auto& v : verts)
+            {
+                bmin.x = std::min(bmin.x, v.x), bmin.y = std::min(bmin.y, v.y);
+                bmax.x = std::max(bmax.x, v.x), bmax.y = std::max(bmax.y, v.y);
+            }
+            double sx = bmax.x > bmin.x ? 65535.0 / (bmax.x - bmin.x) : 0.0;
+            double sy = bmax.y > bmin.y ? 65535.0 / (bmax.y - bmin.y) : 0.0;
+            for (auto& p : pending)
+            {
+                p.code = morton(
+                    (std::uint32_t)clamp((p.p.x - bmin.x) * sx, 0.0, 65535.0),
+                    (std::uint32_t)clamp((p.p.y - bmin.y) * sy, 0.0, 65535.0));
+            }
+
+            std::vector<int> order(pending.size());
+            for (unsigned i = 0; i < order.size(); ++i)
+                order[i] = i;
+            std::sort(order.begin(), order.end(), [&](int lhs, int rhs) {
+                return pending[lhs].code < pending[rhs].code; });
+
+            unsigned count = 0;
+            for (int i : order)
+            {
+                if (canceled && (++count & 255) == 0 && canceled())
+                    return;
+
+                if ((unsigned)num_triangles() >= _max_num_triangles)
+                    break;
+
+                auto& p = pending[i];
+                int v = insert_point(p.p, p.marker);
+                if (p.segment != NONE)
+                {
+                    if (p.end == 0)
+                        segment_verts[p.segment].first = v;
+                    else
+                        segment_verts[p.segment].second = v;
+                }
+            }
+
+            // recover the segments in the order of their first vertex
+            order.resize(segment_verts.size());
+            for (unsigned i = 0; i < order.size(); ++i)
+                order[i] = i;
+            std::sort(order.begin(), order.end(), [&](int lhs, int rhs) {
+                return segment_verts[lhs].first < segment_verts[rhs].first; });
+
+            count = 0;
+            for (int i : order)
+            {
+                if (canceled && (++count & 255) == 0 && canceled())
+                    return;
+
+                if ((unsigned)num_triangles() >= _max_num_triangles)
+                    break;
+
+                insert_segment(segment_verts[i].first, segment_verts[i].second, segment_markers[i]);
+            }
+        }
+
+        // centroid of a triangle
+        inline vert_t centroid(int t) const
+        {
+            const vert_t& a = verts[tri_verts[3 * t]];
+            const vert_t& b = verts[tri_verts[3 * t + 1]];
+            const vert_t& c = verts[tri_verts[3 * t + 2]];
+            return vert_t((a.x + b.x + c.x) / 3.0, (a.y + b.y + c.y) / 3.0, (a.z + b.z + c.z) / 3.0);
+        }
+
+    private:
+
+        enum { LOC_OUTSIDE, LOC_TRIANGLE, LOC_EDGE, LOC_VERTEX };
+        enum { WALK_FAILED, WALK_EDGE_EXISTS, WALK_THROUGH_VERTEX, WALK_CROSSING, WALK_THROUGH_CONSTRAINT, WALK_DONE };
+
+        struct vert_key_hash_t
+        {
+            std::size_t operator()(const vert_t& v) const {
+                std::uint64_t x, y;
+                std::memcpy(&x, &v.x, sizeof(x));
+                std::memcpy(&y, &v.y, sizeof(y));
+                return hash_value_unsigned(x ^ (y * 0x9E3779B97F4A7C15ull));
+            }
+        };
+
+        struct vert_key_equal_t
+        {
+            bool operator()(const vert_t& a, const vert_t& b) const {
+                return a.x == b.x && a.y == b.y;
+            }
+        };
+
+        std::unordered_map<vert_t, int, vert_key_hash_t, vert_key_equal_t> _vert_lut;
+        std::vector<int> _vert_tri; // one triangle touching each vertex
+        std::vector<segment_t> _hull;
+        int _last_tri = 0;
+        unsigned _walk_seed = 0;
+
+        static inline std::uint64_t key(int u, int v) {
+            return ((std::uint64_t)(std::uint32_t)u << 32) | (std::uint32_t)v;
+        }
+
+        static inline std::uint32_t morton(std::uint32_t x, std::uint32_t y)
+        {
+            auto spread = [](std::uint32_t v) {
+                v = (v | (v << 8)) & 0x00FF00FF;
+                v = (v | (v << 4)) & 0x0F0F0F0F;
+                v = (v | (v << 2)) & 0x33333333;
+                v = (v | (v << 1)) & 0x55555555;
+                return v;
+            };
+            return spread(x) | (spread(y) << 1);
+        }
+
+        int new_triangle()
+        {
+            int t = num_triangles();
+            tri_verts.insert(tri_verts.end(), 3, NONE);
+            twins.insert(twins.end(), 3, NONE);
+            constrained.insert(constrained.end(), 3, 0);
+            ++_num_edits;
+            return t;
+        }
+
+        void set_triangle(int t, int a, int b, int c)
+        {
+            tri_verts[3 * t] = a, tri_verts[3 * t + 1] = b, tri_verts[3 * t + 2] = c;
+            constrained[3 * t] = constrained[3 * t + 1] = constrained[3 * t + 2] = 0;
+            _vert_tri[a] = _vert_tri[b] = _vert_tri[c] = t;
+        }
+
+        inline void link(int e, int f)
+        {
+            twins[e] = f;
+            if (f != NONE)
+                twins[f] = e;
+        }
+
+        inline void set_constrained(int e)
+        {
+            constrained[e] = 1;
+            if (twins[e] != NONE)
+                constrained[twins[e]] = 1;
+        }
+
+        // distance from p to segment a->b is within epsilon
+        inline bool on_segment(const vert_t& p, const vert_t& a, const vert_t& b) const
+        {
+            vert_t ab = b - a;
+            double len2 = ab.length2d_squared();
+            if (len2 <= 0.0)
+                return false;
+            double u = (p - a).dot2d(ab) / len2;
+            if (u <= 0.0 || u >= 1.0)
+                return false;
+            vert_t c = a + ab * u;
+            return (p - c).length2d_squared() <= _epsilon * _epsilon;
+        }
+
+        inline bool near_vert(const vert_t& p, int v) const
+        {
+            return
+                std::abs(p.x - verts[v].x) <= _epsilon &&
+                std::abs(p.y - verts[v].y) <= _epsilon;
+        }
+
+        // classifies p against triangle t, with tolerance
+        int classify(const vert_t& p, int t, int& where) const
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                if (near_vert(p, tri_verts[3 * t + i]))
+                {
+                    where = tri_verts[3 * t + i];
+                    return LOC_VERTEX;
+                }
+            }
+
+            for (int i = 0; i < 3; ++i)
+            {
+                int e = 3 * t + i;
+                if (on_segment(p, verts[tri_verts[e]], verts[tri_verts[next(e)]]))
+                {
+                    where = e;
+                    return LOC_EDGE;
+                }
+            }
+
+            for (int i = 0; i < 3; ++i)
+            {
+                int e = 3 * t + i;
+                if (orient(verts[tri_verts[e]], verts[tri_verts[next(e)]], p) < 0.0)
+                    return LOC_OUTSIDE;
+            }
+
+            where = t;
+            return LOC_TRIANGLE;
+        }
+
+        // find the triangle, edge or vertex containing p by walking
+        // from the last location; falls back on a linear search if the
+        // walk leaves the mesh (which can happen on a concave hull).
+        int locate(const vert_t& p, int& where)
+        {
+            int t = _last_tri < num_triangles() ? _last_tri : 0;
+            int max_steps = num_triangles() + 3;
+
+            for (int step = 0; step < max_steps; ++step)
+            {
+                int start = (int)(_walk_seed++ % 3);
+                int exit_edge = NONE;
+
+                for (int i = 0; i < 3; ++i)
+                {
+                    int e = 3 * t + (start + i) % 3;
+                    if (orient(verts[tri_verts[e]], verts[tri_verts[next(e)]], p) < 0.0)
+                    {
+                        exit_edge = e;
+                        break;
+                    }
+                }
+
+                if (exit_edge == NONE || twins[exit_edge] == NONE)
+                {
+                    int type = classify(p, t, where);
+                    if (type != LOC_OUTSIDE)
+                    {
+                        _last_tri = t;
+                        return type;
+                    }
+                    break;
+                }
+
+                t = twins[exit_edge] / 3;
+            }
+
+            for (t = 0; t < num_triangles(); ++t)
+            {
+                int type = classify(p, t, where);
+                if (type != LOC_OUTSIDE)
+                {
+                    _last_tri = t;
+                    return type;
+                }
+            }
+
+            return LOC_OUTSIDE;
+        }
+
+        // computes the z and markers of a vertex inserted on the edge a->b
+        void interpolate_on_edge(vert_t& p, int& marker, int a, int b) const
+        {
+            if ((markers[a] & _boundary_marker) && (markers[b] & _boundary_marker))
+                marker |= _boundary_marker;
+
+            if (!(marker & _has_elevation_marker) &&
+                (markers[a] & _has_elevation_marker) &&
+                (markers[b] & _has_elevation_marker))
+            {
+                vert_t ab = verts[b] - verts[a];
+                double len2 = ab.length2d_squared();
+                double u = len2 > 0.0 ? clamp((p - verts[a]).dot2d(ab) / len2, 0.0, 1.0) : 0.0;
+                p.z = verts[a].z + ab.z * u;
+                marker |= _has_elevation_marker;
+            }
+        }
+
+        int split_triangle(int t, const vert_t& p_in, int marker)
+        {
+            int a = tri_verts[3 * t], b = tri_verts[3 * t + 1], c = tri_verts[3 * t + 2];
+            vert_t p = p_in;
+
+            if (!(marker & _has_elevation_marker) &&
+                (markers[a] & _has_elevation_marker) &&
+                (markers[b] & _has_elevation_marker) &&
+                (markers[c] & _has_elevation_marker))
+            {
+                // barycentric elevation
+                const vert_t &A = verts[a], &B = verts[b], &C = verts[c];
+                double area = orient(A, B, C);
+                if (area != 0.0)
+                {
+                    double wa = orient(B, C, p) / area;
+                    double wb = orient(C, A, p) / area;
+                    double wc = 1.0 - wa - wb;
+                    p.z = wa * A.z + wb * B.z + wc * C.z;
+                    marker |= _has_elevation_marker;
+                }
+            }
+
+            int v = get_or_create_vertex(p, marker);
+
+            int o0 = twins[3 * t], o1 = twins[3 * t + 1], o2 = twins[3 * t + 2];
+            std::uint8_t c0 = constrained[3 * t], c1 = constrained[3 * t + 1], c2 = constrained[3 * t + 2];
+
+            int t1 = new_triangle();
+            int t2 = new_triangle();
+
+            set_triangle(t, a, b, v);
+            set_triangle(t1, b, c, v);
+            set_triangle(t2, c, a, v);
+
+            link(3 * t, o0);   constrained[3 * t] = c0;
+            link(3 * t1, o1);  constrained[3 * t1] = c1;
+            link(3 * t2, o2);  constrained[3 * t2] = c2;
+            link(3 * t + 1, 3 * t1 + 2);
+            link(3 * t + 2, 3 * t2 + 1);
+            link(3 * t1 + 1, 3 * t2 + 2);
+
+            markers[a] |= _constraint_marker;
+            markers[b] |= _constraint_marker;
+            markers[c] |= _constraint_marker;
+
+            _last_tri = t;
+
+            legalize({ 3 * t, 3 * t1, 3 * t2 });
+            return v;
+        }
+
+        int split_edge(int e, const vert_t& p_in, int marker)
+        {
+            int p = tri_verts[e], q = tri_verts[next(e)], r = tri_verts[prev(e)];
+            int b = twins[e];
+            std::uint8_t ce = constrained[e];
+
+            vert_t pos = p_in;
+            interpolate_on_edge(pos, marker, p, q);
+            if (ce)
+                marker |= _constraint_marker;
+            int v = get_or_create_vertex(pos, marker);
+
+            int t0 = e / 3;
+            int o_qr = twins[next(e)], o_rp = twins[prev(e)];
+            std::uint8_t c_qr = constrained[next(e)], c_rp = constrained[prev(e)];
+
+            markers[p] |= _constraint_marker;
+            markers[q] |= _constraint_marker;
+            markers[r] |= _constraint_marker;
+
+            if (b == NONE)
+            {
+                int t1 = new_triangle();
+                set_triangle(t0, p, v, r);
+                set_triangle(t1, v, q, r);
+
+                link(3 * t0, NONE);       constrained[3 * t0] = ce;
+                link(3 * t0 + 2, o_rp);   constrained[3 * t0 + 2] = c_rp;
+                link(3 * t1, NONE);       constrained[3 * t1] = ce;
+                link(3 * t1 + 1, o_qr);   constrained[3 * t1 + 1] = c_qr;
+                link(3 * t0 + 1, 3 * t1 + 2);
+
+                _last_tri = t0;
+                legalize({ 3 * t0 + 2, 3 * t1 + 1 });
+            }
+            else
+            {
+                int t1 = b / 3;
+                int s = tri_verts[prev(b)];
+                int o_ps = twins[next(b)], o_sq = twins[prev(b)];
+                std::uint8_t c_ps = constrained[next(b)], c_sq = constrained[prev(b)];
+
+                markers[s] |= _constraint_marker;
+
+                int tb = new_triangle();
+                int td = new_triangle();
+
+                set_triangle(t0, p, v, r); // A
+                set_triangle(tb, v, q, r); // B
+                set_triangle(t1, q, v, s); // C
+                set_triangle(td, v, p, s); // D
+
+                link(3 * t0 + 2, o_rp);  constrained[3 * t0 + 2] = c_rp;
+                link(3 * tb + 1, o_qr);  constrained[3 * tb + 1] = c_qr;
+                link(3 * t1 + 2, o_sq);  constrained[3 * t1 + 2] = c_sq;
+                link(3 * td + 1, o_ps);  constrained[3 * td + 1] = c_ps;
+
+                link(3 * t0, 3 * td);
+                link(3 * t0 + 1, 3 * tb + 2);
+                link(3 * tb, 3 * t1);
+                link(3 * t1 + 1, 3 * td + 2);
+
+                constrained[3 * t0] = constrained[3 * td] = ce;
+                constrained[3 * tb] = constrained[3 * t1] = ce;
+
+                _last_tri = t0;
+                legalize({ 3 * t0 + 2, 3 * tb + 1, 3 * t1 + 2, 3 * td + 1 });
+            }
+
+            return v;
+        }
+
+        // true if the quad around edge e is strictly convex (so it can flip)
+        bool flippable(int e) const
+        {
+            int b = twins[e];
+            if (b == NONE)
+                return false;
+            const vert_t& p = verts[tri_verts[e]];
+            const vert_t& q = verts[tri_verts[next(e)]];
+            const vert_t& r = verts[tri_verts[prev(e)]];
+            const vert_t& s = verts[tri_verts[prev(b)]];
+            return orient(r, s, p) * orient(r, s, q) < 0.0;
+        }
+
+        // true if edge e violates the Delaunay condition
+        bool illegal(int e) const
+        {
+            int b = twins[e];
+            if (b == NONE || constrained[e])
+                return false;
+
+            const vert_t& p = verts[tri_verts[e]];
+            const vert_t& q = verts[tri_verts[next(e)]];
+            const vert_t& r = verts[tri_verts[prev(e)]];
+            const vert_t& s = verts[tri_verts[prev(b)]];
+
+            // relative in-circle test; the slack keeps near-cocircular
+            // grid cells from flipping back and forth.
+            double adx = p.x - s.x, ady = p.y - s.y;
+            double bdx = q.x - s.x, bdy = q.y - s.y;
+            double cdx = r.x - s.x, cdy = r.y - s.y;
+            double ad = adx * adx + ady * ady;
+            double bd = bdx * bdx + bdy * bdy;
+            double cd = cdx * cdx + cdy * cdy;
+            double det =
+                adx * (bdy * cd - bd * cdy) -
+                ady * (bdx * cd - bd * cdx) +
+                ad * (bdx * cdy - bdy * cdx);
+            double scale = (ad + bd + cd);
+            return det > 1e-9 * scale * scale;
+        }
+
+        // flips the diagonal of the quad around e. Returns the half-edge
+        // holding the new diagonal in e's triangle. Afterwards the
+        // half-edges previously at prev(twin) and prev(e) are found at
+        // e and twin respectively.
+        int flip(int a)
+        {
+            int b = twins[a];
+            int al = next(a), ar = prev(a);
+            int bl = prev(b);
+
+            int p = tri_verts[a], q = tri_verts[al], r = tri_verts[ar];
+            int s = tri_verts[bl];
+
+            int hbl = twins[bl], har = twins[ar];
+            std::uint8_t cbl = constrained[bl], car = constrained[ar];
+
+            tri_verts[a] = s;
+            tri_verts[b] = r;
+
+            link(a, hbl);  constrained[a] = cbl;
+            link(b, har);  constrained[b] = car;
+            link(ar, bl);  constrained[ar] = constrained[bl] = 0;
+
+            _vert_tri[p] = b / 3;
+            _vert_tri[q] = a / 3;
+            _vert_tri[r] = a / 3;
+            _vert_tri[s] = a / 3;
+
+            markers[p] |= _constraint_marker;
+            markers[q] |= _constraint_marker;
+            markers[r] |= _constraint_marker;
+            markers[s] |= _constraint_marker;
+
+            ++_num_edits;
+            return ar;
+        }
+
+        // Lawson flips until the edges around a change are Delaunay
+        void legalize(std::initializer_list<int> edges)
+        {
+            std::vector<int> stack(edges);
+            int budget = 64 + 16 * (int)stack.size();
+
+            while (!stack.empty() && budget-- > 0)
+            {
+                int e = stack.back();
+                stack.pop_back();
+
+                if (illegal(e) && flippable(e))
+                {
+                    int b = twins[e];
+                    flip(e);
+                    stack.push_back(e);
+                    stack.push_back(next(e));
+                    stack.push_back(b);
+                    stack.push_back(next(b));
+                }
+            }
+        }
+
+        // finds an outgoing half-edge of vertex v
+        int outgoing_edge(int v)
+        {
+            int t = _vert_tri[v];
+            if (t != NONE)
+            {
+                for (int i = 0; i < 3; ++i)
+                    if (tri_verts[3 * t + i] == v)
+                        return 3 * t + i;
+            }
+
+            // stale hint; search
+            for (int e = 0; e < (int)tri_verts.size(); ++e)
+            {
+                if (tri_verts[e] == v)
+                {
+                    _vert_tri[v] = e / 3;
+                    return e;
+                }
+            }
+            return NONE;
+        }
+
+        // true if vertex x lies on the open segment a->b
+        inline bool between(int x, int a, int b) const
+        {
+            return on_segment(verts[x], verts[a], verts[b]);
+        }
+
+        // rotates around s0 to find the first triangle the segment s0->s1
+        // passes through. On WALK_CROSSING, "e" is the outgoing half-edge
+        // of s0 in that triangle.
+        int find_first_crossing(int s0, int s1, int& e, int& stop)
+        {
+            int start = outgoing_edge(s0);
+            if (start == NONE)
+                return WALK_FAILED;
+
+            const vert_t& A = verts[s0];
+            const vert_t& B = verts[s1];
+
+            auto test = [&](int h) -> int
+            {
+                int x = tri_verts[next(h)];
+                int y = tri_verts[prev(h)];
+                if (x == s1) { e = h; return WALK_EDGE_EXISTS; }
+                if (between(x, s0, s1)) { e = h; stop = x; return WALK_THROUGH_VERTEX; }
+                if (y == s1) { e = prev(h); return WALK_EDGE_EXISTS; }
+                if (between(y, s0, s1)) { e = prev(h); stop = y; return WALK_THROUGH_VERTEX; }
+                if (orient(A, verts[x], B) > 0.0 && orient(A, verts[y], B) < 0.0)
+                {
+                    e = h;
+                    return WALK_CROSSING;
+                }
+                return WALK_FAILED;
+            };
+
+            // counter-clockwise
+            int h = start;
+            for (int i = 0; i < 1024; ++i)
+            {
+                int r = test(h);
+                if (r != WALK_FAILED)
+                    return r;
+                int t = twins[prev(h)];
+                if (t == NONE || t == start)
+                    break;
+                h = t;
+            }
+
+            // clockwise (only needed when we hit the hull)
+            h = start;
+            for (int i = 0; i < 1024; ++i)
+            {
+                if (twins[h] == NONE)
+                    break;
+                h = next(twins[h]);
+                if (h == start)
+                    break;
+                int r = test(h);
+                if (r != WALK_FAILED)
+                    return r;
+            }
+
+            return WALK_FAILED;
+        }
+
+        // walks the channel of triangles crossed by s0->s1, starting in the
+        // triangle of half-edge e (outgoing from s0).
+        int collect_crossings(int s0, int s1, int e, std::vector<int>& crossings, int& target, int& stop)
+        {
+            const vert_t& A = verts[s0];
+            const vert_t& B = verts[s1];
+
+            int h = next(e);
+            for (int i = 0; i < (int)tri_verts.size(); ++i)
+            {
+                if (constrained[h])
+                {
+                    stop = h;
+                    return WALK_THROUGH_CONSTRAINT;
+                }
+
+                crossings.push_back(h);
+
+                int tw = twins[h];
+                if (tw == NONE)
+                    return WALK_FAILED;
+
+                int z = tri_verts[prev(tw)];
+                if (z == s1)
+                {
+                    target = s1;
+                    return WALK_DONE;
+                }
+                if (between(z, s0, s1))
+                {
+                    target = z;
+                    return WALK_DONE;
+                }
+
+                h = orient(A, B, verts[z]) > 0.0 ? next(tw) : prev(tw);
+            }
+            return WALK_FAILED;
+        }
+
+        // splits constrained edge h where the segment s0->s1 crosses it
+        int split_constrained_crossing(int h, int s0, int s1, int marker)
+        {
+            // the walk guarantees the edge endpoints straddle s0->s1, so
+            // parameterize along the edge (no divide by zero) and take z
+            // from the segment being inserted.
+            const vert_t& A = verts[s0];
+            const vert_t& B = verts[s1];
+            const vert_t& P = verts[tri_verts[h]];
+            const vert_t& Q = verts[tri_verts[next(h)]];
+            double op = orient(A, B, P), oq = orient(A, B, Q);
+            double t = clamp(op / (op - oq), 0.0, 1.0);
+            vert_t out = P + (Q - P) * t;
+
+            vert_t ab = B - A;
+            double len2 = ab.length2d_squared();
+            double u = len2 > 0.0 ? clamp((out - A).dot2d(ab) / len2, 0.0, 1.0) : 0.0;
+            out.z = A.z + ab.z * u;
+
+            int mark = marker;
+            int a = tri_verts[h], b = tri_verts[next(h)];
+            if (!(mark & _has_elevation_marker) &&
+                (markers[a] & _has_elevation_marker) &&
+                (markers[b] & _has_elevation_marker))
+            {
+                // same rule as weemesh: keep the higher of the two
+                vert_t ab = verts[b] - verts[a];
+                double len2 = ab.length2d_squared();
+                double v = len2 > 0.0 ? clamp((out - verts[a]).dot2d(ab) / len2, 0.0, 1.0) : 0.0;
+                out.z = std::max(out.z, verts[a].z + ab.z * v);
+                mark |= _has_elevation_marker;
+            }
+
+            if (near_vert(out, a)) return a;
+            if (near_vert(out, b)) return b;
+
+            return split_edge(h, out, mark | _constraint_marker);
+        }
+
+        // true if edge e properly crosses the segment a-b
+        inline bool crosses(int e, const vert_t& A, const vert_t& B) const
+        {
+            const vert_t& P = verts[tri_verts[e]];
+            const vert_t& Q = verts[tri_verts[next(e)]];
+            return
+                orient(A, B, P) * orient(A, B, Q) < 0.0 &&
+                orient(P, Q, A) * orient(P, Q, B) < 0.0;
+        }
+
+        // flips the channel edges until s0-s1 is an edge (Sloan's method),
+        // then restores the Delaunay property around the new edges.
+        void recover_edge(int s0, int s1, std::vector<int>& queue)
+        {
+            const vert_t& A = verts[s0];
+            const vert_t& B = verts[s1];
+            std::vector<int> created;
+            int budget = 16 * (int)queue.size() * (int)queue.size() + 64;
+
+            std::size_t head = 0;
+            while (head < queue.size() && budget-- > 0)
+            {
+                int e = queue[head++];
+                if (!crosses(e, A, B))
+                    continue;
+
+                if (!flippable(e))
+                {
+                    queue.push_back(e);
+                    continue;
+                }
+
+                int b = twins[e];
+                int ar = prev(e), bl = prev(b);
+                int d = flip(e);
+
+                // keep pending indices pointing at the same edges
+                auto remap = [&](int& x) {
+                    if (x == bl) x = e;
+                    else if (x == ar) x = b;
+                };
+                for (std::size_t i = head; i < queue.size(); ++i)
+                    remap(queue[i]);
+                for (auto& x : created)
+                    remap(x);
+
+                if (crosses(d, A, B))
+                    queue.push_back(d);
+                else
+                    created.push_back(d);
+            }
+
+            // mark the recovered edge
+            int h = outgoing_edge(s0);
+            int start = h;
+            for (int i = 0; h != NONE && i < 1024; ++i)
+            {
+                if (tri_verts[next(h)] == s1)
+                {
+                    set_constrained(h);
+                    break;
+                }
+                if (tri_verts[prev(h)] == s1)
+                {
+                    set_constrained(prev(h));
+                    break;
+                }
+                h = twins[prev(h)];
+                if (h == start)
+                    break;
+            }
+            if (h == NONE)
+            {
+                // hit the hull going CCW; go the other way
+                h = start;
+                for (int i = 0; h != NONE && i < 1024; ++i)
+                {
+                    if (tri_verts[next(h)] == s1) { set_constrained(h); break; }
+                    if (tri_verts[prev(h)] == s1) { set_constrained(prev(h)); break; }
+                    h = twins[h] == NONE ? NONE : next(twins[h]);
+                    if (h == start)
+                        break;
+                }
+            }
+
+            for (int e : created)
+            {
+                int x = tri_verts[e], y = tri_verts[next(e)];
+                if ((x == s0 && y == s1) || (x == s1 && y == s0))
+                    continue;
+                if (illegal(e) && flippable(e))
+                {
+                    int b = twins[e];
+                    flip(e);
+                    legalize({ e, next(e), b, next(b) });
+                }
+            }
+        }
+
+        // clips a segment to the mesh hull, returning pairs of points
+        void clip_to_hull(const vert_t& p0, const vert_t& p1, std::vector<vert_t>& out) const
+        {
+            out.clear();
+            bool in0 = inside_hull(p0), in1 = inside_hull(p1);
+
+            if (in0 && in1)
+            {
+                // may still leave and re-enter a concave hull, but the
+                // tile hull is convex for all practical purposes.
+                out.push_back(p0);
+                out.push_back(p1);
+                return;
+            }
+
+            // hull vertices count as hits, so a segment passing exactly
+            // through one is still clipped there
+            vert_t d = p1 - p0;
+            std::vector<double> params;
+            params.push_back(0.0);
+            for (auto& edge : _hull)
+            {
+                vert_t s = edge.second - edge.first;
+                double det = d.cross2d(s);
+                if (std::abs(det) <= 1e-12 * d.length2d() * s.length2d())
+                    continue;
+                vert_t diff = edge.first - p0;
+                double u = diff.cross2d(s) / det;
+                double v = diff.cross2d(d) / det;
+                if (u > 0.0 && u < 1.0 && v >= -1e-9 && v <= 1.0 + 1e-9)
+                    params.push_back(u);
+            }
+            params.push_back(1.0);
+            std::sort(params.begin(), params.end());
+
+            for (unsigned i = 0; i + 1 < params.size(); ++i)
+            {
+                if (params[i + 1] - params[i] <= 0.0)
+                    continue;
+                vert_t mid = p0 + d * (0.5 * (params[i] + params[i + 1]));
+                if (inside_hull(mid))
+                {
+                    out.push_back(p0 + d * params[i]);
+                    out.push_back(p0 + d * params[i + 1]);
+                }
+            }
+        }
+
+        // even-odd test against the hull edges
+        bool inside_hull(const vert_t& p) const
+        {
+            bool inside = false;
+            for (auto& edge : _hull)
+            {
+                const vert_t& a = edge.first;
+                const vert_t& b = edge.second;
+                if ((a.y > p.y) != (b.y > p.y))
+                {
+                    double x = a.x + (p.y - a.y) * (b.x - a.x) / (b.y - a.y);
+                    if (p.x < x)
+                        inside = !inside;
+                }
+            }
+            return inside;
+        }
+
+        // breaks a segment into pieces no longer than _max_segment_length
+        // so that terrain sampling along constraints matches the grid.
+        template<typename PENDING>
+        void subdivide(
+            const vert_t& p0, const vert_t& p1, int marker,
+            std::vector<PENDING>& pending,
+            std::vector<std::pair<int, int>>& segment_verts,
+            std::vector<int>& segment_markers) const
+        {
+            vert_t d = p1 - p0;
+            double len = d.length2d();
+            if (len <= _epsilon)
+                return;
+
+            int n = 1;
+            if (_max_segment_length > 0.0)
+                n = std::max(1, (int)std::ceil(len / _max_segment_length));
+
+            for (int i = 0; i < n; ++i)
+            {
+                int index = (int)segment_verts.size();
+                segment_verts.emplace_back(NONE, NONE);
+                segment_markers.push_back(marker);
+                pending.push_back({ p0 + d * ((double)i / (double)n), marker, index, 0, 0u });
+                pending.push_back({ p0 + d * ((double)(i + 1) / (double)n), marker, index, 1, 0u });
+            }
+        }
+    };
+}
@@ -218,6 +218,29 @@ LevelDBCacheBin::readImage(const std::string& key, const osgDB::Options* readOpt
     return read(key, ImageReader(_rw.get(), readOptions));
 }
 
+std::vector<ReadResult>
+LevelDBCacheBin::readImages(const std::vector<std::string>& keys, const osgDB::Options* readOptions)
+{
+    std::vector<ReadResult> results(keys.size());
+    if ( keys.empty() || !binValidForReading() )
+        return results;
+
+    // LevelDB has no multi-get, but reading the whole batch from one
+    // snapshot pins a single version of the database for all lookups
+    // and keeps the batch consistent against concurrent writers.
+    leveldb::ReadOptions ro;
+    ro.snapshot = _db->GetSnapshot();
+
+    ImageReader reader(_rw.get(), readOptions);
+    for (unsigned i = 0; i < keys.size(); ++i)
+    {
+        results[i] = read(keys[i], reader, ro);
+    }
+
+    _db->ReleaseSnapshot(ro.snapshot);
+    return results;
+}
+
 ReadResult
 LevelDBCacheBin::readObject(const std::string& key, const osgDB::Options* readOptions)
 {
@@ -233,6 +256,12 @@ LevelDBCacheBin::readNode(const std::string& key, const osgDB::Options* readOpti
 
 ReadResult
 LevelDBCacheBin::read(const std::string& key, const Reader& reader)
+{
+    return read(key, reader, leveldb::ReadOptions());
+}
+
+ReadResult
+LevelDBCacheBin::read(const std::string& key, const Reader& reader, const leveldb::ReadOptions& ro)
 {
     if ( !binValidForReading() ) 
         return ReadResult(ReadResult::RESULT_NOT_FOUND);
@@ -241,7 +270,6 @@ LevelDBCacheBin::read(const std::string& key, const Reader& reader)
 
     Config metadata;
     leveldb::Status status;
-    leveldb::ReadOptions ro;
 
     // first read the metadata record.
     std::string metavalue;
@@ -14,6 +14,7 @@
 #include <rocksdb/cache.h>
 #include <rocksdb/filter_policy.h>
 #include <rocksdb/table.h>
+#include <rocksdb/write_batch.h>
 #include <sys/stat.h>
 #ifndef _WIN32
 #   include <unistd.h>
@@ -23,7 +24,17 @@
 
 #define OSGEARTH_ENV_CACHE_MAX_SIZE_MB "OSGEARTH_CACHE_MAX_SIZE_MB"
 
-#define ROCKSDB_CACHE_VERSION 1
+#define ROCKSDB_CACHE_VERSION 2
+
+// global records (outside of any bin)
+#define GLOBAL_VERSION_KEY "g!version"
+#define GLOBAL_EPOCH_KEY   "g!epoch"
+
+// legacy (version 1) key prefixes
+#define LEGACY_DATA_PREFIX "d!"
+#define LEGACY_META_PREFIX "m!"
+#define LEGACY_TIME_PREFIX "t!"
+#define LEGACY_TIME_FIELD  "rocksdb.time"
 
 using namespace osgEarth;
 using namespace osgEarth::RocksDBCache;
@@ -32,7 +43,8 @@ using namespace osgEarth::RocksDBCache;
 RocksDBCacheImpl::RocksDBCacheImpl( const CacheOptions& options ) :
 osgEarth::Cache( options ),
 _options       ( options ),
-_active        ( true )
+_active        ( true ),
+_db            ( nullptr )
 {
     // Force OSG to initialize the image wrapper. Failure to do this can result
     // in a race condition within OSG when the cache is accessed from multiple threads.
@@ -141,10 +153,19 @@ RocksDBCacheImpl::open()
     options.stats_dump_period_sec = 30;
 
 	table_options.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10));
+    table_options.whole_key_filtering = true;
     table_options.block_size = _options.blockSize().value();
 	table_options.block_cache = rocksdb::NewLRUCache(_options.blockCacheSize().value());
     options.table_factory.reset( NewBlockBasedTableFactory( table_options ) );
 
+    // Record keys are prefixed by bin, so each bin gets its own prefix
+    // bloom filter in addition to the whole-key filter:
+    options.prefix_extractor.reset(new BinPrefixExtractor());
+
+    // Size-limited caches purge by age during compaction:
+    _purgeFilter.reset(new PurgeFilter(_tracker.get()));
+    options.compaction_filter = _purgeFilter.get();
+
 	if (_options.logPath().isSet())
 		options.db_log_dir = _options.logPath().value();
 
@@ -159,7 +180,10 @@ RocksDBCacheImpl::open()
         
     status = rocksdb::DB::Open(options, _rootPath, &_db);
     if ( status.ok() )
+    {
+        initRecords();
         return;
+    }
 
     OE_WARN << LC << "Database problem...attempting to repair..." << std::endl;
     status = rocksdb::RepairDB(_rootPath, options);
@@ -169,6 +193,7 @@ RocksDBCacheImpl::open()
         if ( status.ok() )
         {
             OE_WARN << LC << "...repair complete!" << std::endl;
+            initRecords();
             return;
         }
     }
@@ -182,6 +207,118 @@ RocksDBCacheImpl::open()
     }
 }
 
+void
+RocksDBCacheImpl::initRecords()
+{
+    rocksdb::ReadOptions ro;
+    std::string value;
+
+    if ( !_db->Get(ro, GLOBAL_VERSION_KEY, &value).ok() )
+    {
+        // Either a brand new cache, or one written in the legacy layout.
+        TimeStamp epoch = DateTime().asTimeStamp();
+
+        ro.total_order_seek = true;
+        std::unique_ptr<rocksdb::Iterator> it(_db->NewIterator(ro));
+        it->Seek(LEGACY_DATA_PREFIX);
+        bool legacy = it->Valid() && it->key().starts_with(LEGACY_DATA_PREFIX);
+        it.reset();
+
+        if ( legacy )
+        {
+            if ( _options.migrate() == false )
+            {
+                OE_WARN << LC << "Cache at \"" << _rootPath << "\" uses an old layout; "
+                    << "existing records will be ignored. Run \"osgearth_cache --migrate " << _rootPath
+                    << "\" or set migrate=true to convert it." << std::endl;
+            }
+            else
+            {
+                OE_INFO << LC << "Migrating cache at \"" << _rootPath << "\" to the current layout..." << std::endl;
+                unsigned count = migrate();
+                OE_INFO << LC << "...migrated " << count << " record(s)" << std::endl;
+                epoch = _tracker->epoch();
+            }
+        }
+
+        _db->Put(rocksdb::WriteOptions(), GLOBAL_EPOCH_KEY, std::to_string(epoch));
+        _db->Put(rocksdb::WriteOptions(), GLOBAL_VERSION_KEY, std::to_string(ROCKSDB_CACHE_VERSION));
+    }
+
+    if ( _db->Get(rocksdb::ReadOptions(), GLOBAL_EPOCH_KEY, &value).ok() )
+    {
+        _tracker->setEpoch(as<TimeStamp>(value, 0));
+    }
+
+    if ( _db->Get(rocksdb::ReadOptions(), GLOBAL_PURGE_KEY, &value).ok() )
+    {
+        _tracker->setPurgeCutoff(as<TimeStamp>(value, 0));
+    }
+}
+
+unsigned
+RocksDBCacheImpl::migrate()
+{
+    rocksdb::ReadOptions ro;
+    ro.total_order_seek = true;
+    rocksdb::WriteOptions wo;
+
+    const std::string dataBegin(LEGACY_DATA_PREFIX);
+    TimeStamp now = DateTime().asTimeStamp();
+    TimeStamp oldest = now;
+    unsigned count = 0;
+    rocksdb::WriteBatch batch;
+
+    std::unique_ptr<rocksdb::Iterator> it(_db->NewIterator(ro));
+    for(it->Seek(dataBegin); it->Valid() && it->key().starts_with(dataBegin); it->Next())
+    {
+        // legacy keys are "d!<bin>!<key>"; the tuple carries over as-is
+        std::string tuple = it->key().ToString().substr(dataBegin.length());
+
+        TimeStamp t = now;
+        std::string meta;
+        std::string metakey = LEGACY_META_PREFIX + tuple;
+        std::string metavalue;
+        if ( _db->Get(ro, metakey, &metavalue).ok() )
+        {
+            Config conf;
+            conf.fromJSON(metavalue);
+            if ( conf.hasValue(LEGACY_TIME_FIELD) )
+                t = DateTime(conf.value(LEGACY_TIME_FIELD)).asTimeStamp();
+            conf.remove(LEGACY_TIME_FIELD);
+            if ( !conf.empty() )
+                meta = conf.toJSON(false);
+            batch.Delete(metakey);
+        }
+
+        // data is copied verbatim, so obfuscated caches stay obfuscated
+        std::string value;
+        Record::encode(t, meta, it->value().ToString(), value);
+        batch.Put("r!" + tuple, value);
+        batch.Delete(it->key());
+
+        oldest = std::min(oldest, t);
+
+        if ( (++count % 1000) == 0 )
+        {
+            _db->Write(wo, &batch);
+            batch.Clear();
+        }
+    }
+    it.reset();
+    _db->Write(wo, &batch);
+
+    // the time index is no longer needed; purging is age-based now.
+    _db->DeleteRange(wo, _db->DefaultColumnFamily(), LEGACY_TIME_PREFIX, LEGACY_TIME_PREFIX "\xff");
+
+    _tracker->setEpoch(oldest);
+
+    // reclaim the space held by the old records.
+    _db->CompactRange({}, nullptr, nullptr);
+
+    return count;
+}
+
 CacheBin*
 RocksDBCacheImpl::addBin( const std::string& name )
 {
@@ -234,10 +371,15 @@ RocksDBCacheImpl::clear()
     // No WriteBatch because it doesn't seem to allow compaction to occur
     // -- need to figure out why someday.
 
-    rocksdb::Iterator* it = _db->NewIterator(rocksdb::ReadOptions());
+    // Scan the whole key space, not just one prefix:
+    rocksdb::ReadOptions ro;
+    ro.total_order_seek = true;
+
+    std::unique_ptr<rocksdb::Iterator> it(_db->NewIterator(ro));
     for(it->SeekToFirst(); it->Valid(); it->Next())
     {
-        _db->Delete(rocksdb::WriteOptions(), it->key());
+        if ( !it->key().starts_with("g!") )
+            _db->Delete(rocksdb::WriteOptions(), it->key());
     }
 
     return true;
@@ -3,11 +3,13 @@
  * MIT License
  */
 #include "RocksDBCacheBin"
+#include "Record"
 #include <osgEarth/Cache>
 #include <osgEarth/Registry>
 #include <osgEarth/Random>
 #include <osgDB/Registry>
-#include <rocksdb/write_batch.h>
+#include <algorithm>
+#include <memory>
 #include <string>
 
 using namespace osgEarth;
@@ -62,7 +64,10 @@ namespace
 #undef  OE_TEST
 #define OE_TEST OE_NOTICE
 
-#define TIME_FIELD "rocksdb.time"
+// records touched more recently than this are not re-stamped on read
+#define TOUCH_INTERVAL_SECONDS 300
+
+#define JOB_POOL "oe.rocksdb"
 
 
 RocksDBCacheBin::RocksDBCacheBin(const std::string& binID,
@@ -111,17 +116,11 @@ RocksDBCacheBin::binValidForWriting(bool silent)
 std::string
 RocksDBCacheBin::getHashedKey(const std::string& key) const
 {
-    return dataKey(key);
+    return recordKey(key);
 }
 
 #define SEP std::string("!")
 
-std::string
-RocksDBCacheBin::binPhrase() const
-{
-    return SEP + getID() + SEP;
-}
-
 std::string
 RocksDBCacheBin::binKey() const
 {
@@ -129,134 +128,115 @@ RocksDBCacheBin::binKey() const
 }
 
 std::string
-RocksDBCacheBin::dataKey(const std::string& key) const
+RocksDBCacheBin::recordKey(const std::string& key) const
 {
-    return "d" + SEP + binDataKeyTuple(key);
+    return "r" + SEP + getID() + SEP + key;
 }
 
 std::string
-RocksDBCacheBin::binDataKeyTuple(const std::string& key) const
+RocksDBCacheBin::recordBegin() const
 {
-    return getID() + SEP + key;
+    return "r" + SEP + getID() + SEP;
 }
 
 std::string
-RocksDBCacheBin::dataKeyFromTuple(const std::string& tuple) const
+RocksDBCacheBin::recordEnd() const
 {
-    return "d" + SEP + tuple;
+    return "r" + SEP + getID() + SEP + "\xff";
 }
 
-std::string
-RocksDBCacheBin::dataBegin() const
+ReadResult
+RocksDBCacheBin::readImage(const std::string& key, const osgDB::Options* readOptions)
 {
-    return "d" + SEP + getID() + SEP;
+    return read(key, ImageReader(_rw.get(), readOptions));  
 }
 
-std::string
-RocksDBCacheBin::dataEnd() const
+std::vector<ReadResult>
+RocksDBCacheBin::readImages(const std::vector<std::string>& keys, const osgDB::Options* readOptions)
 {
-    return "d" + SEP + getID() + SEP + "\xff";
+    std::vector<ReadResult> results;
+    read(keys, ImageReader(_rw.get(), readOptions), results);
+    return results;
 }
 
-std::string
-RocksDBCacheBin::metaKey(const std::string& key) const
+ReadResult
+RocksDBCacheBin::readObject(const std::string& key, const osgDB::Options* readOptions)
 {
-    return "m" + SEP + binDataKeyTuple(key);
+    //OE_INFO << LC << "Read attempt: " << key << " from " << getID() << std::endl;
+    return read(key, ObjectReader(_rw.get(), readOptions));
 }
 
-std::string
-RocksDBCacheBin::metaKeyFromTuple(const std::string& tuple) const
+ReadResult
+RocksDBCacheBin::read(const std::string& key, const Reader& reader)
 {
-    return "m" + SEP + tuple;
-}
+    if ( !binValidForReading() ) 
+        return ReadResult(ReadResult::RESULT_NOT_FOUND);
 
-std::string
-RocksDBCacheBin::metaBegin() const
-{
-    return "m" + SEP + getID() + SEP;
-}
+    ++_tracker->reads;
 
-std::string
-RocksDBCacheBin::metaEnd() const
-{
-    return "m" + SEP + getID() + SEP + "\xff";
-}
+    // data and metadata live in the same record, so this is
+    // the only lookup we need.
+    rocksdb::PinnableSlice value;
+    rocksdb::Status status = _db->Get(
+        rocksdb::ReadOptions(), _db->DefaultColumnFamily(), recordKey(key), &value);
 
-std::string
-RocksDBCacheBin::timeKey(const DateTime& t, const std::string& key) const
-{
-    return "t" + SEP + t.asCompactISO8601() + SEP + getID() + SEP + key;
-}
+    if ( !status.ok() )
+    {
+        return ReadResult(ReadResult::RESULT_NOT_FOUND);
+    }
 
-std::string
-RocksDBCacheBin::timeBegin() const
-{
-    return "t" + SEP + getID() + SEP;
+    return decode(key, value, reader);
 }
 
-std::string
-RocksDBCacheBin::timeEnd() const
+void
+RocksDBCacheBin::read(const std::vector<std::string>& keys, const Reader& reader, std::vector<ReadResult>& out)
 {
-    return "t" + SEP + getID() + SEP + "\xff";
-}
+    out.clear();
+    out.resize(keys.size(), ReadResult(ReadResult::RESULT_NOT_FOUND));
 
-std::string
-RocksDBCacheBin::timeBeginGlobal() const
-{
-    return "t" + SEP;
-}
+    if ( keys.empty() || !binValidForReading() )
+        return;
 
-std::string
-RocksDBCacheBin::timeEndGlobal() const
-{
-    return "t" + SEP + "\xff";
-}
+    _tracker->reads += keys.size();
 
-ReadResult
-RocksDBCacheBin::readImage(const std::string& key, const osgDB::Options* readOptions)
-{
-    return read(key, ImageReader(_rw.get(), readOptions));  
-}
+    std::vector<std::string> recordKeys;
+    recordKeys.reserve(keys.size());
+    for (auto& key : keys)
+        recordKeys.emplace_back(recordKey(key));
 
-ReadResult
-RocksDBCacheBin::readObject(const std::string& key, const osgDB::Options* readOptions)
-{
-    //OE_INFO << LC << "Read attempt: " << key << " from " << getID() << std::endl;
-    return read(key, ObjectReader(_rw.get(), readOptions));
+    std::vector<rocksdb::Slice> slices(recordKeys.begin(), recordKeys.end());
+    std::vector<rocksdb::PinnableSlice> values(keys.size());
+    std::vector<rocksdb::Status> statuses(keys.size());
+
+    rocksdb::ReadOptions ro;
+    _db->MultiGet(ro, _db->DefaultColumnFamily(), keys.size(),
+        slices.data(), values.data(), statuses.data(), false);
+
+    for (unsigned i = 0; i < keys.size(); ++i)
+    {
+        if (statuses[i].ok())
+        {
+            out[i] = decode(keys[i], values[i], reader);
+        }
+    }
 }
 
 ReadResult
-RocksDBCacheBin::read(const std::string& key, const Reader& reader)
+RocksDBCacheBin::decode(const std::string& key, const rocksdb::Slice& value, const Reader& reader)
 {
-    if ( !binValidForReading() ) 
-        return ReadResult(ReadResult::RESULT_NOT_FOUND);
-
-    ++_tracker->reads;
+    TimeStamp lastModified;
+    rocksdb::Slice metaSlice, dataSlice;
+    if ( !Record::decode(value, lastModified, metaSlice, dataSlice) )
+    {
+        OE_WARN << LC << "Bin " << getID() << ": unrecognized record format for (" << key << ")\n";
+        return ReadResult(ReadResult::RESULT_READER_ERROR);
+    }
 
     Config metadata;
-    rocksdb::Status status;
-    rocksdb::ReadOptions ro;
+    if ( !metaSlice.empty() )
+        decodeMeta(metaSlice.ToString(), metadata);
 
-    // first read the metadata record.
-    std::string metavalue;
-    status = _db->Get( ro, metaKey(key), &metavalue );
-    TimeStamp lastModified = (TimeStamp)0;
-    if ( status.ok() )
-    {        
-        decodeMeta(metavalue, metadata);
-        DateTime t( metadata.value(TIME_FIELD));
-        lastModified = t.asTimeStamp();
-    }
-        
-    // next read the data record.
-    std::string datakey = dataKey(key);
-    std::string datavalue;
-    status = _db->Get( ro, datakey, &datavalue );
-    if ( !status.ok() )
-    {
-        // main record not found for some reason.
-        return ReadResult(ReadResult::RESULT_NOT_FOUND);
-    }
+    std::string datavalue = dataSlice.ToString();
 
     // blend the data string
     if ( _tracker->seed().isSet() )
@@ -270,7 +250,6 @@ RocksDBCacheBin::read(const std::string& key, const Reader& reader)
         OE_WARN << LC << "Cache read failure!"
             << "\n reader = " << reader.name()
             << "\n error detail = " << r.message()
-            << "\n data value = " << datavalue
             << "\n";
 
         return ReadResult(ReadResult::RESULT_READER_ERROR);
@@ -281,12 +260,12 @@ RocksDBCacheBin::read(const std::string& key, const Reader& reader)
         OE_NOTICE << LC << "Bin " << getID() << ": read (" << key << ")\n";
     }
 
-    // if there's a size limit, we need to 'touch' the record.
+    // if there's a size limit, we need to 'touch' the record so the
+    // purge sees it as recently used. We already have the record in hand
+    // so there's no need to look it up again.
     if ( _tracker->hasSizeLimit() )
     {
-        // Room for optimization here since we already have the 
-        // meta/time records around.
-        touch( key );
+        touch( key, value );
     }
 
     ++_tracker->hits;
@@ -357,25 +336,19 @@ RocksDBCacheBin::write(const std::string& key, const osg::Object* object, const
 
     if (objWriteOK)
     {
-        DateTime now;
-        rocksdb::WriteBatch batch;
-
-        // write the data:
         data = datastream.str();
         if ( _tracker->seed().isSet() )
             blend(data, _tracker->seed().value());
-        batch.Put( dataKey(key), data );
 
-        // write the timestamp index:
-        batch.Put( timeKey(now, key), binDataKeyTuple(key) );
+        std::string metavalue;
+        if ( !meta.empty() )
+            encodeMeta( meta, metavalue );
 
-        // write the metadata:
-        Config metadata(meta);
-        metadata.set( TIME_FIELD, now.asCompactISO8601() );
-        encodeMeta( metadata, data );
-        batch.Put( metaKey(key), data );
+        // data, metadata and timestamp go out as one record:
+        std::string value;
+        Record::encode( DateTime().asTimeStamp(), metavalue, data, value );
 
-        objWriteOK = _db->Write( rocksdb::WriteOptions(), &batch ).ok();
+        objWriteOK = _db->Put( rocksdb::WriteOptions(), recordKey(key), value ).ok();
 
         if ( objWriteOK )
         {
@@ -408,7 +381,7 @@ RocksDBCacheBin::postWrite()
         {
             if ( _tracker->isTimeToPurge() )
             {
-                this->purgeOldest(_tracker->numToPurge());
+                this->purgeOldest();
 
                 if (_debug)
                 {
@@ -438,23 +411,56 @@ RocksDBCacheBin::postWrite()
 CacheBin::RecordStatus
 RocksDBCacheBin::getRecordStatus(const std::string& key)
 {
-    if ( !binValidForReading() ) 
-        return STATUS_NOT_FOUND;
+    return getRecordStatuses({ key }).front();
+}
 
-    rocksdb::Status status;
-    rocksdb::ReadOptions ro;
+std::vector<CacheBin::RecordStatus>
+RocksDBCacheBin::getRecordStatuses(const std::vector<std::string>& keys)
+{
+    std::vector<RecordStatus> out(keys.size(), STATUS_NOT_FOUND);
+
+    if ( keys.empty() || !binValidForReading() )
+        return out;
 
-    // read the metadata record.
-    std::string metavalue;
-    status = _db->Get( ro, metaKey(key), &metavalue );
-    if ( status.ok() )
-    {        
-        return STATUS_OK;
+    // let the bloom filters weed out the misses. A key that's already in
+    // memory is confirmed on the spot; the rest need a lookup.
+    std::vector<std::pair<std::string, unsigned>> candidates;
+    candidates.reserve(keys.size());
+
+    std::string unused;
+    for (unsigned i = 0; i < keys.size(); ++i)
+    {
+        std::string k = recordKey(keys[i]);
+        bool inMemory = false;
+        if ( _db->KeyMayExist(rocksdb::ReadOptions(), _db->DefaultColumnFamily(), k, &unused, &inMemory) )
+        {
+            if ( inMemory )
+                out[i] = STATUS_OK;
+            else
+                candidates.emplace_back(std::move(k), i);
+        }
     }
-    else
+
+    if ( candidates.empty() )
+        return out;
+
+    // confirm the candidates by key alone: seek a single iterator through
+    // them in order and never touch the values, which can be large. Don't
+    // let the check push useful blocks out of the cache either.
+    std::sort(candidates.begin(), candidates.end());
+
+    rocksdb::ReadOptions ro;
+    ro.fill_cache = false;
+    std::unique_ptr<rocksdb::Iterator> it(_db->NewIterator(ro));
+
+    for (auto& candidate : candidates)
     {
-        return STATUS_NOT_FOUND;
+        it->Seek(candidate.first);
+        if ( it->Valid() && it->key() == candidate.first )
+            out[candidate.second] = STATUS_OK;
     }
+
+    return out;
 }
 
 bool
@@ -463,21 +469,7 @@ RocksDBCacheBin::remove(const std::string& key)
     if ( !binValidForReading() )
         return false;
 
-    // first read in the time from the metadata record.
-    std::string metavalue;
-    if ( _db->Get(rocksdb::ReadOptions(), metaKey(key), &metavalue).ok() == false )
-        return false;
-
-    Config metadata;
-    decodeMeta(metavalue, metadata);
-    DateTime t(metadata.value(TIME_FIELD));
-
-    rocksdb::WriteBatch batch;
-    batch.Delete( dataKey(key) );
-    batch.Delete( metaKey(key) );
-    batch.Delete( timeKey(t, key) );
-        
-    rocksdb::Status status = _db->Write(rocksdb::WriteOptions(), &batch);
+    rocksdb::Status status = _db->Delete(rocksdb::WriteOptions(), recordKey(key));
     if ( !status.ok() )
     {
         OE_WARN << LC << "Failed to remove (" << key << ") from bin " << getID() << std::endl;
@@ -497,30 +489,26 @@ RocksDBCacheBin::touch(const std::string& key)
     if ( !binValidForWriting() )
         return false;
 
-    // first read in the time from the metadata record.
-    std::string metavalue;
-    if ( _db->Get(rocksdb::ReadOptions(), metaKey(key), &metavalue).ok() == false )
+    std::string value;
+    if ( _db->Get(rocksdb::ReadOptions(), recordKey(key), &value).ok() == false )
         return false;
 
-    Config metadata;
-    decodeMeta(metavalue, metadata);
-    DateTime oldtime(metadata.value(TIME_FIELD));
-        
-    rocksdb::WriteBatch batch;
-
-    // In a transaction, update the metadata record with the current time.
-    std::string newtime = DateTime().asCompactISO8601();
-    metadata.set(TIME_FIELD, newtime);
-    encodeMeta(metadata, metavalue);
-    batch.Put(metaKey(key), metavalue);
+    touch(key, value);
+    return true;
+}
 
-    // ...remove the old time index record:
-    batch.Delete( timeKey(oldtime, key) );
+void
+RocksDBCacheBin::touch(const std::string& key, const rocksdb::Slice& value)
+{
+    TimeStamp now = DateTime().asTimeStamp();
+    TimeStamp then;
+    if ( !Record::readTime(value, then) || now - then < TOUCH_INTERVAL_SECONDS )
+        return;
 
-    // ...and write a new time index record.
-    batch.Put( timeKey(newtime, key), binDataKeyTuple(key) );
+    std::string newvalue = value.ToString();
+    Record::writeTime(newvalue, now);
 
-    rocksdb::Status status = _db->Write(rocksdb::WriteOptions(), &batch);
+    rocksdb::Status status = _db->Put(rocksdb::WriteOptions(), recordKey(key), newvalue);
     if ( !status.ok() )
     {
         OE_WARN << LC << "Failed to touch (" << key << ") in bin " << getID() << std::endl;
@@ -529,7 +517,6 @@ RocksDBCacheBin::touch(const std::string& key)
     {
         OE_NOTICE << LC << "Bin " << getID() << ": touch (" << key << ")\n";
     }
-    return status.ok();
 }
 
 bool
@@ -538,19 +525,14 @@ RocksDBCacheBin::clear()
     if ( !binValidForWriting() )
         return false;
     
-    rocksdb::WriteOptions wo;
-    std::string binphrase = binPhrase();
-    rocksdb::WriteBatch batch;
-    rocksdb::Iterator* i = _db->NewIterator(rocksdb::ReadOptions());
-    for(i->SeekToFirst(); i->Valid(); i->Next())
+    rocksdb::Status status = _db->DeleteRange(
+        rocksdb::WriteOptions(), _db->DefaultColumnFamily(), recordBegin(), recordEnd());
+
+    if ( !status.ok() )
     {
-        std::string key = i->key().ToString();
-        if ( key.find(binphrase) != std::string::npos )
-        {
-            _db->Delete( wo, i->key() );
-        }
+        OE_WARN << LC << "Failed to clear bin " << getID() << std::endl;
+        return false;
     }
-    delete i;
 
     if ( _debug )
     {
@@ -567,9 +549,9 @@ RocksDBCacheBin::compact()
         return false;
 
     // This could take a while.
-    _db->CompactRange({}, nullptr, nullptr);
-
-    return false;
+    std::string begin = recordBegin(), end = recordEnd();
+    rocksdb::Slice b(begin), e(end);
+    return _db->CompactRange({}, &b, &e).ok();
 }
 
 unsigned
@@ -578,17 +560,12 @@ RocksDBCacheBin::getStorageSize()
     if ( !binValidForReading() )
         return false;
 
-    //Note: doesn't work..
-    rocksdb::Range ranges[3];
-    uint64_t       sizes[3];
+    std::string begin = recordBegin(), end = recordEnd();
+    rocksdb::Range range(begin, end);
+    uint64_t size = 0;
 
-    ranges[0] = rocksdb::Range(dataBegin(), dataEnd());
-    ranges[1] = rocksdb::Range(metaBegin(), metaEnd());
-    ranges[2] = rocksdb::Range(timeBegin(), timeEnd());
-    sizes[0] = sizes[1] = sizes[2] = 0;
-
-    _db->GetApproximateSizes( ranges, 3, sizes );
-    return sizes[0] + sizes[1] + sizes[2];
+    _db->GetApproximateSizes( &range, 1, &size );
+    return size;
 }
 
 Config
@@ -634,41 +611,49 @@ RocksDBCacheBin::writeMetadata(const Config& conf)
 }
 
 bool
-RocksDBCacheBin::purgeOldest(unsigned maxnum)
+RocksDBCacheBin::purgeOldest()
 {
     if ( !binValidForWriting() )
         return false;
 
-    rocksdb::Iterator* it = _db->NewIterator(rocksdb::ReadOptions());
+    // Instead of walking a time index, raise the age cutoff and let the
+    // compaction filter drop everything older. The compaction runs in the
+    // background so the writer that tripped the size limit doesn't stall.
+    // Like the old time index, this affects records of ALL bins.
+    if ( !_tracker->beginCompaction() )
+        return true;
 
-    unsigned count = 0;
-    std::string limit = timeEndGlobal();
+    TimeStamp cutoff = _tracker->advancePurgeCutoff();
 
-    // note: this will delete records NOT OF THIS BIN as well!
-    for(it->Seek(timeBeginGlobal());
-        count < maxnum && it->Valid() && it->key().ToString() < limit;
-        it->Next(), ++count )
+    // persist the cutoff so a restarted process keeps purging from here
+    // instead of starting over at the epoch
+    if ( !_db->Put(rocksdb::WriteOptions(), GLOBAL_PURGE_KEY, std::to_string(cutoff)).ok() )
     {
-        if ( !it->status().ok() )
-            break;
+        OE_WARN << LC << "Failed to store the purge cutoff" << std::endl;
+    }
 
-        std::string tuple = it->value().ToString();
+    rocksdb::DB* db = _db;
+    osg::ref_ptr<Tracker> tracker = _tracker;
+    bool debug = _debug;
 
-        // doing this in a WriteBatch did not work. The size of the
-        // database would never go down.
-        rocksdb::WriteOptions wo;
-        _db->Delete( wo, dataKeyFromTuple(tuple) );
-        _db->Delete( wo, metaKeyFromTuple(tuple) );
-        _db->Delete( wo, it->key() );
-    }
+    jobs::dispatch([db, tracker, cutoff, debug]()
+        {
+            std::string begin = "r" + SEP, end = "r" + SEP + "\xff";
+            rocksdb::Slice b(begin), e(end);
+            rocksdb::CompactRangeOptions options;
+            options.bottommost_level_compaction = rocksdb::BottommostLevelCompaction::kForce;
+            db->CompactRange(options, &b, &e);
 
-    delete it;
+            off_t size = tracker->calcSize();
+            tracker->endCompaction();
 
-    if ( _debug )
-    {
-        OE_NOTICE << LC << "Purged " << count << " record(s) for "
-            << (_tracker->calcSize()/1048576) << " MB" << std::endl;
-    }
+            if ( debug )
+            {
+                OE_NOTICE << LC << "Purged records older than " << DateTime(cutoff).asRFC1123()
+                    << "; cache size = " << (size/1048576) << " MB" << std::endl;
+            }
+        },
+        jobs::context{ "RocksDB purge", jobs::get_pool(JOB_POOL) });
 
     return true;
 }
@@ -11,6 +11,7 @@
 #include "TerrainCuller"
 
 #include <osgEarth/TerrainTileModel>
+#include <osgEarth/TerrainEngineNode>
 #include <osgEarth/CullingUtils>
 #include <osgEarth/ImageUtils>
 #include <osgEarth/Metrics>
@@ -673,10 +674,49 @@ TileNode::createChildren()
                     osg::ref_ptr<TileNode> tile;
                     if (tile_weakptr.lock(tile) && !state.canceled())
                     {
+                        std::vector<TileKey> childkeys(4);
                         for (unsigned q = 0; q < 4; ++q)
                         {
-                            auto childkey = tile->getKey().createChildKey(q);
-                            result[q] = tile->createChild(childkey, &state);
+                            childkeys[q] = tile->getKey().createChildKey(q);
+                            result[q] = tile->createChild(childkeys[q], &state);
+                        }
+
+                        // Fetch the children's layer data as one batch per layer;
+                        // each child's data load will pick up its share. This runs
+                        // in its own job so the children publish without waiting.
+                        osg::ref_ptr<TerrainEngineNode> engine = context->getEngine();
+                        osg::ref_ptr<const Map> map = context->getMap();
+                        if (engine.valid() && map.valid() && !state.canceled())
+                        {
+                            std::vector<osg::observer_ptr<TileNode>> children(result.begin(), result.end());
+
+                            // Moot once the parent or a child goes away, or a child
+                            // dispatches its own data load and reads its own images
+                            auto superseded = [tile_weakptr, children]()
+                                {
+                                    if (!tile_weakptr.valid())
+                                        return true;
+                                    for (auto& child_weakptr : children)
+                                    {
+                                        osg::ref_ptr<TileNode> child;
+                                        if (!child_weakptr.lock(child) || child->isLoadIssued())
+                                            return true;
+                                    }
+                                    return false;
+                                };
+
+                            auto prefetch = [engine, map, childkeys, superseded]()
+                                {
+                                    if (superseded())
+                                        return;
+
+                                    osg::ref_ptr<ProgressCallback> progress = new ProgressCallback(nullptr, superseded);
+                                    engine->prefetchTileModels(map.get(), childkeys, CreateTileManifest(), progress.get());
+                                };
+
+                            jobs::context pc{ tile->getKey().str() + " prefetch" };
+                            pc.pool = jobs::get_pool(ARENA_LOAD_TILE);
+                            jobs::dispatch(prefetch, pc);
                         }
                     }
 
@@ -1308,6 +1348,7 @@ TileNode::load(TerrainCuller* culler)
         {
             // Actually this means that the task has not yet been dispatched,
             // so assign the priority and do it now.
+            _loadIssued = true;
             op->dispatch();
         }
 
@@ -1333,6 +1374,7 @@ TileNode::loadSync()
         std::make_shared<LoadTileDataOperation>(this, _context.get());
 
     loadTileData->setEnableCancelation(false);
+    _loadIssued = true;
     loadTileData->dispatch(false);
     loadTileData->merge();
 }
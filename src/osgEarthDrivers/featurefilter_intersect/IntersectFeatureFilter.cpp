@@ -14,6 +14,7 @@
 #include <osgEarth/FilterContext>
 
 #include <osgEarth/Geometry>
+#include <osgEarth/SpatialJoin>
 
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
@@ -30,6 +31,7 @@ class IntersectFeatureFilter : public FeatureFilter, public IntersectFeatureFilt
 private:
     osg::ref_ptr< FeatureSource > _featureSource;
     osg::ref_ptr< const osgDB::Options > _readOptions;
+    Util::SpatialJoinCache _joins;
 
 public:
     IntersectFeatureFilter(const ConfigOptions& options)
@@ -62,38 +64,20 @@ public: // FeatureFilter
         }
     }
 
-    /**
-     * Gets all the features that intersect the extent
-     */
-    void getFeatures(const GeoExtent& extent, FeatureList& features, ProgressCallback* progress)
-    {
-        GeoExtent localExtent = extent.transform( _featureSource->getFeatureProfile()->getSRS() );
-        Query query;
-        query.bounds() = localExtent.bounds();
-        if (localExtent.intersects( _featureSource->getFeatureProfile()->getExtent()))
-        {
-            osg::ref_ptr< FeatureCursor > cursor = _featureSource->createFeatureCursor(query, {}, nullptr, progress);
-            if (cursor)
-            {
-                cursor->fill( features );
-            }
-        }     
-    }
-
     FilterContext push(FeatureList& input, FilterContext& context)
     {       
         if (_featureSource.valid())
         {
             osg::ref_ptr<ProgressCallback> progress = new ProgressCallback();
 
-            // Get any features that intersect this query.
-            FeatureList boundaries;
-            getFeatures(context.extent().get(), boundaries, progress.get());
+            // Spatial index of the boundaries that intersect this query,
+            // already transformed into the coordinate system of the features
+            auto join = _joins.get(_featureSource.get(), context.extent().get(), context.profile()->getSRS(), progress.get());
                         
             // The list of output features
             FeatureList output;
 
-            if (boundaries.empty())
+            if (!join)
             {
                 // No intersecting features.  If contains is false, then just the output to the input.
                 if (contains() == false)
@@ -103,57 +87,45 @@ public: // FeatureFilter
             }
             else
             {
-                // Transform the boundaries into the coordinate system of the features
-                for (FeatureList::iterator itr = boundaries.begin(); itr != boundaries.end(); ++itr)
-                {
-                    itr->get()->transform( context.profile()->getSRS() );
-                }
+                // Probe the center of each feature that passes the coarsest test
+                std::vector<unsigned> probed;
+                std::vector<osg::Vec2d> centers;
+                probed.reserve(input.size());
+                centers.reserve(input.size());
+
+                const GeoExtent& sourceExtent = _featureSource->getFeatureProfile()->getExtent();
 
-                for(FeatureList::const_iterator f = input.begin(); f != input.end(); ++f)
+                for (unsigned i = 0; i < input.size(); ++i)
                 {
-                    Feature* feature = f->get();
+                    Feature* feature = input[i].get();
                     if ( feature && feature->getGeometry() )
                     {
                         osg::Vec3d c = feature->getGeometry()->getBounds().center();
 
-                        if ( contains() == true )
+                        // coarsest:
+                        if (sourceExtent.contains(GeoPoint(feature->getSRS(), c.x(), c.y())))
                         {
-                            // coarsest:
-                            if (_featureSource->getFeatureProfile()->getExtent().contains(GeoPoint(feature->getSRS(), c.x(), c.y())))
-                            {
-                                for (FeatureList::iterator itr = boundaries.begin(); itr != boundaries.end(); ++itr)
-                                {
-                                    Ring* ring = dynamic_cast< Ring*>(itr->get()->getGeometry());
-                                    if (ring && ring->contains2D(c.x(), c.y()))
-                                    {
-                                        output.push_back( feature );
-                                    }
-                                }                        
-                            }
+                            probed.push_back(i);
+                            centers.emplace_back(c.x(), c.y());
                         }
+                    }
+                }
 
-                        else
-                        {    
-                            bool contained = false;
-
-                            // coarsest:
-                            if (_featureSource->getFeatureProfile()->getExtent().contains(GeoPoint(feature->getSRS(), c.x(), c.y())))
-                            {
-                                for (FeatureList::iterator itr = boundaries.begin(); itr != boundaries.end(); ++itr)
-                                {
-                                    Ring* ring = dynamic_cast< Ring*>(itr->get()->getGeometry());
-                                    if (ring && ring->contains2D(c.x(), c.y()))
-                                    {                             
-                                        contained = true;
-                                        break;
-                                    }
-                                }
-                            }
-                            if ( !contained )
-                            {
-                                output.push_back( feature );
-                            }
-                        }
+                std::vector<int> hits;
+                join->findContaining(centers, hits);
+
+                std::vector<bool> contained(input.size(), false);
+                for (unsigned k = 0; k < probed.size(); ++k)
+                {
+                    contained[probed[k]] = (hits[k] >= 0);
+                }
+
+                for (unsigned i = 0; i < input.size(); ++i)
+                {
+                    Feature* feature = input[i].get();
+                    if ( feature && feature->getGeometry() && contained[i] == contains() )
+                    {
+                        output.push_back( feature );
                     }
                 }
             }
@@ -15,11 +15,13 @@
 #include <osgEarth/FilterContext>
 #include <osgEarth/Geometry>
 #include <osgEarth/Metrics>
+#include <osgEarth/SpatialJoin>
 
 #define LC "[Intersect FeatureFilter] "
 
 using namespace osgEarth;
 using namespace osgEarth::Drivers;
+using namespace osgEarth::Util;
 
 
 /**
@@ -46,76 +48,51 @@ public: // FeatureFilter
         return Status::OK();
     }
 
-    /**
-     * Gets all the features that intersect the extent
-     */
-    void getFeatures(const GeoExtent& extent, FeatureList& features, ProgressCallback* progress)
-    {
-        FeatureSource* fs = featureSource().getLayer();
-        if (!fs)
-            return;
-
-        OE_PROFILING_ZONE;
-
-        //TODO: should this be Profile::transformAndClampExtent instead?
-        GeoExtent extentInFeatureSRS = extent.transform( fs->getFeatureProfile()->getSRS() );
-
-        if (extentInFeatureSRS.intersects( fs->getFeatureProfile()->getExtent()))
-        {
-            Query query;
-            query.bounds() = extentInFeatureSRS.bounds();
-
-            osg::ref_ptr<FeatureCursor> cursor = fs->createFeatureCursor(query, {}, nullptr, progress);
-            if (cursor)
-            {
-                cursor->fill( features );
-            }
-        }     
-    }
-
     //! Joins the boundaries attributes into the features by doing a
     //! spatial intersection.
-    void combine(FeatureList& boundaries, FeatureList& input, FilterContext& context) const
+    void combine(const SpatialJoin& join, FeatureList& input) const
     {
         OE_PROFILING_ZONE;
-        
 
-        // Transform the boundaries into the coordinate system of the features
-        // for fast intersection testing
-        for (auto& boundary : boundaries)
-        {
-            boundary->transform(context.profile()->getSRS());
-        }
+        const FeatureList& boundaries = join.getBoundaries();
 
-        // For each feature, check for a spatial join:
-        for (auto& feature : input)
+        if (*rough())
         {
-            if (feature.valid() && feature->getGeometry())
+            osg::ref_ptr< Feature> boundary = boundaries[0].get();
+            for (auto& feature : input)
             {
-                if (*rough())
+                if (feature.valid() && feature->getGeometry())
                 {
-                    osg::ref_ptr< Feature> boundary = boundaries[0].get();
                     // Copy the attributes from the boundary to the feature (and overwrite)
                     for (const auto& attr : boundary->getAttrs())
                     {
                         feature->set(attr.first, attr.second);
                     }
                 }
-                else
+            }
+        }
+        else
+        {
+            // Find the first boundary that intersects each feature; the index
+            // only runs the exact test against boundaries whose extents overlap
+            std::vector<const Geometry*> geometries;
+            geometries.reserve(input.size());
+            for (auto& feature : input)
+            {
+                geometries.push_back(feature.valid() ? feature->getGeometry() : nullptr);
+            }
+
+            std::vector<int> hits;
+            join.findIntersecting(geometries, hits);
+
+            for (unsigned i = 0; i < input.size(); ++i)
+            {
+                if (hits[i] >= 0)
                 {
-                    for (const auto& boundary : boundaries)
+                    // Copy the attributes from the boundary to the feature (and overwrite)
+                    for (const auto& attr : boundaries[hits[i]]->getAttrs())
                     {
-                        if (boundary->getGeometry()->intersects(feature->getGeometry()))
-                        {
-                            // Copy the attributes from the boundary to the feature (and overwrite)
-                            for (const auto& attr : boundary->getAttrs())
-                            {
-                                feature->set(attr.first, attr.second);
-                            }
-
-                            // upon success, don't check any more boundaries:
-                            break;
-                        }
+                        input[i]->set(attr.first, attr.second);
                     }
                 }
             }
@@ -129,18 +106,21 @@ public: // FeatureFilter
 
         if (featureSource().getLayer())
         {
-            // Get any features that intersect this query.
-            FeatureList boundaries;
-            getFeatures(context.extent().get(), boundaries, nullptr); // TODO: progress...
+            // Get any features that intersect this query, indexed and
+            // transformed into the coordinate system of the features
+            auto join = _joins.get(featureSource().getLayer(), context.extent().get(), context.profile()->getSRS(), nullptr); // TODO: progress...
 
-            if (!boundaries.empty())
+            if (join)
             {
-                combine(boundaries, input, context);
+                combine(*join, input);
             }
         }
 
         return context;
     }
+
+private:
+    SpatialJoinCache _joins;
 };
 
 
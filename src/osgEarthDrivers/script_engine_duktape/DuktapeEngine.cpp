@@ -7,6 +7,8 @@
 #include <osgEarth/StringUtils>
 #include <osgEarth/GeometryUtils>
 #include <osgEarth/Metrics>
+#include <atomic>
+#include <cstring>
 
 #undef  LC
 #define LC "[JavaScript] "
@@ -118,6 +120,318 @@ namespace
 
 //............................................................................
 
+namespace
+{
+    // The minimal profile exposes the feature through two Proxy objects
+    // ("feature" and "feature.properties") created once per heap. Their traps
+    // read from whichever feature setFeature() last stored in the global
+    // stash, so changing features costs one pointer write instead of
+    // marshalling every attribute. Values a script assigns are kept in
+    // per-feature override objects that setFeature() discards.
+
+    enum ProxyLevel { PROXY_FEATURE = 0, PROXY_PROPERTIES = 1 };
+
+    const char* overridesName(int level)
+    {
+        return level == PROXY_FEATURE ? "oe_feature_set" : "oe_properties_set";
+    }
+
+    const Feature* currentFeature(duk_context* ctx)
+    {
+        duk_push_global_stash(ctx);                     // [stash]
+        duk_get_prop_string(ctx, -1, "oe_feature");     // [stash, ptr]
+        const Feature* feature = static_cast<const Feature*>(duk_get_pointer(ctx, -1));
+        duk_pop_2(ctx);                                 // []
+        return feature;
+    }
+
+    // Pushes the override object for a proxy level; returns false (and
+    // pushes nothing) if it does not exist and "create" is false.
+    bool pushOverrides(duk_context* ctx, int level, bool create)
+    {
+        duk_push_global_stash(ctx);                                 // [stash]
+        if (duk_get_prop_string(ctx, -1, overridesName(level)))     // [stash, obj]
+        {
+            duk_remove(ctx, -2);                                    // [obj]
+            return true;
+        }
+        duk_pop(ctx);                                               // [stash]
+
+        if (!create)
+        {
+            duk_pop(ctx);                                           // []
+            return false;
+        }
+
+        // bare, so that inherited names don't read as overrides
+        duk_push_bare_object(ctx);                                  // [stash, obj]
+        duk_dup_top(ctx);                                           // [stash, obj, obj]
+        duk_put_prop_string(ctx, -3, overridesName(level));         // [stash, obj]
+        duk_remove(ctx, -2);                                        // [obj]
+        return true;
+    }
+
+    void pushAttribute(duk_context* ctx, const AttributeValue& value)
+    {
+        switch (value.type) {
+        case ATTRTYPE_DOUBLE: duk_push_number(ctx, value.getDouble()); break;
+        case ATTRTYPE_INT:    duk_push_number(ctx, (double)value.getInt()); break;
+        case ATTRTYPE_BOOL:   duk_push_boolean(ctx, value.getBool() ? 1 : 0); break;
+        case ATTRTYPE_STRING:
+        default:              duk_push_string(ctx, value.getString().c_str()); break;
+        }
+    }
+
+    // Whether the proxy at "level" has "key" for the current feature
+    bool hasProperty(duk_context* ctx, int level, const char* key)
+    {
+        if (pushOverrides(ctx, level, false))
+        {
+            bool found = duk_has_prop_string(ctx, -1, key) != 0;
+            duk_pop(ctx);
+            if (found)
+                return true;
+        }
+
+        const Feature* feature = currentFeature(ctx);
+        if (!feature)
+            return false;
+
+        if (level == PROXY_PROPERTIES)
+            return feature->indexOf(key) >= 0;
+
+        return
+            strcmp(key, "id") == 0 ||
+            strcmp(key, "properties") == 0 ||
+            strcmp(key, "attributes") == 0 ||
+            strcmp(key, "geometry") == 0;
+    }
+
+    // get trap: (target, key, receiver)
+    duk_ret_t oe_duk_proxy_get(duk_context* ctx)
+    {
+        const int level = duk_get_current_magic(ctx);
+
+        if (duk_is_string(ctx, 1))
+        {
+            const char* key = duk_get_string(ctx, 1);
+
+            if (pushOverrides(ctx, level, false))                   // [..., obj]
+            {
+                if (duk_has_prop_string(ctx, -1, key))
+                {
+                    duk_get_prop_string(ctx, -1, key);              // [..., obj, value]
+                    return 1;
+                }
+                duk_pop(ctx);
+            }
+
+            const Feature* feature = currentFeature(ctx);
+            if (feature)
+            {
+                if (level == PROXY_PROPERTIES)
+                {
+                    int i = feature->indexOf(key);
+                    if (i >= 0)
+                    {
+                        pushAttribute(ctx, feature->getAttrs()._container[i].second);
+                        return 1;
+                    }
+                }
+                else if (strcmp(key, "id") == 0)
+                {
+                    duk_push_number(ctx, (double)feature->getFID());
+                    return 1;
+                }
+                else if (strcmp(key, "properties") == 0 || strcmp(key, "attributes") == 0)
+                {
+                    duk_push_global_stash(ctx);
+                    duk_get_prop_string(ctx, -1, "oe_properties");
+                    return 1;
+                }
+                else if (strcmp(key, "geometry") == 0)
+                {
+                    if (!feature->getGeometry())
+                    {
+                        duk_push_null(ctx);
+                        return 1;
+                    }
+                    duk_idx_t geometry_i = duk_push_object(ctx);
+                    duk_push_string(ctx, Geometry::toString(feature->getGeometry()->getComponentType()).c_str());
+                    duk_put_prop_string(ctx, geometry_i, "type");
+                    return 1;
+                }
+            }
+        }
+
+        // anything else (prototype methods, symbols) comes from the target
+        duk_dup(ctx, 1);
+        duk_get_prop(ctx, 0);
+        return 1;
+    }
+
+    // set trap: (target, key, value, receiver)
+    duk_ret_t oe_duk_proxy_set(duk_context* ctx)
+    {
+        const int level = duk_get_current_magic(ctx);
+        pushOverrides(ctx, level, true);    // [..., obj]
+        duk_dup(ctx, 1);                    // [..., obj, key]
+        duk_dup(ctx, 2);                    // [..., obj, key, value]
+        duk_put_prop(ctx, -3);              // [..., obj]
+        duk_push_true(ctx);
+        return 1;
+    }
+
+    // has trap: (target, key)
+    duk_ret_t oe_duk_proxy_has(duk_context* ctx)
+    {
+        const int level = duk_get_current_magic(ctx);
+        bool found = duk_is_string(ctx, 1) && hasProperty(ctx, level, duk_get_string(ctx, 1));
+        if (!found)
+        {
+            // inherited names only; the target's own keys are placeholders
+            // left over from the last ownKeys call
+            duk_get_prototype(ctx, 0);
+            duk_dup(ctx, 1);
+            found = duk_has_prop(ctx, -2) != 0;
+        }
+        duk_push_boolean(ctx, found ? 1 : 0);
+        return 1;
+    }
+
+    void appendKey(duk_context* ctx, duk_idx_t keys_i, duk_uarridx_t& n, const char* key)
+    {
+        duk_push_string(ctx, key);
+        duk_put_prop_index(ctx, keys_i, n++);
+    }
+
+    // ownKeys trap: (target)
+    // Duktape has no getOwnPropertyDescriptor trap and drops every key that
+    // is not an enumerable own property of the target, so each key is also
+    // defined on the target as a placeholder. Values still come from "get".
+    duk_ret_t oe_duk_proxy_keys(duk_context* ctx)
+    {
+        const int level = duk_get_current_magic(ctx);
+        duk_idx_t keys_i = duk_push_array(ctx);
+        duk_uarridx_t n = 0;
+
+        const Feature* feature = currentFeature(ctx);
+        if (feature)
+        {
+            if (level == PROXY_PROPERTIES)
+            {
+                for (auto& attr : feature->getAttrs())
+                    appendKey(ctx, keys_i, n, attr.first.c_str());
+            }
+            else
+            {
+                appendKey(ctx, keys_i, n, "id");
+                appendKey(ctx, keys_i, n, "properties");
+                appendKey(ctx, keys_i, n, "geometry");
+            }
+        }
+
+        if (pushOverrides(ctx, level, false))                // [keys, obj]
+        {
+            duk_enum(ctx, -1, DUK_ENUM_OWN_PROPERTIES_ONLY); // [keys, obj, enum]
+            while (duk_next(ctx, -1, 0))                     // [keys, obj, enum, key]
+            {
+                bool known = false;
+                const char* key = duk_get_string(ctx, -1);
+                for (duk_uarridx_t i = 0; i < n && !known; ++i)
+                {
+                    duk_get_prop_index(ctx, keys_i, i);
+                    known = strcmp(duk_get_string(ctx, -1), key) == 0;
+                    duk_pop(ctx);
+                }
+                if (known)
+                    duk_pop(ctx);
+                else
+                    duk_put_prop_index(ctx, keys_i, n++);    // [keys, obj, enum]
+            }
+            duk_pop_2(ctx);                                  // [keys]
+        }
+
+        // replace the previous placeholders with this feature's keys
+        duk_enum(ctx, 0, DUK_ENUM_OWN_PROPERTIES_ONLY);      // [keys, enum]
+        while (duk_next(ctx, -1, 0))                         // [keys, enum, key]
+        {
+            duk_del_prop(ctx, 0);                            // [keys, enum]
+        }
+        duk_pop(ctx);                                        // [keys]
+
+        for (duk_uarridx_t i = 0; i < n; ++i)
+        {
+            duk_get_prop_index(ctx, keys_i, i);              // [keys, key]
+            duk_push_undefined(ctx);                         // [keys, key, undefined]
+            duk_def_prop(ctx, 0,
+                DUK_DEFPROP_HAVE_VALUE |
+                DUK_DEFPROP_SET_WRITABLE |
+                DUK_DEFPROP_SET_ENUMERABLE |
+                DUK_DEFPROP_SET_CONFIGURABLE);               // [keys]
+        }
+        return 1;
+    }
+
+    // Proxies have no prototype of their own, so the target supplies this;
+    // without it, hasOwnProperty would only ever see the target.
+    duk_ret_t oe_duk_proxy_hasOwnProperty(duk_context* ctx)
+    {
+        const int level = duk_get_current_magic(ctx);
+        bool found = duk_is_string(ctx, 0) && hasProperty(ctx, level, duk_get_string(ctx, 0));
+        duk_push_boolean(ctx, found ? 1 : 0);
+        return 1;
+    }
+
+    void pushTrap(duk_context* ctx, duk_c_function func, duk_idx_t nargs, int level, const char* name)
+    {
+        duk_push_c_function(ctx, func, nargs);      // [handler, function]
+        duk_set_magic(ctx, -1, level);
+        duk_put_prop_string(ctx, -2, name);         // [handler]
+    }
+
+    // Pushes an empty proxy target carrying a (non-enumerable) hasOwnProperty
+    void pushTarget(duk_context* ctx, int level)
+    {
+        duk_push_object(ctx);                                   // [target]
+        duk_push_string(ctx, "hasOwnProperty");                 // [target, key]
+        duk_push_c_function(ctx, oe_duk_proxy_hasOwnProperty, 1);
+        duk_set_magic(ctx, -1, level);                          // [target, key, function]
+        duk_def_prop(ctx, -3,
+            DUK_DEFPROP_HAVE_VALUE |
+            DUK_DEFPROP_SET_WRITABLE |
+            DUK_DEFPROP_CLEAR_ENUMERABLE |
+            DUK_DEFPROP_SET_CONFIGURABLE);                      // [target]
+    }
+
+    void pushProxy(duk_context* ctx, int level)
+    {
+        pushTarget(ctx, level);                                 // [target]
+        duk_push_object(ctx);                                   // [target, handler]
+        pushTrap(ctx, oe_duk_proxy_get, 3, level, "get");
+        pushTrap(ctx, oe_duk_proxy_set, 4, level, "set");
+        pushTrap(ctx, oe_duk_proxy_has, 2, level, "has");
+        pushTrap(ctx, oe_duk_proxy_keys, 1, level, "ownKeys");
+        duk_push_proxy(ctx, 0);                                 // [proxy]
+    }
+
+    // Creates the "feature" global and its properties proxy.
+    void installFeatureProxy(duk_context* ctx)
+    {
+        duk_push_global_stash(ctx);                             // [stash]
+        pushProxy(ctx, PROXY_PROPERTIES);                       // [stash, proxy]
+        duk_put_prop_string(ctx, -2, "oe_properties");          // [stash]
+        duk_pop(ctx);                                           // []
+
+        duk_push_global_object(ctx);                            // [global]
+        pushProxy(ctx, PROXY_FEATURE);                          // [global, proxy]
+        duk_put_prop_string(ctx, -2, "feature");                // [global]
+        duk_pop(ctx);                                           // []
+    }
+}
+
+//............................................................................
+
 namespace
 {
     // Create a "feature" object in the global namespace.
@@ -152,43 +466,16 @@ namespace
             GeometryAPI::bindToFeature(ctx);
         }
 
-        // Minimal profile: ID and properties only. MUCH faster!
+        // Minimal profile: point the feature proxy at the new feature
+        // and forget anything a script assigned to the previous one.
         else
         {
-            duk_idx_t feature_i = duk_push_object(ctx);     // [global] [feature]
-            {
-                duk_push_number(ctx, feature->getFID());       // [global] [feature] [id]
-                duk_put_prop_string(ctx, feature_i, "id");  // [global] [feature]
-
-                duk_idx_t props_i = duk_push_object(ctx);   // [global] [feature] [properties]
-                {
-                    const AttributeTable& attrs = feature->getAttrs();
-                    for(AttributeTable::const_iterator a = attrs.begin(); a != attrs.end(); ++a)
-                    {
-                        AttributeType type = a->second.type;
-                        switch(type) {
-                        case ATTRTYPE_DOUBLE: duk_push_number (ctx, a->second.getDouble()); break;          // [global] [feature] [properties] [name]
-                        case ATTRTYPE_INT:    duk_push_number(ctx, (double)a->second.getInt()); break;             // [global] [feature] [properties] [name]
-                        case ATTRTYPE_BOOL:   duk_push_boolean(ctx, a->second.getBool()?1:0); break;            // [global] [feature] [properties] [name]
-#if 0
-                        case ATTRTYPE_DOUBLEARRAY: break;
-#endif
-                        case ATTRTYPE_STRING:
-                        default:              duk_push_string (ctx, a->second.getString().c_str()); break;  // [global] [feature] [properties] [name]
-                        }
-                        duk_put_prop_string(ctx, props_i, a->first.c_str()); // [global] [feature] [properties]
-                    }
-                }
-                duk_put_prop_string(ctx, feature_i, "properties"); // [global] [feature]
-
-                duk_idx_t geometry_i = duk_push_object(ctx);  // [global] [feature] [geometry]
-                {
-                    duk_push_string(ctx, Geometry::toString(feature->getGeometry()->getComponentType()).c_str()); // [global] [feature] [geometry] [type]
-                    duk_put_prop_string(ctx, geometry_i, "type"); // [global] [feature] [geometry]
-                }
-                duk_put_prop_string(ctx, feature_i, "geometry");
-            }
-            duk_put_prop_string(ctx, -2, "feature"); // [global] [feature]
+            duk_push_global_stash(ctx);                             // [global, stash]
+            duk_push_pointer(ctx, (void*)feature);                  // [global, stash, ptr]
+            duk_put_prop_string(ctx, -2, "oe_feature");             // [global, stash]
+            duk_del_prop_string(ctx, -1, overridesName(PROXY_FEATURE));
+            duk_del_prop_string(ctx, -1, overridesName(PROXY_PROPERTIES));
+            duk_pop(ctx);                                           // [global]
         }
 
         duk_pop(ctx);
@@ -286,6 +573,17 @@ DuktapeEngine::Context::initialize(const ScriptEngineOptions& options, bool comp
         }
 
         duk_pop(_ctx); // []
+
+        if ( !complete )
+        {
+            installFeatureProxy(_ctx);
+        }
+
+        // compiled scripts live here, indexed by Context::_functions
+        duk_push_global_stash(_ctx);                        // [stash]
+        duk_push_array(_ctx);                               // [stash, array]
+        duk_put_prop_string(_ctx, -2, "oe_functions");      // [stash]
+        duk_pop(_ctx);                                      // []
     }
 }
 
@@ -300,8 +598,17 @@ DuktapeEngine::Context::~Context()
 
 //............................................................................
 
+namespace
+{
+    std::atomic<unsigned> s_engineUID(0u);
+
+    // Compiled functions kept per heap before the cache starts over
+    constexpr std::size_t MAX_CACHED_FUNCTIONS = 1024u;
+}
+
 DuktapeEngine::DuktapeEngine(const ScriptEngineOptions& options) :
     ScriptEngine(options),
+    _uid(s_engineUID++),
     _options(options)
 {
     //nop
@@ -312,57 +619,79 @@ DuktapeEngine::~DuktapeEngine()
     //nop
 }
 
+DuktapeEngine::Context&
+DuktapeEngine::getContext()
+{
+    // remember this thread's context for the engine it last used, so the
+    // common case skips the lock in PerThread::get(). Engine UIDs are never
+    // reused, so a stale entry can never match.
+    struct Last {
+        unsigned uid = ~0u;
+        Context* context = nullptr;
+    };
+    thread_local Last last;
+
+    if (last.uid != _uid || last.context == nullptr)
+    {
+        last.context = &_contexts.get();
+        last.uid = _uid;
+    }
+    return *last.context;
+}
+
 bool
 DuktapeEngine::compile(Context& c, const std::string& code, ScriptResult& result)
 {
     duk_context* ctx = c._ctx;
 
-    if (code != c._bytecodeSource)
+    auto i = c._functions.find(code);
+    if (i != c._functions.end())
     {
-        c._bytecodeSource = code;
-        c._errorCount = 0u;
-
-        if (duk_pcompile_string(ctx, 0, code.c_str()) != 0) // [function|error]
-        {
-            std::string resultString = duk_safe_to_string(ctx, -1);
-            OE_WARN << LC << "Compile error: " << resultString << std::endl;
-            c._errorCount++;
-            duk_pop(ctx); // []
-            result = ScriptResult("", false, resultString); // return error.
-            return false;
-        }
-
-        duk_dump_function(ctx); // [buffer]
-        duk_size_t size;
-        void* bytecode = duk_get_buffer(ctx, 0, &size);
-        if (bytecode == nullptr)
+        if (i->second < 0)
         {
-            // error. remove the buffer and return.
-            duk_pop(ctx); // []
-            OE_WARN << LC << "Allocation error; cannot continue" << std::endl;
-            result = ScriptResult("", false, "Allocation error"); // return error
-            c._errorCount++;
+            // this code caused a previous compile error, so bail out.
+            result = ScriptResult("", false, "Script failed to compile");
             return false;
         }
 
-        if (c._bytecode) delete[] c._bytecode;
-        c._bytecode = new unsigned char[size];
-        ::memcpy(c._bytecode, (unsigned char*)bytecode, size);
-        c._bytecodeSize = size;
+        duk_push_global_stash(ctx);                     // [stash]
+        duk_get_prop_string(ctx, -1, "oe_functions");   // [stash, array]
+        duk_get_prop_index(ctx, -1, i->second);         // [stash, array, function]
+        duk_replace(ctx, -3);                           // [function, array]
+        duk_pop(ctx);                                   // [function]
+        return true;
     }
-    else if (c._errorCount == 0u)
+
+    // keep the cache bounded for engines that see endless distinct snippets
+    if (c._functions.size() >= MAX_CACHED_FUNCTIONS)
     {
-        void* buf = duk_push_buffer(ctx, (duk_size_t)c._bytecodeSize, (duk_bool_t)0); // [buffer]
-        ::memcpy(buf, c._bytecode, c._bytecodeSize);
+        c._functions.clear();
+        c._nextFunction = 0;
+        duk_push_global_stash(ctx);
+        duk_push_array(ctx);
+        duk_put_prop_string(ctx, -2, "oe_functions");
+        duk_pop(ctx);
     }
-    else
+
+    if (duk_pcompile_string(ctx, 0, code.c_str()) != 0) // [function|error]
     {
-        // this code caused a previous compile error, so bail out.
+        std::string resultString = duk_safe_to_string(ctx, -1);
+        OE_WARN << LC << "Compile error: " << resultString << std::endl;
+        c._errorCount++;
+        c._functions[code] = -1;
+        duk_pop(ctx); // []
+        result = ScriptResult("", false, resultString); // return error.
         return false;
     }
 
-    // convert bytecode to a function object:
-    duk_load_function(ctx); // [function]
+    // store the function object for next time:
+    int index = c._nextFunction++;
+    duk_push_global_stash(ctx);                         // [function, stash]
+    duk_get_prop_string(ctx, -1, "oe_functions");       // [function, stash, array]
+    duk_dup(ctx, -3);                                   // [function, stash, array, function]
+    duk_put_prop_index(ctx, -2, index);                 // [function, stash, array]
+    duk_pop_2(ctx);                                     // [function]
+    c._functions[code] = index;
 
     return true;
 }
@@ -386,7 +715,7 @@ DuktapeEngine::run(
     const bool complete = false;
 
     // cache the Context on a per-thread basis
-    Context& c = _contexts.get();
+    Context& c = getContext();
     c.initialize(_options, complete);
     duk_context* ctx = c._ctx;
 
@@ -404,6 +733,7 @@ DuktapeEngine::run(
     {
         // Load the next feature into the global object:
         setFeature(c._ctx, feature.get(), complete);
+        c._feature = feature.get();
 
         // Duplicate the function on the top since we'll be calling it multiple times
         duk_dup_top(ctx); // [function function]
@@ -448,7 +778,7 @@ DuktapeEngine::run(
     const bool complete = false;
 
     // cache the Context on a per-thread basis
-    Context& c = _contexts.get();
+    Context& c = getContext();
     c.initialize( _options, complete );
     duk_context* ctx = c._ctx;
 
@@ -130,11 +130,7 @@ namespace
                     vec.normalize();
                     p0 += vec * distance.as(Units::METERS);
 
-                    RoadNetwork::Junction new_junction(p0);
-                    new_junction.ways = way->start->ways;
-                    network.junctions.erase(*way->start);
-                    auto iter = network.junctions.emplace(new_junction);
-                    way->start = &*iter.first;
+                    way->start = &network.moveJunction(*way->start, p0);
 
                     way->length += distance.as(Units::METERS);
 
@@ -149,11 +145,7 @@ namespace
                     vec.normalize();
                     p0 += vec * distance.as(Units::METERS);
 
-                    RoadNetwork::Junction new_junction(p0);
-                    new_junction.ways = way->end->ways;
-                    network.junctions.erase(*way->end);
-                    auto iter = network.junctions.emplace(new_junction);
-                    way->end = &*iter.first;
+                    way->end = &network.moveJunction(*way->end, p0);
 
                     way->length += distance.as(Units::METERS);
 
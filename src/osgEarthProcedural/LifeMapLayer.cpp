@@ -233,6 +233,7 @@ void
 LifeMapLayer::removedFromMap(const Map* map)
 {
     _map = nullptr;
+    _elevationTiles.clear();
     options().biomeLayer().removedFromMap(map);
     options().maskLayer().removedFromMap(map);
     options().waterLayer().removedFromMap(map);
@@ -382,57 +383,157 @@ LifeMapLayer::getUseNoise() const
 
 #define NOISE_LEVELS 2
 
+// Source data shared by the tiles of one batch. Sibling tiles use the
+// same landcover neighbors and usually fall back on the same ancestor
+// for the mask, water and color rasters, so each is only created once.
+struct LifeMapLayer::Inputs
+{
+    std::unordered_map<TileKey, GeoCoverage<LandCoverSample>> landcover;
+    std::unordered_map<TileKey, GeoImage> densityMasks;
+    std::unordered_map<TileKey, GeoImage> waterMasks;
+    std::unordered_map<TileKey, GeoImage> colors;
+    std::unordered_map<std::string, unsigned> materialLUT;
+};
+
+namespace
+{
+    // Creates an image for the key or, failing that, its closest ancestor,
+    // remembering every attempt so the next sibling can reuse it.
+    GeoImage getRasterInput(
+        ImageLayer* layer,
+        const TileKey& key,
+        std::unordered_map<TileKey, GeoImage>& memo,
+        TileKey& out_key,
+        ProgressCallback* progress)
+    {
+        for (TileKey k = key; k.valid(); k.makeParent())
+        {
+            auto i = memo.find(k);
+            if (i == memo.end())
+            {
+                i = memo.emplace(k, layer->createImage(k, progress)).first;
+            }
+
+            if (i->second.valid())
+            {
+                out_key = k;
+                return i->second;
+            }
+        }
+        return GeoImage::INVALID;
+    }
+
+    // One row of values for one input, stored by channel so that
+    // the mixing pass runs over contiguous floats.
+    struct RowBuffer
+    {
+        std::vector<float> value[3]; // LIFEMAP_RUGGED, LIFEMAP_DENSE, LIFEMAP_LUSH
+        std::vector<float> weight;
+
+        void reset(unsigned size)
+        {
+            for (auto& channel : value)
+                channel.assign(size, 0.0f);
+            weight.assign(size, 0.0f);
+        }
+    };
+}
+
 GeoImage
 LifeMapLayer::createImageImplementation(
     const TileKey& key,
     ProgressCallback* progress) const
+{
+    Inputs inputs;
+    return createLifeMap(key, inputs, progress);
+}
+
+std::vector<GeoImage>
+LifeMapLayer::createImagesImplementation(
+    const std::vector<TileKey>& keys,
+    ProgressCallback* progress) const
 {
     OE_PROFILING_ZONE;
 
-    osg::ref_ptr<const Map> map;
-    if (!_map.lock(map))
-        return GeoImage::INVALID;
+    Inputs inputs;
 
-    // collect the elevation data:
+    std::vector<GeoImage> results;
+    results.reserve(keys.size());
+
+    for (auto& key : keys)
+    {
+        if (progress && progress->isCanceled())
+            results.emplace_back(GeoImage::INVALID);
+        else
+            results.emplace_back(createLifeMap(key, inputs, progress));
+    }
+
+    return results;
+}
+
+osg::ref_ptr<ElevationTexture>
+LifeMapLayer::getElevationTile(
+    const TileKey& key,
+    const Map* map,
+    ProgressCallback* progress) const
+{
     osg::ref_ptr<ElevationTexture> elevTile;
-    ElevationPool* ep = map->getElevationPool();
-    ep->getTile(key, true, elevTile, &_workingSet, progress);
+    map->getElevationPool()->getTile(key, true, elevTile, &_workingSet, progress);
 
     // ensure we have a normal map for slopes and curvatures:
     if (elevTile.valid() && getTerrainWeight() > 0.0f)
     {
-        elevTile->generateNormalMap(map.get(), &_workingSet, progress);
+        elevTile->generateNormalMap(map, &_workingSet, progress);
+
+        // Hold a reference so the pool returns this same tile, normal map
+        // and all, to the next sibling or neighbor that asks for it.
+        _elevationTiles.insert(key, elevTile);
     }
 
+    return elevTile;
+}
+
+GeoImage
+LifeMapLayer::createLifeMap(
+    const TileKey& key,
+    Inputs& inputs,
+    ProgressCallback* progress) const
+{
+    OE_PROFILING_ZONE;
+
+    osg::ref_ptr<const Map> map;
+    if (!_map.lock(map))
+        return GeoImage::INVALID;
+
+    // collect the elevation data:
+    osg::ref_ptr<ElevationTexture> elevTile = getElevationTile(key, map.get(), progress);
+
     GeoExtent extent = key.getExtent();
 
     // set up the land cover data metatiler:
     MetaTile<GeoCoverage<LandCoverSample>> landcover;
     if (_landCoverFactory)
     {
-        auto creator = [&](const TileKey& key, ProgressCallback* p) {
-            return _landCoverFactory->createCoverage(key, p);
+        auto creator = [&](const TileKey& key, ProgressCallback* p)
+            {
+                auto i = inputs.landcover.find(key);
+                if (i == inputs.landcover.end())
+                    i = inputs.landcover.emplace(key, _landCoverFactory->createCoverage(key, p)).first;
+                return i->second;
             };
         landcover.setCreateTileFunction(creator);
         landcover.setCenterTileKey(key, progress);
     }
 
+    // the mask layer zero's out density(etc)
     GeoImage densityMask;
     ImageUtils::PixelReader readDensityMask;
     osg::Matrixf dm_matrix;
 
-    // the mask layer zero's out density(etc)
     if (getMaskLayer())
     {
-        TileKey dm_key(key);
-
-        while (dm_key.valid() && !densityMask.valid())
-        {
-            densityMask = getMaskLayer()->createImage(dm_key, progress);
-            if (!densityMask.valid())
-                dm_key.makeParent();
-        }
-
+        TileKey dm_key;
+        densityMask = getRasterInput(getMaskLayer(), key, inputs.densityMasks, dm_key, progress);
         if (densityMask.valid())
         {
             readDensityMask.setImage(densityMask.getImage());
@@ -448,15 +549,8 @@ LifeMapLayer::createImageImplementation(
 
     if (getWaterLayer())
     {
-        TileKey wm_key(key);
-
-        while (wm_key.valid() && !waterMask.valid())
-        {
-            waterMask = getWaterLayer()->createImage(wm_key, progress);
-            if (!waterMask.valid())
-                wm_key.makeParent();
-        }
-
+        TileKey wm_key;
+        waterMask = getRasterInput(getWaterLayer(), key, inputs.waterMasks, wm_key, progress);
         if (waterMask.valid())
         {
             readWaterMask.setImage(waterMask.getImage());
@@ -473,15 +567,8 @@ LifeMapLayer::createImageImplementation(
 
     if (getColorLayer() && getColorWeight() > 0.0f)
     {
-        TileKey color_key(key);
-
-        while (color_key.valid() && !color.valid())
-        {
-            color = getColorLayer()->createImage(color_key, progress);
-            if (!color.valid())
-                color_key.makeParent();
-        }
-
+        TileKey color_key;
+        color = getRasterInput(getColorLayer(), key, inputs.colors, color_key, progress);
         if (color.valid())
         {
             readColor.setImage(color.getImage());
@@ -502,27 +589,16 @@ LifeMapLayer::createImageImplementation(
 
     ImageUtils::PixelWriter write(image.get());
 
-    float elevation;
-    osg::Vec3 normal;
-    float slope;
     const osg::Vec3 up(0, 0, 1);
 
-    std::string lu_id;
-    osg::Vec4f hsl;
-
-    osg::Vec2d noiseCoords[NOISE_LEVELS];
-    osg::Vec4 noise[NOISE_LEVELS];
+    osg::Vec2d noiseCoords;
+    osg::Vec4 noise;
     const unsigned noiseLOD[NOISE_LEVELS] = { 10u, 14u };
-    //    12u, 13u, 14u, 15u //, 16u // 0u, 9u, 13u, 16u
-    //};
     const unsigned noisePattern[NOISE_LEVELS] = { RANDOM, CLUMPY };
-    //RANDOM, SMOOTH, CLUMPY, RANDOM2 };
 
     CoordScaler coordScalers[NOISE_LEVELS] = {
         CoordScaler(key.getProfile(), key.getLOD(), noiseLOD[0]),
-        CoordScaler(key.getProfile(), key.getLOD(), noiseLOD[1]) //,
-        //CoordScaler(key.getProfile(), key.getLOD(), noiseLOD[2]),
-        //CoordScaler(key.getProfile(), key.getLOD(), noiseLOD[3])
+        CoordScaler(key.getProfile(), key.getLOD(), noiseLOD[1])
     };
 
     ImageUtils::PixelReader noiseSampler(_noiseFunc.get());
@@ -536,128 +612,121 @@ LifeMapLayer::createImageImplementation(
 
     // land cover blurring values
     double lc_blur_m = std::max(0.0, options().landCoverBlur()->as(Units::METERS));
-    double lc_blur_u = lc_blur_m / width_m;
-    double lc_blur_v = lc_blur_m / height_m;
 
     double mpp_x = width_m / (double)getTileSize();
     double mpp_y = height_m / (double)getTileSize();
 
     // landcover material index lookup table:
-    std::unordered_map<std::string, unsigned> materialLUT;
-    if (getBiomeLayer() && getLandCoverLayer() && getUseLandCover())
+    if (inputs.materialLUT.empty() && getBiomeLayer() && getLandCoverLayer() && getUseLandCover())
     {
         unsigned ptr = 0;
         for (auto& material : getBiomeLayer()->getBiomeCatalog()->getAssets().getMaterials())
         {
-            materialLUT[material.name().get()] = ptr++;
+            inputs.materialLUT[material.name().get()] = ptr++;
         }
     }
+    const auto& materialLUT = inputs.materialLUT;
 
-    std::minstd_rand gen(key.hash());
+    // weights that are the same for every pixel:
+    const bool useNoise = getUseNoise();
+    const bool useTerrain = getUseTerrain() && elevTile.valid();
+    const float noiseWeight = useNoise ? getNoiseWeight() : 0.0f;
+    const float terrainWeight = useTerrain ? getTerrainWeight() : 0.0f;
+    const float landCoverWeight = getLandCoverWeight();
+    const float colorWeight = getColorWeight();
+    const float slopeIntensity = options().slopeIntensity().get();
 
     GeoImage result(image.get(), extent);
 
     {
         OE_PROFILING_ZONE_NAMED("RasterizeLifeMap");
 
+        const unsigned width = result.s();
+
         double bu = 0.5 / (double)image->s();
         double bv = 0.5 / (double)image->t();
 
+        // Each row is built in two passes. The first samples every input
+        // into its own row buffer; the second mixes the buffers, one
+        // channel at a time, with no branching per input.
+        RowBuffer noiseRow, landCoverRow, colorRow;
+        noiseRow.reset(width);
+        landCoverRow.reset(width);
+        colorRow.reset(width);
+
+        std::vector<float> ruggedRow(width, 0.0f);
+        std::vector<float> densityMaskRow(width, 1.0f);
+        std::vector<float> waterMaskRow(width, 1.0f);
+        std::vector<unsigned> materialRow(width, 0u);
+        std::vector<osg::Vec4f> outputRow(width);
+
         for (unsigned int t = 0; t < result.t(); ++t)
         {
             double v = bv + ((double)t * 2.0 * bv);
             double y = result.getExtent().yMin() + result.getExtent().height() * v;
 
-            for (unsigned int s = 0; s < result.s(); ++s)
+            landCoverRow.reset(width);
+            std::fill(materialRow.begin(), materialRow.end(), 0u);
+
+            for (unsigned int s = 0; s < width; ++s)
             {
                 double u = bu + ((double)s * 2.0 * bu);
                 double x = result.getExtent().xMin() + result.getExtent().width() * u;
 
-                osg::Vec4f pixel[NUM_INPUTS];
-                float weight[NUM_INPUTS] = { 0,0,0,0 };
                 osg::Vec4f temp;
 
-                // in case the land cover specifies a custom material.
-                unsigned customMaterialIndex = 0u;
-
                 // NOISE contribution
-                if (getUseNoise())
+                if (useNoise)
                 {
+                    float dense = 0.0f, rugged = 0.0f;
                     for (int n = 0; n < NOISE_LEVELS; ++n)
                     {
                         if (key.getLOD() >= coordScalers[n]._refLOD)
                         {
-                            noiseCoords[n].set(u, v);
-                            coordScalers[n].scaleCoordsToRefLOD(noiseCoords[n], key);
-                            getNoise(noise[n], noiseSampler, noiseCoords[n]);
-
-                            //double L = 1.0; // 1.0 / pow(2.0, double(NOISE_LEVELS - 1 - n));
                             int p = noisePattern[n];
-                            double L = 1.0; //  n == 0 ? 0.25 : 1.0;
 
-                            pixel[NOISE][LIFEMAP_DENSE] += noise[n][p] * L; // 3
-                            pixel[NOISE][LIFEMAP_LUSH] = 0.0; // += noise[n][p] * L; // = 0.0;
+                            noiseCoords.set(u, v);
+                            coordScalers[n].scaleCoordsToRefLOD(noiseCoords, key);
+                            getNoise(noise, noiseSampler, noiseCoords);
+                            dense += noise[p];
 
-                            noiseCoords[n].set(v, u);
-                            getNoise(noise[n], noiseSampler, noiseCoords[n]);
-                            pixel[NOISE][LIFEMAP_RUGGED] += noise[n][p] * L; // 2
+                            noiseCoords.set(v, u);
+                            getNoise(noise, noiseSampler, noiseCoords);
+                            rugged += noise[p];
                         }
                     }
-
-                    //pixel[NOISE][LIFEMAP_DENSE] = clamp(pixel[NOISE][LIFEMAP_DENSE], 0.0f, 1.0f);
-                    //pixel[NOISE][LIFEMAP_RUGGED] = clamp(pixel[NOISE][LIFEMAP_RUGGED], 0.0f, 1.0f);
-
-                    weight[NOISE] = getNoiseWeight();
+                    noiseRow.value[LIFEMAP_DENSE][s] = dense;
+                    noiseRow.value[LIFEMAP_RUGGED][s] = rugged;
                 }
 
                 // LAND COVER CONTRIBUTION
                 if (getLandCoverLayer() && landcover.valid())
                 {
-                    const LandCoverSample* temp;
-                    LandCoverSample sample;
-                    int dense_samples = 0;
-                    int lush_samples = 0;
-                    int rugged_samples = 0;
-
                     if (equivalent(lc_blur_m, 0.0))
                     {
-                        temp = landcover.read((int)s, (int)t);
-                        if (temp)
+                        const LandCoverSample* sample = landcover.read((int)s, (int)t);
+                        if (sample)
                         {
-#if 0
-                            // RNG with normal distribution between approx +1/-1
-                            const float coverage_stddev = 1.0f / 12.0f; // 6.0f;
-                            {
-                                std::normal_distribution<float> normal_dist(temp->dense().get(), coverage_stddev);
-                                pixel[LANDCOVER][LIFEMAP_DENSE] = clamp(normal_dist(gen), 0.0f, 1.0f);
-                            }
-                            {
-                                std::normal_distribution<float> normal_dist(temp->lush().get(), coverage_stddev);
-                                pixel[LANDCOVER][LIFEMAP_LUSH] = clamp(normal_dist(gen), 0.0f, 1.0f);
-                            }
-                            {
-                                std::normal_distribution<float> normal_dist(temp->rugged().get(), coverage_stddev);
-                                pixel[LANDCOVER][LIFEMAP_RUGGED] = clamp(normal_dist(gen), 0.0f, 1.0f);
-                            }
-#else
-                            pixel[LANDCOVER][LIFEMAP_DENSE] = temp->dense().get();
-                            pixel[LANDCOVER][LIFEMAP_LUSH] = temp->lush().get();
-                            pixel[LANDCOVER][LIFEMAP_RUGGED] = temp->rugged().get();
-#endif
-                            weight[LANDCOVER] = getLandCoverWeight();
-
-                            if (temp->material().isSet() && getBiomeLayer())
+                            landCoverRow.value[LIFEMAP_DENSE][s] = sample->dense().get();
+                            landCoverRow.value[LIFEMAP_LUSH][s] = sample->lush().get();
+                            landCoverRow.value[LIFEMAP_RUGGED][s] = sample->rugged().get();
+                            landCoverRow.weight[s] = landCoverWeight;
+
+                            if (sample->material().isSet() && getBiomeLayer())
                             {
                                 // land cover asked for a custom material. Find its index.
-                                auto i = materialLUT.find(temp->material().get());
+                                auto i = materialLUT.find(sample->material().get());
                                 if (i != materialLUT.end())
-                                    customMaterialIndex = i->second + 1;
+                                    materialRow[s] = i->second + 1;
                             }
                         }
                     }
                     else
                     {
                         // read the landcover with a blurring filter.
+                        float sum[3] = { 0.0f, 0.0f, 0.0f };
+                        int count[3] = { 0, 0, 0 };
+
                         for (int a = -1; a <= 1; ++a)
                         {
                             for (int b = -1; b <= 1; ++b)
@@ -665,55 +734,36 @@ LifeMapLayer::createImageImplementation(
                                 int ss = a * (int)(lc_blur_m / mpp_x);
                                 int tt = b * (int)(lc_blur_m / mpp_y);
 
-                                temp = landcover.read((int)s + ss, (int)t + tt);
-
-                                if (temp)
+                                const LandCoverSample* sample = landcover.read((int)s + ss, (int)t + tt);
+                                if (sample)
                                 {
-                                    if (temp->dense().isSet())
-                                    {
-                                        sample.dense() = sample.dense().get() + temp->dense().get();
-                                        ++dense_samples;
-                                    }
+                                    if (sample->dense().isSet())
+                                        sum[LIFEMAP_DENSE] += sample->dense().get(), ++count[LIFEMAP_DENSE];
 
-                                    if (temp->lush().isSet())
-                                    {
-                                        sample.lush() = sample.lush().get() + temp->lush().get();
-                                        ++lush_samples;
-                                    }
+                                    if (sample->lush().isSet())
+                                        sum[LIFEMAP_LUSH] += sample->lush().get(), ++count[LIFEMAP_LUSH];
 
-                                    if (temp->rugged().isSet())
-                                    {
-                                        sample.rugged() = sample.rugged().get() + temp->rugged().get();
-                                        ++rugged_samples;
-                                    }
+                                    if (sample->rugged().isSet())
+                                        sum[LIFEMAP_RUGGED] += sample->rugged().get(), ++count[LIFEMAP_RUGGED];
 
-                                    if (temp->material().isSet() && getBiomeLayer())
+                                    if (sample->material().isSet() && getBiomeLayer())
                                     {
                                         // land cover asked for a custom material. Find its index.
-                                        auto i = materialLUT.find(temp->material().get());
+                                        auto i = materialLUT.find(sample->material().get());
                                         if (i != materialLUT.end())
-                                            customMaterialIndex = i->second + 1;
+                                            materialRow[s] = i->second + 1;
                                     }
                                 }
                             }
                         }
 
-                        weight[LANDCOVER] = 0.0f;
-
-                        if (dense_samples > 0)
-                        {
-                            pixel[LANDCOVER][LIFEMAP_DENSE] = sample.dense().get() / (float)dense_samples;
-                            weight[LANDCOVER] = getLandCoverWeight();
-                        }
-                        if (lush_samples > 0)
-                        {
-                            pixel[LANDCOVER][LIFEMAP_LUSH] = sample.lush().get() / (float)lush_samples;
-                            weight[LANDCOVER] = getLandCoverWeight();
-                        }
-                        if (rugged_samples > 0)
+                        for (int c = 0; c < 3; ++c)
                         {
-                            pixel[LANDCOVER][LIFEMAP_RUGGED] = sample.rugged().get() / (float)rugged_samples;
-                            weight[LANDCOVER] = getLandCoverWeight();
+                            if (count[c] > 0)
+                            {
+                                landCoverRow.value[c][s] = sum[c] / (float)count[c];
+                                landCoverRow.weight[s] = landCoverWeight;
+                            }
                         }
                     }
                 }
@@ -727,11 +777,10 @@ LifeMapLayer::createImageImplementation(
 
                     // convert to HSL:
                     Color c(temp.r(), temp.g(), temp.b(), 0.0f);
-                    hsl = c.asHSL();
+                    osg::Vec4f hsl = c.asHSL();
 
                     constexpr float red = 0.0f;
                     constexpr float green = 0.3333333f;
-                    constexpr float blue = 0.6666667f;
 
                     // amplification factors for greenness and redness,
                     // obtained empirically
@@ -772,71 +821,31 @@ LifeMapLayer::createImageImplementation(
                     greenness = pow(greenness, green_amp);
                     redness = pow(redness, red_amp);
 
-                    float w = options().colorWeight().get();
-
-                    pixel[COLOR][LIFEMAP_DENSE] = greenness;
-                    pixel[COLOR][LIFEMAP_LUSH] = greenness * (1.0 - hsl.z()); // lighter green is less lush.
-                    pixel[COLOR][LIFEMAP_RUGGED] = redness;
+                    colorRow.value[LIFEMAP_DENSE][s] = greenness;
+                    colorRow.value[LIFEMAP_LUSH][s] = greenness * (1.0 - hsl.z()); // lighter green is less lush.
+                    colorRow.value[LIFEMAP_RUGGED][s] = redness;
 
                     // if the lightness value is too high, it's white, which is usually
                     // snow or clouds, and we can't use it for anything meaningful
-                    if (pow(hsl[2], 5.0f) > 0.5f)
-                        weight[COLOR] = 0.0f;
-                    else
-                        weight[COLOR] = getColorWeight(); // * max(greeness, redness) ...???
+                    colorRow.weight[s] = pow(hsl[2], 5.0f) > 0.5f ? 0.0f : colorWeight;
                 }
 
                 // TERRAIN CONTRIBUTION:
-                if (getUseTerrain() && elevTile.valid())
+                if (useTerrain)
                 {
-                    // Establish elevation at this pixel:
-                    elevation = elevTile->getElevation(x, y).elevation().as(Units::METERS);
-
-                    // Normal map at this pixel:
-                    normal = elevTile->getNormal(x, y);
-
                     // exaggerate the slope value
-                    slope = 1.0 - (normal * up);
-                    float r = decel(slope * options().slopeIntensity().get());
-                    pixel[TERRAIN][LIFEMAP_RUGGED] = r;
-                    pixel[TERRAIN][LIFEMAP_DENSE] = -r;
-                    pixel[TERRAIN][LIFEMAP_LUSH] = -r;
-
-                    weight[TERRAIN] = getTerrainWeight();
-                }
-
-                // CONBINE WITH WEIGHTS:
-                osg::Vec4f combined_pixel;
-
-                // first, combine landcover and color by relative weight.
-                float w2 = weight[LANDCOVER] + weight[COLOR];
-                if (w2 > 0.0f)
-                {
-                    combined_pixel =
-                        pixel[LANDCOVER] * weight[LANDCOVER] / w2 +
-                        pixel[COLOR] * weight[COLOR] / w2;
+                    osg::Vec3 normal = elevTile->getNormal(x, y);
+                    float slope = 1.0 - (normal * up);
+                    ruggedRow[s] = decel(slope * slopeIntensity);
                 }
 
-                // apply terrain additively:
-                combined_pixel += pixel[TERRAIN] * weight[TERRAIN];
-
-                // apply the noise additively:
-                combined_pixel += pixel[NOISE] * weight[NOISE];
-
-                // apply the lushness static factor
-                //combined_pixel[LIFEMAP_LUSH] *= options().lushFactor().get();
-
                 // MASK CONTRIBUTION (applied to final combined pixel data)
                 if (densityMask.valid())
                 {
                     double uu = clamp(u * dm_matrix(0, 0) + dm_matrix(3, 0), 0.0, 1.0);
                     double vv = clamp(v * dm_matrix(1, 1) + dm_matrix(3, 1), 0.0, 1.0);
                     readDensityMask(temp, uu, vv);
-
-                    // multiply all 3 so that roads can have a barren look
-                    combined_pixel[LIFEMAP_DENSE] *= temp.r();
-                    combined_pixel[LIFEMAP_LUSH] *= temp.r();
-                    combined_pixel[LIFEMAP_RUGGED] *= temp.r();
+                    densityMaskRow[s] = temp.r();
                 }
 
                 // WATER MASK
@@ -845,26 +854,51 @@ LifeMapLayer::createImageImplementation(
                     double uu = clamp(u * wm_matrix(0, 0) + wm_matrix(3, 0), 0.0, 1.0);
                     double vv = clamp(v * wm_matrix(1, 1) + wm_matrix(3, 1), 0.0, 1.0);
                     readWaterMask(temp, uu, vv);
-
-                    combined_pixel[LIFEMAP_DENSE] *= temp.r();
-                    combined_pixel[LIFEMAP_LUSH] *= temp.r();
-                    combined_pixel[LIFEMAP_RUGGED] *= temp.r();
-                    combined_pixel[3] = 1.0f - temp.r();
+                    waterMaskRow[s] = temp.r();
                 }
-                else combined_pixel[3] = 0.0f;
+            }
 
-                if (customMaterialIndex > 0)
+            // COMBINE WITH WEIGHTS:
+            // landcover and color mix by relative weight; terrain and noise
+            // are additive; then the masks scale everything.
+            for (int c = 0; c < 3; ++c)
+            {
+                const float* lc_value = landCoverRow.value[c].data();
+                const float* lc_weight = landCoverRow.weight.data();
+                const float* color_value = colorRow.value[c].data();
+                const float* color_weight = colorRow.weight.data();
+                const float* noise_value = noiseRow.value[c].data();
+                const float* dm = densityMaskRow.data();
+                const float* wm = waterMaskRow.data();
+                const float* rugged = ruggedRow.data();
+
+                // terrain raises ruggedness and lowers density and lushness
+                const float terrain = (c == LIFEMAP_RUGGED ? terrainWeight : -terrainWeight);
+
+                for (unsigned s = 0; s < width; ++s)
                 {
-                    combined_pixel[3] = (float)customMaterialIndex / 255.0f;
-                }
+                    float w2 = lc_weight[s] + color_weight[s];
+                    float mixed = w2 > 0.0f ?
+                        (lc_value[s] * lc_weight[s] + color_value[s] * color_weight[s]) / w2 :
+                        0.0f;
 
-                // Clamp everything to [0..1] and write it out.
-                for (int i = 0; i < 4; ++i)
-                {
-                    combined_pixel[i] = clamp(combined_pixel[i], 0.0f, 1.0f);
+                    float value =
+                        (mixed + rugged[s] * terrain + noise_value[s] * noiseWeight) * dm[s] * wm[s];
+
+                    outputRow[s][c] = clamp(value, 0.0f, 1.0f);
                 }
+            }
+
+            for (unsigned s = 0; s < width; ++s)
+            {
+                float special = waterMask.valid() ? 1.0f - waterMaskRow[s] : 0.0f;
+
+                if (materialRow[s] > 0)
+                    special = (float)materialRow[s] / 255.0f;
+
+                outputRow[s][LIFEMAP_SPECIAL] = clamp(special, 0.0f, 1.0f);
 
-                write(combined_pixel, s, t);
+                write(outputRow[s], s, t);
             }
         }
     }
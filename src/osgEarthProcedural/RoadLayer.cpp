@@ -140,7 +140,6 @@ namespace
         mutable std::vector<edge_t*> edges;
         intersection_t intersection;
         bool has_crossing = false;
-        int subgraph_id = -1;
         const properties_t* props = nullptr;
 
         node_t() : uid(s_uidgen++) {
@@ -325,20 +324,9 @@ namespace
 
     struct graph_t
     {
-        int num_subgraphs = -1;
         std::unordered_set<node_t, node_t> nodes;
         std::set<edge_t> edges;
 
-        // sets a node's id and then propagates it to all neighbors
-        void set_subgraph_id(node_t& n, int id) {
-            n.subgraph_id = id;
-            for (auto& edge : n.edges) {
-                auto& other_node = edge->other_node(n);
-                if (other_node.subgraph_id != id)
-                    set_subgraph_id(const_cast<node_t&>(other_node), id);
-            }
-        }
-
         node_t* add_node(double x1, double y1, double z1, const properties_t* props) {
             const auto iter = nodes.emplace(x1, y1, z1).first;
             auto node = const_cast<node_t*>(&(*iter));
@@ -370,18 +358,6 @@ namespace
                 }
             if (!found) node2->edges.emplace_back(edge);
 
-            auto& n1 = const_cast<node_t&>(*node1);
-            auto& n2 = const_cast<node_t&>(*node2);
-
-            // propagate the subgraph ids.
-            int new_id =
-                n1.subgraph_id < 0 && n2.subgraph_id < 0 ? ++num_subgraphs :
-                n1.subgraph_id < 0 ? n2.subgraph_id :
-                n2.subgraph_id < 0 ? n1.subgraph_id :
-                std::min(n1.subgraph_id, n2.subgraph_id);
-
-            set_subgraph_id(n1, new_id); // will set n2 as well
-
             return edge;
         }
         // find crossing segments and break them up.
@@ -5,6 +5,8 @@
 #include "RoadNetwork"
 #include <osgEarth/Feature>
 #include <osgEarth/GeoData>
+#include <osgEarth/Math>
+#include <cmath>
 
 using namespace osgEarth;
 using namespace osgEarth::Procedural;
@@ -17,6 +19,8 @@ RoadNetwork::addFeature(Feature* feature)
 {
     OE_SOFT_ASSERT_AND_RETURN(feature, void());
 
+    auto fid = feature->getFID();
+
     auto* geom = feature->getGeometry();
     geom->forEachPart([&](Geometry* part)
         {
@@ -24,44 +28,155 @@ RoadNetwork::addFeature(Feature* feature)
             {
                 auto& j0 = addJunction(part->front());
                 auto& j1 = addJunction(part->back());
+
+                // skip a piece we already have (e.g. from a neighboring tile)
+                if (fid != 0LL && !_wayKeys.emplace(fid, j0.index, j1.index).second)
+                    return;
+
                 ways.emplace_back(j0, j1, feature, part);
                 ways.back().length = part->getLength();
-                j0.ways.emplace_back(&ways.back());
-                j1.ways.emplace_back(&ways.back());
+                const_cast<Junction&>(j0).degree++;
+                const_cast<Junction&>(j1).degree++;
+                _compiled = false;
             }
         });
 }
 
+std::uint64_t
+RoadNetwork::gridKey(std::int64_t cx, std::int64_t cy) const
+{
+    return (static_cast<std::uint64_t>(cx) << 32) ^ (static_cast<std::uint64_t>(cy) & 0xffffffffULL);
+}
+
 const RoadNetwork::Junction&
 RoadNetwork::addJunction(const osg::Vec3d& point)
 {
-    auto i = junctions.insert(Junction(point));
-    return *i.first;
+    // The grid cell size equals the snap tolerance, so any junction
+    // within tolerance is in this cell or one of its eight neighbors.
+    double cell = std::max(snapTolerance, 1e-9);
+    std::int64_t cx = static_cast<std::int64_t>(std::floor(point.x() / cell));
+    std::int64_t cy = static_cast<std::int64_t>(std::floor(point.y() / cell));
+
+    const Junction* best = nullptr;
+    double best_d2 = snapTolerance * snapTolerance;
+
+    for (std::int64_t y = cy - 1; y <= cy + 1; ++y)
+    {
+        for (std::int64_t x = cx - 1; x <= cx + 1; ++x)
+        {
+            auto iter = _grid.find(gridKey(x, y));
+            if (iter == _grid.end())
+                continue;
+
+            for (unsigned i = iter->second; i != ~0u; i = _gridNext[i])
+            {
+                auto& j = junctions[i];
+                double dx = j.x() - point.x(), dy = j.y() - point.y();
+                double d2 = dx * dx + dy * dy;
+                if (d2 <= best_d2)
+                {
+                    best = &j;
+                    best_d2 = d2;
+                }
+            }
+        }
+    }
+
+    if (best)
+        return *best;
+
+    unsigned index = junctions.size();
+    junctions.emplace_back(point);
+    junctions.back().index = index;
+
+    auto& head = _grid.emplace(gridKey(cx, cy), ~0u).first->second;
+    _gridNext.push_back(head);
+    head = index;
+
+    return junctions.back();
+}
+
+const RoadNetwork::Junction&
+RoadNetwork::moveJunction(const Junction& junction, const osg::Vec3d& point)
+{
+    compile();
+
+    // The moved junction is not entered in the snapping grid; it keeps
+    // exactly the ways it had.
+    junctions.emplace_back(point);
+    auto& moved = junctions.back();
+    moved.index = junctions.size() - 1;
+    moved.ways = junction.ways;
+    moved.degree = junction.degree;
+    moved.offset = junction.offset;
+
+    auto& old = const_cast<Junction&>(junction);
+    old.ways = WayRange();
+    old.degree = 0u;
+
+    for (auto* way : moved.ways)
+    {
+        if (way->start == &junction) way->start = &moved;
+        if (way->end == &junction) way->end = &moved;
+    }
+
+    return moved;
+}
+
+void
+RoadNetwork::compile()
+{
+    if (_compiled)
+        return;
+
+    // Lay out each junction's ways contiguously (CSR), then fill them in.
+    unsigned offset = 0u;
+    for (auto& j : junctions)
+    {
+        j.offset = offset;
+        offset += j.degree;
+    }
+
+    _adjacency.assign(offset, nullptr);
+
+    std::vector<unsigned> fill(junctions.size(), 0u);
+    for (auto& way : ways)
+    {
+        _adjacency[way.start->offset + fill[way.start->index]++] = &way;
+        _adjacency[way.end->offset + fill[way.end->index]++] = &way;
+    }
+
+    for (auto& j : junctions)
+    {
+        j.ways.first = _adjacency.data() + j.offset;
+        j.ways.last = j.ways.first + j.degree;
+    }
+
+    _compiled = true;
 }
 
 void
 RoadNetwork::buildRelations()
 {
+    compile();
+
+    relations.clear();
+    geometryEndpointFlags.clear();
+
     // Keep track of nodes already traversed.
-    std::set<const Junction*> endpoints_traversed;
-    std::set<const Junction*> midpoints_traversed;
+    std::unordered_set<const Junction*> endpoints_traversed;
+    std::unordered_set<const Junction*> midpoints_traversed;
 
     for (auto& junction : junctions)
     {
-        // collect nodes that are NOT endpoints.
-        if (junction.is_midpoint())
-        {
-            midpoints.insert(junction);
-        }
-
         // Is this junction an endpoint that does not already belong to a relation?
-        else if (junction.is_endpoint() && endpoints_traversed.count(&junction) == 0)
+        if (junction.is_endpoint() && endpoints_traversed.count(&junction) == 0)
         {
             endpoints_traversed.insert(&junction);
 
             Relation relation;
             Way* incoming_way = nullptr;
-            auto* current_junction = &junction;
+            const Junction* current_junction = &junction;
 
             while (current_junction)
             {
@@ -105,11 +220,15 @@ RoadNetwork::buildRelations()
 
                     // Make sure the relation all flows in the same direction; this include not only 
                     // the Way start and end junctions, but also the geometry's points themselves.
-                    if (*current_junction != *outgoing_way->start)
+                    // (Snapped endpoints may not match the junction exactly, so
+                    // orient the geometry by whichever end is closer.)
+                    if (current_junction != outgoing_way->start)
                     {
                         std::swap(outgoing_way->start, outgoing_way->end);
                     }
-                    if (*current_junction != outgoing_way->geometry->front())
+                    auto& front = outgoing_way->geometry->front();
+                    auto& back = outgoing_way->geometry->back();
+                    if (distanceSquared2D(front, *current_junction) > distanceSquared2D(back, *current_junction))
                     {
                         std::reverse(outgoing_way->geometry->begin(), outgoing_way->geometry->end());
                     }
@@ -41,6 +41,13 @@
 #define LC "[VegetationLayer] " << getName() << ": "
 
 #define JOB_ARENA_VEGETATION "oe.vegetation"
+#define JOB_ARENA_VEGETATION_PLACEMENT "oe.vegetation.placement"
+
+// Target number of candidate instances per placement cell
+#define PLACEMENT_SAMPLES_PER_CELL 1024u
+
+// Upper limit on the placement grid size (cells per tile side)
+#define PLACEMENT_MAX_CELLS_PER_SIDE 8u
 
 #define OE_DEVEL OE_DEBUG
 
@@ -165,20 +172,43 @@ namespace
         return static_cast<ChonkDrawable*>(value.get());
     }
 
-    bool inConstrainedRegion(double x, double y, const std::vector<MeshConstraint>& constraints)
+    // Collects the constraint geometry that overlaps a region, so that
+    // points inside it only need testing against those.
+    void getConstraintMasks(const Bounds& bounds, const std::vector<MeshConstraint>& constraints, std::vector<const Geometry*>& masks)
     {
         for (auto& con : constraints)
         {
             for (auto& feature : con.features)
             {
-                if (feature->getGeometry()->contains2D(x, y))
+                const Geometry* geom = feature->getGeometry();
+                if (geom && intersects2d(geom->getBounds(), bounds))
                 {
-                    return true;
+                    masks.push_back(geom);
                 }
             }
         }
+    }
+
+    bool inConstrainedRegion(double x, double y, const std::vector<const Geometry*>& masks)
+    {
+        for (auto geom : masks)
+        {
+            if (geom->contains2D(x, y))
+            {
+                return true;
+            }
+        }
         return false;
     }
+
+    // An instance sampled by one placement cell, before the
+    // overlap and density passes decide whether to keep it
+    struct PlacementCandidate
+    {
+        VegetationLayer::Placement placement;
+        float cull; // random draw compared against the density
+        bool constrained; // inside a terrain constraint
+    };
 }
 
 void
@@ -403,6 +433,7 @@ VegetationLayer::update(osg::NodeVisitor& nv)
         {
             std::lock_guard<std::mutex> lock(_assets.mutex());
             _assets = std::move(_newAssets.release());
+            ++_assetsRevision;
         }
 
         // do we need to activate A2C?
@@ -423,6 +454,8 @@ VegetationLayer::dirty()
         {
             _cameraState.clear();
         });
+
+    _placementCache.clear();
 }
 
 void
@@ -1164,6 +1197,7 @@ VegetationLayer::reset()
     _assets.scoped_lock([this]()
         {
             _assets.clear();
+            ++_assetsRevision;
         });
 
     _tiles.scoped_lock([this]()
@@ -1217,9 +1251,6 @@ VegetationLayer::createDrawableAsync(
     return jobs::dispatch(function, context);
 }
 
-#undef RAND
-#define RAND() prng.next()
-
 bool
 VegetationLayer::getAssetPlacements(
     const TileKey& key,
@@ -1275,6 +1306,44 @@ VegetationLayer::getAssetPlacements(
         }
     }
 
+    // Constraint layers whose interiors are kept free of vegetation
+    TerrainConstraintQuery query;
+    map->getLayers<TerrainConstraintLayer>(query.layers, [](const auto* layer)
+        {
+            auto clayer = static_cast<const TerrainConstraintLayer*>(layer);
+            return clayer->getRemoveInterior() == true;
+        });
+
+    // The placements depend only on the tile, the group and the revisions
+    // of the layer, its inputs (including the terrain they are clamped to
+    // and the constraints that mask them) and the resident assets.
+    std::string cacheKey;
+    auto findCached = [&]()
+    {
+        Stringify buf;
+        buf << key.str() << ':' << group << ':' << getRevision()
+            << ':' << (getLifeMapLayer() ? getLifeMapLayer()->getRevision() : 0)
+            << ':' << (getBiomeLayer() ? getBiomeLayer()->getRevision() : 0)
+            << ':' << _assetsRevision
+            << ':' << map->getElevationPool()->getRevision();
+        for (auto& layer : query.layers)
+            buf << ':' << layer->getUID() << '.' << layer->getRevision();
+        cacheKey = buf;
+
+        PlacementCache::Record record;
+        if (_placementCache.get(cacheKey, record))
+        {
+            output = *record.value();
+            return true;
+        }
+        return false;
+    };
+
+    if (loadBiomesOnDemand == false && findCached())
+    {
+        return true;
+    }
+
     // Load a lifemap raster:
     GeoImage lifemap;
     osg::Matrix lifemap_sb;
@@ -1308,13 +1377,6 @@ VegetationLayer::getAssetPlacements(
 
     // Prepare to deal with holes in the terrain, where we do not want
     // to place vegetation
-    TerrainConstraintQuery query;
-    map->getLayers<TerrainConstraintLayer>(query.layers, [](const auto* layer)
-        {
-            auto clayer = static_cast<const TerrainConstraintLayer*>(layer);
-            return clayer->getRemoveInterior() == true;
-        });
-
     MeshConstraints constraints;
     query.getConstraints(key, constraints, progress);
 
@@ -1330,6 +1392,7 @@ VegetationLayer::getAssetPlacements(
             {
                 std::lock_guard<std::mutex> lock(_assets.mutex());
                 _assets = std::move(newAssets);
+                ++_assetsRevision;
             }
         }
 
@@ -1354,20 +1417,18 @@ VegetationLayer::getAssetPlacements(
             output = std::move(result);
             return true;
         }
+
+        if (findCached())
+        {
+            return true;
+        }
     }
 
     const Biome* default_biome = groupAssets.begin()->second.biome;
 
-    osg::Vec4f noise;
     ImageUtils::PixelReader readNoise(_noiseTex->osgTexture()->getImage(0));
     readNoise.setSampleAsRepeatingTexture(true);
 
-    using Index = RTree<int, double, 2>;
-    Index index;
-
-    std::default_random_engine gen(key.hash());
-    Random prng(0);
-
     // approximate area of the tile in km
     GeoCircle c = key.getExtent().computeBoundingGeoCircle();
     double x = 0.001 * c.getRadius() * 2.8284271247;
@@ -1377,23 +1438,10 @@ VegetationLayer::getAssetPlacements(
 
     float overlap = clamp(groupOptions.overlap().get(), 0.0f, 1.0f);
 
-    // reserve some memory, maybe more than we need
-    result.reserve(max_instances);
-
-    // store these separately so we can clamp them all in one go
-    std::vector<osg::Vec3d> map_points;
-    map_points.reserve(max_instances);
-
     const GeoExtent& e = key.getExtent();
 
-    osg::Vec4f lifemap_value;
-    osg::Vec4f biomemap_value;
-    std::vector<double> hits;
-
     auto catalog = getBiomeLayer()->getBiomeCatalog();
 
-    bool scaleWithDensity = (group == GROUP_UNDERGROWTH);
-
     // determine a local tile bbox size for collisions and uv generation
     // note. This doesn't take elevation data into account. Does that matter?
     auto& ex = key.getExtent();
@@ -1406,16 +1454,6 @@ VegetationLayer::getAssetPlacements(
     double local_width = x1 - x0;
     double local_height = y1 - y0;
 
-    // keep track of biomes with no assets (for a possible error condition?)
-    std::set<const Biome*> empty_biomes;
-
-    // indicies of assets selected based on their lushness
-    std::vector<unsigned> assetIndices;
-
-    // cumulative density function based on asset weights
-    std::vector<float> assetCDF;
-
-
     //TEMP - DEBUGGING DETERMINISTIC BEHAVIOR.
     bool debug = false; // key.is(14, 17117, 4120);
     if (debug) {
@@ -1423,194 +1461,235 @@ VegetationLayer::getAssetPlacements(
         OE_INFO << LC << "Attempting to place " << max_instances << std::endl;
     }
 
-    // normal distribution for lushness
-    std::normal_distribution<float> normal_dist(0.0f, 1.0f / 6.0f);
+    // Split the tile into a grid of cells. Each cell draws its candidates
+    // from its own seed, so the cells can be sampled in any order, on any
+    // number of threads, and still produce the same placements.
+    const unsigned cellsPerSide = clamp(
+        (unsigned)std::sqrt((double)max_instances / (double)PLACEMENT_SAMPLES_PER_CELL),
+        1u, PLACEMENT_MAX_CELLS_PER_SIDE);
+    const unsigned numCells = cellsPerSide * cellsPerSide;
 
-    // Generate random instances within the tile:
-    for (unsigned i = 0; i < max_instances; ++i)
+    std::vector<std::vector<PlacementCandidate>> cells(numCells);
+
+    auto sampleCell = [&](unsigned cell)
     {
-        // perform all random number generations first to preserve determinism
-        // in the even of an early loop break.
+        unsigned cx = cell % cellsPerSide;
+        unsigned cy = cell / cellsPerSide;
+        unsigned count = max_instances / numCells + (cell < max_instances % numCells ? 1u : 0u);
+
+        unsigned seed = (unsigned)hash_value_unsigned(key.hash(), cell);
+        Random prng(seed);
+        std::default_random_engine gen(seed);
+
+        // normal distribution for lushness
+        std::normal_distribution<float> normal_dist(0.0f, 1.0f / 6.0f);
+
+        // only the constraint geometry overlapping this cell can mask it
+        double cw = e.width() / (double)cellsPerSide;
+        double ch = e.height() / (double)cellsPerSide;
+        Bounds cellBounds(
+            e.xMin() + cx * cw, e.yMin() + cy * ch, 0.0,
+            e.xMin() + (cx + 1) * cw, e.yMin() + (cy + 1) * ch, 0.0);
 
-        // random tile-normalized position:
-        float u = RAND();
-        float v = RAND();
+        std::vector<const Geometry*> masks;
+        getConstraintMasks(cellBounds, constraints, masks);
 
-        float asset_index_rand = RAND();
-        float rotation_rand = RAND();
-        float normal_rand = RAND();
-        float lush_offset = normal_dist(gen);
+        osg::Vec4f noise;
+        osg::Vec4f lifemap_value;
+        osg::Vec4f biomemap_value;
 
+        // indicies of assets selected based on their lushness
+        std::vector<unsigned> assetIndices;
 
-        // resolve the biome at this position:
-        const Biome* biome = nullptr;
-        if (biomemap.valid())
+        // cumulative density function based on asset weights
+        std::vector<float> assetCDF;
+
+        auto& candidates = cells[cell];
+        candidates.reserve(count);
+
+        for (unsigned i = 0; i < count; ++i)
         {
-            float uu = u * biomemap_sb(0, 0) + biomemap_sb(3, 0);
-            float vv = v * biomemap_sb(1, 1) + biomemap_sb(3, 1);
-            biomemap.getReader()(biomemap_value, uu, vv);
-            int index = (int)biomemap_value.r();
-            biome = catalog->getBiomeByIndex(index);
-            if (!biome)
+            // perform all random number generations first to preserve determinism
+            // in the even of an early loop break.
+
+            // random tile-normalized position:
+            float u = ((float)cx + (float)prng.next()) / (float)cellsPerSide;
+            float v = ((float)cy + (float)prng.next()) / (float)cellsPerSide;
+
+            float asset_index_rand = prng.next();
+            float rotation_rand = prng.next();
+            float cull_rand = prng.next();
+            float lush_offset = normal_dist(gen);
+
+            // resolve the biome at this position:
+            const Biome* biome = nullptr;
+            if (biomemap.valid())
+            {
+                float uu = u * biomemap_sb(0, 0) + biomemap_sb(3, 0);
+                float vv = v * biomemap_sb(1, 1) + biomemap_sb(3, 1);
+                biomemap.getReader()(biomemap_value, uu, vv);
+                int index = (int)biomemap_value.r();
+                biome = catalog->getBiomeByIndex(index);
+                if (!biome)
+                {
+                    continue;
+                }
+            }
+
+            if (biome == nullptr)
+            {
+                // not sure this is even possible
+                biome = default_biome;
+            }
+
+            // fetch the collection of assets belonging to the selected biome:
+            auto iter = groupAssets.find(biome->id());
+            if (iter == groupAssets.end())
             {
-                if (debug) OE_INFO << LC << "Instance " << i << " has invalid biome index " << index << std::endl;
                 continue;
             }
-        }
+            const ResidentBiomeModelAssetInstances& biome_assets = iter->second;
 
-        if (biome == nullptr)
-        {
-            // not sure this is even possible
-            biome = default_biome;
-        }
+            // sample the noise texture at this (u,v)
+            readNoise(noise, u, v);
 
-        // fetch the collection of assets belonging to the selected biome:
-        auto iter = groupAssets.find(biome->id());
-        if (iter == groupAssets.end())
-        {
-            empty_biomes.insert(biome);
-            if (debug) OE_INFO << LC << "Instance " << i << " has no assets for biome " << biome->id() << std::endl;
-            continue;
-        }
-        ResidentBiomeModelAssetInstances& biome_assets = iter->second;
+            // read the life map at this point:
+            float density = 1.0f;
+            float lush = 1.0f;
+            if (lifemap.valid())
+            {
+                float uu = u * lifemap_sb(0, 0) + lifemap_sb(3, 0);
+                float vv = v * lifemap_sb(1, 1) + lifemap_sb(3, 1);
+                lifemap.getReader()(lifemap_value, uu, vv);
+                density = lifemap_value[LIFEMAP_DENSE];
+                lush = lifemap_value[LIFEMAP_LUSH];
+            }
 
-        // sample the noise texture at this (u,v)
-        readNoise(noise, u, v);
+            auto& assetInstances = biome_assets.instances;
 
-        // read the life map at this point:
-        float density = 1.0f;
-        float lush = 1.0f;
-        if (lifemap.valid())
-        {
-            float uu = u * lifemap_sb(0, 0) + lifemap_sb(3, 0);
-            float vv = v * lifemap_sb(1, 1) + lifemap_sb(3, 1);
-            lifemap.getReader()(lifemap_value, uu, vv);
-            density = lifemap_value[LIFEMAP_DENSE];
-            lush = lifemap_value[LIFEMAP_LUSH];
-        }
+            // RNG with normal distribution between approx lush-1..lush+1
+            lush = clamp(lush + lush_offset, 0.0f, 1.0f);
 
-        auto& assetInstances = biome_assets.instances;
+            assetIndices.clear();
+            assetCDF.clear();
+            float cumulativeWeight = 0.0f;
+            for (unsigned i = 0; i < assetInstances.size(); ++i)
+            {
+                float min_lush = assetInstances[i].residentAsset()->assetDef()->minLush().get();
+                float max_lush = assetInstances[i].residentAsset()->assetDef()->maxLush().get();
 
-        // RNG with normal distribution between approx lush-1..lush+1
-        // Note: moved this earlier in the loop to make it deterministic
-        //std::normal_distribution<float> normal_dist(lush, 1.0f / 6.0f);
-        lush = clamp(lush + lush_offset, 0.0f, 1.0f);
+                if (lush >= min_lush && lush <= max_lush)
+                {
+                    assetIndices.push_back(i);
+                    cumulativeWeight += assetInstances[i].weight();
+                    assetCDF.push_back(cumulativeWeight);
+                }
+            }
 
-        assetIndices.clear();
-        assetCDF.clear();
-        float cumulativeWeight = 0.0f;
-        for (unsigned i = 0; i < assetInstances.size(); ++i)
-        {
-            float min_lush = assetInstances[i].residentAsset()->assetDef()->minLush().get();
-            float max_lush = assetInstances[i].residentAsset()->assetDef()->maxLush().get();
+            // if there are no assets that match the lushness criteria, move on.
+            if (assetIndices.empty())
+            {
+                continue;
+            }
 
-            if (lush >= min_lush && lush <= max_lush)
+            int assetIndex = 0;
+            if (assetIndices.size() > 1)
             {
-                assetIndices.push_back(i);
-                cumulativeWeight += assetInstances[i].weight();
-                assetCDF.push_back(cumulativeWeight);
+                float k = asset_index_rand * cumulativeWeight;
+                for (assetIndex = 0;
+                    assetIndex < assetCDF.size() - 1 && k > assetCDF[assetIndex];
+                    ++assetIndex);
             }
-        }
+            auto& instance = assetInstances[assetIndices[assetIndex]];
+            auto& asset = instance.residentAsset();
 
-        // if there are no assets that match the lushness criteria, move on.
-        if (assetIndices.empty())
-        {
-            if (debug) OE_INFO << LC << "Instance " << i << " has no assets for lushness " << lush << std::endl;
-            continue;
-        }
+            // if there's no geometry... bye
+            if (asset->chonk() == nullptr)
+            {
+                continue;
+            }
 
-        int assetIndex = 0;
-        if (assetIndices.size() > 1)
-        {
-            float k = asset_index_rand * cumulativeWeight;
-            for (assetIndex = 0;
-                assetIndex < assetCDF.size() - 1 && k > assetCDF[assetIndex];
-                ++assetIndex);
+            osg::Vec3d scale(1, 1, 1);
+
+            // Apply a size variation with some randomness
+            if (asset->assetDef()->sizeVariation().isSet())
+            {
+                scale *= 1.0 + (asset->assetDef()->sizeVariation().get() *
+                    (noise[N_CLUMPY] * 2.0f - 1.0f));
+            }
+
+            // apply instance-specific density adjustment:
+            density *= instance.coverage();
+
+            double map_x = e.xMin() + u * e.width();
+            double map_y = e.yMin() + v * e.height();
+
+            PlacementCandidate candidate;
+            candidate.cull = cull_rand;
+            candidate.constrained = inConstrainedRegion(map_x, map_y, masks);
+
+            Placement& p = candidate.placement;
+            p.mapPoint().set(map_x, map_y, 0.0);
+            p.localPoint().set(
+                local_bbox.xMin() + u * local_width,
+                local_bbox.yMin() + v * local_height);
+            p.uv().set(u, v);
+            p.scale() = scale;
+            p.rotation() = rotation_rand * 3.1415927 * 2.0;
+            p.asset() = asset;
+            p.density() = density;
+            p.biome = biome;
+
+            candidates.emplace_back(std::move(candidate));
         }
-        auto& instance = assetInstances[assetIndices[assetIndex]];
-        auto& asset = instance.residentAsset();
+    };
 
-        // if there's no geometry... bye
-        if (asset->chonk() == nullptr)
+    jobs::parallel_for(JOB_ARENA_VEGETATION_PLACEMENT, numCells, [&](unsigned begin, unsigned end)
         {
-            if (debug) OE_INFO << LC << "Instance " << i << " has no geometry" << std::endl;
-            continue;
-        }
+            for (unsigned cell = begin; cell < end; ++cell)
+                sampleCell(cell);
+        });
 
-        osg::Vec3d scale(1, 1, 1);
+    // Resolve overlap in cell order so the outcome is deterministic.
+    // A candidate that wins its space keeps it even if it then falls in a
+    // constrained region.
+    using Index = RTree<int, double, 2>;
+    Index index;
 
-        // Apply a size variation with some randomness
-        if (asset->assetDef()->sizeVariation().isSet())
-        {
-            scale *= 1.0 + (asset->assetDef()->sizeVariation().get() *
-                (noise[N_CLUMPY] * 2.0f - 1.0f));
-        }
+    result.reserve(max_instances);
 
-        // apply instance-specific density adjustment:
-        density *= instance.coverage();
+    std::vector<float> cull;
+    cull.reserve(max_instances);
 
-#if 0
-        // Removed, because this is causing the placement to go non-deterministic
-        // for some reason that I have not yet identified.
-        const float edge_threshold = 0.10f;
-        if (scaleWithDensity && density < edge_threshold)
+    for (auto& candidates : cells)
+    {
+        for (auto& candidate : candidates)
         {
-            float edginess = (density / edge_threshold);
-            scale *= edginess;
-        }
-#endif
+            Placement& p = candidate.placement;
 
-        // tile-local coordinates of the position:
-        osg::Vec2d local(
-            local_bbox.xMin() + u * local_width,
-            local_bbox.yMin() + v * local_height);
+            if (overlap < 1.0f)
+            {
+                // To prevent overlap, write positions and radii to an r-tree.
+                // scale the asset bounding box in preparation for collision:
+                const auto& aabb = p.asset()->boundingBox();
+                const osg::Vec2d& local = p.localPoint();
+                const osg::Vec3f& scale = p.scale();
 
-        bool pass = true;
+                double so = (1.0 - overlap);
+                double a_min[2] = { local.x() + aabb.xMin() * scale.x() * so, local.y() + aabb.yMin() * scale.y() * so };
+                double a_max[2] = { local.x() + aabb.xMax() * scale.x() * so, local.y() + aabb.yMax() * scale.y() * so };
+
+                if (index.Search(a_min, a_max) > 0)
+                    continue;
 
-        if (overlap < 1.0f)
-        {
-            // To prevent overlap, write positions and radii to an r-tree. 
-            // TODO: consider using a Blend2d raster to update the 
-            // density/lifemap raster as we place objects..?
-            pass = false;
-
-            // scale the asset bounding box in preparation for collision:
-            const auto& aabb = asset->boundingBox();
-
-            double so = (1.0 - overlap);
-            double a_min[2] = { local.x() + aabb.xMin() * scale.x() * so, local.y() + aabb.yMin() * scale.y() * so };
-            double a_max[2] = { local.x() + aabb.xMax() * scale.x() * so, local.y() + aabb.yMax() * scale.y() * so };
-            
-            if (index.Search(a_min, a_max) == 0)
-            {
                 index.Insert(a_min, a_max, 0);
-                pass = true;
             }
-        }
 
-        if (pass)
-        {
-            osg::Vec3d map_point(e.xMin() + u * e.width(), e.yMin() + v * e.height(), 0);
+            if (candidate.constrained)
+                continue;
 
-            if (!inConstrainedRegion(map_point.x(), map_point.y(), constraints))
-            {
-                map_points.emplace_back(map_point);
-
-                Placement p;
-                p.localPoint() = local;
-                p.uv().set(u, v);
-                p.scale() = scale;
-                p.rotation() = rotation_rand * 3.1415927 * 2.0;
-                p.asset() = asset;
-                p.density() = density;
-                p.biome = biome;
-
-                result.emplace_back(std::move(p));
-            }
-            else
-            {
-                if (debug) OE_INFO << LC << "Instance " << i << " is in a constrained region" << std::endl;
-            }
+            cull.push_back(candidate.cull);
+            result.emplace_back(std::move(p));
         }
     }
 
@@ -1623,24 +1702,23 @@ VegetationLayer::getAssetPlacements(
     std::vector<Placement> result_culled;
     result_culled.reserve(result.size());
 
-    std::vector<osg::Vec3d> map_points_culled;
-    map_points_culled.reserve(result.size());
+    std::vector<osg::Vec3d> map_points;
+    map_points.reserve(result.size());
 
-    for (int i = 0; i < result.size(); ++i)
+    for (unsigned i = 0; i < result.size(); ++i)
     {
         Placement& p = result[i];
 
-        if (RAND() <= p.density())
+        if (cull[i] <= p.density())
         {
+            map_points.emplace_back(p.mapPoint());
             result_culled.emplace_back(std::move(p));
-            map_points_culled.emplace_back(std::move(map_points[i]));
         }
     }
 
     if (debug) OE_INFO << LC << (result.size()-result_culled.size()) << " instances removed due to density" << std::endl;
 
     std::swap(result, result_culled);
-    std::swap(map_points, map_points_culled);
 
     if (debug) OE_INFO << LC << "Final instance count = " << result.size() << std::endl;
 
@@ -1658,16 +1736,7 @@ VegetationLayer::getAssetPlacements(
         result[i].mapPoint() = std::move(map_points[i]);
     }
 
-#if 0
-    // print warnings about empty biomes
-    if (!empty_biomes.empty())
-    {
-        for (auto biome : empty_biomes)
-        {
-            OE_WARN << LC << "No assets defined in group " << AssetGroup::name(group) << " for biome " << biome->id() << std::endl;
-        }
-    }
-#endif
+    _placementCache.insert(cacheKey, std::make_shared<const std::vector<Placement>>(result));
 
     output = std::move(result);
     return true;
@@ -1787,6 +1856,7 @@ VegetationLayer::simulateAssetPlacement(const GeoPoint& point, const std::string
             {
                 std::lock_guard<std::mutex> lock(_assets.mutex());
                 _assets = std::move(newAssets);
+                ++_assetsRevision;
             }
         }
 
@@ -1932,6 +2002,9 @@ VegetationLayer::createDrawable(
 
     result->setName(key.str() + " Vegetation");
 
+    if (key.getProfile()->getSRS()->isGeographic())
+        result->setEllipsoid(key.getProfile()->getSRS()->getEllipsoid());
+
     for (auto& p : placements)
     {
         osg::Matrixd xform;